@@ -284,5 +284,8 @@
 #ifndef MHD_DAUTH_DEF_MAX_NC_
 #  define MHD_DAUTH_DEF_MAX_NC_ 1000
 #endif /* ! MHD_DAUTH_DEF_MAX_NC_ */
+#ifndef MHD_BAUTH_CACHE_DEF_TIMEOUT_
+#  define MHD_BAUTH_CACHE_DEF_TIMEOUT_ 60
+#endif /* ! MHD_BAUTH_CACHE_DEF_TIMEOUT_ */
 
 #endif /* MHD_OPTIONS_H */
@@ -101,7 +101,7 @@ MHD_C_DECLRATIONS_START_HERE_
  * they are parsed as decimal numbers.
  * Example: 0x01093001 = 1.9.30-1.
  */
-#define MHD_VERSION 0x01000101
+#define MHD_VERSION 0x01000102
 
 /* If generic headers don't work on your platform, include headers
    which define 'va_list', 'size_t', 'ssize_t', 'intptr_t', 'off_t',
@@ -1090,6 +1090,12 @@ MHD_get_reason_phrase_len_for (unsigned int code);
  * @defgroup versions HTTP versions
  * These strings should be used to match against the first line of the
  * HTTP header.
+ *
+ * Only HTTP/1.0 and HTTP/1.1 are implemented, HTTP/2 is not supported.
+ * TLS connections negotiate only "http/1.1" or "http/1.0" by ALPN.
+ * The clients using HTTP/2 with prior knowledge on the cleartext
+ * connections get the HTTP/2 SETTINGS frame followed by the GOAWAY frame
+ * with HTTP_1_1_REQUIRED error code, then the connection is closed.
  * @{
  */
 #define MHD_HTTP_VERSION_1_0 "HTTP/1.0"
@@ -1826,6 +1832,10 @@ enum MHD_OPTION
    * greater than 1.
    * Can be used only for daemons started with #MHD_USE_INTERNAL_POLLING_THREAD.
    * Ignored if followed by zero value.
+   * Only the first thread is started by #MHD_start_daemon(), the next
+   * thread (with its inter-thread communication channel and epoll FD)
+   * is started when the last started thread gets a connection, so
+   * the idle daemons do not spend resources on unused threads.
    */
   MHD_OPTION_THREAD_POOL_SIZE = 14,
 
@@ -1896,6 +1906,8 @@ enum MHD_OPTION
    * handle several clients simultaneously.
    * If Digest Auth is not used, this option can be set to zero to minimise
    * memory allocation.
+   * The map is allocated when the first nonce is generated, so large
+   * map does not slow down the start of the daemon.
    */
   MHD_OPTION_NONCE_NC_SIZE = 18,
 
@@ -2197,10 +2209,375 @@ enum MHD_OPTION
    * @note Available since #MHD_VERSION 0x00097709
    */
   MHD_OPTION_DIGEST_AUTH_DEFAULT_MAX_NC = 42
+  ,
+  /**
+   * Register a function that should be called whenever the set of
+   * network events MHD is interested in changes for any of the daemon's
+   * sockets (the listen socket, the inter-thread communication channel and
+   * the connections' sockets).
+   * With this option MHD does not poll the sockets and does not need
+   * #MHD_get_fdset2() / #MHD_run_from_select2(): the application watches
+   * the sockets in its own event loop (libuv, libevent, etc.) and reports
+   * readiness of the individual sockets by #MHD_run_watched().
+   * The cost of the processing is proportional to the number of active
+   * sockets, not to the total number of connections.
+   * Can be used only for daemons without #MHD_USE_INTERNAL_POLLING_THREAD
+   * and without #MHD_USE_EPOLL.  Cannot be combined with #MHD_USE_TLS
+   * if #MHD_ALLOW_UPGRADE is used.
+   * Should be used together with #MHD_OPTION_WATCH_TIMER_CALLBACK.
+   *
+   * This option should be followed by TWO pointers.  First a pointer
+   * to a function of type #MHD_WatchSocketCallback and second a
+   * pointer to a closure to pass to the callback.
+   * The second pointer may be NULL.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_WATCH_SOCKET_CALLBACK = 43
+  ,
+  /**
+   * Register a function that should be called whenever the time of
+   * the next required call of #MHD_run_watched() changes.
+   * Used only together with #MHD_OPTION_WATCH_SOCKET_CALLBACK.
+   *
+   * This option should be followed by TWO pointers.  First a pointer
+   * to a function of type #MHD_WatchTimerCallback and second a
+   * pointer to a closure to pass to the callback.
+   * The second pointer may be NULL.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_WATCH_TIMER_CALLBACK = 44
+  ,
+  /**
+   * The maximum number of the parked connection threads.
+   * With #MHD_USE_THREAD_PER_CONNECTION MHD normally creates a new thread
+   * for every connection and the thread exits when the connection is
+   * closed.  When this option is set to non-zero value, the thread is
+   * parked when connection is finished and reused for the next
+   * connection, saving the thread creation and destruction cost.
+   * If the number of the parked threads already reached this value, the
+   * thread exits as usual.
+   * Can be used only with #MHD_USE_THREAD_PER_CONNECTION.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero (threads are not reused).
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_THREAD_REUSE_MAX_IDLE = 45
+  ,
+  /**
+   * The number of the parked connection threads that are kept even if
+   * they are idle longer than #MHD_OPTION_THREAD_REUSE_IDLE_TIMEOUT.
+   * Used only together with #MHD_OPTION_THREAD_REUSE_MAX_IDLE.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_THREAD_REUSE_MIN_IDLE = 46
+  ,
+  /**
+   * The time (in seconds) after which the parked connection thread
+   * exits if it has not got a new connection.
+   * Zero means that parked threads never exit (until the daemon is
+   * stopped).
+   * Used only together with #MHD_OPTION_THREAD_REUSE_MAX_IDLE.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is 60 seconds.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_THREAD_REUSE_IDLE_TIMEOUT = 47
+  ,
+  /**
+   * The number of the threads calling the access handler
+   * (#MHD_AccessHandlerCallback) outside of the daemon's thread.
+   * When this option is set to non-zero value, the calls of the access
+   * handler without upload data (the first call and the final call) are
+   * performed by the separate handler threads, while the connection is
+   * automatically suspended.  The connection is resumed when the handler
+   * returns.  This keeps the daemon's threads responsive when the access
+   * handler blocks (for example, on database requests).
+   * The calls with upload data are still performed by the daemon's thread.
+   * The handler may queue the response or suspend the connection as usual.
+   * Automatically enables #MHD_ALLOW_SUSPEND_RESUME.
+   * Cannot be used with #MHD_USE_THREAD_PER_CONNECTION.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero (the handler is called by the daemon's thread).
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_HANDLER_OFFLOAD_THREADS = 48
+  ,
+  /**
+   * The maximum number of the access handler calls waiting for the
+   * handler thread.  When the limit is reached, the new requests are
+   * rejected with #MHD_HTTP_SERVICE_UNAVAILABLE.
+   * Used only together with #MHD_OPTION_HANDLER_OFFLOAD_THREADS.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero (no limit).
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_HANDLER_OFFLOAD_QUEUE_LIMIT = 49
+  ,
+  /**
+   * The routes of the built-in URL router.
+   * This option should be followed by a `const struct MHD_Route *`
+   * argument, pointing to the array of routes terminated by the entry
+   * with NULL `path`.  The routes are compiled when the daemon starts,
+   * the array is not used after #MHD_start_daemon() returns.
+   * The request is routed once, when the request line is received:
+   * the handler of the matching route is used instead of the default
+   * access handler for all calls for this request.  If no route
+   * matches the URL and the method, the default handler is used.
+   * The values of the path parameters are available by
+   * #MHD_get_route_param().
+   * The daemon fails to start if the routes are invalid or conflicting.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_ROUTES = 50
+  ,
+  /**
+   * The minimal size of the response body data to send with
+   * MSG_ZEROCOPY, avoiding the copy of the data to the kernel buffers.
+   * Used only for non-TLS connections for the responses with the data
+   * in memory (created by #MHD_create_response_from_buffer() and similar
+   * functions or by #MHD_create_response_from_iovec()) when the connection
+   * is kept alive after the response.
+   * The response is kept referenced (and the data is not freed) until
+   * the kernel reports that the data has been sent.  The application
+   * must not modify the response data until the response is destroyed.
+   * Zero-copy send has a fixed overhead of the notifications processing,
+   * it is beneficial for the large bodies only; the threshold of several
+   * hundreds kilobytes is a reasonable starting point.
+   * This option should be followed by a `size_t` argument.
+   * The default is zero (zero-copy send is not used).
+   * Ignored on platforms without MSG_ZEROCOPY.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_ZEROCOPY_THRESHOLD = 51
+  ,
+  /**
+   * The number of the threads reading the file data for the responses
+   * created by #MHD_create_response_from_fd() (and similar functions)
+   * or by #MHD_create_response_from_segments() when the data cannot
+   * be sent by sendfile() (for example, for TLS connections or for
+   * the chunked replies).
+   * When this option is set to non-zero value, the next block of the
+   * response data is read by the separate threads into the connection's
+   * memory pool while the connection is automatically suspended.  The
+   * connection is resumed when the data is ready, so slow disk reads
+   * do not block the processing of other connections.
+   * The responses from pipes are always read by the daemon's thread.
+   * Automatically enables #MHD_ALLOW_SUSPEND_RESUME.
+   * Cannot be used with #MHD_USE_THREAD_PER_CONNECTION.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero (the data is read by the daemon's thread).
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_FILE_READ_THREADS = 52
+  ,
+  /**
+   * The size of the memory slabs for the per-connection memory pools.
+   * When this option is set to non-zero value, the memory pools of the
+   * connections are taken from the large memory areas (slabs) allocated
+   * and pre-faulted when the daemon starts, instead of the separate
+   * allocation of every pool.  The connection setup does not cause
+   * the page faults and the memory of many connections uses fewer TLB
+   * entries, especially with #MHD_OPTION_CONNECTION_MEMORY_HUGE_PAGES.
+   * Each worker thread of the thread pool has its own slabs.  The new
+   * slab is allocated when all pools of the existing slabs are in use.
+   * The size of the slab that fits the pools of all expected connections
+   * of the thread is a reasonable choice.
+   * This option should be followed by a `size_t` argument.
+   * The default is zero (the slabs are not used).
+   * Ignored on platforms without anonymous mmap().
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_CONNECTION_MEMORY_SLAB_SIZE = 53
+  ,
+  /**
+   * The use of the huge memory pages for the memory slabs.
+   * Used only together with #MHD_OPTION_CONNECTION_MEMORY_SLAB_SIZE.
+   * This option should be followed by an `unsigned int` argument with
+   * one of the #MHD_HugePagesMode values.
+   * The default is #MHD_HUGE_PAGES_NONE.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_CONNECTION_MEMORY_HUGE_PAGES = 54
+  ,
+  /**
+   * The profiling and debugging of the per-connection memory pools.
+   * With #MHD_MEMORY_PROFILE_COLLECT the daemon records the high-water
+   * marks of the connection memory use for every request, the collected
+   * histograms are available via #MHD_get_daemon_info() with
+   * #MHD_DAEMON_INFO_MEMORY_PROFILE.  The data could be used to choose
+   * the values for #MHD_OPTION_CONNECTION_MEMORY_LIMIT and
+   * #MHD_OPTION_CONNECTION_MEMORY_INCREMENT.
+   * With #MHD_MEMORY_PROFILE_GUARD_PAGES every memory pool is followed by
+   * the inaccessible memory page, so any overrun of the pool is caught
+   * immediately; #MHD_OPTION_CONNECTION_MEMORY_SLAB_SIZE is ignored in
+   * this mode.
+   * This option should be followed by an `unsigned int` argument with
+   * the combination of #MHD_MemoryProfileFlags values.
+   * The default is #MHD_MEMORY_PROFILE_NONE.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_CONNECTION_MEMORY_PROFILE = 55
+  ,
+  /**
+   * The busy polling time for the epoll-based event loop.
+   * Before blocking in epoll_wait(), the event loop polls the sockets
+   * without blocking for up to the specified number of microseconds.
+   * The busy polling reduces the latency of the requests processing at
+   * the cost of the CPU time: the polling thread keeps the CPU core busy
+   * while waiting for the network activity.  Recommended only for the
+   * threads running on the dedicated CPU cores, typically together with
+   * #MHD_USE_TURBO.
+   * The busy polling is not used when some data is already pending for
+   * processing, as the event loop does not wait in such case.
+   * Used only with #MHD_USE_EPOLL or #MHD_USE_EPOLL_INTERNAL_THREAD,
+   * ignored for other polling functions.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero (no busy polling).
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_EPOLL_BUSY_POLL = 56
+  ,
+  /**
+   * The size of the events array used by the epoll-based event loop:
+   * the maximum number of the events received by a single epoll_wait()
+   * call.  With the thread pool every worker thread has its own array.
+   * Larger values reduce the number of epoll_wait() calls when many
+   * connections are active at the same time.
+   * Used only with #MHD_USE_EPOLL or #MHD_USE_EPOLL_INTERNAL_THREAD,
+   * ignored for other polling functions.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is 128; zero means the default value.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_EPOLL_EVENTS_SIZE = 57
+  ,
+  /**
+   * The callback used by #MHD_basic_auth_verify() to check the Basic
+   * Authentication credentials sent by the client.
+   * This option should be followed by two arguments:
+   *  - #MHD_BasicAuthVerifyCallback the callback to check the credentials,
+   *  - `void *` the closure for the callback.
+   * @note Available since #MHD_VERSION 0x01000102
+   * @ingroup authentication
+   */
+  MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK = 58
+  ,
+  /**
+   * The maximum number of the entries in the cache of the verified
+   * Basic Authentication credentials used by #MHD_basic_auth_verify().
+   * The cache stores only the keyed hashes of the verified "Authorization"
+   * headers, the credentials are never stored.  When the same header is
+   * received again, the credentials are reported as valid without
+   * decoding the header and without calling the verify callback.
+   * With the thread pool the cache is shared by all worker threads.
+   * The key of the hashes is taken from the system entropy source
+   * (getrandom() or "/dev/urandom"), the daemon fails to start if
+   * the source is not available.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is zero (the cache is not used).
+   * The cache is available only when the library is built with
+   * the SHA-256 support, the option is ignored otherwise.
+   * @note Available since #MHD_VERSION 0x01000102
+   * @ingroup authentication
+   */
+  MHD_OPTION_BASIC_AUTH_CACHE_SIZE = 59
+  ,
+  /**
+   * The time, in seconds, after which the verified Basic Authentication
+   * credentials are removed from the cache and checked by the verify
+   * callback again.  Changes of the credentials made by the application
+   * (like removal of the user or change of the password) may be unnoticed
+   * for the cached credentials until this time is expired.
+   * This option should be followed by an `unsigned int` argument.
+   * The default is 60 seconds.  Zero means the default value.
+   * @sa #MHD_OPTION_BASIC_AUTH_CACHE_SIZE
+   * @note Available since #MHD_VERSION 0x01000102
+   * @ingroup authentication
+   */
+  MHD_OPTION_BASIC_AUTH_CACHE_TIMEOUT = 60
+  ,
+  /**
+   * The callback to report the progress of the connections draining
+   * started by #MHD_drain_daemon().
+   * This option should be followed by two arguments:
+   *  - #MHD_DrainCallback the callback,
+   *  - `void *` the closure for the callback.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_DRAIN_CALLBACK = 61
+  ,
+  /**
+   * The callback to take over the idle connections while the daemon is
+   * drained by #MHD_drain_daemon().
+   * When set, the idle keep-alive connections (and the connections
+   * without any received data) are not closed by draining, instead their
+   * sockets are detached from the daemon and given to the callback.
+   * The connections with the requests in progress are still finished and
+   * closed as usual.  TLS connections are always closed.
+   * This option should be followed by two arguments:
+   *  - #MHD_HandoffCallback the callback,
+   *  - `void *` the closure for the callback.
+   * @sa #MHD_handoff_send_socket(), #MHD_handoff_receive_socket()
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_OPTION_DRAIN_HANDOFF_CALLBACK = 62
 
 } _MHD_FIXED_ENUM;
 
 
+/**
+ * The use of the huge memory pages for the connections memory.
+ * @see #MHD_OPTION_CONNECTION_MEMORY_HUGE_PAGES
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+enum MHD_HugePagesMode
+{
+  /**
+   * Use the normal memory pages.
+   */
+  MHD_HUGE_PAGES_NONE = 0
+  ,
+  /**
+   * Use the transparent huge pages, if supported by the platform.
+   */
+  MHD_HUGE_PAGES_TRANSPARENT = 1
+  ,
+  /**
+   * Use the explicit (pre-reserved) huge pages, if available.
+   * Falls back to the transparent huge pages if the explicit huge pages
+   * are not available.
+   */
+  MHD_HUGE_PAGES_EXPLICIT = 2
+} _MHD_FIXED_ENUM;
+
+
+/**
+ * The flags for the profiling and debugging of the connections memory.
+ * @see #MHD_OPTION_CONNECTION_MEMORY_PROFILE
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+enum MHD_MemoryProfileFlags
+{
+  /**
+   * No profiling, no debugging.
+   */
+  MHD_MEMORY_PROFILE_NONE = 0
+  ,
+  /**
+   * Collect the histograms of the connection memory use.
+   */
+  MHD_MEMORY_PROFILE_COLLECT = 1 << 0
+  ,
+  /**
+   * Put the inaccessible guard page after every connection memory pool,
+   * if supported by the platform.
+   */
+  MHD_MEMORY_PROFILE_GUARD_PAGES = 1 << 1
+} _MHD_FIXED_FLAGS_ENUM;
+
+
 /**
  * Bitfield for the #MHD_OPTION_SERVER_INSANITY specifying
  * which santiy checks should be disabled.
@@ -2621,6 +2998,18 @@ enum MHD_DaemonInfoType
    * value will be real port number.
    */
   MHD_DAEMON_INFO_BIND_PORT
+  ,
+  /**
+   * Request the histograms of the connection memory use.
+   * Available only if the daemon was started with
+   * #MHD_OPTION_CONNECTION_MEMORY_PROFILE with #MHD_MEMORY_PROFILE_COLLECT.
+   * No extra arguments should be passed.
+   * Note: when using MHD in "external" polling mode, this type of request
+   * could be used only when #MHD_run()/#MHD_run_from_select is not
+   * working in other thread at the same time.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_DAEMON_INFO_MEMORY_PROFILE
 } _MHD_FIXED_ENUM;
 
 
@@ -2730,6 +3119,104 @@ typedef enum MHD_Result
                              void **req_cls);
 
 
+/**
+ * The methods of the route for the #MHD_OPTION_ROUTES.
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+enum MHD_RouteMethod
+{
+  /**
+   * "GET" method.
+   */
+  MHD_ROUTE_GET = 1 << 0,
+
+  /**
+   * "HEAD" method.
+   */
+  MHD_ROUTE_HEAD = 1 << 1,
+
+  /**
+   * "POST" method.
+   */
+  MHD_ROUTE_POST = 1 << 2,
+
+  /**
+   * "PUT" method.
+   */
+  MHD_ROUTE_PUT = 1 << 3,
+
+  /**
+   * "DELETE" method.
+   */
+  MHD_ROUTE_DELETE = 1 << 4,
+
+  /**
+   * "CONNECT" method.
+   */
+  MHD_ROUTE_CONNECT = 1 << 5,
+
+  /**
+   * "OPTIONS" method.
+   */
+  MHD_ROUTE_OPTIONS = 1 << 6,
+
+  /**
+   * "TRACE" method.
+   */
+  MHD_ROUTE_TRACE = 1 << 7,
+
+  /**
+   * Any other method.
+   */
+  MHD_ROUTE_OTHER = 1 << 8,
+
+  /**
+   * Any method.
+   */
+  MHD_ROUTE_ANY = (1 << 9) - 1
+} _MHD_FIXED_FLAGS_ENUM;
+
+
+/**
+ * The route for the #MHD_OPTION_ROUTES.
+ *
+ * The @a path must start with '/'.  The path segment started with ':'
+ * (like "/users/:id") is the parameter, matching any non-empty segment
+ * of the request URL.  The path segment started with '*' (like the
+ * last segment "*path" in the "/files/" "*path") is the wildcard,
+ * matching the rest of the URL
+ * (possibly empty); the wildcard must be the last element of the path.
+ * Up to 16 parameters are supported in a single route.
+ * The static segments have priority over the parameters, the parameters
+ * have priority over the wildcards.
+ * The URL is matched after the percent-decoding, without the query
+ * string.
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+struct MHD_Route
+{
+  /**
+   * The set of #MHD_RouteMethod flags, zero for any method.
+   */
+  unsigned int methods;
+
+  /**
+   * The path of the route, NULL to terminate the array of routes.
+   */
+  const char *path;
+
+  /**
+   * The handler for the requests matching the route.
+   */
+  MHD_AccessHandlerCallback handler;
+
+  /**
+   * The closure for the @a handler.
+   */
+  void *handler_cls;
+};
+
+
 /**
  * Signature of the callback used by MHD to notify the
  * application about completed requests.
@@ -2775,6 +3262,155 @@ typedef void
                                  enum MHD_ConnectionNotificationCode toe);
 
 
+/**
+ * Signature of the callback used by MHD to report the progress of
+ * the connections draining started by #MHD_drain_daemon().
+ *
+ * The callback is called when draining is started and then every time
+ * when some connections are closed.  When the thread pool is used, the
+ * callback could be called by different threads, but the calls are
+ * serialised: the callback is never called by several threads at
+ * the same time.  The same number of connections (including zero) could
+ * be reported more than once.
+ *
+ * @param cls client-defined closure
+ * @param connections_left the number of the connections not closed yet
+ *                         (including the suspended connections),
+ *                         zero when draining is complete
+ * @see #MHD_OPTION_DRAIN_CALLBACK
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+typedef void
+(*MHD_DrainCallback) (void *cls,
+                      unsigned int connections_left);
+
+
+/**
+ * Signature of the callback used by MHD to give the idle connection
+ * to the application while draining the daemon.
+ *
+ * The socket is not managed by MHD anymore: the application must close
+ * it or pass it to another daemon (typically in another process by
+ * #MHD_handoff_send_socket()) where it could be added by
+ * #MHD_add_connection().  The socket has no data buffered by MHD: any
+ * data sent by the client after the last request is still in the socket
+ * and will be processed by the new owner.
+ * The callback is called by the thread processing the connection.
+ *
+ * @param cls client-defined closure
+ * @param sock the socket of the connection
+ * @param addr the address of the client
+ * @param addrlen the length of the @a addr
+ * @see #MHD_OPTION_DRAIN_HANDOFF_CALLBACK
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+typedef void
+(*MHD_HandoffCallback) (void *cls,
+                        MHD_socket sock,
+                        const struct sockaddr *addr,
+                        socklen_t addrlen);
+
+
+/**
+ * The network events for the sockets watched by the application.
+ * @see #MHD_OPTION_WATCH_SOCKET_CALLBACK, #MHD_run_watched()
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+enum MHD_WatchEvents
+{
+  /**
+   * No events.
+   * When used as the interest: the socket must not be watched for now,
+   * but it is still managed by MHD.
+   */
+  MHD_WATCH_EVENT_NONE = 0,
+
+  /**
+   * The socket has some data to receive / MHD needs to receive data.
+   */
+  MHD_WATCH_EVENT_RECV = 1 << 0,
+
+  /**
+   * The socket is ready to send / MHD needs to send data.
+   */
+  MHD_WATCH_EVENT_SEND = 1 << 1,
+
+  /**
+   * An error or a hang-up has been detected on the socket.
+   * Used only for reporting events by #MHD_run_watched(), errors are
+   * always of interest for MHD.
+   */
+  MHD_WATCH_EVENT_ERROR = 1 << 2,
+
+  /**
+   * Used only as the interest: the socket is going to be closed or it is
+   * no longer managed by MHD.  The application must stop watching the
+   * socket and must release the resources associated with the socket.
+   */
+  MHD_WATCH_EVENT_REMOVE = 1 << 3
+} _MHD_FIXED_FLAGS_ENUM;
+
+
+/**
+ * Signature of the callback used by MHD to notify the application
+ * about the changes of the network events MHD is interested in for
+ * the socket.
+ *
+ * The callback is called when the socket must be added to the watched
+ * set (first call for the socket), every time when the interest is changed
+ * and, finally, with #MHD_WATCH_EVENT_REMOVE when the socket must be
+ * removed from the watched set.
+ * The callback must not call any MHD functions.
+ *
+ * @param cls client-defined closure
+ * @param fd the socket to watch
+ * @param interest the bitwise OR combination of #MHD_WATCH_EVENT_RECV
+ *                 and #MHD_WATCH_EVENT_SEND, or #MHD_WATCH_EVENT_NONE
+ *                 if the socket should not be watched for now,
+ *                 or #MHD_WATCH_EVENT_REMOVE
+ * @param mhd_sckt_ctx the MHD's context of the socket, must be passed to
+ *                     #MHD_run_watched() when any event is detected
+ * @param app_sckt_ctx the pointer to the application's context of the
+ *                     socket, initially set to NULL, the application may
+ *                     store here any value, the same pointer is provided
+ *                     for all calls for the same socket
+ * @see #MHD_OPTION_WATCH_SOCKET_CALLBACK
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup event
+ */
+typedef void
+(*MHD_WatchSocketCallback) (void *cls,
+                            MHD_socket fd,
+                            enum MHD_WatchEvents interest,
+                            void *mhd_sckt_ctx,
+                            void **app_sckt_ctx);
+
+
+/**
+ * Signature of the callback used by MHD to notify the application
+ * about the change of the time of the next required call of
+ * #MHD_run_watched() (when no network activity is detected).
+ *
+ * The callback must not call any MHD functions.
+ * The later time is not reported while the timer already set has not
+ * fired yet: the timer is set again by #MHD_run_watched() called when
+ * the timer fires.
+ *
+ * @param cls client-defined closure
+ * @param timeout_ms the number of milliseconds (starting from now) when
+ *                   #MHD_run_watched() with NULL socket context must be
+ *                   called,
+ *                   zero if it must be called as soon as possible,
+ *                   -1 if the timer should be cancelled
+ * @see #MHD_OPTION_WATCH_TIMER_CALLBACK
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup event
+ */
+typedef void
+(*MHD_WatchTimerCallback) (void *cls,
+                           int64_t timeout_ms);
+
+
 /**
  * Iterator over key-value pairs.  This iterator
  * can be used to iterate over all of the cookies,
@@ -2889,6 +3525,41 @@ typedef void
 (*MHD_ContentReaderFreeCallback) (void *cls);
 
 
+/**
+ * Callback used by libmicrohttpd to obtain the next block of the
+ * response body without copying it.
+ *
+ * Instead of copying the data to the buffer provided by MHD, the
+ * application returns the pointer to its own data.  The data is sent
+ * directly from this memory (by vectored send when possible) and must
+ * stay valid and unchanged until @a release is called by MHD.
+ * MHD may use only the initial part of the returned data; in this case
+ * the callback is called again for the rest of the data, with @a pos
+ * advanced by the used size only.
+ *
+ * @param cls extra argument to the callback
+ * @param pos position in the datastream to access, the same rules
+ *        as for #MHD_ContentReaderCallback apply
+ * @param[out] data set to the pointer to the block of the data
+ * @param[out] release set to the function to be called when the data
+ *                     is not used by MHD anymore, could be set to NULL
+ * @param[out] release_cls set to the argument for @a release
+ * @return the size of the data at @a data;
+ *  the value 0 and the special values #MHD_CONTENT_READER_END_OF_STREAM
+ *  and #MHD_CONTENT_READER_END_WITH_ERROR are processed in the same way
+ *  as for #MHD_ContentReaderCallback; @a release is not called if the
+ *  returned value is not positive
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup response
+ */
+typedef ssize_t
+(*MHD_ContentBorrowCallback) (void *cls,
+                              uint64_t pos,
+                              const void **data,
+                              MHD_ContentReaderFreeCallback *release,
+                              void **release_cls);
+
+
 /**
  * Iterator over key-value pairs where the value
  * may be made available in increments and/or may
@@ -3002,6 +3673,86 @@ _MHD_EXTERN MHD_socket
 MHD_quiesce_daemon (struct MHD_Daemon *daemon);
 
 
+/**
+ * Gracefully close all connections of the daemon.
+ *
+ * The daemon stops accepting new connections (as with
+ * #MHD_quiesce_daemon(), but the listen socket is still closed by
+ * #MHD_stop_daemon()), the idle keep-alive connections are closed (or
+ * given to the callback set by #MHD_OPTION_DRAIN_HANDOFF_CALLBACK), the
+ * responses of the requests in progress are sent with "Connection: close"
+ * header and connections are closed once the responses are sent.
+ * Connections not closed within @a timeout_ms milliseconds are closed
+ * forcibly.
+ * The progress is reported by the callback set by
+ * #MHD_OPTION_DRAIN_CALLBACK.
+ *
+ * The daemon must be still run (by the internal threads or by the
+ * application) until draining is complete; after that #MHD_stop_daemon()
+ * could be called to stop the daemon without breaking any request.
+ * The suspended connections are not closed until they are resumed or
+ * the daemon is stopped.
+ *
+ * As with #MHD_quiesce_daemon(), some thread modes require #MHD_USE_ITC.
+ *
+ * @param daemon the daemon to drain
+ * @param timeout_ms the maximum time in milliseconds given to the requests
+ *                   in progress to be completed
+ * @return #MHD_YES if draining is started,
+ *         #MHD_NO if draining is not supported in the daemon mode or
+ *         draining has been started already
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup specialized
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_drain_daemon (struct MHD_Daemon *daemon,
+                  unsigned int timeout_ms);
+
+
+/**
+ * Send the socket to another process over the local (UNIX domain)
+ * socket.
+ *
+ * Could be used to pass the listen socket returned by
+ * #MHD_quiesce_daemon() and the connections given by
+ * #MHD_OPTION_DRAIN_HANDOFF_CALLBACK to the new instance of the
+ * server, so the server could be replaced without breaking or refusing
+ * the client connections.
+ * The @a sock is not closed by this function.
+ *
+ * @param local_socket the connected local socket
+ * @param sock the socket to send
+ * @return #MHD_YES on success,
+ *         #MHD_NO on error or if sending sockets is not supported
+ *         by the platform
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup specialized
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_handoff_send_socket (MHD_socket local_socket,
+                         MHD_socket sock);
+
+
+/**
+ * Receive the socket sent by #MHD_handoff_send_socket().
+ *
+ * The received listen socket could be used with
+ * #MHD_OPTION_LISTEN_SOCKET, the received connection could be added by
+ * #MHD_add_connection() with the address obtained by getpeername().
+ * This function blocks if @a local_socket is blocking and no socket
+ * has been sent yet.
+ *
+ * @param local_socket the connected local socket
+ * @return the received socket,
+ *         #MHD_INVALID_SOCKET on error or if receiving sockets is not
+ *         supported by the platform
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup specialized
+ */
+_MHD_EXTERN MHD_socket
+MHD_handoff_receive_socket (MHD_socket local_socket);
+
+
 /**
  * Shutdown an HTTP daemon.
  *
@@ -3515,11 +4266,56 @@ MHD_run_from_select2 (struct MHD_Daemon *daemon,
 #define MHD_run_from_select(d,r,w,e) \
   MHD_run_from_select2((d),(r),(w),(e),(unsigned int)(FD_SETSIZE))
 
+
+/**
+ * Run webserver operations for the socket watched by the application.
+ * This function must be used (instead of #MHD_run() and
+ * #MHD_run_from_select2()) by the daemons started with
+ * #MHD_OPTION_WATCH_SOCKET_CALLBACK.
+ *
+ * The function processes the events reported for the socket, then
+ * processes connections that have some data pending and timed-out
+ * connections.  All changes of the watched sockets set and of the timer
+ * are reported by callbacks before this function returns.
+ *
+ * The function must be called with NULL @a mhd_sckt_ctx when the timer
+ * set by #MHD_WatchTimerCallback is expired.  It should be called with NULL
+ * @a mhd_sckt_ctx as well after resuming of any suspended connection and
+ * after #MHD_add_connection() if the daemon was not started with
+ * #MHD_USE_ITC flag.
+ *
+ * This function cannot be used with daemon started with
+ * #MHD_USE_INTERNAL_POLLING_THREAD flag.
+ *
+ * @param daemon the daemon to run
+ * @param mhd_sckt_ctx the MHD's context of the socket, as provided
+ *                     to the #MHD_WatchSocketCallback, or NULL if
+ *                     only timer is expired
+ * @param events the detected events, the bitwise OR combination of
+ *               #MHD_WATCH_EVENT_RECV, #MHD_WATCH_EVENT_SEND and
+ *               #MHD_WATCH_EVENT_ERROR,
+ *               ignored if @a mhd_sckt_ctx is NULL
+ * @return #MHD_NO on serious errors or if the daemon was not started with
+ *         the right options for this call, #MHD_YES on success
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup event
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_run_watched (struct MHD_Daemon *daemon,
+                 void *mhd_sckt_ctx,
+                 unsigned int events);
+
 /* **************** Connection handling functions ***************** */
 
 /**
  * Get all of the headers from the request.
  *
+ * The GET arguments and the cookies are parsed when they are requested
+ * for the first time.  If the memory pool of the connection has no space
+ * for them, the values that do not fit are not reported and MHD replies
+ * with "431 Request Header Fields Too Large" error when the access handler
+ * returns without queuing a response.
+ *
  * @param connection connection to get values from
  * @param kind types of values to iterate over, can be a bitmask
  * @param iterator callback to call on each header;
@@ -3702,6 +4498,23 @@ MHD_lookup_connection_value_n (struct MHD_Connection *connection,
                                size_t *value_size_ptr);
 
 
+/**
+ * Get the value of the path parameter captured by the built-in router.
+ *
+ * @param connection the connection to get the value from
+ * @param name the name of the parameter (without leading ':' or '*')
+ * @return the zero-terminated percent-decoded value of the parameter,
+ *         NULL if the request was not routed by the #MHD_OPTION_ROUTES
+ *         or the matched route has no such parameter;
+ *         the value is valid until the request is completed
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup request
+ */
+_MHD_EXTERN const char *
+MHD_get_route_param (struct MHD_Connection *connection,
+                     const char *name);
+
+
 /**
  * Queue a response to be transmitted to the client (as soon as
  * possible but after #MHD_AccessHandlerCallback returns).
@@ -3890,6 +4703,23 @@ enum MHD_ResponseFlags
    * @note Available since #MHD_VERSION 0x00097701
    */
   MHD_RF_HEAD_ONLY_RESPONSE = 1 << 4
+  ,
+  /**
+   * The content reader callback of the response (#MHD_ContentReaderCallback)
+   * is thread-safe and does not depend on the order of the calls: it can be
+   * called simultaneously for the different positions by the different
+   * connections.
+   * When the response is queued for several connections, each connection
+   * reads the data into its own buffer (allocated in the connection's
+   * memory pool) and the content reader is called without the response's
+   * lock, so the connections processed by different threads do not wait
+   * for each other.
+   * The responses created by #MHD_create_response_from_fd() (and similar
+   * functions, except the responses from pipes) and by
+   * #MHD_create_response_from_segments() are always processed this way.
+   * @note Available since #MHD_VERSION 0x01000102
+   */
+  MHD_RF_CONTENT_READER_THREAD_SAFE = 1 << 5
 } _MHD_FIXED_FLAGS_ENUM;
 
 
@@ -4314,6 +5144,112 @@ MHD_create_response_from_iovec (const struct MHD_IoVec *iov,
                                 void *cls);
 
 
+/**
+ * The segment of the response body: the region of the file or
+ * the memory buffer.
+ * @see #MHD_create_response_from_segments()
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+struct MHD_ResponseSegment
+{
+  /**
+   * The file descriptor of the file with the segment data,
+   * or -1 if the segment data is in memory.
+   */
+  int fd;
+
+  /**
+   * The offset of the segment data in the file.
+   * Ignored for the segments in memory.
+   */
+  uint64_t offset;
+
+  /**
+   * The pointer to the segment data in memory.
+   * Ignored for the file segments.
+   */
+  const void *data;
+
+  /**
+   * The size of the segment in bytes.
+   */
+  uint64_t size;
+};
+
+
+/**
+ * Create a response object with the body composed of the file regions
+ * and the memory buffers.
+ *
+ * The response body is the concatenation of all segments, in the order
+ * of the @a segments array.  Useful for "multipart/byteranges" replies,
+ * for concatenation of the media segments or for the archive-like bundles.
+ * The file segments are sent with sendfile() when possible, the
+ * consecutive memory segments are sent with a single vectored send.
+ * When sendfile() cannot be used (for example for TLS connections), the
+ * data is read from the files.
+ *
+ * The file descriptors are not closed by MHD, the application should
+ * close them (if needed) in @a free_cb.  The file descriptors should be
+ * in 'blocking' mode and must not be used for reading by the
+ * application while the response exists.
+ *
+ * The response object can be extended with header information and then
+ * be used any number of times.
+ *
+ * If response object is used to answer HEAD request then the body
+ * of the response is not used, while all headers (including automatic
+ * headers) are used.
+ *
+ * @param segments the array of the segments, an internal copy of this
+ *        will be made
+ * @param num_segments the number of elements in @a segments
+ * @param free_cb the callback to clean up any data associated with
+ *        @a segments (to close the files, to free the memory) when the
+ *        response is destroyed, could be NULL
+ * @param cls the argument passed to @a free_cb
+ * @return NULL on error (i.e. invalid arguments, out of memory)
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_create_response_from_segments (const struct MHD_ResponseSegment *segments,
+                                   unsigned int num_segments,
+                                   MHD_ContentReaderFreeCallback free_cb,
+                                   void *cls);
+
+
+/**
+ * Create a response object with the body provided by the application
+ * in its own buffers.
+ *
+ * Similar to #MHD_create_response_from_callback(), but the data is not
+ * copied to the MHD buffer: @a bcb returns the pointers to the
+ * application's data, the data is sent directly from the application's
+ * memory and released by the callback provided by @a bcb after
+ * the data has been sent (or when the connection is closed).
+ * Useful when the response data is already available in the
+ * application's (refcounted) buffers.
+ *
+ * The response object can be extended with header information and then
+ * be used any number of times.
+ *
+ * @param size size of the data portion of the response, #MHD_SIZE_UNKNOWN
+ *        for unknown
+ * @param bcb callback to use to obtain the response data
+ * @param bcb_cls extra argument to @a bcb
+ * @param crfc callback to call to free @a bcb_cls resources
+ * @return NULL on error (i.e. invalid arguments, out of memory)
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_create_response_from_borrow_callback (uint64_t size,
+                                          MHD_ContentBorrowCallback bcb,
+                                          void *bcb_cls,
+                                          MHD_ContentReaderFreeCallback crfc);
+
+
 /**
  * Create a response object with empty (zero size) body.
  *
@@ -6023,6 +6959,45 @@ struct MHD_BasicAuthInfo
 _MHD_EXTERN struct MHD_BasicAuthInfo *
 MHD_basic_auth_get_username_password3 (struct MHD_Connection *connection);
 
+/**
+ * The callback to check the Basic Authentication credentials.
+ *
+ * The callback may be called by several threads at the same time, when
+ * the thread pool or "thread per connection" mode is used.
+ *
+ * @param cls the closure set with #MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK
+ * @param info the username and the password sent by the client,
+ *             the pointer is valid only until the callback returns
+ * @return #MHD_YES if the credentials are valid,
+ *         #MHD_NO otherwise
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup authentication
+ */
+typedef enum MHD_Result
+(*MHD_BasicAuthVerifyCallback)(void *cls,
+                               const struct MHD_BasicAuthInfo *info);
+
+/**
+ * Check the Basic Authentication credentials sent by the client by
+ * the callback set with #MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK.
+ *
+ * If the cache is enabled by #MHD_OPTION_BASIC_AUTH_CACHE_SIZE, the
+ * successfully verified credentials are cached and the repeated
+ * requests with the same "Authorization" header are answered from
+ * the cache, without decoding the header and calling the callback.
+ * Failed verifications are never cached.
+ *
+ * @param connection the MHD connection structure
+ * @return #MHD_YES if the request has valid Basic Authentication
+ *         credentials,
+ *         #MHD_NO if the credentials are missing or invalid, or if
+ *         the verify callback is not set
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup authentication
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_basic_auth_verify (struct MHD_Connection *connection);
+
 /**
  * Queues a response to request basic authentication from the client.
  *
@@ -6145,6 +7120,68 @@ MHD_set_connection_option (struct MHD_Connection *connection,
                            ...);
 
 
+/**
+ * The number of the buckets in every histogram of
+ * the #MHD_MemoryProfile.
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+#define MHD_MEMORY_PROFILE_BUCKETS 32
+
+/**
+ * The histograms of the connection memory use.
+ *
+ * Each histogram counts the requests by the high-water mark of the
+ * memory used by the request: the bucket number @a n counts
+ * the requests with the high-water mark not less than 2^n bytes and
+ * less than 2^(n+1) bytes.  The first bucket counts also the requests
+ * that have not used the memory of this kind, the last bucket counts
+ * also all larger values.
+ * All requests are counted, including requests interrupted by
+ * the connection close (for example, because of the lack of memory).
+ * @see #MHD_DAEMON_INFO_MEMORY_PROFILE
+ * @note Available since #MHD_VERSION 0x01000102
+ */
+struct MHD_MemoryProfile
+{
+  /**
+   * The total number of the profiled requests.
+   */
+  uint64_t num_requests;
+
+  /**
+   * The largest amount of the received and not yet processed data held
+   * in the read buffer, including the request line and the headers.
+   */
+  uint64_t read_buffer[MHD_MEMORY_PROFILE_BUCKETS];
+
+  /**
+   * The largest amount of the data held in the write buffer (the reply
+   * header and the copied reply content).
+   */
+  uint64_t write_buffer[MHD_MEMORY_PROFILE_BUCKETS];
+
+  /**
+   * The memory allocated for the parsed request headers (the header
+   * entries and the related data) before the first call of the access
+   * handler.
+   */
+  uint64_t headers[MHD_MEMORY_PROFILE_BUCKETS];
+
+  /**
+   * The memory allocated for the request after the headers have been
+   * processed (the parsed arguments, cookies, authorisation data, etc.)
+   */
+  uint64_t app_alloc[MHD_MEMORY_PROFILE_BUCKETS];
+
+  /**
+   * The peak use of the whole connection memory pool.
+   * Compare with the size of the pool set by
+   * #MHD_OPTION_CONNECTION_MEMORY_LIMIT.
+   */
+  uint64_t pool[MHD_MEMORY_PROFILE_BUCKETS];
+};
+
+
 /**
  * Information about an MHD daemon.
  */
@@ -6189,6 +7226,12 @@ union MHD_DaemonInfo
    * daemon, especially if #MHD_USE_AUTO was set.
    */
   enum MHD_FLAG flags;
+
+  /**
+   * The histograms of the connection memory use,
+   * for #MHD_DAEMON_INFO_MEMORY_PROFILE.
+   */
+  const struct MHD_MemoryProfile *memory_profile;
 };
 
 
@@ -31,6 +31,11 @@
 #include "internal.h"
 #include "mhd_compat.h"
 #include "mhd_str.h"
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+#include "mhd_sha256_wrap.h"
+#include "mhd_locks.h"
+#include "mhd_mono_clock.h"
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
 
 
 /**
@@ -123,6 +128,162 @@ MHD_basic_auth_get_username_password3 (struct MHD_Connection *connection)
 }
 
 
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+/**
+ * Calculate the keyed hash of the Basic Authentication token
+ * @param daemon the master daemon
+ * @param token68 the token from the "Authorization" header
+ * @param[out] hash the buffer for the hash,
+ *                  must be at least #SHA256_DIGEST_SIZE bytes long
+ * @return true if succeed,
+ *         false if hashing failed
+ */
+static bool
+bauth_cache_hash (const struct MHD_Daemon *daemon,
+                  const struct _MHD_str_w_len *token68,
+                  uint8_t *hash)
+{
+  struct Sha256CtxWr ctx;
+  bool ret;
+
+  MHD_SHA256_init_one_time (&ctx);
+  MHD_SHA256_update (&ctx,
+                     daemon->bauth_cache_key,
+                     sizeof(daemon->bauth_cache_key));
+  MHD_SHA256_update (&ctx,
+                     (const uint8_t *) token68->str,
+                     token68->len);
+  MHD_SHA256_finish_reset (&ctx, hash);
+#ifdef MHD_SHA256_HAS_EXT_ERROR
+  ret = (0 == ctx.ext_error);
+#else  /* ! MHD_SHA256_HAS_EXT_ERROR */
+  ret = true;
+#endif /* ! MHD_SHA256_HAS_EXT_ERROR */
+  MHD_SHA256_deinit (&ctx);
+  return ret;
+}
+
+
+/**
+ * Get the cache entry for the hash
+ * @param daemon the master daemon
+ * @param hash the hash of the token
+ * @return the pointer to the cache entry for the @a hash
+ */
+static struct MHD_BAuthCacheEntry *
+bauth_cache_get_entry (const struct MHD_Daemon *daemon,
+                       const uint8_t *hash)
+{
+  uint32_t idx;
+
+  mhd_assert (0 != daemon->bauth_cache_size);
+  /* The hash is uniformly distributed, any bytes are good as the index */
+  idx = (((uint32_t) hash[0]) << 24) | (((uint32_t) hash[1]) << 16)
+        | (((uint32_t) hash[2]) << 8) | ((uint32_t) hash[3]);
+  return daemon->bauth_cache + (idx % daemon->bauth_cache_size);
+}
+
+
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+
+
+/**
+ * Check the Basic Authentication credentials sent by the client by
+ * the callback set with #MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK.
+ *
+ * If the cache is enabled by #MHD_OPTION_BASIC_AUTH_CACHE_SIZE, the
+ * successfully verified credentials are cached and the repeated
+ * requests with the same "Authorization" header are answered from
+ * the cache, without decoding the header and calling the callback.
+ * Failed verifications are never cached.
+ *
+ * @param connection the MHD connection structure
+ * @return #MHD_YES if the request has valid Basic Authentication
+ *         credentials,
+ *         #MHD_NO if the credentials are missing or invalid, or if
+ *         the verify callback is not set
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup authentication
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_basic_auth_verify (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = MHD_get_master (connection->daemon);
+  struct MHD_BasicAuthInfo *info;
+  enum MHD_Result ret;
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+  const struct MHD_RqBAuth *params;
+  uint8_t hash[SHA256_DIGEST_SIZE];
+  bool use_cache;
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+
+  if (NULL == daemon->bauth_verify_cb)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("MHD_basic_auth_verify() is used, but " \
+                 "MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK is not set.\n"));
+#endif /* HAVE_MESSAGES */
+    return MHD_NO;
+  }
+
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+  mhd_assert (MHD_SHA256_DIGEST_SIZE == SHA256_DIGEST_SIZE);
+  use_cache = false;
+  if (NULL != daemon->bauth_cache)
+  {
+    params = MHD_get_rq_bauth_params_ (connection);
+    if ((NULL == params) || (NULL == params->token68.str) ||
+        (0 == params->token68.len))
+      return MHD_NO;
+
+    if (bauth_cache_hash (daemon, &params->token68, hash))
+    {
+      struct MHD_BAuthCacheEntry *entry;
+      const uint64_t now = MHD_monotonic_msec_counter ();
+      bool found;
+
+      use_cache = true;
+      entry = bauth_cache_get_entry (daemon, hash);
+      MHD_mutex_lock_chk_ (&daemon->bauth_cache_lock);
+      found = (0 != entry->expires) &&
+              ((int64_t) (entry->expires - now) > 0) &&
+              (0 == memcmp (entry->hash, hash, sizeof(hash)));
+      MHD_mutex_unlock_chk_ (&daemon->bauth_cache_lock);
+      if (found)
+        return MHD_YES;
+    }
+  }
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+
+  info = MHD_basic_auth_get_username_password3 (connection);
+  if (NULL == info)
+    return MHD_NO;
+  ret = daemon->bauth_verify_cb (daemon->bauth_verify_cb_cls,
+                                 info);
+  free (info);
+
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+  if ((MHD_YES == ret) && use_cache)
+  {
+    struct MHD_BAuthCacheEntry *entry;
+    uint64_t expires;
+
+    entry = bauth_cache_get_entry (daemon, hash);
+    expires = MHD_monotonic_msec_counter () + daemon->bauth_cache_timeout_ms;
+    if (0 == expires)
+      expires = 1; /* Zero is reserved for unused entries */
+    MHD_mutex_lock_chk_ (&daemon->bauth_cache_lock);
+    memcpy (entry->hash, hash, sizeof(hash));
+    entry->expires = expires;
+    MHD_mutex_unlock_chk_ (&daemon->bauth_cache_lock);
+  }
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+
+  return ret;
+}
+
+
 /**
  * Get the username and password from the basic authorization header sent by the client
  *
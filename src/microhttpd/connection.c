@@ -32,6 +32,7 @@
 #include "response.h"
 #include "mhd_mono_clock.h"
 #include "mhd_str.h"
+#include "router.h"
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
 #include "mhd_locks.h"
 #endif
@@ -509,6 +510,17 @@
 #define REQUEST_CHUNKED_MALFORMED ""
 #endif
 
+/**
+ * Response text used when the queue of the offloaded handler calls is full.
+ */
+#ifdef HAVE_MESSAGES
+#define HANDLER_OFFLOAD_BUSY \
+  "<html><head><title>Service unavailable</title></head>" \
+  "<body>The server is too busy to process the request.</body></html>"
+#else
+#define HANDLER_OFFLOAD_BUSY ""
+#endif
+
 /**
  * Response text used when the request HTTP chunk is too large.
  */
@@ -638,6 +650,99 @@ str_conn_error_ (ssize_t mhd_err_code)
 
 #endif /* HAVE_MESSAGES */
 
+/**
+ * Update the high-water marks of the read and write buffers use by
+ * the current request.
+ * Used only when the memory profiling is enabled.
+ * @param c the connection to use
+ */
+static void
+connection_mem_profile_sample (struct MHD_Connection *c)
+{
+  struct MHD_RequestMemProfile *const p = &c->rq.mem_profile;
+
+  mhd_assert (c->daemon->pool_profile);
+  if (p->read_buffer < c->read_buffer_offset)
+    p->read_buffer = c->read_buffer_offset;
+  if (p->write_buffer < c->write_buffer_append_offset)
+    p->write_buffer = c->write_buffer_append_offset;
+}
+
+
+/**
+ * Get the number of the histogram bucket for the @a value.
+ * @param value the value to put to the histogram
+ * @return the number of the bucket
+ */
+static unsigned int
+mem_profile_bucket (size_t value)
+{
+  unsigned int bucket;
+
+  for (bucket = 0; bucket < MHD_MEMORY_PROFILE_BUCKETS - 1; ++bucket)
+  {
+    value >>= 1;
+    if (0 == value)
+      break;
+  }
+  return bucket;
+}
+
+
+/**
+ * Add the memory use of the current request to the daemon's histograms.
+ * Called when the request is completed or the connection is closed.
+ * Requests without any received data are not counted.
+ * @param c the connection to use
+ */
+static void
+connection_mem_profile_commit (struct MHD_Connection *c)
+{
+  struct MHD_Daemon *const d = c->daemon;
+  struct MHD_MemoryProfile *const stats = &d->pool_profile_stats;
+  const struct MHD_RequestMemProfile *const p = &c->rq.mem_profile;
+  size_t pool_peak;
+
+  mhd_assert (d->pool_profile);
+  mhd_assert (NULL != c->pool);
+  if ( (MHD_CONNECTION_INIT == c->state) ||
+       (MHD_CONNECTION_CLOSED == c->state) )
+    return;
+  connection_mem_profile_sample (c);
+  pool_peak = MHD_pool_get_peak (c->pool);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_lock_chk_ (&d->cleanup_connection_mutex);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  stats->num_requests++;
+  stats->read_buffer[mem_profile_bucket (p->read_buffer)]++;
+  stats->write_buffer[mem_profile_bucket (p->write_buffer)]++;
+  stats->headers[mem_profile_bucket (p->headers)]++;
+  stats->app_alloc[mem_profile_bucket (p->app_alloc)]++;
+  stats->pool[mem_profile_bucket (pool_peak)]++;
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_unlock_chk_ (&d->cleanup_connection_mutex);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+}
+
+
+/**
+ * Account the memory allocated for the current request.
+ * Used only when the memory profiling is enabled.
+ * @param c the connection to use
+ * @param size the size of the allocated memory
+ */
+static void
+connection_mem_profile_alloc (struct MHD_Connection *c,
+                              size_t size)
+{
+  mhd_assert (c->daemon->pool_profile);
+  if (MHD_CONNECTION_HEADERS_PROCESSED > c->state)
+    c->rq.mem_profile.headers += size;
+  else
+    c->rq.mem_profile.app_alloc += size;
+}
+
+
 /**
  * Allocate memory from connection's memory pool.
  * If memory pool doesn't have enough free memory but read or write buffer
@@ -660,7 +765,11 @@ MHD_connection_alloc_memory_ (struct MHD_Connection *connection,
                             size,
                             &need_to_be_freed);
   if (NULL != res)
+  {
+    if (c->daemon->pool_profile)
+      connection_mem_profile_alloc (c, size);
     return res;
+  }
 
   if (MHD_pool_is_resizable_inplace (pool,
                                      c->write_buffer,
@@ -708,6 +817,8 @@ MHD_connection_alloc_memory_ (struct MHD_Connection *connection,
     return NULL;
   res = MHD_pool_allocate (pool, size, true);
   mhd_assert (NULL != res); /* It has been checked that pool has enough space */
+  if (c->daemon->pool_profile)
+    connection_mem_profile_alloc (c, size);
   return res;
 }
 
@@ -800,6 +911,8 @@ MHD_get_connection_values (struct MHD_Connection *connection,
 
   if (NULL == connection)
     return -1;
+  MHD_connection_parse_deferred_ (connection,
+                                  kind);
   ret = 0;
   for (pos = connection->rq.headers_received; NULL != pos; pos = pos->next)
     if (0 != (pos->kind & kind))
@@ -839,6 +952,8 @@ MHD_get_connection_values_n (struct MHD_Connection *connection,
 
   if (NULL == connection)
     return -1;
+  MHD_connection_parse_deferred_ (connection,
+                                  kind);
   ret = 0;
 
   if (NULL == iterator)
@@ -1066,6 +1181,8 @@ MHD_lookup_connection_value_n (struct MHD_Connection *connection,
 
   if (NULL == connection)
     return MHD_NO;
+  MHD_connection_parse_deferred_ (connection,
+                                  kind);
 
   if (NULL == key)
   {
@@ -1209,7 +1326,8 @@ MHD_connection_mark_closed_ (struct MHD_Connection *connection)
 {
   const struct MHD_Daemon *daemon = connection->daemon;
 
-  if (0 == (daemon->options & MHD_USE_TURBO))
+  if ( (0 == (daemon->options & MHD_USE_TURBO)) &&
+       (! connection->drain_handoff) )
   {
 #ifdef HTTPS_SUPPORT
     /* For TLS connection use shutdown of TLS layer
@@ -1233,6 +1351,24 @@ MHD_connection_mark_closed_ (struct MHD_Connection *connection)
 }
 
 
+/**
+ * Release the response data borrowed from the application, if any.
+ *
+ * @param connection the connection
+ */
+static void
+reply_release_borrowed (struct MHD_Connection *connection)
+{
+  const MHD_ContentReaderFreeCallback release =
+    connection->rp.borrow_release;
+
+  if (NULL == release)
+    return;
+  connection->rp.borrow_release = NULL;
+  release (connection->rp.borrow_release_cls);
+}
+
+
 /**
  * Close the given connection and give the
  * specified termination code to the user.
@@ -1261,6 +1397,7 @@ MHD_connection_close_ (struct MHD_Connection *connection,
                               &connection->rq.client_context,
                               termination_code);
   connection->rq.client_aware = false;
+  reply_release_borrowed (connection);
   if (NULL != resp)
   {
     connection->rp.response = NULL;
@@ -1268,6 +1405,8 @@ MHD_connection_close_ (struct MHD_Connection *connection,
   }
   if (NULL != connection->pool)
   {
+    if (daemon->pool_profile)
+      connection_mem_profile_commit (connection);
     MHD_pool_destroy (connection->pool);
     connection->pool = NULL;
   }
@@ -1387,10 +1526,298 @@ connection_close_error (struct MHD_Connection *connection,
 #endif
 
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+/**
+ * Read the next block of the response data by the file read thread.
+ *
+ * Submit the read to the file read threads if the previous block
+ * of the data is sent.  The connection is suspended until the data
+ * is read.  The result of the read is processed when the connection
+ * is resumed.
+ * @param connection the connection
+ * @param buf the buffer for the data
+ * @param size the size of the @a buf
+ * @param[out] p_ret the pointer to the variable to set to the result
+ *                   of the read
+ * @return 'true' if @a p_ret is set,
+ *         'false' if the connection is suspended until the data is read
+ */
+static bool
+file_read_offload (struct MHD_Connection *connection,
+                   char *buf,
+                   size_t size,
+                   ssize_t *p_ret)
+{
+  struct MHD_Response *const response = connection->rp.response;
+
+  mhd_assert (connection->rp.fr_offload);
+  if (! connection->rp.fr_done)
+  {
+    if (MHD_file_read_offload_submit_ (connection,
+                                       buf,
+                                       size))
+      return false;
+    /* The daemon is being stopped, read by the daemon's thread */
+    *p_ret = response->crc (response->crc_cls,
+                            connection->rp.rsp_write_position,
+                            buf,
+                            size);
+    return true;
+  }
+  mhd_assert (buf == connection->rp.fr_buf);
+  mhd_assert (size == connection->rp.fr_size);
+  connection->rp.fr_done = false;
+  *p_ret = connection->rp.fr_result;
+  return true;
+}
+
+
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
+/**
+ * Lock the response of the connection for the access to the response's
+ * content reader and the shared response's buffer.
+ * The response is not locked if it does not need the lock.
+ *
+ * @param connection the connection
+ */
+static void
+reply_lock_response (struct MHD_Connection *connection)
+{
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  struct MHD_Response *const response = connection->rp.response;
+
+  if ( (NULL != response->crc) &&
+       (! connection->rp.crc_unlocked) )
+    MHD_mutex_lock_chk_ (&response->mutex);
+#else  /* ! MHD_USE_POSIX_THREADS && ! MHD_USE_W32_THREADS */
+  (void) connection; /* Mute compiler warning */
+#endif /* ! MHD_USE_POSIX_THREADS && ! MHD_USE_W32_THREADS */
+}
+
+
+/**
+ * Unlock the response locked by #reply_lock_response().
+ *
+ * @param connection the connection
+ */
+static void
+reply_unlock_response (struct MHD_Connection *connection)
+{
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  struct MHD_Response *const response = connection->rp.response;
+
+  if ( (NULL != response->crc) &&
+       (! connection->rp.crc_unlocked) )
+    MHD_mutex_unlock_chk_ (&response->mutex);
+#else  /* ! MHD_USE_POSIX_THREADS && ! MHD_USE_W32_THREADS */
+  (void) connection; /* Mute compiler warning */
+#endif /* ! MHD_USE_POSIX_THREADS && ! MHD_USE_W32_THREADS */
+}
+
+
+/**
+ * Prepare the response data for sending when the response's content
+ * reader is called without the response's lock.
+ * The data is read into the connection's write buffer, by the daemon's
+ * thread or by the file read thread.
+ * If the transmission is complete, this function may close the socket
+ * (and return #MHD_NO).
+ *
+ * @param connection the connection
+ * @return #MHD_NO if readying the response failed or if the data is
+ *         not ready yet
+ */
+static enum MHD_Result
+try_ready_unlocked_body (struct MHD_Connection *connection)
+{
+  struct MHD_Response *const response = connection->rp.response;
+  size_t size;
+  ssize_t ret;
+
+  mhd_assert (connection->rp.crc_unlocked);
+  if (connection->write_buffer_send_offset <
+      connection->write_buffer_append_offset)
+    return MHD_YES; /* the data is not sent completely yet */
+
+  connection->write_buffer_send_offset = 0;
+  connection->write_buffer_append_offset = 0;
+  size = connection->write_buffer_size + MHD_pool_get_free (connection->pool);
+  if (size > response->data_buffer_size)
+    size = response->data_buffer_size;
+  if (128 > size)
+  {
+    /* not enough memory */
+    CONNECTION_CLOSE_ERROR (connection,
+                            _ ("Closing connection (out of memory)."));
+    return MHD_NO;
+  }
+  if (size != connection->write_buffer_size)
+  {
+    mhd_assert ((NULL == connection->write_buffer) || \
+                MHD_pool_is_resizable_inplace (connection->pool, \
+                                               connection->write_buffer, \
+                                               connection->write_buffer_size));
+    connection->write_buffer =
+      MHD_pool_reallocate (connection->pool,
+                           connection->write_buffer,
+                           connection->write_buffer_size,
+                           size);
+    mhd_assert (NULL != connection->write_buffer);
+    connection->write_buffer_size = size;
+  }
+  if ((uint64_t) size >
+      response->total_size - connection->rp.rsp_write_position)
+    size = (size_t) (response->total_size
+                     - connection->rp.rsp_write_position);
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (connection->rp.fr_offload)
+  {
+    if (! file_read_offload (connection,
+                             connection->write_buffer,
+                             size,
+                             &ret))
+    {
+      connection->state = MHD_CONNECTION_NORMAL_BODY_UNREADY;
+      return MHD_NO;
+    }
+  }
+  else
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  ret = response->crc (response->crc_cls,
+                       connection->rp.rsp_write_position,
+                       connection->write_buffer,
+                       size);
+  if (0 > ret)
+  {
+    /* The response is shared, do not update the response size */
+    if (MHD_CONTENT_READER_END_OF_STREAM == ret)
+      MHD_connection_close_ (connection,
+                             MHD_REQUEST_TERMINATED_COMPLETED_OK);
+    else
+      CONNECTION_CLOSE_ERROR (connection,
+                              _ ("Closing connection (application reported " \
+                                 "error generating data)."));
+    return MHD_NO;
+  }
+  if (0 == ret)
+  {
+    connection->state = MHD_CONNECTION_NORMAL_BODY_UNREADY;
+    return MHD_NO;
+  }
+  if (size < (size_t) ret)
+  {
+    CONNECTION_CLOSE_ERROR (connection,
+                            _ ("Closing connection (application returned " \
+                               "more data than requested)."));
+    return MHD_NO;
+  }
+  connection->write_buffer_append_offset = (size_t) ret;
+  return MHD_YES;
+}
+
+
+/**
+ * Obtain the next block of the response data borrowed from the
+ * application.  Assumes that the response is locked by
+ * #reply_lock_response().
+ *
+ * @param connection the connection
+ * @param max_size the maximum size of the data to use
+ * @param[out] p_data set to the pointer to the borrowed data
+ * @return the size of the borrowed data, not larger than @a max_size,
+ *         or the value returned by the application if it is not positive
+ */
+static ssize_t
+reply_borrow_data (struct MHD_Connection *connection,
+                   uint64_t max_size,
+                   const void **p_data)
+{
+  struct MHD_Response *const response = connection->rp.response;
+  ssize_t ret;
+
+  mhd_assert (NULL != response->bcb);
+  mhd_assert (NULL == connection->rp.borrow_release);
+  *p_data = NULL;
+  connection->rp.borrow_release_cls = NULL;
+  ret = response->bcb (response->bcb_cls,
+                       connection->rp.rsp_write_position,
+                       p_data,
+                       &connection->rp.borrow_release,
+                       &connection->rp.borrow_release_cls);
+  if (0 >= ret)
+  {
+    connection->rp.borrow_release = NULL;
+    return ret;
+  }
+  if (max_size < (uint64_t) ret)
+    ret = (ssize_t) max_size;
+#if defined(MHD_WINSOCK_SOCKETS) && defined(_WIN64)
+  if (MHD_IOV_ELMN_MAX_SIZE < (size_t) ret)
+    ret = (ssize_t) MHD_IOV_ELMN_MAX_SIZE;
+#endif /* MHD_WINSOCK_SOCKETS && _WIN64 */
+  return ret;
+}
+
+
+/**
+ * Prepare the next block of the response data borrowed from the
+ * application for sending.  Assumes that the response is locked by
+ * #reply_lock_response().  If the transmission is complete,
+ * this function may close the socket (and return #MHD_NO).
+ *
+ * @param connection the connection
+ * @return #MHD_NO if readying the response failed (the
+ *  lock on the response will have been released already
+ *  in this case).
+ */
+static enum MHD_Result
+try_ready_borrowed_body (struct MHD_Connection *connection)
+{
+  struct MHD_Response *const response = connection->rp.response;
+  const void *data;
+  ssize_t ret;
+
+  if (0 != connection->rp.chunk_iov.cnt)
+    return MHD_YES; /* the data is not sent completely yet */
+
+  ret = reply_borrow_data (connection,
+                           response->total_size
+                           - connection->rp.rsp_write_position,
+                           &data);
+  if (0 > ret)
+  {
+    reply_unlock_response (connection);
+    /* The response could be shared, do not update the response size */
+    if (MHD_CONTENT_READER_END_OF_STREAM == ret)
+      MHD_connection_close_ (connection,
+                             MHD_REQUEST_TERMINATED_COMPLETED_OK);
+    else
+      CONNECTION_CLOSE_ERROR (connection,
+                              _ ("Closing connection (application reported " \
+                                 "error generating data)."));
+    return MHD_NO;
+  }
+  if (0 == ret)
+  {
+    connection->state = MHD_CONNECTION_NORMAL_BODY_UNREADY;
+    reply_unlock_response (connection);
+    return MHD_NO;
+  }
+  connection->rp.chunk_iov_buf[0].iov_base = _MHD_DROP_CONST (data);
+  connection->rp.chunk_iov_buf[0].iov_len = (MHD_iov_size_) ret;
+  connection->rp.chunk_iov.iov = connection->rp.chunk_iov_buf;
+  connection->rp.chunk_iov.cnt = 1;
+  connection->rp.chunk_iov.sent = 0;
+  return MHD_YES;
+}
+
+
 /**
  * Prepare the response buffer of this connection for
- * sending.  Assumes that the response mutex is
- * already held.  If the transmission is complete,
+ * sending.  Assumes that the response is locked by
+ * #reply_lock_response().  If the transmission is complete,
  * this function may close the socket (and return
  * #MHD_NO).
  *
@@ -1423,7 +1850,7 @@ try_ready_normal_body (struct MHD_Connection *connection)
                                                                 copy_size);
     if (NULL == connection->rp.resp_iov.iov)
     {
-      MHD_mutex_unlock_chk_ (&response->mutex);
+      reply_unlock_response (connection);
       /* not enough memory */
       CONNECTION_CLOSE_ERROR (connection,
                               _ ("Closing connection (out of memory)."));
@@ -1438,6 +1865,10 @@ try_ready_normal_body (struct MHD_Connection *connection)
   }
   if (NULL == response->crc)
     return MHD_YES;
+  if (NULL != response->bcb)
+    return try_ready_borrowed_body (connection);
+  if (connection->rp.crc_unlocked)
+    return try_ready_unlocked_body (connection);
   if ( (response->data_start <=
         connection->rp.rsp_write_position) &&
        (response->data_size + response->data_start >
@@ -1463,9 +1894,7 @@ try_ready_normal_body (struct MHD_Connection *connection)
     /* TODO: do not update total size, check whether response
      * was really with unknown size */
     response->total_size = connection->rp.rsp_write_position;
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-    MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+    reply_unlock_response (connection);
     if (MHD_CONTENT_READER_END_OF_STREAM == ret)
       MHD_connection_close_ (connection,
                              MHD_REQUEST_TERMINATED_COMPLETED_OK);
@@ -1480,18 +1909,256 @@ try_ready_normal_body (struct MHD_Connection *connection)
   if (0 == ret)
   {
     connection->state = MHD_CONNECTION_NORMAL_BODY_UNREADY;
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-    MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+    reply_unlock_response (connection);
+    return MHD_NO;
+  }
+  return MHD_YES;
+}
+
+
+/**
+ * Check whether the first block of the response data, generated by the
+ * response's content reader, could be sent together with the reply
+ * header.
+ *
+ * Only non-chunked replies with the known size and with the data read
+ * into the response's buffer are sent this way.
+ * @param connection the connection to check
+ * @return true if the first block of the data could be sent with the
+ *         reply header,
+ *         false otherwise
+ */
+static bool
+reply_first_block_with_header (struct MHD_Connection *connection)
+{
+  struct MHD_Response *const r = connection->rp.response;
+
+  return (NULL != r->crc) &&
+         (NULL == r->bcb) &&
+         (! connection->rp.crc_unlocked) &&
+#if defined(_MHD_HAVE_SENDFILE)
+         (MHD_resp_sender_std == connection->rp.resp_sender) &&
+#endif /* _MHD_HAVE_SENDFILE */
+         (connection->rp.props.send_reply_body) &&
+         (! connection->rp.props.chunked) &&
+         (0 != r->total_size) &&
+         (MHD_SIZE_UNKNOWN != r->total_size);
+}
+
+
+/**
+ * Read the first block of the response data to the response's buffer
+ * to send it together with the reply header.
+ * If the application has no data immediately available, the reply
+ * header is sent alone and the data is read later as usual.
+ * If the application reported an error or the end of the stream (before
+ * the end of the data with the known size), the connection is closed.
+ *
+ * @param connection the connection
+ * @return #MHD_NO if the connection has been closed,
+ *         #MHD_YES otherwise
+ */
+static enum MHD_Result
+reply_ready_first_block (struct MHD_Connection *connection)
+{
+  struct MHD_Response *const response = connection->rp.response;
+  ssize_t ret;
+
+  mhd_assert (reply_first_block_with_header (connection));
+  mhd_assert (0 == connection->rp.rsp_write_position);
+
+  reply_lock_response (connection);
+  if ( (0 == response->data_start) &&
+       (0 != response->data_size) )
+  {
+    reply_unlock_response (connection);
+    return MHD_YES; /* The data is already in the response's buffer */
+  }
+  ret = response->crc (response->crc_cls,
+                       0,
+                       (char *) response->data,
+                       (size_t) MHD_MIN ((uint64_t) response->data_buffer_size,
+                                         response->total_size));
+  if (0 > ret)
+  {
+    /* TODO: do not update total size, check whether response
+     * was really with unknown size */
+    response->total_size = 0;
+    reply_unlock_response (connection);
+    if (MHD_CONTENT_READER_END_OF_STREAM == ret)
+      MHD_connection_close_ (connection,
+                             MHD_REQUEST_TERMINATED_COMPLETED_OK);
+    else
+      CONNECTION_CLOSE_ERROR (connection,
+                              _ ("Closing connection (application reported " \
+                                 "error generating data)."));
+    return MHD_NO;
+  }
+  response->data_start = 0;
+  response->data_size = (size_t) ret;
+  reply_unlock_response (connection);
+  return MHD_YES;
+}
+
+
+/**
+ * Set the iovec for the next chunk with the payload sent directly from
+ * the memory.
+ * The chunk header is formatted in the write buffer.
+ *
+ * @param connection the connection
+ * @param payload the chunk payload
+ * @param payload_size the size of the @a payload, must not be larger
+ *                     than 0xFFFFFF
+ */
+static void
+reply_set_chunk_iov (struct MHD_Connection *connection,
+                     const void *payload,
+                     size_t payload_size)
+{
+  static const char crlf[] = "\r\n";
+  MHD_iovec_ *const iov = connection->rp.chunk_iov_buf;
+  size_t hdr_len;
+
+  mhd_assert (0 == connection->rp.chunk_iov.cnt);
+  mhd_assert (16 <= connection->write_buffer_size);
+  mhd_assert (0 != payload_size);
+  mhd_assert (0xFFFFFF >= payload_size);
+
+  hdr_len = MHD_uint32_to_strx ((uint32_t) payload_size,
+                                connection->write_buffer,
+                                connection->write_buffer_size - 2);
+  mhd_assert (0 != hdr_len);
+  connection->write_buffer[hdr_len++] = '\r';
+  connection->write_buffer[hdr_len++] = '\n';
+  iov[0].iov_base = connection->write_buffer;
+  iov[0].iov_len = (MHD_iov_size_) hdr_len;
+  iov[1].iov_base = _MHD_DROP_CONST (payload);
+  iov[1].iov_len = (MHD_iov_size_) payload_size;
+  iov[2].iov_base = _MHD_DROP_CONST (crlf);
+  iov[2].iov_len = 2;
+  connection->rp.chunk_iov.iov = iov;
+  connection->rp.chunk_iov.cnt = 3;
+  connection->rp.chunk_iov.sent = 0;
+  connection->rp.rsp_write_position += payload_size;
+}
+
+
+/**
+ * Prepare the next chunk of the response with the data in memory.
+ * The chunk header is formatted in the write buffer, the payload is
+ * sent directly from the response's memory.
+ *
+ * @param connection the connection
+ * @param[out] p_finished the pointer to variable that will be set to "true"
+ *                        when the response data is sent completely
+ * @return always #MHD_YES
+ */
+static enum MHD_Result
+ready_chunked_mem_body (struct MHD_Connection *connection,
+                        bool *p_finished)
+{
+  struct MHD_Response *const response = connection->rp.response;
+  const uint64_t pos = connection->rp.rsp_write_position;
+  const char *payload;
+  size_t payload_size;
+
+  mhd_assert (NULL == response->crc);
+  mhd_assert (pos < response->total_size);
+
+  if (NULL != response->data_iov)
+  {
+    uint64_t off = pos;
+    unsigned int i;
+
+    payload = NULL;
+    payload_size = 0;
+    for (i = 0; i < response->data_iovcnt; ++i)
+    {
+      if (off < (uint64_t) response->data_iov[i].iov_len)
+      {
+        payload = ((const char *) response->data_iov[i].iov_base)
+                  + (size_t) off;
+        payload_size = (size_t) (response->data_iov[i].iov_len - off);
+        break;
+      }
+      off -= response->data_iov[i].iov_len;
+    }
+    mhd_assert (NULL != payload);
+  }
+  else
+  {
+    mhd_assert (0 == response->data_start);
+    payload = response->data + (size_t) pos;
+    payload_size = (size_t) (response->data_size - pos);
+  }
+  if (0xFFFFFF < payload_size)
+    payload_size = 0xFFFFFF;
+
+  reply_set_chunk_iov (connection,
+                       payload,
+                       payload_size);
+  *p_finished = false;
+  return MHD_YES;
+}
+
+
+/**
+ * Prepare the next chunk of the response with the data borrowed from
+ * the application.  Assumes that the response is locked by
+ * #reply_lock_response().
+ *
+ * @param connection the connection
+ * @param left_to_send the size of the response data left to send,
+ *                     could be #MHD_SIZE_UNKNOWN
+ * @param[out] p_finished the pointer to variable that will be set to "true"
+ *                        when application returned indication of the end
+ *                        of the stream
+ * @return #MHD_NO if readying the response failed (the
+ *  lock on the response will have been released already
+ *  in this case).
+ */
+static enum MHD_Result
+ready_chunked_borrowed_body (struct MHD_Connection *connection,
+                             uint64_t left_to_send,
+                             bool *p_finished)
+{
+  const void *data;
+  ssize_t ret;
+
+  ret = reply_borrow_data (connection,
+                           MHD_MIN (left_to_send, 0xFFFFFF),
+                           &data);
+  if (MHD_CONTENT_READER_END_OF_STREAM == ret)
+  {
+    *p_finished = true;
+    return MHD_YES;
+  }
+  if (0 == ret)
+  {
+    connection->state = MHD_CONNECTION_CHUNKED_BODY_UNREADY;
+    reply_unlock_response (connection);
     return MHD_NO;
   }
+  if (0 > ret)
+  {
+    reply_unlock_response (connection);
+    CONNECTION_CLOSE_ERROR (connection,
+                            _ ("Closing connection (application error " \
+                               "generating response)."));
+    return MHD_NO;
+  }
+  reply_set_chunk_iov (connection,
+                       data,
+                       (size_t) ret);
+  *p_finished = false;
   return MHD_YES;
 }
 
 
 /**
  * Prepare the response buffer of this connection for sending.
- * Assumes that the response mutex is already held.  If the
+ * Assumes that the response is locked by #reply_lock_response().  If the
  * transmission is complete, this function may close the socket (and
  * return #MHD_NO).
  *
@@ -1530,9 +2197,7 @@ try_ready_chunked_body (struct MHD_Connection *connection,
     size = connection->write_buffer_size + MHD_pool_get_free (connection->pool);
     if (128 > size)
     {
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-      MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+      reply_unlock_response (connection);
       /* not enough memory */
       CONNECTION_CLOSE_ERROR (connection,
                               _ ("Closing connection (out of memory)."));
@@ -1571,7 +2236,34 @@ try_ready_chunked_body (struct MHD_Connection *connection,
   if (0 == left_to_send)
     /* nothing to send, don't bother calling crc */
     ret = MHD_CONTENT_READER_END_OF_STREAM;
-  else if ( (response->data_start <=
+  else if (NULL == response->crc)
+  {
+    /* The response data is in memory and never changes,
+     * send it without copying to the write buffer */
+    reply_unlock_response (connection);
+    return ready_chunked_mem_body (connection,
+                                   p_finished);
+  }
+  else if (NULL != response->bcb)
+    return ready_chunked_borrowed_body (connection,
+                                        left_to_send,
+                                        p_finished);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  else if (connection->rp.fr_offload)
+  {
+    if (! file_read_offload (connection,
+                             &connection->write_buffer[max_chunk_hdr_len],
+                             size_to_fill,
+                             &ret))
+    {
+      connection->state = MHD_CONNECTION_CHUNKED_BODY_UNREADY;
+      reply_unlock_response (connection);
+      return MHD_NO;
+    }
+  }
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  else if ( (! connection->rp.crc_unlocked) &&
+            (response->data_start <=
              connection->rp.rsp_write_position) &&
             (response->data_start + response->data_size >
              connection->rp.rsp_write_position) )
@@ -1595,9 +2287,7 @@ try_ready_chunked_body (struct MHD_Connection *connection,
   {
     if (NULL == response->crc)
     { /* There is no way to reach this code */
-#if defined(MHD_USE_THREADS)
-      MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+      reply_unlock_response (connection);
       CONNECTION_CLOSE_ERROR (connection,
                               _ ("No callback for the chunked data."));
       return MHD_NO;
@@ -1611,10 +2301,9 @@ try_ready_chunked_body (struct MHD_Connection *connection,
   {
     /* error, close socket! */
     /* TODO: remove update of the response size */
-    response->total_size = connection->rp.rsp_write_position;
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-    MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+    if (! connection->rp.crc_unlocked)
+      response->total_size = connection->rp.rsp_write_position;
+    reply_unlock_response (connection);
     CONNECTION_CLOSE_ERROR (connection,
                             _ ("Closing connection (application error " \
                                "generating response)."));
@@ -1624,22 +2313,19 @@ try_ready_chunked_body (struct MHD_Connection *connection,
   {
     *p_finished = true;
     /* TODO: remove update of the response size */
-    response->total_size = connection->rp.rsp_write_position;
+    if (! connection->rp.crc_unlocked)
+      response->total_size = connection->rp.rsp_write_position;
     return MHD_YES;
   }
   if (0 == ret)
   {
     connection->state = MHD_CONNECTION_CHUNKED_BODY_UNREADY;
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-    MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+    reply_unlock_response (connection);
     return MHD_NO;
   }
   if (size_to_fill < (size_t) ret)
   {
-#if defined(MHD_USE_THREADS)
-    MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+    reply_unlock_response (connection);
     CONNECTION_CLOSE_ERROR (connection,
                             _ ("Closing connection (application returned " \
                                "more data than requested)."));
@@ -1715,6 +2401,9 @@ keepalive_possible (struct MHD_Connection *connection)
   if ((c->read_closed) || (c->discard_request))
     return MHD_CONN_MUST_CLOSE;
 
+  if (c->daemon->draining)
+    return MHD_CONN_MUST_CLOSE;
+
   if (0 != (r->flags & MHD_RF_HTTP_1_0_COMPATIBLE_STRICT))
     return MHD_CONN_MUST_CLOSE;
   if (0 != (r->flags_auto & MHD_RAF_HAS_CONNECTION_CLOSE))
@@ -2904,6 +3593,10 @@ transmit_error_response_len (struct MHD_Connection *connection,
     connection->rq.url_len = 0;
     connection->rq.headers_received = NULL;
     connection->rq.headers_received_tail = NULL;
+    connection->rq.args_deferred = NULL;
+#ifdef COOKIE_SUPPORT
+    connection->rq.cookies_deferred = false;
+#endif /* COOKIE_SUPPORT */
     connection->write_buffer = NULL;
     connection->write_buffer_size = 0;
     connection->write_buffer_send_offset = 0;
@@ -3328,6 +4021,38 @@ handle_req_cookie_no_space (struct MHD_Connection *c)
 #endif /* COOKIE_SUPPORT */
 
 
+/**
+ * Send error reply if the pool had no space for the values parsed on
+ * the first access by the access handler.
+ * The response queued by the application is used as is.
+ * @param c the connection to handle
+ * @return true if the error reply has been queued,
+ *         false otherwise
+ */
+static bool
+handle_deferred_values_no_space (struct MHD_Connection *c)
+{
+  if ( (NULL != c->rp.response) ||
+       (c->suspended) )
+    return false;
+  if (c->rq.args_no_space)
+  {
+    transmit_error_response_static (c,
+                                    MHD_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE,
+                                    ERR_MSG_REQUEST_TOO_BIG);
+    return true;
+  }
+#ifdef COOKIE_SUPPORT
+  if (c->rq.cookies_no_space)
+  {
+    handle_req_cookie_no_space (c);
+    return true;
+  }
+#endif /* COOKIE_SUPPORT */
+  return false;
+}
+
+
 /**
  * Send error reply when receive buffer space exhausted while receiving
  * the chunk size line.
@@ -3862,48 +4587,6 @@ MHD_connection_update_event_loop_info (struct MHD_Connection *connection)
 }
 
 
-/**
- * Add an entry to the HTTP headers of a connection.  If this fails,
- * transmit an error response (request too big).
- *
- * @param cls the context (connection)
- * @param kind kind of the value
- * @param key key for the value
- * @param key_size number of bytes in @a key
- * @param value the value itself
- * @param value_size number of bytes in @a value
- * @return #MHD_NO on failure (out of memory), #MHD_YES for success
- */
-static enum MHD_Result
-connection_add_header (void *cls,
-                       const char *key,
-                       size_t key_size,
-                       const char *value,
-                       size_t value_size,
-                       enum MHD_ValueKind kind)
-{
-  struct MHD_Connection *connection = (struct MHD_Connection *) cls;
-  if (MHD_NO ==
-      MHD_set_connection_value_n (connection,
-                                  kind,
-                                  key,
-                                  key_size,
-                                  value,
-                                  value_size))
-  {
-#ifdef HAVE_MESSAGES
-    MHD_DLOG (connection->daemon,
-              _ ("Not enough memory in pool to allocate header record!\n"));
-#endif
-    transmit_error_response_static (connection,
-                                    MHD_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE,
-                                    ERR_MSG_REQUEST_TOO_BIG);
-    return MHD_NO;
-  }
-  return MHD_YES;
-}
-
-
 #ifdef COOKIE_SUPPORT
 
 /**
@@ -4238,11 +4921,196 @@ parse_cookie_header (struct MHD_Connection *connection)
 #endif /* COOKIE_SUPPORT */
 
 
+/**
+ * Add the GET argument parsed on the first access.
+ *
+ * @param cls the context (connection)
+ * @param kind kind of the value
+ * @param key key for the value
+ * @param key_size number of bytes in @a key
+ * @param value the value itself
+ * @param value_size number of bytes in @a value
+ * @return #MHD_NO on failure (out of memory), #MHD_YES for success
+ */
+static enum MHD_Result
+connection_add_deferred_arg (void *cls,
+                             const char *key,
+                             size_t key_size,
+                             const char *value,
+                             size_t value_size,
+                             enum MHD_ValueKind kind)
+{
+  struct MHD_Connection *connection = (struct MHD_Connection *) cls;
+  if (MHD_NO ==
+      MHD_set_connection_value_n_nocheck_ (connection,
+                                           kind,
+                                           key,
+                                           key_size,
+                                           value,
+                                           value_size))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (connection->daemon,
+              _ ("Not enough memory in pool to allocate GET argument " \
+                 "record!\n"));
+#endif
+    return MHD_NO;
+  }
+  return MHD_YES;
+}
+
+
+/**
+ * Move the request values added after @a old_tail to the position
+ * after @a pos.
+ * @param c the connection to use
+ * @param old_tail the tail of the list of the request values before
+ *                 adding the new values, could be NULL
+ * @param pos the element after which the new values must be placed,
+ *            NULL to place them at the head of the list
+ */
+static void
+move_new_values (struct MHD_Connection *c,
+                 struct MHD_HTTP_Req_Header *old_tail,
+                 struct MHD_HTTP_Req_Header *pos)
+{
+  struct MHD_HTTP_Req_Header *first;
+  struct MHD_HTTP_Req_Header *last;
+
+  if (old_tail == c->rq.headers_received_tail)
+    return; /* No new values */
+  if (pos == old_tail)
+    return; /* Already at the right place */
+  /* The list had some values before, otherwise 'pos' is equal 'old_tail' */
+  mhd_assert (NULL != old_tail);
+  first = old_tail->next;
+  last = c->rq.headers_received_tail;
+  mhd_assert (NULL != first);
+
+  /* Detach new values */
+  old_tail->next = NULL;
+  c->rq.headers_received_tail = old_tail;
+
+  /* Insert new values */
+  if (NULL == pos)
+  {
+    last->next = c->rq.headers_received;
+    c->rq.headers_received = first;
+  }
+  else
+  {
+    last->next = pos->next;
+    pos->next = first;
+  }
+  mhd_assert (NULL != last->next);
+}
+
+
+void
+MHD_connection_parse_deferred_ (struct MHD_Connection *c,
+                                enum MHD_ValueKind kind)
+{
+  if ( (0 != (kind & MHD_GET_ARGUMENT_KIND)) &&
+       (NULL != c->rq.args_deferred) )
+  {
+    struct MHD_HTTP_Req_Header *const old_tail = c->rq.headers_received_tail;
+    char *const args = c->rq.args_deferred;
+
+    c->rq.args_deferred = NULL;
+    if (MHD_NO == MHD_parse_arguments_ (c,
+                                        MHD_GET_ARGUMENT_KIND,
+                                        args,
+                                        &connection_add_deferred_arg,
+                                        c))
+      c->rq.args_no_space = true;
+    /* The arguments precede any other values */
+    move_new_values (c,
+                     old_tail,
+                     NULL);
+  }
+#ifdef COOKIE_SUPPORT
+  if ( (0 != (kind & MHD_COOKIE_KIND)) &&
+       (c->rq.cookies_deferred) )
+  {
+    struct MHD_HTTP_Req_Header *const old_tail = c->rq.headers_received_tail;
+
+    c->rq.cookies_deferred = false;
+    if (MHD_PARSE_COOKIE_NO_MEMORY == parse_cookie_header (c))
+      c->rq.cookies_no_space = true;
+    /* The cookies follow the request headers */
+    move_new_values (c,
+                     old_tail,
+                     c->rq.cookies_pos);
+  }
+#endif /* COOKIE_SUPPORT */
+}
+
+
 /**
  * The valid length of any HTTP version string
  */
 #define HTTP_VER_LEN (MHD_STATICSTR_LEN_ (MHD_HTTP_VERSION_1_1))
 
+/**
+ * Check whether the request line is the start of the HTTP/2 connection
+ * preface ("PRI * HTTP/2.0"), sent by the clients using HTTP/2 with
+ * prior knowledge.
+ * See https://www.rfc-editor.org/rfc/rfc9113#name-http-2-connection-preface
+ *
+ * @param c the connection to check, the HTTP version must be "HTTP/2.0"
+ * @return true if the request line is the HTTP/2 preface,
+ *         false otherwise
+ */
+static bool
+is_http2_preface (struct MHD_Connection *c)
+{
+  mhd_assert (NULL != c->rq.method);
+  mhd_assert (NULL != c->rq.hdrs.rq_line.rq_tgt);
+  return (MHD_HTTP_MTHD_OTHER == c->rq.http_mthd) &&
+         (0 == strcmp (c->rq.method, "PRI")) &&
+         ('*' == c->rq.hdrs.rq_line.rq_tgt[0]) &&
+         (c->rq.hdrs.rq_line.rq_tgt + 2 == c->rq.version);
+}
+
+
+/**
+ * Refuse the HTTP/2 connection.
+ *
+ * HTTP/2 is not supported.  Instead of HTTP/1.x error response, which
+ * cannot be understood by HTTP/2 client, send the HTTP/2 server preface
+ * (an empty SETTINGS frame) followed by GOAWAY frame with
+ * HTTP_1_1_REQUIRED error code, then close the connection.
+ * The client may retry the request with HTTP/1.1.
+ * See https://www.rfc-editor.org/rfc/rfc9113#name-error-codes
+ *
+ * @param c the connection to refuse
+ */
+static void
+refuse_http2_connection (struct MHD_Connection *c)
+{
+  static const uint8_t frames[] = {
+    /* SETTINGS: length 0, type 0x4, no flags, stream 0 */
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* GOAWAY: length 8, type 0x7, no flags, stream 0 */
+    0x00, 0x00, 0x08, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00,
+    /* Last-Stream-ID: 0 */
+    0x00, 0x00, 0x00, 0x00,
+    /* Error code: HTTP_1_1_REQUIRED (0xd) */
+    0x00, 0x00, 0x00, 0x0d
+  };
+
+  /* Nothing has been sent yet on this connection, the small frames fit
+     the socket buffer.  If sending fails, the connection is just closed. */
+  (void) MHD_send_data_ (c,
+                         (const char *) frames,
+                         sizeof(frames),
+                         true);
+  connection_close_error (c,
+                          _ ("HTTP/2 connection preface has been received, " \
+                             "but HTTP/2 is not supported.\n"));
+}
+
+
 /**
  * Detect HTTP version, send error response if version is not supported
  *
@@ -4299,6 +5167,12 @@ parse_http_version (struct MHD_Connection *connection,
   }
 
   connection->rq.http_ver = MHD_HTTP_VER_FUTURE;
+  if (('2' == h[5]) && ('0' == h[7]) &&
+      is_http2_preface (connection))
+  {
+    refuse_http2_connection (connection);
+    return false;
+  }
   transmit_error_response_static (connection,
                                   MHD_HTTP_HTTP_VERSION_NOT_SUPPORTED,
                                   REQ_HTTP_VER_IS_NOT_SUPPORTED);
@@ -4351,6 +5225,24 @@ parse_http_std_method (struct MHD_Connection *connection,
 }
 
 
+/**
+ * Update the time of the current pass of the event loop after the call
+ * of the application, which could take a long time.  Otherwise
+ * the activity of the connection would be stamped with the time before
+ * the call, while the timeout is checked with the precise clock.
+ * Must be called in the thread that processes the daemon's connections.
+ * @param c the connection to use
+ */
+static void
+connection_refresh_loop_time (struct MHD_Connection *c)
+{
+  struct MHD_Daemon *const daemon = c->daemon;
+
+  if (! MHD_D_IS_USING_THREAD_PER_CONN_ (daemon))
+    daemon->loop_time_ms = MHD_monotonic_msec_counter ();
+}
+
+
 /**
  * Call the handler of the application for this
  * connection.  Handles chunking of the upload
@@ -4366,18 +5258,57 @@ call_connection_handler (struct MHD_Connection *connection)
 
   if (NULL != connection->rp.response)
     return;                     /* already queued a response */
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (MHD_HANDLER_OFFLOAD_DONE == connection->offload_state)
+  {
+    /* The handler has been called by the handler thread */
+    connection->offload_state = MHD_HANDLER_OFFLOAD_NONE;
+    if (MHD_NO == connection->offload_result)
+    {
+      /* serious internal error, close connection */
+      CONNECTION_CLOSE_ERROR (connection,
+                              _ ("Application reported internal error, " \
+                                 "closing connection."));
+      return;
+    }
+    if (! connection->offload_app_suspended)
+    {
+      (void) handle_deferred_values_no_space (connection);
+      return;
+    }
+    /* The application has suspended and then resumed the connection,
+       the handler must be called again. */
+  }
+  if (NULL != MHD_get_master (daemon)->handler_offload)
+  {
+    switch (MHD_handler_offload_submit_ (connection))
+    {
+    case MHD_HANDLER_OFFLOAD_SUBMITTED:
+      connection->rq.client_aware = true;
+      return;
+    case MHD_HANDLER_OFFLOAD_BUSY:
+      transmit_error_response_static (connection,
+                                      MHD_HTTP_SERVICE_UNAVAILABLE,
+                                      HANDLER_OFFLOAD_BUSY);
+      return;
+    case MHD_HANDLER_OFFLOAD_STOPPED:
+    default:
+      break; /* Call the handler in this thread */
+    }
+  }
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
   processed = 0;
   connection->rq.client_aware = true;
   connection->in_access_handler = true;
   if (MHD_NO ==
-      daemon->default_handler (daemon->default_handler_cls,
-                               connection,
-                               connection->rq.url,
-                               connection->rq.method,
-                               connection->rq.version,
-                               NULL,
-                               &processed,
-                               &connection->rq.client_context))
+      connection->rq.handler (connection->rq.handler_cls,
+                              connection,
+                              connection->rq.url,
+                              connection->rq.method,
+                              connection->rq.version,
+                              NULL,
+                              &processed,
+                              &connection->rq.client_context))
   {
     connection->in_access_handler = false;
     /* serious internal error, close connection */
@@ -4387,6 +5318,8 @@ call_connection_handler (struct MHD_Connection *connection)
     return;
   }
   connection->in_access_handler = false;
+  connection_refresh_loop_time (connection);
+  (void) handle_deferred_values_no_space (connection);
 }
 
 
@@ -4614,14 +5547,14 @@ process_request_body (struct MHD_Connection *connection)
     connection->rq.client_aware = true;
     connection->in_access_handler = true;
     if (MHD_NO ==
-        daemon->default_handler (daemon->default_handler_cls,
-                                 connection,
-                                 connection->rq.url,
-                                 connection->rq.method,
-                                 connection->rq.version,
-                                 buffer_head,
-                                 &left_unprocessed,
-                                 &connection->rq.client_context))
+        connection->rq.handler (connection->rq.handler_cls,
+                                connection,
+                                connection->rq.url,
+                                connection->rq.method,
+                                connection->rq.version,
+                                buffer_head,
+                                &left_unprocessed,
+                                &connection->rq.client_context))
     {
       connection->in_access_handler = false;
       /* serious internal error, close connection */
@@ -4631,9 +5564,12 @@ process_request_body (struct MHD_Connection *connection)
       return;
     }
     connection->in_access_handler = false;
+    connection_refresh_loop_time (connection);
 
     if (left_unprocessed > to_be_processed)
       MHD_PANIC (_ ("libmicrohttpd API violation.\n"));
+    if (handle_deferred_values_no_space (connection))
+      return;
 
     connection->rq.some_payload_processed =
       (left_unprocessed != to_be_processed);
@@ -4723,11 +5659,9 @@ parse_connection_headers (struct MHD_Connection *connection)
   size_t val_len;
 
 #ifdef COOKIE_SUPPORT
-  if (MHD_PARSE_COOKIE_NO_MEMORY == parse_cookie_header (connection))
-  {
-    handle_req_cookie_no_space (connection);
-    return;
-  }
+  /* The cookies are parsed on the first access */
+  connection->rq.cookies_deferred = true;
+  connection->rq.cookies_pos = connection->rq.headers_received_tail;
 #endif /* COOKIE_SUPPORT */
   if ( (-3 < connection->daemon->client_discipline) &&
        (MHD_IS_HTTP_VER_1_1_COMPAT (connection->rq.http_ver)) &&
@@ -5585,15 +6519,8 @@ process_request_target (struct MHD_Connection *c)
       - (size_t) (c->rq.hdrs.rq_line.rq_tgt_qmark - c->rq.hdrs.rq_line.rq_tgt);
 #endif /* _DEBUG */
     c->rq.hdrs.rq_line.rq_tgt_qmark[0] = 0; /* Replace '?' with zero termination */
-    if (MHD_NO == MHD_parse_arguments_ (c,
-                                        MHD_GET_ARGUMENT_KIND,
-                                        c->rq.hdrs.rq_line.rq_tgt_qmark + 1,
-                                        &connection_add_header,
-                                        c))
-    {
-      mhd_assert (MHD_CONNECTION_REQ_LINE_RECEIVING != c->state);
-      return false;
-    }
+    /* The arguments are parsed on the first access */
+    c->rq.args_deferred = c->rq.hdrs.rq_line.rq_tgt_qmark + 1;
   }
 #ifdef _DEBUG
   else
@@ -5610,6 +6537,20 @@ process_request_target (struct MHD_Connection *c)
                                   c->rq.hdrs.rq_line.rq_tgt);
   c->rq.url = c->rq.hdrs.rq_line.rq_tgt;
 
+  /* Select the request handler once for the whole request */
+  if (! MHD_router_route_ (c))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (c->daemon,
+              _ ("Not enough memory in pool to store the path " \
+                 "parameters!\n"));
+#endif
+    transmit_error_response_static (c,
+                                    MHD_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE,
+                                    ERR_MSG_REQUEST_TOO_BIG);
+    return false;
+  }
+
   return true;
 }
 
@@ -6356,6 +7297,12 @@ get_req_headers (struct MHD_Connection *c, bool process_footers)
 }
 
 
+/**
+ * The maximum size of the "activity bucket" in milliseconds.
+ * @see #MHD_update_last_activity_()
+ */
+#define MHD_ACTIVITY_BUCKET_MAX_MS 1000
+
 /**
  * Update the 'last_activity' field of the connection to the current time
  * and move the connection to the head of the 'normal_timeout' list if
@@ -6367,6 +7314,8 @@ void
 MHD_update_last_activity_ (struct MHD_Connection *connection)
 {
   struct MHD_Daemon *daemon = connection->daemon;
+  uint64_t prev_activity;
+  uint64_t bucket_size;
 #if defined(MHD_USE_THREADS)
   mhd_assert (NULL == daemon->worker_pool);
 #endif /* MHD_USE_THREADS */
@@ -6377,12 +7326,31 @@ MHD_update_last_activity_ (struct MHD_Connection *connection)
   if (connection->suspended)
     return;  /* no activity on suspended connections */
 
-  connection->last_activity = MHD_monotonic_msec_counter ();
   if (MHD_D_IS_USING_THREAD_PER_CONN_ (daemon))
+  {
+    connection->last_activity = MHD_monotonic_msec_counter ();
     return; /* each connection has personal timeout */
+  }
+  prev_activity = connection->last_activity;
+  connection->last_activity = daemon->loop_time_ms;
 
   if (connection->connection_timeout_ms != daemon->connection_timeout_ms)
     return; /* custom timeout, no need to move it in "normal" DLL */
+
+  /* The "normal" DLL is sorted by the time when the connection was moved
+     to the head of the list.  To avoid the update of the list (and the
+     locking of the mutex) on every read and write, the connection is
+     moved only when its activity time gets to the next "bucket".
+     The connections are out of order by less than the size of the bucket,
+     so the timeouts are detected not later than by the size of the
+     bucket. */
+  bucket_size = daemon->connection_timeout_ms / 16;
+  if (MHD_ACTIVITY_BUCKET_MAX_MS < bucket_size)
+    bucket_size = MHD_ACTIVITY_BUCKET_MAX_MS;
+  if ( (0 != bucket_size) &&
+       ((prev_activity / bucket_size) ==
+        (connection->last_activity / bucket_size)) )
+    return;
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
 #endif
@@ -6573,6 +7541,57 @@ MHD_connection_handle_read (struct MHD_Connection *connection,
 }
 
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+/**
+ * Decide whether the body of the reply is sent in the zero-copy mode.
+ *
+ * Zero-copy send is used only for the data in memory (without the data
+ * reader callback) when the connection is not closed after the reply.
+ * The data of the closed connection could still be unsent when the
+ * response is freed.
+ * The response is referenced until the kernel reports the completion of
+ * all zero-copy sends.  Only one response per connection can be
+ * referenced, if the previous response is still referenced then the reply
+ * is sent without zero-copy.
+ * @param connection the connection to process
+ */
+static void
+setup_reply_zerocopy (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = connection->daemon;
+  struct MHD_Response *const resp = connection->rp.response;
+
+  mhd_assert (! connection->zc_send);
+  if ( (0 == daemon->zerocopy_threshold) ||
+       (0 != (daemon->options & MHD_USE_TLS)) ||
+       (! connection->rp.props.send_reply_body) ||
+       (connection->rp.props.chunked) ||
+       (NULL != resp->crc) ||
+       (resp->total_size < daemon->zerocopy_threshold) ||
+       (MHD_CONN_MUST_CLOSE == connection->keepalive) )
+    return;
+
+  if ( (NULL != connection->zc_response) &&
+       (resp != connection->zc_response) )
+  {
+    (void) MHD_send_zc_complete_ (connection);
+    if (NULL != connection->zc_response)
+      return; /* The previous response is still in use by the kernel */
+  }
+  if (! MHD_send_zc_enable_ (connection))
+    return;
+
+  if (NULL == connection->zc_response)
+  {
+    MHD_increment_response_rc (resp);
+    connection->zc_response = resp;
+  }
+  connection->zc_send = true;
+}
+
+
+#endif /* MHD_USE_ZEROCOPY_SEND */
+
 /**
  * This function was created to handle writes to sockets when it has
  * been determined that the socket can be written to. All
@@ -6675,6 +7694,11 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
       if ( (connection->rp.props.send_reply_body) &&
            (NULL == resp->crc) &&
            (NULL == resp->data_iov) &&
+#ifdef MHD_USE_ZEROCOPY_SEND
+           /* The header is in the pool memory, send zero-copy body
+            * separately */
+           (! connection->zc_send) &&
+#endif /* MHD_USE_ZEROCOPY_SEND */
            /* TODO: remove the next check as 'send_reply_body' is used */
            (0 == connection->rp.rsp_write_position) &&
            (! connection->rp.props.chunked) )
@@ -6692,6 +7716,27 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
                                       resp->data_size,
                                       (resp->total_size == resp->data_size));
       }
+      else if ( (0 == connection->rp.rsp_write_position) &&
+                reply_first_block_with_header (connection))
+      {
+        size_t first_block_size;
+
+        /* Send response headers alongside the first block of the
+         * dynamically generated body, if the block is available. */
+        reply_lock_response (connection);
+        /* The shared response's buffer could be already reused for
+         * other data */
+        first_block_size = (0 == resp->data_start) ? resp->data_size : 0;
+        ret = MHD_send_hdr_and_body_ (connection,
+                                      &connection->write_buffer
+                                      [connection->write_buffer_send_offset],
+                                      wb_ready,
+                                      false,
+                                      resp->data,
+                                      first_block_size,
+                                      (resp->total_size == first_block_size));
+        reply_unlock_response (connection);
+      }
       else
       {
         /* This is response for HEAD request or reply body is not allowed
@@ -6753,10 +7798,7 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
     {
       uint64_t data_write_offset;
 
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-      if (NULL != response->crc)
-        MHD_mutex_lock_chk_ (&response->mutex);
-#endif
+      reply_lock_response (connection);
       if (MHD_NO == try_ready_normal_body (connection))
       {
         /* mutex was already unlocked by try_ready_normal_body */
@@ -6776,6 +7818,28 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
                                &connection->rp.resp_iov,
                                true);
       }
+      else if (NULL != response->bcb)
+      {
+        ret = MHD_send_iovec_ (connection,
+                               &connection->rp.chunk_iov,
+                               true);
+        if (connection->rp.chunk_iov.cnt == connection->rp.chunk_iov.sent)
+        {
+          connection->rp.chunk_iov.cnt = 0;
+          reply_release_borrowed (connection);
+        }
+      }
+      else if (connection->rp.crc_unlocked)
+      {
+        ret = MHD_send_data_ (connection,
+                              &connection->write_buffer
+                              [connection->write_buffer_send_offset],
+                              connection->write_buffer_append_offset
+                              - connection->write_buffer_send_offset,
+                              true);
+        if (0 < ret)
+          connection->write_buffer_send_offset += (size_t) ret;
+      }
       else
       {
         data_write_offset = connection->rp.rsp_write_position
@@ -6798,10 +7862,7 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
                                       - rp.response->data_start]);
 #endif
       }
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-      if (NULL != response->crc)
-        MHD_mutex_unlock_chk_ (&response->mutex);
-#endif
+      reply_unlock_response (connection);
       if (ret < 0)
       {
         if (MHD_ERR_AGAIN_ == ret)
@@ -6828,12 +7889,17 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
     mhd_assert (0);
     return;
   case MHD_CONNECTION_CHUNKED_BODY_READY:
-    ret = MHD_send_data_ (connection,
-                          &connection->write_buffer
-                          [connection->write_buffer_send_offset],
-                          connection->write_buffer_append_offset
-                          - connection->write_buffer_send_offset,
-                          true);
+    if (0 != connection->rp.chunk_iov.cnt)
+      ret = MHD_send_iovec_ (connection,
+                             &connection->rp.chunk_iov,
+                             true);
+    else
+      ret = MHD_send_data_ (connection,
+                            &connection->write_buffer
+                            [connection->write_buffer_send_offset],
+                            connection->write_buffer_append_offset
+                            - connection->write_buffer_send_offset,
+                            true);
     if (ret < 0)
     {
       if (MHD_ERR_AGAIN_ == ret)
@@ -6849,8 +7915,16 @@ MHD_connection_handle_write (struct MHD_Connection *connection)
                               NULL);
       return;
     }
-    connection->write_buffer_send_offset += (size_t) ret;
     MHD_update_last_activity_ (connection);
+    if (0 != connection->rp.chunk_iov.cnt)
+    {
+      if (connection->rp.chunk_iov.cnt != connection->rp.chunk_iov.sent)
+        return;
+      connection->rp.chunk_iov.cnt = 0;
+      reply_release_borrowed (connection);
+    }
+    else
+      connection->write_buffer_send_offset += (size_t) ret;
     if (MHD_CONNECTION_CHUNKED_BODY_READY != connection->state)
       return;
     check_write_done (connection,
@@ -6962,6 +8036,31 @@ connection_check_timedout (struct MHD_Connection *c)
 }
 
 
+/**
+ * Check whether connection must be closed as the daemon is draining
+ * connections.
+ * @param c the connection to check
+ * @return true if connection is idle or the draining deadline is reached
+ *         and connection needs to be closed,
+ *         false otherwise.
+ */
+static bool
+connection_check_drained (struct MHD_Connection *c)
+{
+  struct MHD_Daemon *const daemon = c->daemon;
+
+  if (! daemon->draining)
+    return false;
+  if (c->suspended)
+    return false;
+  if ( (MHD_CONNECTION_INIT == c->state) &&
+       (0 == c->read_buffer_offset) )
+    return true; /* Idle keep-alive connection */
+  return 0 <= (int64_t) (MHD_monotonic_msec_counter ()
+                         - MHD_get_drain_deadline_ (daemon));
+}
+
+
 /**
  * Clean up the state of the given connection and move it into the
  * clean up queue for final disposal.
@@ -7126,10 +8225,19 @@ connection_reset (struct MHD_Connection *connection,
                            MHD_REQUEST_TERMINATED_COMPLETED_OK);
     c->rq.client_aware = false;
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+    c->zc_send = false;
+    if (NULL != c->zc_response)
+      (void) MHD_send_zc_complete_ (c);
+#endif /* MHD_USE_ZEROCOPY_SEND */
+    reply_release_borrowed (c);
     if (NULL != c->rp.response)
       MHD_destroy_response (c->rp.response);
     c->rp.response = NULL;
 
+    if (d->pool_profile)
+      connection_mem_profile_commit (c);
+
     c->keepalive = MHD_CONN_KEEPALIVE_UNKOWN;
     c->state = MHD_CONNECTION_INIT;
     c->event_loop_info =
@@ -7185,10 +8293,10 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
   mhd_assert ( (! MHD_D_IS_USING_THREADS_ (daemon)) || \
                MHD_thread_handle_ID_is_current_thread_ (connection->tid) );
 #endif /* MHD_USE_THREADS */
-  /* 'daemon' is not used if epoll is not available and asserts are disabled */
-  (void) daemon; /* Mute compiler warning */
 
   connection->in_idle = true;
+  if (daemon->pool_profile)
+    connection_mem_profile_sample (connection);
   while (! connection->suspended)
   {
 #ifdef HTTPS_SUPPORT
@@ -7351,6 +8459,12 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
                                    "response header).\n"));
         continue;
       }
+#ifdef MHD_USE_ZEROCOPY_SEND
+      setup_reply_zerocopy (connection);
+#endif /* MHD_USE_ZEROCOPY_SEND */
+      if ( (reply_first_block_with_header (connection)) &&
+           (MHD_NO == reply_ready_first_block (connection)) )
+        continue;
       connection->state = MHD_CONNECTION_HEADERS_SENDING;
       break;
 
@@ -7402,16 +8516,10 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
     case MHD_CONNECTION_NORMAL_BODY_UNREADY:
       mhd_assert (connection->rp.props.send_reply_body);
       mhd_assert (! connection->rp.props.chunked);
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-      if (NULL != connection->rp.response->crc)
-        MHD_mutex_lock_chk_ (&connection->rp.response->mutex);
-#endif
+      reply_lock_response (connection);
       if (0 == connection->rp.response->total_size)
       {
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-        if (NULL != connection->rp.response->crc)
-          MHD_mutex_unlock_chk_ (&connection->rp.response->mutex);
-#endif
+        reply_unlock_response (connection);
         if (connection->rp.props.chunked)
           connection->state = MHD_CONNECTION_CHUNKED_BODY_SENT;
         else
@@ -7420,10 +8528,7 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
       }
       if (MHD_NO != try_ready_normal_body (connection))
       {
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-        if (NULL != connection->rp.response->crc)
-          MHD_mutex_unlock_chk_ (&connection->rp.response->mutex);
-#endif
+        reply_unlock_response (connection);
         connection->state = MHD_CONNECTION_NORMAL_BODY_READY;
         /* Buffering for flushable socket was already enabled*/
 
@@ -7440,18 +8545,12 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
     case MHD_CONNECTION_CHUNKED_BODY_UNREADY:
       mhd_assert (connection->rp.props.send_reply_body);
       mhd_assert (connection->rp.props.chunked);
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-      if (NULL != connection->rp.response->crc)
-        MHD_mutex_lock_chk_ (&connection->rp.response->mutex);
-#endif
+      reply_lock_response (connection);
       if ( (0 == connection->rp.response->total_size) ||
            (connection->rp.rsp_write_position ==
             connection->rp.response->total_size) )
       {
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-        if (NULL != connection->rp.response->crc)
-          MHD_mutex_unlock_chk_ (&connection->rp.response->mutex);
-#endif
+        reply_unlock_response (connection);
         connection->state = MHD_CONNECTION_CHUNKED_BODY_SENT;
         continue;
       }
@@ -7460,10 +8559,7 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
         bool finished;
         if (MHD_NO != try_ready_chunked_body (connection, &finished))
         {
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-          if (NULL != connection->rp.response->crc)
-            MHD_mutex_unlock_chk_ (&connection->rp.response->mutex);
-#endif
+          reply_unlock_response (connection);
           connection->state = finished ? MHD_CONNECTION_CHUNKED_BODY_SENT :
                               MHD_CONNECTION_CHUNKED_BODY_READY;
           continue;
@@ -7504,11 +8600,15 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
         /* FIXME: maybe partially reset memory pool? */
         continue;
       }
-      /* Reset connection after complete reply */
+      /* Reset connection after complete reply.
+         If draining has been started after the reply header, the idle
+         connection is handed off by connection_check_drained() below. */
       connection_reset (connection,
                         MHD_CONN_USE_KEEPALIVE == connection->keepalive &&
                         ! connection->read_closed &&
-                        ! connection->discard_request);
+                        ! connection->discard_request &&
+                        ( (! daemon->draining) ||
+                          (NULL != daemon->drain_handoff_cb) ));
       continue;
     case MHD_CONNECTION_CLOSED:
       cleanup_connection (connection);
@@ -7525,6 +8625,8 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
     }
     break;
   }
+  if (daemon->pool_profile)
+    connection_mem_profile_sample (connection);
   if (connection_check_timedout (connection))
   {
     MHD_connection_close_ (connection,
@@ -7532,6 +8634,21 @@ MHD_connection_handle_idle (struct MHD_Connection *connection)
     connection->in_idle = false;
     return MHD_YES;
   }
+  if (connection_check_drained (connection))
+  {
+    /* Connections without timeout are not revisited by the event loop,
+       clean up immediately */
+    if ( (NULL != daemon->drain_handoff_cb) &&
+         (0 == (daemon->options & MHD_USE_TLS)) &&
+         (MHD_CONNECTION_INIT == connection->state) &&
+         (0 == connection->read_buffer_offset) )
+      connection->drain_handoff = true; /* Keep the socket open for the app */
+    MHD_connection_close_ (connection,
+                           MHD_REQUEST_TERMINATED_DAEMON_SHUTDOWN);
+    cleanup_connection (connection);
+    connection->in_idle = false;
+    return MHD_NO;
+  }
   MHD_connection_update_event_loop_info (connection);
   ret = MHD_YES;
 #ifdef EPOLL_SUPPORT
@@ -7584,6 +8701,7 @@ MHD_connection_epoll_update_ (struct MHD_Connection *connection)
 
     event.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET;
     event.data.ptr = connection;
+    daemon->epoll_ctl_conn_calls++;
     if (0 != epoll_ctl (daemon->epoll_fd,
                         EPOLL_CTL_ADD,
                         connection->socket_fd,
@@ -8041,7 +9159,8 @@ MHD_queue_response (struct MHD_Connection *connection,
   connection->rp.responseCode = status_code;
   connection->rp.responseIcy = reply_icy;
 #if defined(_MHD_HAVE_SENDFILE)
-  if ( (response->fd == -1) ||
+  if ( ( (response->fd == -1) &&
+         (NULL == response->data_segs) ) ||
        (response->is_pipe) ||
        (0 != (connection->daemon->options & MHD_USE_TLS))
 #if defined(MHD_SEND_SPIPE_SUPPRESS_NEEDED) && \
@@ -8054,6 +9173,27 @@ MHD_queue_response (struct MHD_Connection *connection,
   else
     connection->rp.resp_sender = MHD_resp_sender_sendfile;
 #endif /* _MHD_HAVE_SENDFILE */
+  if (1)
+  { /* pseudo-branch for local variables scope */
+    /* Positional readers of files do not use the shared state */
+    const bool file_backed = ( (-1 != response->fd) &&
+                               (! response->is_pipe) ) ||
+                             (NULL != response->data_segs);
+
+    connection->rp.crc_unlocked =
+      (NULL != response->crc) &&
+#if defined(_MHD_HAVE_SENDFILE)
+      (MHD_resp_sender_std == connection->rp.resp_sender) &&
+#endif /* _MHD_HAVE_SENDFILE */
+      ( (file_backed) ||
+        (0 != (response->flags & MHD_RF_CONTENT_READER_THREAD_SAFE)) );
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+    connection->rp.fr_offload =
+      (connection->rp.crc_unlocked) &&
+      (file_backed) &&
+      (NULL != MHD_get_master (daemon)->file_read_offload);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  }
   /* FIXME: if 'is_pipe' is set, TLS is off, and we have *splice*, we could use splice()
      to avoid two user-space copies... */
 
@@ -8079,6 +9219,8 @@ MHD_queue_response (struct MHD_Connection *connection,
   }
   if (! connection->in_idle)
     (void) MHD_connection_handle_idle (connection);
+  if (! connection->suspended)
+    connection_refresh_loop_time (connection);
   MHD_update_last_activity_ (connection);
   return MHD_YES;
 }
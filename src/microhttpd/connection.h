@@ -213,4 +213,22 @@ void *
 MHD_connection_alloc_memory_ (struct MHD_Connection *connection,
                               size_t size);
 
+
+/**
+ * Parse the request values of the given kind if parsing of them has been
+ * deferred until the first use.
+ * The GET arguments and the cookies are parsed only when they are
+ * requested for the first time.  The parsed values are inserted into
+ * the list of the request values at the same positions as if they were
+ * parsed when the request was received.
+ * If the pool has no space for the parsed values, the values that do not
+ * fit are missing and the error is replied when the access handler returns
+ * without queuing a response.
+ * @param c the connection to use
+ * @param kind the kind (the bitmask of the kinds) of the requested values
+ */
+void
+MHD_connection_parse_deferred_ (struct MHD_Connection *c,
+                                enum MHD_ValueKind kind);
+
 #endif
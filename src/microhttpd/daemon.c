@@ -46,6 +46,7 @@
 #include "mhd_send.h"
 #include "mhd_align.h"
 #include "mhd_str.h"
+#include "router.h"
 
 #ifdef MHD_USE_SYS_TSEARCH
 #include <search.h>
@@ -72,6 +73,9 @@
 #include <signal.h>
 #endif /* HAVE_SIGNAL_H */
 #endif /* MHD_USE_POSIX_THREADS */
+#ifdef HAVE_POSIX_FADVISE
+#include <fcntl.h>
+#endif /* HAVE_POSIX_FADVISE */
 
 /**
  * Default connection limit.
@@ -114,6 +118,19 @@ MHD_fini (void);
 static void
 close_all_connections (struct MHD_Daemon *daemon);
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+/**
+ * Start the next worker of the pool if @a worker is the last started
+ * worker.
+ * @remark To be called only from the worker's thread
+ *
+ * @param worker the worker daemon that has got a new connection
+ */
+static void
+worker_pool_grow_ (struct MHD_Daemon *worker);
+
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
 #ifdef EPOLL_SUPPORT
 
 /**
@@ -1196,7 +1213,8 @@ MHD_get_fdset2 (struct MHD_Daemon *daemon,
        (NULL == read_fd_set) ||
        (NULL == write_fd_set) ||
        MHD_D_IS_USING_THREADS_ (daemon) ||
-       MHD_D_IS_USING_POLL_ (daemon))
+       MHD_D_IS_USING_POLL_ (daemon) ||
+       MHD_D_IS_USING_WATCH_ (daemon))
     return MHD_NO;
 
 #ifdef HAVE_MESSAGES
@@ -1276,6 +1294,140 @@ MHD_get_fdset2 (struct MHD_Daemon *daemon,
 }
 
 
+/**
+ * Update the interest of the connection's socket watched by the application
+ * and the connection's membership in the daemon's list of connections that
+ * need processing without network activity.
+ * The application is notified only if the interest has been changed.
+ *
+ * @param c the connection to update
+ */
+static void
+watch_connection_update_ (struct MHD_Connection *c)
+{
+  struct MHD_Daemon *const daemon = c->daemon;
+  enum MHD_WatchEvents interest;
+  bool pending;
+
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+
+  if (MHD_EVENT_LOOP_INFO_CLEANUP == c->event_loop_info)
+  {
+    /* The connection will be removed from the watched set when cleaned up */
+    interest = c->watch_interest;
+    pending = false;
+  }
+  else if (c->suspended)
+  {
+    interest = MHD_WATCH_EVENT_NONE;
+    pending = false;
+  }
+  else
+  {
+    interest = MHD_WATCH_EVENT_NONE;
+    if (0 != (MHD_EVENT_LOOP_INFO_READ & c->event_loop_info))
+      interest |= MHD_WATCH_EVENT_RECV;
+    if (0 != (MHD_EVENT_LOOP_INFO_WRITE & c->event_loop_info))
+      interest |= MHD_WATCH_EVENT_SEND;
+    pending = (0 != (MHD_EVENT_LOOP_INFO_PROCESS & c->event_loop_info));
+#ifdef HTTPS_SUPPORT
+    if ( (c->tls_read_ready) &&
+         (0 != (MHD_EVENT_LOOP_INFO_READ & c->event_loop_info)) )
+      pending = true;
+#endif /* HTTPS_SUPPORT */
+  }
+
+  if (pending != c->watch_pending)
+  {
+    /* Connections already in the list are not moved to keep the list
+       stable while it is processed. */
+    if (pending)
+      WDLL_insert (daemon->watch_pending_head,
+                   daemon->watch_pending_tail,
+                   c);
+    else
+      WDLL_remove (daemon->watch_pending_head,
+                   daemon->watch_pending_tail,
+                   c);
+    c->watch_pending = pending;
+  }
+
+  if ( (! c->watch_registered) ||
+       (interest != c->watch_interest) )
+  {
+    c->watch_registered = true;
+    c->watch_interest = interest;
+    daemon->watch_socket_cb (daemon->watch_socket_cb_cls,
+                             c->socket_fd,
+                             interest,
+                             c,
+                             &c->watch_app_ctx);
+  }
+}
+
+
+/**
+ * Remove the connection's socket from the set of sockets watched by
+ * the application.
+ *
+ * @param c the connection to remove
+ */
+static void
+watch_connection_remove_ (struct MHD_Connection *c)
+{
+  struct MHD_Daemon *const daemon = c->daemon;
+
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+
+  if (c->watch_pending)
+  {
+    WDLL_remove (daemon->watch_pending_head,
+                 daemon->watch_pending_tail,
+                 c);
+    c->watch_pending = false;
+  }
+  if (c->watch_registered)
+  {
+    c->watch_registered = false;
+    daemon->watch_socket_cb (daemon->watch_socket_cb_cls,
+                             c->socket_fd,
+                             MHD_WATCH_EVENT_REMOVE,
+                             c,
+                             &c->watch_app_ctx);
+  }
+}
+
+
+/**
+ * Check whether the connection has more data to be processed after
+ * the connection's data and states are processed for this turn.
+ * If connection already has more data to be processed - use
+ * zero timeout for next select()/poll().
+ *
+ * @param con the connection to check
+ */
+static void
+check_data_already_pending (struct MHD_Connection *con)
+{
+  /* Thread-per-connection do not need global zero timeout as
+   * connections are processed individually. */
+  /* Note: no need to check for read buffer availability for
+   * TLS read-ready connection in 'read info' state as connection
+   * without space in read buffer will be marked as 'info block'. */
+  if ( (! con->daemon->data_already_pending) &&
+       (! MHD_D_IS_USING_THREAD_PER_CONN_ (con->daemon)) )
+  {
+    if (0 != (MHD_EVENT_LOOP_INFO_PROCESS & con->event_loop_info))
+      con->daemon->data_already_pending = true;
+#ifdef HTTPS_SUPPORT
+    else if ( (con->tls_read_ready) &&
+              (0 != (MHD_EVENT_LOOP_INFO_READ & con->event_loop_info)) )
+      con->daemon->data_already_pending = true;
+#endif /* HTTPS_SUPPORT */
+  }
+}
+
+
 /**
  * Call the handlers for a connection in the appropriate order based
  * on the readiness as detected by the event loop.
@@ -1312,6 +1464,22 @@ call_handlers (struct MHD_Connection *con,
   if (con->tls_read_ready)
     read_ready = true;
 #endif /* HTTPS_SUPPORT */
+#ifdef MHD_USE_ZEROCOPY_SEND
+  /* The zero-copy notifications are signalled as the error condition by
+     poll() and epoll (handled by the epoll loop), and as readiness for
+     reading and writing by select(). */
+  if ( (NULL != con->zc_response) &&
+       (! MHD_D_IS_USING_EPOLL_ (con->daemon)) &&
+       (force_close ||
+        (MHD_D_IS_USING_SELECT_ (con->daemon) && (read_ready || write_ready)))
+       && MHD_send_zc_complete_ (con) )
+  {
+    /* The error condition reported by select() or poll() is caused by
+       the zero-copy notifications.  If the socket was disconnected, it
+       will be reported again on the next round. */
+    force_close = false;
+  }
+#endif /* MHD_USE_ZEROCOPY_SEND */
   if ( (0 != (MHD_EVENT_LOOP_INFO_READ & con->event_loop_info)) &&
        (read_ready || (force_close && con->sk_nonblck)) )
   {
@@ -1375,25 +1543,8 @@ call_handlers (struct MHD_Connection *con,
     }
   }
 
-  /* All connection's data and states are processed for this turn.
-   * If connection already has more data to be processed - use
-   * zero timeout for next select()/poll(). */
-  /* Thread-per-connection do not need global zero timeout as
-   * connections are processed individually. */
-  /* Note: no need to check for read buffer availability for
-   * TLS read-ready connection in 'read info' state as connection
-   * without space in read buffer will be marked as 'info block'. */
-  if ( (! con->daemon->data_already_pending) &&
-       (! MHD_D_IS_USING_THREAD_PER_CONN_ (con->daemon)) )
-  {
-    if (0 != (MHD_EVENT_LOOP_INFO_PROCESS & con->event_loop_info))
-      con->daemon->data_already_pending = true;
-#ifdef HTTPS_SUPPORT
-    else if ( (con->tls_read_ready) &&
-              (0 != (MHD_EVENT_LOOP_INFO_READ & con->event_loop_info)) )
-      con->daemon->data_already_pending = true;
-#endif /* HTTPS_SUPPORT */
-  }
+  /* All connection's data and states are processed for this turn. */
+  check_data_already_pending (con);
   return ret;
 }
 
@@ -1985,29 +2136,145 @@ connection_get_wait (struct MHD_Connection *c)
 
 
 /**
- * Main function of the thread that handles an individual
- * connection when #MHD_USE_THREAD_PER_CONNECTION is set.
+ * Get maximum wait period before the draining deadline.
+ * @param daemon the draining daemon
+ * @return the number of milliseconds left before the draining deadline,
+ *         UINT64_MAX if the deadline has been reached already
+ */
+static uint64_t
+drain_get_wait (struct MHD_Daemon *daemon)
+{
+  const uint64_t now = MHD_monotonic_msec_counter ();
+  const uint64_t deadline = MHD_get_drain_deadline_ (daemon);
+
+  if (0 <= (int64_t) (now - deadline))
+    return UINT64_MAX; /* Connections are being closed already */
+  return deadline - now;
+}
+
+
+/**
+ * Report the number of connections left to the draining callback.
+ * The callback is called with the master's drain lock held, the calls
+ * from the different threads are serialised.
+ * @param daemon the daemon (master or worker)
+ * @remark To be called without holding any of
+ *         MHD_Daemon::cleanup_connection_mutex.
+ */
+static void
+drain_report_progress (struct MHD_Daemon *daemon)
+{
+  struct MHD_Daemon *const master = MHD_get_master (daemon);
+  unsigned int left;
+
+  if (NULL == master->drain_cb)
+    return;
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_lock_chk_ (&master->drain_lock);
+  if (NULL != master->worker_pool)
+  {
+    unsigned int i;
+
+    left = 0;
+    for (i = 0; i < master->worker_pool_size; i++)
+    {
+      struct MHD_Daemon *const worker = master->worker_pool + i;
+
+      MHD_mutex_lock_chk_ (&worker->cleanup_connection_mutex);
+      left += worker->connections;
+      MHD_mutex_unlock_chk_ (&worker->cleanup_connection_mutex);
+    }
+  }
+  else
+  {
+    MHD_mutex_lock_chk_ (&master->cleanup_connection_mutex);
+    left = master->connections;
+    MHD_mutex_unlock_chk_ (&master->cleanup_connection_mutex);
+  }
+#else  /* ! MHD_USE_POSIX_THREADS && ! MHD_USE_W32_THREADS */
+  left = master->connections;
+#endif /* ! MHD_USE_POSIX_THREADS && ! MHD_USE_W32_THREADS */
+  master->drain_cb (master->drain_cb_cls,
+                    left);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_unlock_chk_ (&master->drain_lock);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+}
+
+
+/**
+ * Mark the connection as not used anymore by the reusable connection
+ * thread so the daemon can free the connection.
+ * Replaces joining of the connection thread when connection threads are
+ * reused.
  *
- * @param data the `struct MHD_Connection` this thread will handle
- * @return always 0
+ * @param con the connection
  */
-static MHD_THRD_RTRN_TYPE_ MHD_THRD_CALL_SPEC_
-thread_main_handle_connection (void *data)
+static void
+connection_thread_release_ (struct MHD_Connection *con)
+{
+  struct MHD_Daemon *const daemon = con->daemon;
+
+  if (! MHD_D_IS_REUSING_CONN_THREADS_ (daemon))
+    return;
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  con->thread_joined = true;
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+}
+
+
+/**
+ * Get maximum wait period for the connection thread.
+ * While draining, the wait is limited by the draining deadline.
+ * @param con the connection to check
+ * @return the number of milliseconds to wait for the network events,
+ *         UINT64_MAX if the wait is not limited
+ */
+static uint64_t
+connection_thread_get_wait_ (struct MHD_Connection *con)
+{
+  struct MHD_Daemon *const daemon = con->daemon;
+  uint64_t mseconds_left;
+
+  if (con->connection_timeout_ms > 0)
+    mseconds_left = connection_get_wait (con);
+  else
+    mseconds_left = UINT64_MAX;
+  if (daemon->draining)
+  {
+    const uint64_t drain_left = drain_get_wait (daemon);
+
+    if (UINT64_MAX == drain_left)
+      return 0; /* The connection must be closed now */
+    if (drain_left < mseconds_left)
+      mseconds_left = drain_left;
+  }
+  return mseconds_left;
+}
+
+
+/**
+ * Handle an individual connection in the current thread until the
+ * connection is closed when #MHD_USE_THREAD_PER_CONNECTION is set.
+ *
+ * @param con the connection to handle
+ */
+static void
+handle_connection_in_thread_ (struct MHD_Connection *con)
 {
-  struct MHD_Connection *con = data;
   struct MHD_Daemon *daemon = con->daemon;
   int num_ready;
   fd_set rs;
   fd_set ws;
   fd_set es;
   MHD_socket maxsock;
-#ifdef WINDOWS
 #ifdef HAVE_POLL
   unsigned int extra_slot;
 #endif /* HAVE_POLL */
-#define EXTRA_SLOTS 1
+#ifdef WINDOWS
+#define EXTRA_SLOTS 2
 #else  /* !WINDOWS */
-#define EXTRA_SLOTS 0
+#define EXTRA_SLOTS 1
 #endif /* !WINDOWS */
 #ifdef HAVE_POLL
   struct pollfd p[1 + EXTRA_SLOTS];
@@ -2019,7 +2286,6 @@ thread_main_handle_connection (void *data)
   const bool use_poll = 0;
 #endif /* ! HAVE_POLL */
   bool was_suspended = false;
-  MHD_thread_handle_ID_set_current_thread_ID_ (&(con->tid));
 
   while ( (! daemon->shutdown) &&
           (MHD_CONNECTION_CLOSED != con->state) )
@@ -2121,9 +2387,10 @@ thread_main_handle_connection (void *data)
         tv.tv_usec = 0;
         tvp = &tv;
       }
-      else if (con->connection_timeout_ms > 0)
+      else if ( (con->connection_timeout_ms > 0) ||
+                (daemon->draining) )
       {
-        const uint64_t mseconds_left = connection_get_wait (con);
+        const uint64_t mseconds_left = connection_thread_get_wait_ (con);
 #if (SIZEOF_UINT64_T - 2) >= SIZEOF_STRUCT_TIMEVAL_TV_SEC
         if (mseconds_left / 1000 > TIMEVAL_TV_SEC_MAX)
           tv.tv_sec = TIMEVAL_TV_SEC_MAX;
@@ -2179,6 +2446,16 @@ thread_main_handle_connection (void *data)
           err_state = 1;
       }
 #endif
+      /* Wake up when draining is started */
+      if ( (MHD_ITC_IS_VALID_ (daemon->drain_itc)) &&
+           (! daemon->draining) )
+      {
+        if (! MHD_add_to_fd_set_ (MHD_itc_r_fd_ (daemon->drain_itc),
+                                  &rs,
+                                  &maxsock,
+                                  FD_SETSIZE))
+          err_state = true;
+      }
       if (err_state)
       {
 #ifdef HAVE_MESSAGES
@@ -2232,9 +2509,10 @@ thread_main_handle_connection (void *data)
       /* use poll */
       if (use_zero_timeout)
         timeout_val = 0;
-      else if (con->connection_timeout_ms > 0)
+      else if ( (con->connection_timeout_ms > 0) ||
+                (daemon->draining) )
       {
-        const uint64_t mseconds_left = connection_get_wait (con);
+        const uint64_t mseconds_left = connection_thread_get_wait_ (con);
 #if SIZEOF_UINT64_T >= SIZEOF_INT
         if (mseconds_left >= INT_MAX)
           timeout_val = INT_MAX;
@@ -2264,8 +2542,8 @@ thread_main_handle_connection (void *data)
         /* how did we get here!? */
         goto exit;
       }
-#ifdef WINDOWS
       extra_slot = 0;
+#ifdef WINDOWS
       if (MHD_ITC_IS_VALID_ (daemon->itc))
       {
         p[1].events |= POLLIN;
@@ -2274,12 +2552,17 @@ thread_main_handle_connection (void *data)
         extra_slot = 1;
       }
 #endif
+      /* Wake up when draining is started */
+      if ( (MHD_ITC_IS_VALID_ (daemon->drain_itc)) &&
+           (! daemon->draining) )
+      {
+        p[1 + extra_slot].events = POLLIN;
+        p[1 + extra_slot].fd = MHD_itc_r_fd_ (daemon->drain_itc);
+        p[1 + extra_slot].revents = 0;
+        extra_slot++;
+      }
       if (MHD_sys_poll_ (p,
-#ifdef WINDOWS
                          1 + extra_slot,
-#else
-                         1,
-#endif
                          timeout_val) < 0)
       {
         if (MHD_SCKT_LAST_ERR_IS_ (MHD_SCKT_EINTR_))
@@ -2329,9 +2612,10 @@ thread_main_handle_connection (void *data)
        * will stay in suspended list until 'urh' will be marked
        * with 'was_closed' by application. */
       MHD_resume_connection (con);
+      connection_thread_release_ (con);
 
       /* skip usual clean up  */
-      return (MHD_THRD_RTRN_TYPE_) 0;
+      return;
     }
 #endif /* UPGRADE_SUPPORT */
   }
@@ -2354,7 +2638,8 @@ exit:
     con->rp.response = NULL;
   }
 
-  if (MHD_INVALID_SOCKET != con->socket_fd)
+  if ( (MHD_INVALID_SOCKET != con->socket_fd) &&
+       (! con->drain_handoff) )
   {
     shutdown (con->socket_fd,
               SHUT_WR);
@@ -2362,6 +2647,7 @@ exit:
      * To avoid data races, do not close socket here. Daemon will
      * use more connections only after cleanup anyway. */
   }
+  connection_thread_release_ (con);
   if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
        (! MHD_itc_activate_ (daemon->itc, "t")) )
   {
@@ -2371,85 +2657,447 @@ exit:
                  "communication channel.\n"));
 #endif
   }
-  return (MHD_THRD_RTRN_TYPE_) 0;
 }
 
 
-#endif
-
-
 /**
- * Free resources associated with all closed connections.
- * (destroy responses, free buffers, etc.).  All closed
- * connections are kept in the "cleanup" doubly-linked list.
+ * Main function of the thread that handles an individual
+ * connection when #MHD_USE_THREAD_PER_CONNECTION is set.
  *
- * @param daemon daemon to clean up
- */
-static void
-MHD_cleanup_connections (struct MHD_Daemon *daemon);
-
-#if defined(HTTPS_SUPPORT)
-#if defined(MHD_SEND_SPIPE_SUPPRESS_NEEDED) && \
-  defined(MHD_SEND_SPIPE_SUPPRESS_POSSIBLE) && \
-  ! defined(MHD_socket_nosignal_) && \
-  (GNUTLS_VERSION_NUMBER + 0 < 0x030402) && defined(MSG_NOSIGNAL)
-/**
- * Older version of GnuTLS do not support suppressing of SIGPIPE signal.
- * Use push function replacement with suppressing SIGPIPE signal where necessary
- * and if possible.
- */
-#define MHD_TLSLIB_NEED_PUSH_FUNC 1
-#endif /* MHD_SEND_SPIPE_SUPPRESS_NEEDED &&
-          MHD_SEND_SPIPE_SUPPRESS_POSSIBLE &&
-          ! MHD_socket_nosignal_ && (GNUTLS_VERSION_NUMBER+0 < 0x030402) &&
-          MSG_NOSIGNAL */
-
-#ifdef MHD_TLSLIB_NEED_PUSH_FUNC
-/**
- * Data push function replacement with suppressing SIGPIPE signal
- * for TLS library.
+ * @param data the `struct MHD_Connection` this thread will handle
+ * @return always 0
  */
-static ssize_t
-MHD_tls_push_func_ (gnutls_transport_ptr_t trnsp,
-                    const void *data,
-                    size_t data_size)
+static MHD_THRD_RTRN_TYPE_ MHD_THRD_CALL_SPEC_
+thread_main_handle_connection (void *data)
 {
-#if (MHD_SCKT_SEND_MAX_SIZE_ < SSIZE_MAX) || (0 == SSIZE_MAX)
-  if (data_size > MHD_SCKT_SEND_MAX_SIZE_)
-    data_size = MHD_SCKT_SEND_MAX_SIZE_;
-#endif /* (MHD_SCKT_SEND_MAX_SIZE_ < SSIZE_MAX) || (0 == SSIZE_MAX) */
-  return MHD_send_ ((MHD_socket) (intptr_t) (trnsp), data, data_size);
-}
-
+  struct MHD_Connection *con = data;
 
-#endif /* MHD_TLSLIB_DONT_SUPPRESS_SIGPIPE */
+  MHD_thread_handle_ID_set_current_thread_ID_ (&(con->tid));
+  handle_connection_in_thread_ (con);
+  return (MHD_THRD_RTRN_TYPE_) 0;
+}
 
 
 /**
- * Function called by GNUtls to obtain the PSK for a given session.
+ * Wait until the parked connection thread is woken up or the idle
+ * timeout expires.
  *
- * @param session the session to lookup PSK for
- * @param username username to lookup PSK for
- * @param[out] key where to write PSK
- * @return 0 on success, -1 on error
+ * @param ct the connection thread
+ * @return 'true' if thread has been woken up,
+ *         'false' if idle timeout expired
  */
-static int
-psk_gnutls_adapter (gnutls_session_t session,
-                    const char *username,
-                    gnutls_datum_t *key)
+static bool
+conn_thread_sleep_ (struct MHD_ConnectionThread *ct)
 {
-  struct MHD_Connection *connection;
-  struct MHD_Daemon *daemon;
-#if GNUTLS_VERSION_MAJOR >= 3
-  void *app_psk;
-  size_t app_psk_size;
-#endif /* GNUTLS_VERSION_MAJOR >= 3 */
+  struct MHD_Daemon *const daemon = ct->daemon;
+  const MHD_socket itc_fd = MHD_itc_r_fd_ (ct->itc);
+  int res;
+#ifdef HAVE_POLL
+  struct pollfd p;
+  int timeout_val;
 
-  connection = gnutls_session_get_ptr (session);
-  if (NULL == connection)
+  if (0 == daemon->conn_threads_idle_timeout)
+    timeout_val = -1;
+  else if (daemon->conn_threads_idle_timeout >= INT_MAX / 1000)
+    timeout_val = INT_MAX;
+  else
+    timeout_val = (int) (daemon->conn_threads_idle_timeout * 1000);
+  p.fd = itc_fd;
+  p.events = POLLIN;
+  p.revents = 0;
+  res = MHD_sys_poll_ (&p,
+                       1,
+                       timeout_val);
+#else  /* ! HAVE_POLL */
+  fd_set rs;
+  struct timeval tv;
+  struct timeval *tvp;
+
+  if (0 == daemon->conn_threads_idle_timeout)
+    tvp = NULL;
+  else
+  {
+#if SIZEOF_UNSIGNED_INT >= SIZEOF_STRUCT_TIMEVAL_TV_SEC
+    if (daemon->conn_threads_idle_timeout > TIMEVAL_TV_SEC_MAX)
+      tv.tv_sec = TIMEVAL_TV_SEC_MAX;
+    else
+#endif /* SIZEOF_UNSIGNED_INT >= SIZEOF_STRUCT_TIMEVAL_TV_SEC */
+    tv.tv_sec = (_MHD_TIMEVAL_TV_SEC_TYPE) daemon->conn_threads_idle_timeout;
+    tv.tv_usec = 0;
+    tvp = &tv;
+  }
+  FD_ZERO (&rs);
+  if (! MHD_add_to_fd_set_ (itc_fd,
+                            &rs,
+                            NULL,
+                            FD_SETSIZE))
   {
 #ifdef HAVE_MESSAGES
-    /* Cannot use our logger, we don't even have "daemon" */
+    MHD_DLOG (daemon,
+              _ ("Failed to add FD to fd_set.\n"));
+#endif
+    return false;
+  }
+  res = MHD_SYS_select_ (itc_fd + 1,
+                         &rs,
+                         NULL,
+                         NULL,
+                         tvp);
+#endif /* ! HAVE_POLL */
+  if (0 < res)
+  {
+    MHD_itc_clear_ (ct->itc);
+    return true;
+  }
+  if (0 == res)
+    return false;
+  if (MHD_SCKT_LAST_ERR_IS_ (MHD_SCKT_EINTR_))
+    return true;
+#ifdef HAVE_MESSAGES
+  MHD_DLOG (daemon,
+            _ ("Error while waiting for a new connection in the parked " \
+               "thread: `%s'\n"),
+            MHD_socket_last_strerr_ ());
+#endif
+  return false;
+}
+
+
+/**
+ * Park the connection thread and wait for the next connection.
+ *
+ * @param ct the connection thread
+ * @return the next connection to handle,
+ *         NULL if the thread must exit
+ */
+static struct MHD_Connection *
+conn_thread_park_ (struct MHD_ConnectionThread *ct)
+{
+  struct MHD_Daemon *const daemon = ct->daemon;
+  struct MHD_Connection *con;
+
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  ct->connection = NULL;
+  if ( (daemon->shutdown) ||
+       (daemon->conn_threads_idle_num >= daemon->conn_threads_idle_max) )
+  {
+    ct->exited = true;
+    daemon->conn_threads_exited++;
+    MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+    return NULL;
+  }
+  /* The most recently used threads are reused first,
+   * the threads at the tail are idle longer. */
+  XDLL_insert (daemon->conn_threads_idle_head,
+               daemon->conn_threads_idle_tail,
+               ct);
+  daemon->conn_threads_idle_num++;
+  while (NULL == (con = ct->connection))
+  {
+    bool woken;
+
+    if (! daemon->shutdown)
+    {
+      MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+      woken = conn_thread_sleep_ (ct);
+      MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+      if (NULL != ct->connection)
+        continue; /* Got new connection */
+      if ( (woken) && (! daemon->shutdown) )
+        continue;
+      if ( (! daemon->shutdown) &&
+           (daemon->conn_threads_idle_num <= daemon->conn_threads_idle_min) )
+        continue;
+    }
+    XDLL_remove (daemon->conn_threads_idle_head,
+                 daemon->conn_threads_idle_tail,
+                 ct);
+    daemon->conn_threads_idle_num--;
+    ct->exited = true;
+    daemon->conn_threads_exited++;
+    break;
+  }
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  return con;
+}
+
+
+/**
+ * Main function of the reusable thread that handles individual
+ * connections when #MHD_USE_THREAD_PER_CONNECTION is combined with
+ * #MHD_OPTION_THREAD_REUSE_MAX_IDLE.
+ *
+ * @param data the `struct MHD_ConnectionThread` of this thread
+ * @return always 0
+ */
+static MHD_THRD_RTRN_TYPE_ MHD_THRD_CALL_SPEC_
+thread_main_reusable_connection (void *data)
+{
+  struct MHD_ConnectionThread *ct = data;
+  struct MHD_Connection *con;
+
+  MHD_thread_handle_ID_set_current_thread_ID_ (&(ct->tid));
+  /* The first connection is assigned before the thread is started */
+  con = ct->connection;
+  while (NULL != con)
+  {
+    MHD_thread_handle_ID_set_current_thread_ID_ (&(con->tid));
+    handle_connection_in_thread_ (con);
+    con = conn_thread_park_ (ct);
+  }
+  return (MHD_THRD_RTRN_TYPE_) 0;
+}
+
+
+/**
+ * Start processing of the new connection by the parked connection
+ * thread or by the new reusable connection thread.
+ *
+ * @param connection the new connection
+ * @return 'true' on success,
+ *         'false' if the new thread cannot be started, errno is set
+ */
+static bool
+conn_thread_start_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = connection->daemon;
+  struct MHD_ConnectionThread *ct;
+  int eno;
+
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  ct = daemon->conn_threads_idle_head;
+  if (NULL != ct)
+  {
+    XDLL_remove (daemon->conn_threads_idle_head,
+                 daemon->conn_threads_idle_tail,
+                 ct);
+    daemon->conn_threads_idle_num--;
+    ct->connection = connection;
+  }
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  if (NULL != ct)
+  {
+    if (! MHD_itc_activate_ (ct->itc, "n"))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to signal new connection via inter-thread " \
+                   "communication channel.\n"));
+#endif
+    }
+    return true;
+  }
+
+  ct = (struct MHD_ConnectionThread *)
+       MHD_calloc_ (1, sizeof (struct MHD_ConnectionThread));
+  if (NULL == ct)
+    return false;
+  if (! MHD_itc_init_ (ct->itc))
+  {
+    eno = errno;
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to create inter-thread communication channel: %s\n"),
+              MHD_itc_last_strerror_ ());
+#endif
+    free (ct);
+    errno = eno;
+    return false;
+  }
+  ct->daemon = daemon;
+  ct->connection = connection;
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  DLL_insert (daemon->conn_threads_head,
+              daemon->conn_threads_tail,
+              ct);
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  if (MHD_create_named_thread_ (&ct->tid,
+                                "MHD-connection",
+                                daemon->thread_stack_size,
+                                &thread_main_reusable_connection,
+                                ct))
+    return true;
+  eno = errno;
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  DLL_remove (daemon->conn_threads_head,
+              daemon->conn_threads_tail,
+              ct);
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  MHD_itc_destroy_chk_ (ct->itc);
+  free (ct);
+  errno = eno;
+  return false;
+}
+
+
+/**
+ * Join the reusable connection threads.
+ *
+ * @param daemon the daemon
+ * @param all if 'true' then all threads are stopped and joined,
+ *            otherwise only exited threads are joined
+ */
+static void
+conn_threads_join_ (struct MHD_Daemon *daemon,
+                    bool all)
+{
+  struct MHD_ConnectionThread *ct;
+
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  if (all)
+  {
+    mhd_assert (daemon->shutdown);
+    for (ct = daemon->conn_threads_idle_head; NULL != ct; ct = ct->nextX)
+    {
+      if (! MHD_itc_activate_ (ct->itc, "e"))
+        MHD_PANIC (_ ("Failed to signal shutdown via inter-thread " \
+                      "communication channel.\n"));
+    }
+  }
+  ct = daemon->conn_threads_tail;
+  while ( (NULL != ct) &&
+          (all || (0 != daemon->conn_threads_exited)) )
+  {
+    /* Only this thread modifies the list of all threads */
+    struct MHD_ConnectionThread *const prev = ct->prev;
+
+    if (all || ct->exited)
+    {
+      DLL_remove (daemon->conn_threads_head,
+                  daemon->conn_threads_tail,
+                  ct);
+      MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+      if (! MHD_thread_handle_ID_join_thread_ (ct->tid))
+        MHD_PANIC (_ ("Failed to join a thread.\n"));
+      MHD_itc_destroy_chk_ (ct->itc);
+      MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+      mhd_assert (ct->exited);
+      daemon->conn_threads_exited--;
+      free (ct);
+    }
+    ct = prev;
+  }
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+}
+
+
+#if defined(UPGRADE_SUPPORT) && defined(HTTPS_SUPPORT)
+/**
+ * Wait until the reusable thread finishes processing of the connection.
+ * The thread is joined: when MHD_Daemon::shutdown is set, the thread
+ * exits instead of parking.
+ * @remark To be called with daemon's "cleanup_connection_mutex" locked,
+ * the mutex is unlocked while waiting.
+ *
+ * @param connection the connection to wait for
+ */
+static void
+conn_thread_join_connection_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = connection->daemon;
+  struct MHD_ConnectionThread *ct;
+
+  mhd_assert (daemon->shutdown);
+  for (ct = daemon->conn_threads_head; NULL != ct; ct = ct->next)
+  {
+    if (connection == ct->connection)
+      break;
+  }
+  if (NULL == ct)
+    return; /* The connection has been released already */
+  DLL_remove (daemon->conn_threads_head,
+              daemon->conn_threads_tail,
+              ct);
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  if (! MHD_thread_handle_ID_join_thread_ (ct->tid))
+    MHD_PANIC (_ ("Failed to join a thread.\n"));
+  MHD_itc_destroy_chk_ (ct->itc);
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  mhd_assert (ct->exited);
+  mhd_assert (connection->thread_joined);
+  daemon->conn_threads_exited--;
+  free (ct);
+}
+
+
+#endif /* UPGRADE_SUPPORT && HTTPS_SUPPORT */
+
+
+#endif
+
+
+/**
+ * Free resources associated with all closed connections.
+ * (destroy responses, free buffers, etc.).  All closed
+ * connections are kept in the "cleanup" doubly-linked list.
+ *
+ * @param daemon daemon to clean up
+ */
+static void
+MHD_cleanup_connections (struct MHD_Daemon *daemon);
+
+#if defined(HTTPS_SUPPORT)
+#if defined(MHD_SEND_SPIPE_SUPPRESS_NEEDED) && \
+  defined(MHD_SEND_SPIPE_SUPPRESS_POSSIBLE) && \
+  ! defined(MHD_socket_nosignal_) && \
+  (GNUTLS_VERSION_NUMBER + 0 < 0x030402) && defined(MSG_NOSIGNAL)
+/**
+ * Older version of GnuTLS do not support suppressing of SIGPIPE signal.
+ * Use push function replacement with suppressing SIGPIPE signal where necessary
+ * and if possible.
+ */
+#define MHD_TLSLIB_NEED_PUSH_FUNC 1
+#endif /* MHD_SEND_SPIPE_SUPPRESS_NEEDED &&
+          MHD_SEND_SPIPE_SUPPRESS_POSSIBLE &&
+          ! MHD_socket_nosignal_ && (GNUTLS_VERSION_NUMBER+0 < 0x030402) &&
+          MSG_NOSIGNAL */
+
+#ifdef MHD_TLSLIB_NEED_PUSH_FUNC
+/**
+ * Data push function replacement with suppressing SIGPIPE signal
+ * for TLS library.
+ */
+static ssize_t
+MHD_tls_push_func_ (gnutls_transport_ptr_t trnsp,
+                    const void *data,
+                    size_t data_size)
+{
+#if (MHD_SCKT_SEND_MAX_SIZE_ < SSIZE_MAX) || (0 == SSIZE_MAX)
+  if (data_size > MHD_SCKT_SEND_MAX_SIZE_)
+    data_size = MHD_SCKT_SEND_MAX_SIZE_;
+#endif /* (MHD_SCKT_SEND_MAX_SIZE_ < SSIZE_MAX) || (0 == SSIZE_MAX) */
+  return MHD_send_ ((MHD_socket) (intptr_t) (trnsp), data, data_size);
+}
+
+
+#endif /* MHD_TLSLIB_DONT_SUPPRESS_SIGPIPE */
+
+
+/**
+ * Function called by GNUtls to obtain the PSK for a given session.
+ *
+ * @param session the session to lookup PSK for
+ * @param username username to lookup PSK for
+ * @param[out] key where to write PSK
+ * @return 0 on success, -1 on error
+ */
+static int
+psk_gnutls_adapter (gnutls_session_t session,
+                    const char *username,
+                    gnutls_datum_t *key)
+{
+  struct MHD_Connection *connection;
+  struct MHD_Daemon *daemon;
+#if GNUTLS_VERSION_MAJOR >= 3
+  void *app_psk;
+  size_t app_psk_size;
+#endif /* GNUTLS_VERSION_MAJOR >= 3 */
+
+  connection = gnutls_session_get_ptr (session);
+  if (NULL == connection)
+  {
+#ifdef HAVE_MESSAGES
+    /* Cannot use our logger, we don't even have "daemon" */
     MHD_PANIC (_ ("Internal server error. This should be impossible.\n"));
 #endif
     return -1;
@@ -2617,6 +3265,9 @@ new_connection_prepare_ (struct MHD_Daemon *daemon,
     connection->sk_corked = _MHD_UNKNOWN;
     connection->sk_nodelay = _MHD_UNKNOWN;
   }
+#ifdef MHD_USE_ZEROCOPY_SEND
+  connection->sk_zerocopy = _MHD_UNKNOWN;
+#endif /* MHD_USE_ZEROCOPY_SEND */
 
   if (0 < addrlen)
   {
@@ -2878,7 +3529,9 @@ new_connection_process_ (struct MHD_Daemon *daemon,
    * intensively used memory area is allocated in "good"
    * (for the thread) memory region. It is important with
    * NUMA and/or complex cache hierarchy. */
-  connection->pool = MHD_pool_create (daemon->pool_size);
+  connection->pool = MHD_pool_create (daemon->pool_size,
+                                      daemon->pool_slabs,
+                                      daemon->pool_guard_pages);
   if (NULL == connection->pool)
   { /* 'pool' creation failed */
 #ifdef HAVE_MESSAGES
@@ -2921,6 +3574,10 @@ new_connection_process_ (struct MHD_Daemon *daemon,
                      connection);
       }
       MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+      if (NULL != daemon->master)
+        worker_pool_grow_ (daemon);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
 
       MHD_connection_set_initial_state_ (connection);
 
@@ -2932,12 +3589,19 @@ new_connection_process_ (struct MHD_Daemon *daemon,
 #ifdef MHD_USE_THREADS
       if (MHD_D_IS_USING_THREAD_PER_CONN_ (daemon))
       {
+        bool thread_started;
+
         mhd_assert (! MHD_D_IS_USING_EPOLL_ (daemon));
-        if (! MHD_create_named_thread_ (&connection->tid,
-                                        "MHD-connection",
-                                        daemon->thread_stack_size,
-                                        &thread_main_handle_connection,
-                                        connection))
+        if (MHD_D_IS_REUSING_CONN_THREADS_ (daemon))
+          thread_started = conn_thread_start_ (connection);
+        else
+          thread_started =
+            MHD_create_named_thread_ (&connection->tid,
+                                      "MHD-connection",
+                                      daemon->thread_stack_size,
+                                      &thread_main_handle_connection,
+                                      connection);
+        if (! thread_started)
         {
           eno = errno;
 #ifdef HAVE_MESSAGES
@@ -2974,6 +3638,7 @@ new_connection_process_ (struct MHD_Daemon *daemon,
 
             event.events = EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLET | EPOLLRDHUP;
             event.data.ptr = connection;
+            daemon->epoll_ctl_conn_calls++;
             if (0 != epoll_ctl (daemon->epoll_fd,
                                 EPOLL_CTL_ADD,
                                 connection->socket_fd,
@@ -3007,7 +3672,11 @@ new_connection_process_ (struct MHD_Daemon *daemon,
         }
         else /* No 'epoll' */
 #endif /* EPOLL_SUPPORT */
-        return MHD_YES;    /* *** Function success exit point *** */
+        {
+          if (MHD_D_IS_USING_WATCH_ (daemon))
+            watch_connection_update_ (connection);
+          return MHD_YES;  /* *** Function success exit point *** */
+        }
       }
 
       /* ** Below is a cleanup path ** */
@@ -3260,6 +3929,8 @@ internal_suspend_connection_ (struct MHD_Connection *connection)
               daemon->suspended_connections_tail,
               connection);
   connection->suspended = true;
+  if (MHD_D_IS_USING_WATCH_ (daemon))
+    watch_connection_update_ (connection);
 #ifdef EPOLL_SUPPORT
   if (MHD_D_IS_USING_EPOLL_ (daemon))
   {
@@ -3271,8 +3942,14 @@ internal_suspend_connection_ (struct MHD_Connection *connection)
       connection->epoll_state &=
         ~((enum MHD_EpollState) MHD_EPOLL_STATE_IN_EREADY_EDLL);
     }
-    if (0 != (connection->epoll_state & MHD_EPOLL_STATE_IN_EPOLL_SET))
+#ifdef UPGRADE_SUPPORT
+    /* The suspended connection is kept in the epoll set (the events are
+       ignored until resume), unless the socket is handed over to the
+       application or to the upgrade forwarding loop. */
+    if ( (NULL != connection->urh) &&
+         (0 != (connection->epoll_state & MHD_EPOLL_STATE_IN_EPOLL_SET)) )
     {
+      daemon->epoll_ctl_conn_calls++;
       if (0 != epoll_ctl (daemon->epoll_fd,
                           EPOLL_CTL_DEL,
                           connection->socket_fd,
@@ -3281,6 +3958,7 @@ internal_suspend_connection_ (struct MHD_Connection *connection)
       connection->epoll_state &=
         ~((enum MHD_EpollState) MHD_EPOLL_STATE_IN_EPOLL_SET);
     }
+#endif /* UPGRADE_SUPPORT */
     connection->epoll_state |= MHD_EPOLL_STATE_SUSPENDED;
   }
 #endif
@@ -3323,6 +4001,17 @@ MHD_suspend_connection (struct MHD_Connection *connection)
 {
   struct MHD_Daemon *const daemon = connection->daemon;
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (MHD_HANDLER_OFFLOAD_RUNNING == connection->offload_state)
+  {
+    /* Called from the offloaded access handler, the connection is
+     * suspended already.  Just do not resume it when handler returns. */
+    MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+    connection->offload_app_suspended = true;
+    MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+    return;
+  }
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
 #ifdef MHD_USE_THREADS
   mhd_assert ( (! MHD_D_IS_USING_THREADS_ (daemon)) || \
                MHD_D_IS_USING_THREAD_PER_CONN_ (daemon) || \
@@ -3374,6 +4063,14 @@ MHD_resume_connection (struct MHD_Connection *connection)
                   "MHD_ALLOW_SUSPEND_RESUME!\n"));
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  if ( (MHD_HANDLER_OFFLOAD_QUEUED == connection->offload_state) ||
+       (MHD_HANDLER_OFFLOAD_RUNNING == connection->offload_state) )
+  {
+    /* The connection will be resumed when offloaded handler returns */
+    connection->offload_app_suspended = false;
+    MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+    return;
+  }
 #endif
   connection->resuming = true;
   daemon->resuming = true;
@@ -3392,32 +4089,475 @@ MHD_resume_connection (struct MHD_Connection *connection)
 }
 
 
-#ifdef UPGRADE_SUPPORT
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
 /**
- * Mark upgraded connection as closed by application.
+ * Call the offloaded access handler in the handler thread and resume
+ * the connection.
  *
- * The @a connection pointer must not be used after call of this function
- * as it may be freed in other thread immediately.
- * @param connection the upgraded connection to mark as closed by application
+ * @param connection the suspended connection
  */
-void
-MHD_upgraded_connection_mark_app_closed_ (struct MHD_Connection *connection)
+static void
+handler_offload_call_ (struct MHD_Connection *connection)
 {
-  /* Cache 'daemon' here to avoid data races */
   struct MHD_Daemon *const daemon = connection->daemon;
-#if defined(MHD_USE_THREADS)
-  mhd_assert (NULL == daemon->worker_pool);
-#endif /* MHD_USE_THREADS */
-  mhd_assert (NULL != connection->urh);
-  mhd_assert (0 != (daemon->options & MHD_TEST_ALLOW_SUSPEND_RESUME));
+  size_t processed;
+  enum MHD_Result res;
+  bool resume;
 
+  mhd_assert (connection->suspended);
   MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
-  connection->urh->was_closed = true;
-  connection->resuming = true;
-  daemon->resuming = true;
+  mhd_assert (MHD_HANDLER_OFFLOAD_QUEUED == connection->offload_state);
+  connection->offload_state = MHD_HANDLER_OFFLOAD_RUNNING;
   MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
-  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
-       (! MHD_itc_activate_ (daemon->itc, "r")) )
+
+  processed = 0;
+  connection->in_access_handler = true;
+  res = connection->rq.handler (connection->rq.handler_cls,
+                                connection,
+                                connection->rq.url,
+                                connection->rq.method,
+                                connection->rq.version,
+                                NULL,
+                                &processed,
+                                &connection->rq.client_context);
+  connection->in_access_handler = false;
+
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  connection->offload_result = res;
+  connection->offload_state = MHD_HANDLER_OFFLOAD_DONE;
+  resume = ! connection->offload_app_suspended;
+  if (resume)
+  {
+    connection->resuming = true;
+    daemon->resuming = true;
+  }
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  if ( (resume) &&
+       (MHD_ITC_IS_VALID_ (daemon->itc)) &&
+       (! MHD_itc_activate_ (daemon->itc, "r")) )
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to signal resume via inter-thread " \
+                 "communication channel.\n"));
+#endif
+  }
+}
+
+
+/**
+ * Read the next block of the response data in the file read thread
+ * and resume the connection.
+ *
+ * @param connection the suspended connection
+ */
+static void
+file_read_offload_call_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = connection->daemon;
+  struct MHD_Response *const response = connection->rp.response;
+  ssize_t res;
+
+  mhd_assert (connection->suspended);
+  mhd_assert (connection->rp.fr_offload);
+  mhd_assert (! connection->rp.fr_done);
+#ifdef HAVE_POSIX_FADVISE
+  if ( (0 == connection->rp.rsp_write_position) &&
+       (-1 != response->fd) )
+    (void) posix_fadvise (response->fd,
+                          (off_t) response->fd_off,
+                          0,
+                          POSIX_FADV_SEQUENTIAL);
+#endif /* HAVE_POSIX_FADVISE */
+  /* The content readers of the file-backed responses do not use
+   * the shared state of the response, no need to lock the response */
+  res = response->crc (response->crc_cls,
+                       connection->rp.rsp_write_position,
+                       connection->rp.fr_buf,
+                       connection->rp.fr_size);
+
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  connection->rp.fr_result = res;
+  connection->rp.fr_done = true;
+  connection->resuming = true;
+  daemon->resuming = true;
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
+       (! MHD_itc_activate_ (daemon->itc, "r")) )
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to signal resume via inter-thread " \
+                 "communication channel.\n"));
+#endif
+  }
+}
+
+
+/**
+ * Main function of the thread processing the offloaded connections.
+ *
+ * @param data the `struct MHD_HandlerOffloadThread` of this thread
+ * @return always 0
+ */
+static MHD_THRD_RTRN_TYPE_ MHD_THRD_CALL_SPEC_
+offload_thread_main_ (void *data)
+{
+  struct MHD_HandlerOffloadThread *const t = data;
+  struct MHD_HandlerOffload *const o = t->offload;
+
+  MHD_thread_handle_ID_set_current_thread_ID_ (&(t->tid));
+  MHD_mutex_lock_chk_ (&o->mutex);
+  while (1)
+  {
+    struct MHD_Connection *const c = o->queue_head;
+    int res;
+#ifdef HAVE_POLL
+    struct pollfd p;
+#else  /* ! HAVE_POLL */
+    fd_set rs;
+#endif /* ! HAVE_POLL */
+
+    if (NULL != c)
+    {
+      o->queue_head = c->nextO;
+      if (NULL == o->queue_head)
+        o->queue_tail = NULL;
+      c->nextO = NULL;
+      o->queue_len--;
+      MHD_mutex_unlock_chk_ (&o->mutex);
+      o->call (c);
+      MHD_mutex_lock_chk_ (&o->mutex);
+      continue;
+    }
+    /* Connections being added are counted in 'queue_len' */
+    if ( (o->stopping) &&
+         (0 == o->queue_len) )
+      break;
+    XDLL_insert (o->idle_head,
+                 o->idle_tail,
+                 t);
+    t->idle = true;
+    MHD_mutex_unlock_chk_ (&o->mutex);
+#ifdef HAVE_POLL
+    p.fd = MHD_itc_r_fd_ (t->itc);
+    p.events = POLLIN;
+    p.revents = 0;
+    res = MHD_sys_poll_ (&p,
+                         1,
+                         -1);
+#else  /* ! HAVE_POLL */
+    FD_ZERO (&rs);
+    if (! MHD_add_to_fd_set_ (MHD_itc_r_fd_ (t->itc),
+                              &rs,
+                              NULL,
+                              FD_SETSIZE))
+      MHD_PANIC (_ ("Failed to add FD to fd_set.\n"));
+    res = MHD_SYS_select_ (MHD_itc_r_fd_ (t->itc) + 1,
+                           &rs,
+                           NULL,
+                           NULL,
+                           NULL);
+#endif /* ! HAVE_POLL */
+    if (0 < res)
+      MHD_itc_clear_ (t->itc);
+    else if ( (0 > res) &&
+              (! MHD_SCKT_LAST_ERR_IS_ (MHD_SCKT_EINTR_)) )
+      MHD_PANIC (_ ("Failed to wait for the offloaded connection.\n"));
+    MHD_mutex_lock_chk_ (&o->mutex);
+    if (t->idle)
+    {
+      XDLL_remove (o->idle_head,
+                   o->idle_tail,
+                   t);
+      t->idle = false;
+    }
+  }
+  MHD_mutex_unlock_chk_ (&o->mutex);
+  return (MHD_THRD_RTRN_TYPE_) 0;
+}
+
+
+/**
+ * Add the suspended connection to the queue of the offloaded connections
+ * and wake up an idle thread.
+ * The place in the queue must be reserved by increment of 'queue_len'.
+ *
+ * @param o the threads to use
+ * @param connection the suspended connection
+ */
+static void
+offload_queue_push_ (struct MHD_HandlerOffload *o,
+                     struct MHD_Connection *connection)
+{
+  struct MHD_HandlerOffloadThread *t;
+
+  MHD_mutex_lock_chk_ (&o->mutex);
+  connection->nextO = NULL;
+  if (NULL == o->queue_tail)
+    o->queue_head = connection;
+  else
+    o->queue_tail->nextO = connection;
+  o->queue_tail = connection;
+  t = o->idle_head;
+  if (NULL != t)
+  {
+    XDLL_remove (o->idle_head,
+                 o->idle_tail,
+                 t);
+    t->idle = false;
+  }
+  MHD_mutex_unlock_chk_ (&o->mutex);
+  if ( (NULL != t) &&
+       (! MHD_itc_activate_ (t->itc, "h")) )
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (connection->daemon,
+              _ ("Failed to signal offloaded connection via " \
+                 "inter-thread communication channel.\n"));
+#endif
+  }
+}
+
+
+enum MHD_HandlerOffloadSubmit
+MHD_handler_offload_submit_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = connection->daemon;
+  struct MHD_HandlerOffload *const o = MHD_get_master (daemon)->handler_offload;
+
+  mhd_assert (NULL != o);
+  mhd_assert (MHD_HANDLER_OFFLOAD_NONE == connection->offload_state);
+  MHD_mutex_lock_chk_ (&o->mutex);
+  if (o->stopping)
+  {
+    MHD_mutex_unlock_chk_ (&o->mutex);
+    return MHD_HANDLER_OFFLOAD_STOPPED;
+  }
+  if ( (0 != o->queue_limit) &&
+       (o->queue_len >= o->queue_limit) )
+  {
+    MHD_mutex_unlock_chk_ (&o->mutex);
+    return MHD_HANDLER_OFFLOAD_BUSY;
+  }
+  o->queue_len++; /* Reserve the place in the queue */
+  MHD_mutex_unlock_chk_ (&o->mutex);
+
+  /* The connection must be suspended before the handler thread
+   * can resume it. */
+  internal_suspend_connection_ (connection);
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  connection->offload_state = MHD_HANDLER_OFFLOAD_QUEUED;
+  connection->offload_app_suspended = false;
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+
+  offload_queue_push_ (o,
+                       connection);
+  return MHD_HANDLER_OFFLOAD_SUBMITTED;
+}
+
+
+bool
+MHD_file_read_offload_submit_ (struct MHD_Connection *connection,
+                               char *buf,
+                               size_t size)
+{
+  struct MHD_HandlerOffload *const o =
+    MHD_get_master (connection->daemon)->file_read_offload;
+
+  mhd_assert (NULL != o);
+  mhd_assert (connection->rp.fr_offload);
+  mhd_assert (! connection->rp.fr_done);
+  mhd_assert (0 != size);
+  MHD_mutex_lock_chk_ (&o->mutex);
+  if (o->stopping)
+  {
+    MHD_mutex_unlock_chk_ (&o->mutex);
+    return false;
+  }
+  o->queue_len++; /* Reserve the place in the queue */
+  MHD_mutex_unlock_chk_ (&o->mutex);
+
+  connection->rp.fr_buf = buf;
+  connection->rp.fr_size = size;
+  /* The connection must be suspended before the file read thread
+   * can resume it. */
+  internal_suspend_connection_ (connection);
+  offload_queue_push_ (o,
+                       connection);
+  return true;
+}
+
+
+/**
+ * Stop the threads processing the offloaded connections.
+ * The queued connections are processed before the threads exit.
+ * The new connections are not accepted after this call, but @a o is
+ * kept valid for the daemon's threads that may still try to submit
+ * the connections.
+ *
+ * @param o the threads to stop
+ */
+static void
+offload_threads_stop_ (struct MHD_HandlerOffload *o)
+{
+  struct MHD_HandlerOffloadThread *t;
+  unsigned int i;
+
+  MHD_mutex_lock_chk_ (&o->mutex);
+  o->stopping = true;
+  for (t = o->idle_head; NULL != t; t = t->nextX)
+  {
+    if (! MHD_itc_activate_ (t->itc, "e"))
+      MHD_PANIC (_ ("Failed to signal shutdown via inter-thread " \
+                    "communication channel.\n"));
+  }
+  MHD_mutex_unlock_chk_ (&o->mutex);
+  for (i = 0; i < o->num_threads; ++i)
+  {
+    if (! MHD_thread_handle_ID_join_thread_ (o->threads[i].tid))
+      MHD_PANIC (_ ("Failed to join a thread.\n"));
+    MHD_itc_destroy_chk_ (o->threads[i].itc);
+  }
+  o->num_threads = 0;
+  mhd_assert (NULL == o->queue_head);
+  mhd_assert (NULL == o->idle_head);
+}
+
+
+/**
+ * Free the stopped threads processing the offloaded connections.
+ * Must be called only when no other daemon's threads are running.
+ *
+ * @param o the threads stopped by #offload_threads_stop_(),
+ *          freed by this function
+ */
+static void
+offload_threads_free_ (struct MHD_HandlerOffload *o)
+{
+  mhd_assert (o->stopping);
+  mhd_assert (0 == o->num_threads);
+  MHD_mutex_destroy_chk_ (&o->mutex);
+  free (o->threads);
+  free (o);
+}
+
+
+/**
+ * Start the threads processing the offloaded connections.
+ *
+ * @param daemon the master daemon
+ * @param num_threads the number of the threads to start
+ * @param queue_limit the maximum number of the queued connections,
+ *                    zero for no limit
+ * @param call the function to call for each queued connection
+ * @param thread_name the name of the threads
+ * @return the started threads on success, NULL on failure
+ */
+static struct MHD_HandlerOffload *
+offload_threads_start_ (struct MHD_Daemon *daemon,
+                        unsigned int num_threads,
+                        unsigned int queue_limit,
+                        void (*call)(struct MHD_Connection *connection),
+                        const char *thread_name)
+{
+  struct MHD_HandlerOffload *o;
+  unsigned int i;
+
+  mhd_assert (NULL == daemon->master);
+  mhd_assert (0 != num_threads);
+  o = (struct MHD_HandlerOffload *)
+      MHD_calloc_ (1, sizeof (struct MHD_HandlerOffload));
+  if (NULL == o)
+    return NULL;
+  o->threads = (struct MHD_HandlerOffloadThread *)
+               MHD_calloc_ (num_threads,
+                            sizeof (struct MHD_HandlerOffloadThread));
+  if (NULL == o->threads)
+  {
+    free (o);
+    return NULL;
+  }
+  if (! MHD_mutex_init_ (&o->mutex))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("MHD failed to initialize offloaded connections mutex.\n"));
+#endif
+    free (o->threads);
+    free (o);
+    return NULL;
+  }
+  o->queue_limit = queue_limit;
+  o->call = call;
+  for (i = 0; i < num_threads; ++i)
+  {
+    struct MHD_HandlerOffloadThread *const t = o->threads + i;
+
+    t->offload = o;
+    if (! MHD_itc_init_ (t->itc))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to create inter-thread communication channel: " \
+                   "%s\n"),
+                MHD_itc_last_strerror_ ());
+#endif
+      break;
+    }
+    if (! MHD_create_named_thread_ (&t->tid,
+                                    thread_name,
+                                    daemon->thread_stack_size,
+                                    &offload_thread_main_,
+                                    t))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to create a thread: %s\n"),
+                MHD_strerror_ (errno));
+#endif
+      MHD_itc_destroy_chk_ (t->itc);
+      break;
+    }
+    o->num_threads++;
+  }
+  if (o->num_threads == num_threads)
+    return o;
+  offload_threads_stop_ (o);
+  offload_threads_free_ (o);
+  return NULL;
+}
+
+
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
+
+#ifdef UPGRADE_SUPPORT
+/**
+ * Mark upgraded connection as closed by application.
+ *
+ * The @a connection pointer must not be used after call of this function
+ * as it may be freed in other thread immediately.
+ * @param connection the upgraded connection to mark as closed by application
+ */
+void
+MHD_upgraded_connection_mark_app_closed_ (struct MHD_Connection *connection)
+{
+  /* Cache 'daemon' here to avoid data races */
+  struct MHD_Daemon *const daemon = connection->daemon;
+#if defined(MHD_USE_THREADS)
+  mhd_assert (NULL == daemon->worker_pool);
+#endif /* MHD_USE_THREADS */
+  mhd_assert (NULL != connection->urh);
+  mhd_assert (0 != (daemon->options & MHD_TEST_ALLOW_SUSPEND_RESUME));
+
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  connection->urh->was_closed = true;
+  connection->resuming = true;
+  daemon->resuming = true;
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
+       (! MHD_itc_activate_ (daemon->itc, "r")) )
   {
 #ifdef HAVE_MESSAGES
     MHD_DLOG (daemon,
@@ -3526,6 +4666,16 @@ resume_suspended_connections (struct MHD_Daemon *daemon)
         pos->epoll_state &= ~((enum MHD_EpollState) MHD_EPOLL_STATE_SUSPENDED);
       }
 #endif
+      if (MHD_D_IS_USING_WATCH_ (daemon) &&
+          (! pos->watch_pending) )
+      {
+        /* Process the resumed connection in the next turn, the interest
+           for the socket will be updated after processing. */
+        WDLL_insert (daemon->watch_pending_head,
+                     daemon->watch_pending_tail,
+                     pos);
+        pos->watch_pending = true;
+      }
     }
 #ifdef UPGRADE_SUPPORT
     else
@@ -3749,14 +4899,19 @@ MHD_add_connection (struct MHD_Daemon *daemon,
   if (NULL != daemon->worker_pool)
   {
     unsigned int i;
-    /* have a pool, try to find a pool with capacity; we use the
-       socket as the initial offset into the pool for load
+    unsigned int started;
+
+    MHD_mutex_lock_chk_ (&daemon->worker_start_lock);
+    started = daemon->worker_pool_started;
+    MHD_mutex_unlock_chk_ (&daemon->worker_start_lock);
+    /* have a pool, try to find a started worker with capacity; we use
+       the socket as the initial offset into the pool for load
        balancing */
-    for (i = 0; i < daemon->worker_pool_size; ++i)
+    for (i = 0; i < started; ++i)
     {
       struct MHD_Daemon *const worker =
         &daemon->worker_pool[(i + (unsigned int) client_socket)
-                             % daemon->worker_pool_size];
+                             % started];
       if (worker->connections < worker->connection_limit)
         return internal_add_connection (worker,
                                         client_socket,
@@ -4044,6 +5199,7 @@ static void
 MHD_cleanup_connections (struct MHD_Daemon *daemon)
 {
   struct MHD_Connection *pos;
+  bool closed_any = false;
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   mhd_assert ( (! MHD_D_IS_USING_THREADS_ (daemon)) || \
                MHD_thread_handle_ID_is_current_thread_ (daemon->tid) );
@@ -4051,8 +5207,18 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
 
   MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
 #endif
-  while (NULL != (pos = daemon->cleanup_tail))
+  pos = daemon->cleanup_tail;
+  while (NULL != pos)
   {
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+    if (MHD_D_IS_REUSING_CONN_THREADS_ (daemon) &&
+        (! pos->thread_joined))
+    {
+      /* The connection is still used by the reusable thread. */
+      pos = pos->prev;
+      continue;
+    }
+#endif
     DLL_remove (daemon->cleanup_head,
                 daemon->cleanup_tail,
                 pos);
@@ -4101,6 +5267,7 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
            we are still seeing an event for this fd in epoll,
            causing grief (use-after-free...) --- at least on my
            system. */
+        daemon->epoll_ctl_conn_calls++;
         if (0 != epoll_ctl (daemon->epoll_fd,
                             EPOLL_CTL_DEL,
                             pos->socket_fd,
@@ -4112,12 +5279,25 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
       }
     }
 #endif
+    if (MHD_D_IS_USING_WATCH_ (daemon))
+      watch_connection_remove_ (pos);
+#ifdef MHD_USE_ZEROCOPY_SEND
+    MHD_send_zc_release_ (pos);
+#endif /* MHD_USE_ZEROCOPY_SEND */
     if (NULL != pos->rp.response)
     {
       MHD_destroy_response (pos->rp.response);
       pos->rp.response = NULL;
     }
-    if (MHD_INVALID_SOCKET != pos->socket_fd)
+    if (pos->drain_handoff)
+    {
+      mhd_assert (NULL != daemon->drain_handoff_cb);
+      daemon->drain_handoff_cb (daemon->drain_handoff_cb_cls,
+                                pos->socket_fd,
+                                (const struct sockaddr *) pos->addr,
+                                pos->addr_len);
+    }
+    else if (MHD_INVALID_SOCKET != pos->socket_fd)
       MHD_socket_close_chk_ (pos->socket_fd);
     if (NULL != pos->addr)
       free (pos->addr);
@@ -4128,10 +5308,21 @@ MHD_cleanup_connections (struct MHD_Daemon *daemon)
 #endif
     daemon->connections--;
     daemon->at_limit = false;
+    closed_any = true;
+    pos = daemon->cleanup_tail;
   }
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
-#endif
+  if (MHD_D_IS_REUSING_CONN_THREADS_ (daemon))
+    conn_threads_join_ (daemon,
+                        false);
+#endif
+#ifdef MHD_USE_ZEROCOPY_SEND
+  if (NULL != daemon->zc_pending_head)
+    MHD_send_zc_reap_ (daemon, false);
+#endif /* MHD_USE_ZEROCOPY_SEND */
+  if (closed_any && daemon->draining)
+    drain_report_progress (daemon);
 }
 
 
@@ -4296,6 +5487,36 @@ MHD_get_timeout64 (struct MHD_Daemon *daemon,
   if (NULL != earliest_tmot_conn)
   {
     *timeout64 = connection_get_wait (earliest_tmot_conn);
+    if (daemon->draining)
+    {
+      const uint64_t drain_wait = drain_get_wait (daemon);
+      if (drain_wait < *timeout64)
+        *timeout64 = drain_wait;
+    }
+#ifdef MHD_USE_ZEROCOPY_SEND
+    if ( (NULL != daemon->zc_pending_head) &&
+         (MHD_ZC_REAP_INTERVAL_MS < *timeout64) )
+      *timeout64 = MHD_ZC_REAP_INTERVAL_MS;
+#endif /* MHD_USE_ZEROCOPY_SEND */
+    return MHD_YES;
+  }
+#ifdef MHD_USE_ZEROCOPY_SEND
+  if (NULL != daemon->zc_pending_head)
+  {
+    /* The completions of the closed connections are not polled */
+    *timeout64 = MHD_ZC_REAP_INTERVAL_MS;
+    if (daemon->draining &&
+        (NULL != daemon->connections_head) &&
+        (drain_get_wait (daemon) < *timeout64))
+      *timeout64 = drain_get_wait (daemon);
+    return MHD_YES;
+  }
+#endif /* MHD_USE_ZEROCOPY_SEND */
+  if (daemon->draining &&
+      (NULL != daemon->connections_head) &&
+      (UINT64_MAX != drain_get_wait (daemon)))
+  {
+    *timeout64 = drain_get_wait (daemon);
     return MHD_YES;
   }
   return MHD_NO;
@@ -4500,6 +5721,7 @@ internal_run_from_select (struct MHD_Daemon *daemon,
 
   mhd_assert (0 < fd_setsize);
   (void) fd_setsize; /* Mute compiler warning */
+  daemon->loop_time_ms = MHD_monotonic_msec_counter ();
 #ifndef HAS_FD_SETSIZE_OVERRIDABLE
   (void) fd_setsize; /* Mute compiler warning */
   mhd_assert (((int) FD_SETSIZE) <= fd_setsize);
@@ -4654,7 +5876,8 @@ MHD_run_from_select2 (struct MHD_Daemon *daemon,
                       unsigned int fd_setsize)
 {
   if (MHD_D_IS_USING_POLL_ (daemon) ||
-      MHD_D_IS_USING_THREADS_ (daemon))
+      MHD_D_IS_USING_THREADS_ (daemon) ||
+      MHD_D_IS_USING_WATCH_ (daemon))
     return MHD_NO;
   if ((NULL == read_fd_set) || (NULL == write_fd_set))
     return MHD_NO;
@@ -4961,6 +6184,56 @@ MHD_select (struct MHD_Daemon *daemon,
 
 
 #ifdef HAVE_POLL
+/**
+ * Make sure that the daemon's 'pollfd' array is large enough to hold
+ * the listen socket, the ITC and all connections of the daemon.
+ * The array is grown only, it is kept allocated until the daemon is
+ * stopped, so the poll() loop does not allocate memory on each iteration.
+ *
+ * @param daemon the daemon to use
+ * @return 'true' on success,
+ *         'false' if memory allocation failed
+ */
+static bool
+poll_fds_ensure_size (struct MHD_Daemon *daemon)
+{
+  size_t req_size;
+  struct pollfd *new_fds;
+
+  /* Each connection in the "normal" list requires one element.
+     Upgraded TLS connections are suspended and require two elements. */
+  req_size = (size_t) daemon->connections;
+#if defined(HTTPS_SUPPORT) && defined(UPGRADE_SUPPORT)
+  req_size *= 2;
+#endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
+  req_size += 2; /* The listen socket and the ITC */
+
+  if (req_size <= daemon->poll_fds_size)
+    return true;
+
+  /* Grow with some reserve to avoid frequent reallocations */
+  if (req_size < daemon->poll_fds_size * 2)
+    req_size = daemon->poll_fds_size * 2;
+  if (req_size < 16)
+    req_size = 16;
+
+  new_fds = (struct pollfd *) realloc (daemon->poll_fds,
+                                       req_size * sizeof (struct pollfd));
+  if (NULL == new_fds)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Error allocating memory: %s\n"),
+              MHD_strerror_ (errno));
+#endif
+    return false;
+  }
+  daemon->poll_fds = new_fds;
+  daemon->poll_fds_size = req_size;
+  return true;
+}
+
+
 /**
  * Process all of our connections and possibly the server
  * socket using poll().
@@ -4994,14 +6267,6 @@ MHD_poll_all (struct MHD_Daemon *daemon,
        (MHD_NO != resume_suspended_connections (daemon)) )
     millisec = 0;
 
-  /* count number of connections and thus determine poll set size */
-  num_connections = 0;
-  for (pos = daemon->connections_head; NULL != pos; pos = pos->next)
-    num_connections++;
-#if defined(HTTPS_SUPPORT) && defined(UPGRADE_SUPPORT)
-  for (urh = daemon->urh_head; NULL != urh; urh = urh->next)
-    num_connections += 2;
-#endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
   {
     unsigned int i;
     int timeout;
@@ -5011,17 +6276,9 @@ MHD_poll_all (struct MHD_Daemon *daemon,
     struct pollfd *p;
     MHD_socket ls;
 
-    p = MHD_calloc_ ((2 + (size_t) num_connections),
-                     sizeof (struct pollfd));
-    if (NULL == p)
-    {
-#ifdef HAVE_MESSAGES
-      MHD_DLOG (daemon,
-                _ ("Error allocating memory: %s\n"),
-                MHD_strerror_ (errno));
-#endif
+    if (! poll_fds_ensure_size (daemon))
       return MHD_NO;
-    }
+    p = daemon->poll_fds;
     poll_server = 0;
     poll_listen = -1;
     if ( (MHD_INVALID_SOCKET != (ls = daemon->listen_fd)) &&
@@ -5051,7 +6308,10 @@ MHD_poll_all (struct MHD_Daemon *daemon,
     i = 0;
     for (pos = daemon->connections_tail; NULL != pos; pos = pos->prev)
     {
+      mhd_assert (poll_server + i < daemon->poll_fds_size);
       p[poll_server + i].fd = pos->socket_fd;
+      p[poll_server + i].events = 0;
+      p[poll_server + i].revents = 0;
       switch (pos->event_loop_info)
       {
       case MHD_EVENT_LOOP_INFO_READ:
@@ -5074,32 +6334,29 @@ MHD_poll_all (struct MHD_Daemon *daemon,
     for (urh = daemon->urh_tail; NULL != urh; urh = urh->prev)
     {
       urh_to_pollfd (urh, &(p[poll_server + i]));
+      p[poll_server + i].revents = 0;
+      p[poll_server + i + 1].revents = 0;
       i += 2;
     }
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
+    num_connections = i;
     if (0 == poll_server + num_connections)
-    {
-      free (p);
       return MHD_YES;
-    }
     if (MHD_sys_poll_ (p,
                        poll_server + num_connections,
                        timeout) < 0)
     {
       const int err = MHD_socket_get_error_ ();
       if (MHD_SCKT_ERR_IS_EINTR_ (err))
-      {
-        free (p);
         return MHD_YES;
-      }
 #ifdef HAVE_MESSAGES
       MHD_DLOG (daemon,
                 _ ("poll failed: %s\n"),
                 MHD_socket_strerr_ (err));
 #endif
-      free (p);
       return MHD_NO;
     }
+    daemon->loop_time_ms = MHD_monotonic_msec_counter ();
 
     /* handle ITC FD */
     /* do it before any other processing so
@@ -5110,10 +6367,7 @@ MHD_poll_all (struct MHD_Daemon *daemon,
 
     /* handle shutdown */
     if (daemon->shutdown)
-    {
-      free (p);
       return MHD_NO;
-    }
 
     /* Process externally added connection if any */
     if (daemon->have_new)
@@ -5179,8 +6433,6 @@ MHD_poll_all (struct MHD_Daemon *daemon,
       }
     }
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
-
-    free (p);
   }
   return MHD_YES;
 }
@@ -5483,6 +6735,62 @@ run_epoll_for_upgrade (struct MHD_Daemon *daemon)
 static const char *const epoll_itc_marker = "itc_marker";
 
 
+/**
+ * Wait for the events on the daemon's epoll FD, polling without blocking
+ * for the configured busy polling time before blocking.
+ *
+ * @param daemon the daemon to use
+ * @param events the array for the events
+ * @param max_events the size of the @a events array
+ * @param timeout_ms the maximum time in milliseconds to wait for events,
+ *                   must not be zero,
+ *                   set to '-1' to wait indefinitely.
+ * @return the number of the events,
+ *         -1 on error (as returned by epoll_wait())
+ */
+static int
+epoll_wait_busy_poll (struct MHD_Daemon *daemon,
+                      struct epoll_event *events,
+                      int max_events,
+                      int timeout_ms)
+{
+  const uint64_t start_usec = MHD_monotonic_usec_counter ();
+  uint64_t elapsed_usec;
+  int num_events;
+
+  mhd_assert (0 != daemon->epoll_busy_poll_usec);
+  mhd_assert (0 != timeout_ms);
+  do
+  {
+    num_events = epoll_wait (daemon->epoll_fd,
+                             events,
+                             max_events,
+                             0);
+    if (0 != num_events)
+    {
+      if (0 < num_events)
+        daemon->epoll_busy_poll_hits++;
+      return num_events;
+    }
+    elapsed_usec = MHD_monotonic_usec_counter () - start_usec;
+  } while (daemon->epoll_busy_poll_usec > elapsed_usec);
+  daemon->epoll_busy_poll_misses++;
+
+  if (0 < timeout_ms)
+  {
+    const uint64_t elapsed_ms = elapsed_usec / 1000;
+
+    if ((uint64_t) timeout_ms <= elapsed_ms)
+      return 0;
+    timeout_ms -= (int) elapsed_ms;
+  }
+  return epoll_wait (daemon->epoll_fd,
+                     events,
+                     max_events,
+                     timeout_ms);
+}
+
+
 /**
  * Do epoll()-based processing.
  *
@@ -5501,7 +6809,8 @@ MHD_epoll (struct MHD_Daemon *daemon,
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
   struct MHD_Connection *pos;
   struct MHD_Connection *prev;
-  struct epoll_event events[MAX_EVENTS];
+  struct epoll_event *const events = daemon->epoll_events;
+  const int max_events = (int) daemon->epoll_events_size;
   struct epoll_event event;
   int timeout_ms;
   int num_events;
@@ -5511,6 +6820,7 @@ MHD_epoll (struct MHD_Daemon *daemon,
   bool run_upgraded = false;
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
   bool need_to_accept;
+  bool stop_draining;
 
   mhd_assert ((0 == (daemon->options & MHD_USE_SELECT_INTERNALLY)) || \
               (MHD_thread_handle_ID_is_valid_ID_ (daemon->tid)));
@@ -5606,18 +6916,26 @@ MHD_epoll (struct MHD_Daemon *daemon,
   daemon->data_already_pending = false;
 
   need_to_accept = false;
+  stop_draining = false;
   /* drain 'epoll' event queue; need to iterate as we get at most
-     MAX_EVENTS in one system call here; in practice this should
+     'max_events' in one system call here; in practice this should
      pretty much mean only one round, but better an extra loop here
      than unfair behavior... */
-  num_events = MAX_EVENTS;
-  while (MAX_EVENTS == num_events)
+  num_events = max_events;
+  while (max_events == num_events)
   {
     /* update event masks */
-    num_events = epoll_wait (daemon->epoll_fd,
-                             events,
-                             MAX_EVENTS,
-                             timeout_ms);
+    if ( (0 != daemon->epoll_busy_poll_usec) &&
+         (0 != timeout_ms) )
+      num_events = epoll_wait_busy_poll (daemon,
+                                         events,
+                                         max_events,
+                                         timeout_ms);
+    else
+      num_events = epoll_wait (daemon->epoll_fd,
+                               events,
+                               max_events,
+                               timeout_ms);
     if (-1 == num_events)
     {
       const int err = MHD_socket_get_error_ ();
@@ -5630,6 +6948,9 @@ MHD_epoll (struct MHD_Daemon *daemon,
 #endif
       return MHD_NO;
     }
+    /* The events are already available, do not block when
+       draining the rest of the queue */
+    timeout_ms = 0;
     for (i = 0; i < (unsigned int) num_events; i++)
     {
       /* First, check for the values of `ptr` that would indicate
@@ -5642,6 +6963,7 @@ MHD_epoll (struct MHD_Daemon *daemon,
         /* activity on an upgraded connection, we process
            those in a separate epoll() */
         run_upgraded = true;
+        stop_draining = true;
         continue;
       }
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
@@ -5658,12 +6980,21 @@ MHD_epoll (struct MHD_Daemon *daemon,
         /* FIXME: Initiate MHD_quiesce_daemon() to prevent busy waiting? */
         if (0 == (events[i].events & (EPOLLERR | EPOLLHUP)))
           need_to_accept = true;
+        stop_draining = true;
         continue;
       }
       /* this is an event relating to a 'normal' connection,
          remember the event and if appropriate mark the
          connection as 'eready'. */
       pos = events[i].data.ptr;
+#ifdef MHD_USE_ZEROCOPY_SEND
+      if ( (EPOLLERR == (events[i].events & (EPOLLPRI | EPOLLERR | EPOLLHUP)))
+           && (NULL != pos->zc_response) &&
+           MHD_send_zc_complete_ (pos) )
+        events[i].events &= ~((uint32_t) EPOLLERR); /* Zero-copy notifications */
+#endif /* MHD_USE_ZEROCOPY_SEND */
+      if (0 != (pos->epoll_state & MHD_EPOLL_STATE_SUSPENDED))
+        continue; /* Ignored, resumed connections are always marked as "ready" */
       /* normal processing: update read/write data */
       if (0 != (events[i].events & (EPOLLPRI | EPOLLERR | EPOLLHUP)))
       {
@@ -5705,7 +7036,14 @@ MHD_epoll (struct MHD_Daemon *daemon,
         }
       }
     }
+    /* The listen socket and the epoll FD of the upgraded connections are
+       level-triggered, they are reported again until processed.  Do not
+       drain the queue further, the remaining events are received on the
+       next turn. */
+    if (stop_draining)
+      break;
   }
+  daemon->loop_time_ms = MHD_monotonic_msec_counter ();
 
   /* Process externally added connection if any */
   if (daemon->have_new)
@@ -5749,7 +7087,8 @@ MHD_epoll (struct MHD_Daemon *daemon,
   {
     prev = pos->prevX;
     MHD_connection_handle_idle (pos);
-    if (MHD_CONNECTION_CLOSED != pos->state)
+    if ( (MHD_CONNECTION_CLOSED != pos->state) &&
+         (! daemon->draining) )
       break; /* sorted by timeout, no need to visit the rest! */
   }
 
@@ -5758,15 +7097,68 @@ MHD_epoll (struct MHD_Daemon *daemon,
     run_epoll_for_upgrade (daemon);
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
 
-  /* process events for connections */
+  /* Process events for connections in phases: receive the data for all
+     ready connections, then process the received data, then send the
+     replies.  Each phase runs the same code for all connections, which
+     keeps the code and the data of the phase in the CPU caches. */
+
+  /* Phase one: receive */
   prev = daemon->eready_tail;
   while (NULL != (pos = prev))
   {
+    bool read_ready;
+
     prev = pos->prevE;
-    call_handlers (pos,
-                   0 != (pos->epoll_state & MHD_EPOLL_STATE_READ_READY),
-                   0 != (pos->epoll_state & MHD_EPOLL_STATE_WRITE_READY),
-                   0 != (pos->epoll_state & MHD_EPOLL_STATE_ERROR));
+    if (0 != (pos->epoll_state & MHD_EPOLL_STATE_ERROR))
+    {
+      /* Rare case, the connection is closed by the handlers */
+      call_handlers (pos,
+                     0 != (pos->epoll_state & MHD_EPOLL_STATE_READ_READY),
+                     0 != (pos->epoll_state & MHD_EPOLL_STATE_WRITE_READY),
+                     true);
+      continue;
+    }
+    read_ready = (0 != (pos->epoll_state & MHD_EPOLL_STATE_READ_READY));
+#ifdef HTTPS_SUPPORT
+    if (pos->tls_read_ready)
+      read_ready = true;
+#endif /* HTTPS_SUPPORT */
+    if ( (0 != (MHD_EVENT_LOOP_INFO_READ & pos->event_loop_info)) &&
+         read_ready)
+      MHD_connection_handle_read (pos, false);
+  }
+
+  /* Phase two: process the data, call the application.
+     The connections closed by the receive phase are cleaned up here. */
+  prev = daemon->eready_tail;
+  while (NULL != (pos = prev))
+  {
+    prev = pos->prevE;
+    if (! pos->in_cleanup)
+      MHD_connection_handle_idle (pos);
+  }
+
+  /* Phase three: send */
+  prev = daemon->eready_tail;
+  while (NULL != (pos = prev))
+  {
+    prev = pos->prevE;
+    if ( (MHD_EVENT_LOOP_INFO_WRITE == pos->event_loop_info) &&
+         (0 != (pos->epoll_state & MHD_EPOLL_STATE_WRITE_READY)) )
+    {
+      MHD_connection_handle_write (pos);
+      MHD_connection_handle_idle (pos);
+      /* If all headers were sent and the response body is prepared by
+       * the same MHD_connection_handle_idle() call - continue. */
+      if ( (0 != (pos->epoll_state & MHD_EPOLL_STATE_WRITE_READY)) &&
+           ((MHD_CONNECTION_NORMAL_BODY_READY == pos->state) ||
+            (MHD_CONNECTION_CHUNKED_BODY_READY == pos->state)) )
+      {
+        MHD_connection_handle_write (pos);
+        MHD_connection_handle_idle (pos);
+      }
+    }
+    check_data_already_pending (pos);
     if (MHD_EPOLL_STATE_IN_EREADY_EDLL ==
         (pos->epoll_state & (MHD_EPOLL_STATE_SUSPENDED
                              | MHD_EPOLL_STATE_IN_EREADY_EDLL)))
@@ -5793,6 +7185,315 @@ MHD_epoll (struct MHD_Daemon *daemon,
 #endif
 
 
+/**
+ * The MHD's context of the ITC socket watched by the application.
+ */
+static const char *const watch_itc_marker = "watch_itc_marker";
+
+
+/**
+ * Update the interest of the daemon's listen socket and ITC watched
+ * by the application.
+ *
+ * @param daemon the daemon to update
+ */
+static void
+watch_daemon_update_sockets_ (struct MHD_Daemon *daemon)
+{
+  MHD_socket ls;
+  enum MHD_WatchEvents interest;
+
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+
+  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
+       (! daemon->watch_itc_registered) )
+  {
+    daemon->watch_itc_registered = true;
+    daemon->watch_socket_cb (daemon->watch_socket_cb_cls,
+                             MHD_itc_r_fd_ (daemon->itc),
+                             MHD_WATCH_EVENT_RECV,
+                             _MHD_DROP_CONST (watch_itc_marker),
+                             &daemon->watch_itc_app_ctx);
+  }
+
+  ls = daemon->listen_fd;
+  if ( (MHD_INVALID_SOCKET == ls) ||
+       (daemon->was_quiesced) )
+    return;
+  if ( (daemon->connections < daemon->connection_limit) &&
+       (! daemon->at_limit) )
+    interest = MHD_WATCH_EVENT_RECV;
+  else
+    interest = MHD_WATCH_EVENT_NONE; /* At the limit, do not accept */
+  if ( (daemon->watch_listen_registered) &&
+       (interest == daemon->watch_listen_interest) )
+    return;
+  daemon->watch_listen_registered = true;
+  daemon->watch_listen_interest = interest;
+  daemon->watch_socket_cb (daemon->watch_socket_cb_cls,
+                           ls,
+                           interest,
+                           daemon,
+                           &daemon->watch_listen_app_ctx);
+}
+
+
+/**
+ * Remove the daemon's listen socket from the set of sockets watched by
+ * the application.
+ *
+ * @param daemon the daemon to use
+ */
+static void
+watch_daemon_remove_listen_ (struct MHD_Daemon *daemon)
+{
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+
+  if (! daemon->watch_listen_registered)
+    return;
+  daemon->watch_listen_registered = false;
+  daemon->watch_socket_cb (daemon->watch_socket_cb_cls,
+                           daemon->listen_fd,
+                           MHD_WATCH_EVENT_REMOVE,
+                           daemon,
+                           &daemon->watch_listen_app_ctx);
+}
+
+
+/**
+ * Remove the daemon's sockets from the set of sockets watched by
+ * the application and cancel the timer.
+ * Called when the daemon is stopping, after closing of all connections.
+ *
+ * @param daemon the daemon to use
+ */
+static void
+watch_daemon_remove_all_ (struct MHD_Daemon *daemon)
+{
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+  mhd_assert (NULL == daemon->watch_pending_head);
+
+  watch_daemon_remove_listen_ (daemon);
+  if (daemon->watch_itc_registered)
+  {
+    daemon->watch_itc_registered = false;
+    daemon->watch_socket_cb (daemon->watch_socket_cb_cls,
+                             MHD_itc_r_fd_ (daemon->itc),
+                             MHD_WATCH_EVENT_REMOVE,
+                             _MHD_DROP_CONST (watch_itc_marker),
+                             &daemon->watch_itc_app_ctx);
+  }
+  if ( (NULL != daemon->watch_timer_cb) &&
+       (daemon->watch_timer_set) )
+  {
+    daemon->watch_timer_set = false;
+    daemon->watch_timer_cb (daemon->watch_timer_cb_cls,
+                            -1);
+  }
+}
+
+
+/**
+ * Notify the application about the new time of the next required
+ * processing, if the timer must fire earlier than the timer already set.
+ *
+ * @param daemon the daemon to use
+ */
+static void
+watch_daemon_update_timer_ (struct MHD_Daemon *daemon)
+{
+  int64_t timeout_ms;
+  uint64_t deadline;
+
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+
+  if (NULL == daemon->watch_timer_cb)
+    return;
+
+  /* The list of pending connections is precise in this mode */
+  daemon->data_already_pending = (NULL != daemon->watch_pending_head);
+  timeout_ms = get_timeout_millisec_ (daemon, -1);
+  if (0 > timeout_ms)
+  {
+    if (daemon->watch_timer_set)
+    {
+      daemon->watch_timer_set = false;
+      daemon->watch_timer_cb (daemon->watch_timer_cb_cls,
+                              -1);
+    }
+    return;
+  }
+  deadline = MHD_monotonic_msec_counter () + (uint64_t) timeout_ms;
+  if ( (0 != timeout_ms) &&
+       (daemon->watch_timer_set) &&
+       (deadline >= daemon->watch_timer_deadline) )
+    return; /* The timer already set fires not later than required */
+  daemon->watch_timer_set = true;
+  daemon->watch_timer_deadline = deadline;
+  daemon->watch_timer_cb (daemon->watch_timer_cb_cls,
+                          timeout_ms);
+}
+
+
+/**
+ * Process all daemon's activities not bound to the network events on
+ * the specific sockets and update the sockets watched by the application.
+ *
+ * @param daemon the daemon to process
+ */
+static void
+watch_daemon_process_ (struct MHD_Daemon *daemon)
+{
+  struct MHD_Connection *pos;
+  struct MHD_Connection *prev;
+
+  mhd_assert (MHD_D_IS_USING_WATCH_ (daemon));
+
+  if (daemon->resuming)
+    resume_suspended_connections (daemon);
+
+  /* Process externally added connection if any */
+  if (daemon->have_new)
+    new_connections_list_process_ (daemon);
+
+  /* Process connections that have some data already pending.
+     Connections are removed from the list (or kept at the same position)
+     when processed and new connections are added to the head of the list,
+     so the list is walked only once. */
+  prev = daemon->watch_pending_tail;
+  while (NULL != (pos = prev))
+  {
+    prev = pos->prevW;
+    call_handlers (pos,
+                   false,
+                   false,
+                   false);
+    watch_connection_update_ (pos);
+  }
+
+  /* Handle timed-out connections, the same way as in epoll mode.
+     Connections with custom timeouts must all be looked at. */
+  prev = daemon->manual_timeout_tail;
+  while (NULL != (pos = prev))
+  {
+    prev = pos->prevX;
+    MHD_connection_handle_idle (pos);
+    watch_connection_update_ (pos);
+  }
+  /* Connections with the default timeout are sorted */
+  prev = daemon->normal_timeout_tail;
+  while (NULL != (pos = prev))
+  {
+    prev = pos->prevX;
+    MHD_connection_handle_idle (pos);
+    watch_connection_update_ (pos);
+    if ( (MHD_CONNECTION_CLOSED != pos->state) &&
+         (! daemon->draining) )
+      break; /* sorted by timeout, no need to visit the rest! */
+  }
+
+  MHD_cleanup_connections (daemon);
+
+  watch_daemon_update_sockets_ (daemon);
+  watch_daemon_update_timer_ (daemon);
+}
+
+
+/**
+ * Run webserver operations for the socket watched by the application.
+ * This function must be used (instead of #MHD_run() and
+ * #MHD_run_from_select2()) by the daemons started with
+ * #MHD_OPTION_WATCH_SOCKET_CALLBACK.
+ *
+ * The function processes the events reported for the socket, then
+ * processes connections that have some data pending and timed-out
+ * connections.  All changes of the watched sockets set and of the timer
+ * are reported by callbacks before this function returns.
+ *
+ * The function must be called with NULL @a mhd_sckt_ctx when the timer
+ * set by #MHD_WatchTimerCallback is expired.  It should be called with NULL
+ * @a mhd_sckt_ctx as well after resuming of any suspended connection and
+ * after #MHD_add_connection() if the daemon was not started with
+ * #MHD_USE_ITC flag.
+ *
+ * This function cannot be used with daemon started with
+ * #MHD_USE_INTERNAL_POLLING_THREAD flag.
+ *
+ * @param daemon the daemon to run
+ * @param mhd_sckt_ctx the MHD's context of the socket, as provided
+ *                     to the #MHD_WatchSocketCallback, or NULL if
+ *                     only timer is expired
+ * @param events the detected events, the bitwise OR combination of
+ *               #MHD_WATCH_EVENT_RECV, #MHD_WATCH_EVENT_SEND and
+ *               #MHD_WATCH_EVENT_ERROR,
+ *               ignored if @a mhd_sckt_ctx is NULL
+ * @return #MHD_NO on serious errors or if the daemon was not started with
+ *         the right options for this call, #MHD_YES on success
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup event
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_run_watched (struct MHD_Daemon *daemon,
+                 void *mhd_sckt_ctx,
+                 unsigned int events)
+{
+  if ( (NULL == daemon) ||
+       (! MHD_D_IS_USING_WATCH_ (daemon)) ||
+       MHD_D_IS_USING_THREADS_ (daemon) )
+    return MHD_NO;
+  if (daemon->shutdown)
+    return MHD_NO;
+  daemon->loop_time_ms = MHD_monotonic_msec_counter ();
+
+  if (NULL == mhd_sckt_ctx)
+    daemon->watch_timer_set = false; /* The application's timer has fired */
+  else if (daemon == mhd_sckt_ctx)
+  {
+    /* Check for error conditions on listen socket. */
+    if ( (0 == (events & MHD_WATCH_EVENT_ERROR)) &&
+         (0 != (events & MHD_WATCH_EVENT_RECV)) )
+    {
+      unsigned int series_length = 0;
+
+      /* Run 'accept' until it fails or daemon at limit of connections.
+       * Do not accept more then 10 connections at once. */
+      while ( (MHD_NO != MHD_accept_connection (daemon)) &&
+              (series_length < 10) &&
+              (daemon->connections < daemon->connection_limit) &&
+              (! daemon->at_limit) )
+        series_length++;
+    }
+  }
+  else if (watch_itc_marker == mhd_sckt_ctx)
+  {
+    /* It's OK to clear ITC here as all external
+       conditions will be processed later. */
+    MHD_itc_clear_ (daemon->itc);
+  }
+  else
+  {
+    struct MHD_Connection *const c = (struct MHD_Connection *) mhd_sckt_ctx;
+
+    mhd_assert (daemon == c->daemon);
+    mhd_assert (c->watch_registered);
+    /* Ignore stale events for suspended or closed connections */
+    if ( (! c->suspended) &&
+         (MHD_EVENT_LOOP_INFO_CLEANUP != c->event_loop_info) )
+    {
+      call_handlers (c,
+                     0 != (events & MHD_WATCH_EVENT_RECV),
+                     0 != (events & MHD_WATCH_EVENT_SEND),
+                     0 != (events & MHD_WATCH_EVENT_ERROR));
+      watch_connection_update_ (c);
+    }
+  }
+
+  watch_daemon_process_ (daemon);
+
+  return MHD_YES;
+}
+
+
 /**
  * Run webserver operations (without blocking unless in client callbacks).
  *
@@ -5827,6 +7528,9 @@ MHD_run (struct MHD_Daemon *daemon)
        MHD_D_IS_USING_THREADS_ (daemon) )
     return MHD_NO;
 
+  if (MHD_D_IS_USING_WATCH_ (daemon))
+    return MHD_run_watched (daemon, NULL, 0);
+
   (void) MHD_run_wait (daemon, 0);
   return MHD_YES;
 }
@@ -5876,7 +7580,8 @@ MHD_run_wait (struct MHD_Daemon *daemon,
 {
   enum MHD_Result res;
   if ( (daemon->shutdown) ||
-       MHD_D_IS_USING_THREADS_ (daemon) )
+       MHD_D_IS_USING_THREADS_ (daemon) ||
+       MHD_D_IS_USING_WATCH_ (daemon) )
     return MHD_NO;
 
   mhd_assert (! MHD_thread_handle_ID_is_valid_handle_ (daemon->tid));
@@ -5978,6 +7683,38 @@ close_connection (struct MHD_Connection *pos)
 }
 
 
+/**
+ * Allocate the memory slabs for the memory pools of the connections
+ * processed by the daemon, if requested by the application.
+ * Must be called in the daemon's thread (if any) so the memory is
+ * allocated in the "good" (for the thread) memory region.
+ * If the slabs cannot be allocated, the pools are allocated separately.
+ *
+ * @param daemon the daemon to use
+ */
+static void
+daemon_init_pool_slabs_ (struct MHD_Daemon *daemon)
+{
+  mhd_assert (NULL == daemon->pool_slabs);
+  mhd_assert (NULL == daemon->worker_pool);
+  if ( (0 == daemon->pool_slab_size) ||
+       daemon->pool_guard_pages)
+    return; /* The guard pages cannot be used with the slabs */
+  daemon->pool_slabs =
+    MHD_pool_slabs_create (daemon->pool_size,
+                           daemon->pool_slab_size,
+                           (MHD_HUGE_PAGES_NONE != daemon->pool_huge_pages),
+                           (MHD_HUGE_PAGES_EXPLICIT ==
+                            daemon->pool_huge_pages));
+#ifdef HAVE_MESSAGES
+  if (NULL == daemon->pool_slabs)
+    MHD_DLOG (daemon,
+              _ ("Warning: failed to allocate the memory slabs, " \
+                 "MHD_OPTION_CONNECTION_MEMORY_SLAB_SIZE is ignored.\n"));
+#endif /* HAVE_MESSAGES */
+}
+
+
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
 /**
  * Thread that runs the polling loop until the daemon
@@ -6013,6 +7750,7 @@ MHD_polling_thread (void *cls)
               MHD_strerror_ (errno));
 #endif /* HAVE_MESSAGES */
 #endif /* HAVE_PTHREAD_SIGMASK */
+  daemon_init_pool_slabs_ (daemon);
   while (! daemon->shutdown)
   {
 #ifdef HAVE_POLL
@@ -6145,76 +7883,341 @@ MHD_start_daemon (unsigned int flags,
  * @ingroup specialized
  */
 _MHD_EXTERN MHD_socket
-MHD_quiesce_daemon (struct MHD_Daemon *daemon)
+MHD_quiesce_daemon (struct MHD_Daemon *daemon)
+{
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  unsigned int i;
+#endif
+  MHD_socket ret;
+
+  ret = daemon->listen_fd;
+  if ((MHD_INVALID_SOCKET == ret)
+      || daemon->was_quiesced)
+    return MHD_INVALID_SOCKET;
+  if ( (0 == (daemon->options & (MHD_USE_ITC))) &&
+       MHD_D_IS_USING_THREADS_ (daemon) )
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Using MHD_quiesce_daemon in this mode " \
+                 "requires MHD_USE_ITC.\n"));
+#endif
+    return MHD_INVALID_SOCKET;
+  }
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (NULL != daemon->worker_pool)
+  {
+    /* The workers must not be started while the pool is quiesced */
+    MHD_mutex_lock_chk_ (&daemon->worker_start_lock);
+    for (i = 0; i < daemon->worker_pool_size; i++)
+    {
+      daemon->worker_pool[i].was_quiesced = true;
+#ifdef EPOLL_SUPPORT
+      if (MHD_D_IS_USING_EPOLL_ (daemon) &&
+          (-1 != daemon->worker_pool[i].epoll_fd) &&
+          (daemon->worker_pool[i].listen_socket_in_epoll) )
+      {
+        if (0 != epoll_ctl (daemon->worker_pool[i].epoll_fd,
+                            EPOLL_CTL_DEL,
+                            ret,
+                            NULL))
+          MHD_PANIC (_ ("Failed to remove listen FD from epoll set.\n"));
+        daemon->worker_pool[i].listen_socket_in_epoll = false;
+      }
+      else
+#endif
+      if (MHD_ITC_IS_VALID_ (daemon->worker_pool[i].itc))
+      {
+        if (! MHD_itc_activate_ (daemon->worker_pool[i].itc, "q"))
+          MHD_PANIC (_ ("Failed to signal quiesce via inter-thread " \
+                        "communication channel.\n"));
+      }
+    }
+    MHD_mutex_unlock_chk_ (&daemon->worker_start_lock);
+  }
+#endif
+  daemon->was_quiesced = true;
+  if (MHD_D_IS_USING_WATCH_ (daemon))
+    watch_daemon_remove_listen_ (daemon);
+#ifdef EPOLL_SUPPORT
+  if (MHD_D_IS_USING_EPOLL_ (daemon) &&
+      (-1 != daemon->epoll_fd) &&
+      (daemon->listen_socket_in_epoll) )
+  {
+    if ( (0 != epoll_ctl (daemon->epoll_fd,
+                          EPOLL_CTL_DEL,
+                          ret,
+                          NULL)) &&
+         (ENOENT != errno) )   /* ENOENT can happen due to race with
+                                  #MHD_epoll() */
+      MHD_PANIC ("Failed to remove listen FD from epoll set.\n");
+    daemon->listen_socket_in_epoll = false;
+  }
+#endif
+  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
+       (! MHD_itc_activate_ (daemon->itc, "q")) )
+    MHD_PANIC (_ ("failed to signal quiesce via inter-thread " \
+                  "communication channel.\n"));
+  return ret;
+}
+
+
+/**
+ * Gracefully close all connections of the daemon.
+ *
+ * The daemon stops accepting new connections (as with
+ * #MHD_quiesce_daemon(), but the listen socket is still closed by
+ * #MHD_stop_daemon()), the idle keep-alive connections are closed, the
+ * responses of the requests in progress are sent with "Connection: close"
+ * header and connections are closed once the responses are sent.
+ * Connections not closed within @a timeout_ms milliseconds are closed
+ * forcibly.
+ *
+ * @param daemon the daemon to drain
+ * @param timeout_ms the maximum time in milliseconds given to the requests
+ *                   in progress to be completed
+ * @return #MHD_YES if draining is started,
+ *         #MHD_NO if draining is not supported in the daemon mode or
+ *         draining has been started already
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup specialized
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_drain_daemon (struct MHD_Daemon *daemon,
+                  unsigned int timeout_ms)
+{
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  unsigned int i;
+#endif
+  uint64_t deadline;
+
+  if (daemon->draining)
+    return MHD_NO;
+  if ( (0 == (daemon->options & (MHD_USE_ITC))) &&
+       MHD_D_IS_USING_THREADS_ (daemon) )
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Using MHD_drain_daemon in this mode " \
+                 "requires MHD_USE_ITC.\n"));
+#endif
+    return MHD_NO;
+  }
+
+  if (MHD_INVALID_SOCKET != MHD_quiesce_daemon (daemon))
+    daemon->drain_close_listen = true;
+
+  deadline = MHD_monotonic_msec_counter () + timeout_ms;
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (NULL != daemon->worker_pool)
+    for (i = 0; i < daemon->worker_pool_size; i++)
+    {
+      struct MHD_Daemon *const worker = daemon->worker_pool + i;
+
+      /* The lock publishes the deadline together with the flag */
+      MHD_mutex_lock_chk_ (&worker->cleanup_connection_mutex);
+      worker->drain_deadline = deadline;
+      worker->draining = true;
+      MHD_mutex_unlock_chk_ (&worker->cleanup_connection_mutex);
+      if ( (MHD_ITC_IS_VALID_ (worker->itc)) &&
+           (! MHD_itc_activate_ (worker->itc, "d")) )
+        MHD_PANIC (_ ("Failed to signal drain via inter-thread " \
+                      "communication channel.\n"));
+    }
+  else
+    MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+#endif
+  daemon->drain_deadline = deadline;
+  daemon->draining = true;
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (NULL == daemon->worker_pool)
+    MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+#endif
+  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
+       (! MHD_itc_activate_ (daemon->itc, "d")) )
+    MHD_PANIC (_ ("Failed to signal drain via inter-thread " \
+                  "communication channel.\n"));
+  /* The connection threads stop waiting for this signal once they
+     see the flag, the channel is never cleared */
+  if ( (MHD_ITC_IS_VALID_ (daemon->drain_itc)) &&
+       (! MHD_itc_activate_ (daemon->drain_itc, "d")) )
+    MHD_PANIC (_ ("Failed to signal drain via inter-thread " \
+                  "communication channel.\n"));
+  drain_report_progress (daemon);
+  return MHD_YES;
+}
+
+
+/**
+ * Send the socket to another process over the local (UNIX domain)
+ * socket.
+ *
+ * @param local_socket the connected local socket
+ * @param sock the socket to send
+ * @return #MHD_YES on success,
+ *         #MHD_NO on error or if sending sockets is not supported
+ *         by the platform
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup specialized
+ */
+_MHD_EXTERN enum MHD_Result
+MHD_handoff_send_socket (MHD_socket local_socket,
+                         MHD_socket sock)
+{
+#if defined(MHD_POSIX_SOCKETS) && defined(SCM_RIGHTS)
+  union
+  {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE (sizeof(int))];
+  } ctrl;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char marker = 'S'; /* At least one byte must be sent with the socket */
+  ssize_t res;
+
+  if ( (MHD_INVALID_SOCKET == local_socket) ||
+       (MHD_INVALID_SOCKET == sock) )
+    return MHD_NO;
+  memset (&msg, 0, sizeof(msg));
+  memset (&ctrl, 0, sizeof(ctrl));
+  iov.iov_base = &marker;
+  iov.iov_len = sizeof(marker);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof(ctrl.buf);
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof(int));
+  memcpy (CMSG_DATA (cmsg), &sock, sizeof(int));
+  do
+  {
+    res = sendmsg (local_socket, &msg, MSG_NOSIGNAL_OR_ZERO);
+  } while ( (0 > res) &&
+            MHD_SCKT_LAST_ERR_IS_ (MHD_SCKT_EINTR_) );
+  return (sizeof(marker) == res) ? MHD_YES : MHD_NO;
+#else  /* ! MHD_POSIX_SOCKETS || ! SCM_RIGHTS */
+  (void) local_socket; (void) sock; /* Mute compiler warning */
+  return MHD_NO;
+#endif /* ! MHD_POSIX_SOCKETS || ! SCM_RIGHTS */
+}
+
+
+#if defined(MHD_POSIX_SOCKETS) && defined(SCM_RIGHTS)
+/**
+ * Close all sockets received in the control messages.
+ *
+ * @param msg the received message
+ */
+static void
+handoff_close_received_ (struct msghdr *msg)
+{
+  struct cmsghdr *cmsg;
+
+  for (cmsg = CMSG_FIRSTHDR (msg);
+       NULL != cmsg;
+       cmsg = CMSG_NXTHDR (msg, cmsg))
+  {
+    const unsigned char *data;
+    const unsigned char *end;
+
+    if ( (SOL_SOCKET != cmsg->cmsg_level) ||
+         (SCM_RIGHTS != cmsg->cmsg_type) ||
+         (CMSG_LEN (0) > cmsg->cmsg_len) )
+      continue;
+    data = CMSG_DATA (cmsg);
+    end = ((const unsigned char *) cmsg) + cmsg->cmsg_len;
+    /* The truncated message is limited by the control buffer */
+    if (((const unsigned char *) msg->msg_control) + msg->msg_controllen < end)
+      end = ((const unsigned char *) msg->msg_control) + msg->msg_controllen;
+    while (data + sizeof(int) <= end)
+    {
+      int fd;
+
+      memcpy (&fd, data, sizeof(int));
+      if (0 <= fd)
+        (void) close (fd);
+      data += sizeof(int);
+    }
+  }
+}
+
+
+#endif /* MHD_POSIX_SOCKETS && SCM_RIGHTS */
+
+/**
+ * Receive the socket sent by #MHD_handoff_send_socket().
+ *
+ * @param local_socket the connected local socket
+ * @return the received socket,
+ *         #MHD_INVALID_SOCKET on error or if receiving sockets is not
+ *         supported by the platform
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup specialized
+ */
+_MHD_EXTERN MHD_socket
+MHD_handoff_receive_socket (MHD_socket local_socket)
 {
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-  unsigned int i;
-#endif
-  MHD_socket ret;
-
-  ret = daemon->listen_fd;
-  if ((MHD_INVALID_SOCKET == ret)
-      || daemon->was_quiesced)
-    return MHD_INVALID_SOCKET;
-  if ( (0 == (daemon->options & (MHD_USE_ITC))) &&
-       MHD_D_IS_USING_THREADS_ (daemon) )
+#if defined(MHD_POSIX_SOCKETS) && defined(SCM_RIGHTS)
+  union
   {
-#ifdef HAVE_MESSAGES
-    MHD_DLOG (daemon,
-              _ ("Using MHD_quiesce_daemon in this mode " \
-                 "requires MHD_USE_ITC.\n"));
-#endif
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE (sizeof(int))];
+  } ctrl;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char marker;
+  ssize_t res;
+  MHD_socket sock;
+#ifdef MSG_CMSG_CLOEXEC
+  const int flags = MSG_CMSG_CLOEXEC;
+#else  /* ! MSG_CMSG_CLOEXEC */
+  const int flags = 0;
+#endif /* ! MSG_CMSG_CLOEXEC */
+
+  if (MHD_INVALID_SOCKET == local_socket)
     return MHD_INVALID_SOCKET;
-  }
-
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-  if (NULL != daemon->worker_pool)
-    for (i = 0; i < daemon->worker_pool_size; i++)
-    {
-      daemon->worker_pool[i].was_quiesced = true;
-#ifdef EPOLL_SUPPORT
-      if (MHD_D_IS_USING_EPOLL_ (daemon) &&
-          (-1 != daemon->worker_pool[i].epoll_fd) &&
-          (daemon->worker_pool[i].listen_socket_in_epoll) )
-      {
-        if (0 != epoll_ctl (daemon->worker_pool[i].epoll_fd,
-                            EPOLL_CTL_DEL,
-                            ret,
-                            NULL))
-          MHD_PANIC (_ ("Failed to remove listen FD from epoll set.\n"));
-        daemon->worker_pool[i].listen_socket_in_epoll = false;
-      }
-      else
-#endif
-      if (MHD_ITC_IS_VALID_ (daemon->worker_pool[i].itc))
-      {
-        if (! MHD_itc_activate_ (daemon->worker_pool[i].itc, "q"))
-          MHD_PANIC (_ ("Failed to signal quiesce via inter-thread " \
-                        "communication channel.\n"));
-      }
-    }
-#endif
-  daemon->was_quiesced = true;
-#ifdef EPOLL_SUPPORT
-  if (MHD_D_IS_USING_EPOLL_ (daemon) &&
-      (-1 != daemon->epoll_fd) &&
-      (daemon->listen_socket_in_epoll) )
+  memset (&msg, 0, sizeof(msg));
+  memset (&ctrl, 0, sizeof(ctrl));
+  iov.iov_base = &marker;
+  iov.iov_len = sizeof(marker);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = sizeof(ctrl.buf);
+  do
   {
-    if ( (0 != epoll_ctl (daemon->epoll_fd,
-                          EPOLL_CTL_DEL,
-                          ret,
-                          NULL)) &&
-         (ENOENT != errno) )   /* ENOENT can happen due to race with
-                                  #MHD_epoll() */
-      MHD_PANIC ("Failed to remove listen FD from epoll set.\n");
-    daemon->listen_socket_in_epoll = false;
+    res = recvmsg (local_socket, &msg, flags);
+  } while ( (0 > res) &&
+            MHD_SCKT_LAST_ERR_IS_ (MHD_SCKT_EINTR_) );
+  if (0 > res)
+    return MHD_INVALID_SOCKET;
+  cmsg = CMSG_FIRSTHDR (&msg);
+  if ( (sizeof(marker) != res) ||
+       (0 != (msg.msg_flags & MSG_CTRUNC)) ||
+       (NULL == cmsg) ||
+       (SOL_SOCKET != cmsg->cmsg_level) ||
+       (SCM_RIGHTS != cmsg->cmsg_type) ||
+       (CMSG_LEN (sizeof(int)) != cmsg->cmsg_len) ||
+       (NULL != CMSG_NXTHDR (&msg, cmsg)) )
+  {
+    /* Do not leak the sockets received with the wrong message */
+    handoff_close_received_ (&msg);
+    return MHD_INVALID_SOCKET;
   }
-#endif
-  if ( (MHD_ITC_IS_VALID_ (daemon->itc)) &&
-       (! MHD_itc_activate_ (daemon->itc, "q")) )
-    MHD_PANIC (_ ("failed to signal quiesce via inter-thread " \
-                  "communication channel.\n"));
-  return ret;
+  memcpy (&sock, CMSG_DATA (cmsg), sizeof(int));
+#ifndef MSG_CMSG_CLOEXEC
+  (void) MHD_socket_noninheritable_ (sock);
+#endif /* ! MSG_CMSG_CLOEXEC */
+  return sock;
+#else  /* ! MHD_POSIX_SOCKETS || ! SCM_RIGHTS */
+  (void) local_socket; /* Mute compiler warning */
+  return MHD_INVALID_SOCKET;
+#endif /* ! MHD_POSIX_SOCKETS || ! SCM_RIGHTS */
 }
 
 
@@ -6701,12 +8704,36 @@ parse_options_va (struct MHD_Daemon *daemon,
       daemon->notify_completed_cls = va_arg (ap,
                                              void *);
       break;
+    case MHD_OPTION_DRAIN_CALLBACK:
+      daemon->drain_cb = va_arg (ap,
+                                 MHD_DrainCallback);
+      daemon->drain_cb_cls = va_arg (ap,
+                                     void *);
+      break;
+    case MHD_OPTION_DRAIN_HANDOFF_CALLBACK:
+      daemon->drain_handoff_cb = va_arg (ap,
+                                         MHD_HandoffCallback);
+      daemon->drain_handoff_cb_cls = va_arg (ap,
+                                             void *);
+      break;
     case MHD_OPTION_NOTIFY_CONNECTION:
       daemon->notify_connection = va_arg (ap,
                                           MHD_NotifyConnectionCallback);
       daemon->notify_connection_cls = va_arg (ap,
                                               void *);
       break;
+    case MHD_OPTION_WATCH_SOCKET_CALLBACK:
+      daemon->watch_socket_cb = va_arg (ap,
+                                        MHD_WatchSocketCallback);
+      daemon->watch_socket_cb_cls = va_arg (ap,
+                                            void *);
+      break;
+    case MHD_OPTION_WATCH_TIMER_CALLBACK:
+      daemon->watch_timer_cb = va_arg (ap,
+                                       MHD_WatchTimerCallback);
+      daemon->watch_timer_cb_cls = va_arg (ap,
+                                           void *);
+      break;
     case MHD_OPTION_PER_IP_CONNECTION_LIMIT:
       daemon->per_ip_connection_limit = va_arg (ap,
                                                 unsigned int);
@@ -6731,6 +8758,104 @@ parse_options_va (struct MHD_Daemon *daemon,
       daemon->uri_log_callback_cls = va_arg (ap,
                                              void *);
       break;
+    case MHD_OPTION_ROUTES:
+      daemon->routes = va_arg (ap,
+                               const struct MHD_Route *);
+      break;
+    case MHD_OPTION_ZEROCOPY_THRESHOLD:
+#ifdef MHD_USE_ZEROCOPY_SEND
+      daemon->zerocopy_threshold = va_arg (ap,
+                                           size_t);
+#else  /* ! MHD_USE_ZEROCOPY_SEND */
+      if (0 != va_arg (ap,
+                       size_t))
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("Warning: zero-copy send is not supported on this " \
+                     "platform, MHD_OPTION_ZEROCOPY_THRESHOLD is ignored.\n"));
+#endif /* HAVE_MESSAGES */
+      }
+#endif /* ! MHD_USE_ZEROCOPY_SEND */
+      break;
+    case MHD_OPTION_CONNECTION_MEMORY_SLAB_SIZE:
+      daemon->pool_slab_size = va_arg (ap,
+                                       size_t);
+      break;
+    case MHD_OPTION_CONNECTION_MEMORY_HUGE_PAGES:
+      daemon->pool_huge_pages = (enum MHD_HugePagesMode)
+                                va_arg (ap,
+                                        unsigned int);
+      if ( (MHD_HUGE_PAGES_NONE != daemon->pool_huge_pages) &&
+           (MHD_HUGE_PAGES_TRANSPARENT != daemon->pool_huge_pages) &&
+           (MHD_HUGE_PAGES_EXPLICIT != daemon->pool_huge_pages) )
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("Invalid value of " \
+                     "MHD_OPTION_CONNECTION_MEMORY_HUGE_PAGES.\n"));
+#endif /* HAVE_MESSAGES */
+        return MHD_NO;
+      }
+      break;
+    case MHD_OPTION_CONNECTION_MEMORY_PROFILE:
+      {
+        const unsigned int prof_flags = va_arg (ap,
+                                                unsigned int);
+        if (0 != (prof_flags
+                  & ~((unsigned int) (MHD_MEMORY_PROFILE_COLLECT
+                                      | MHD_MEMORY_PROFILE_GUARD_PAGES))))
+        {
+#ifdef HAVE_MESSAGES
+          MHD_DLOG (daemon,
+                    _ ("Invalid value of " \
+                       "MHD_OPTION_CONNECTION_MEMORY_PROFILE.\n"));
+#endif /* HAVE_MESSAGES */
+          return MHD_NO;
+        }
+        daemon->pool_profile =
+          (0 != (prof_flags & MHD_MEMORY_PROFILE_COLLECT));
+        daemon->pool_guard_pages =
+          (0 != (prof_flags & MHD_MEMORY_PROFILE_GUARD_PAGES));
+      }
+      break;
+    case MHD_OPTION_EPOLL_EVENTS_SIZE:
+#ifdef EPOLL_SUPPORT
+      daemon->epoll_events_size = va_arg (ap,
+                                          unsigned int);
+      if (0 == daemon->epoll_events_size)
+        daemon->epoll_events_size = MAX_EVENTS;
+      else if ((INT_MAX / sizeof (struct epoll_event)) <
+               daemon->epoll_events_size)
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("The value of MHD_OPTION_EPOLL_EVENTS_SIZE " \
+                     "is too large.\n"));
+#endif /* HAVE_MESSAGES */
+        return MHD_NO;
+      }
+#else  /* ! EPOLL_SUPPORT */
+      (void) va_arg (ap,
+                     unsigned int);
+#endif /* ! EPOLL_SUPPORT */
+      break;
+    case MHD_OPTION_EPOLL_BUSY_POLL:
+#ifdef EPOLL_SUPPORT
+      daemon->epoll_busy_poll_usec = va_arg (ap,
+                                             unsigned int);
+#else  /* ! EPOLL_SUPPORT */
+      if (0 != va_arg (ap,
+                       unsigned int))
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("Warning: epoll is not supported on this platform, " \
+                     "MHD_OPTION_EPOLL_BUSY_POLL is ignored.\n"));
+#endif /* HAVE_MESSAGES */
+      }
+#endif /* ! EPOLL_SUPPORT */
+      break;
     case MHD_OPTION_SERVER_INSANITY:
       daemon->insanity_level = (enum MHD_DisableSanityCheck)
                                va_arg (ap,
@@ -7044,6 +9169,49 @@ parse_options_va (struct MHD_Daemon *daemon,
 #endif /* HAVE_MESSAGES */
       return MHD_NO;
 #endif /* ! DAUTH_SUPPORT */
+#ifdef BAUTH_SUPPORT
+    case MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK:
+      daemon->bauth_verify_cb = va_arg (ap,
+                                        MHD_BasicAuthVerifyCallback);
+      daemon->bauth_verify_cb_cls = va_arg (ap,
+                                            void *);
+      break;
+    case MHD_OPTION_BASIC_AUTH_CACHE_SIZE:
+      daemon->bauth_cache_size = va_arg (ap,
+                                         unsigned int);
+#ifndef MHD_BAUTH_CACHE_SUPPORT
+      if (0 != daemon->bauth_cache_size)
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("The cache of Basic Authentication credentials " \
+                     "requires SHA-256 support. The cache is disabled.\n"));
+#endif /* HAVE_MESSAGES */
+        daemon->bauth_cache_size = 0;
+      }
+#endif /* ! MHD_BAUTH_CACHE_SUPPORT */
+      break;
+    case MHD_OPTION_BASIC_AUTH_CACHE_TIMEOUT:
+      if (1)
+      {
+        unsigned int val;
+        val = va_arg (ap,
+                      unsigned int);
+        if (0 != val)
+          daemon->bauth_cache_timeout_ms = ((uint64_t) val) * 1000;
+      }
+      break;
+#else  /* ! BAUTH_SUPPORT */
+    case MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK:
+    case MHD_OPTION_BASIC_AUTH_CACHE_SIZE:
+    case MHD_OPTION_BASIC_AUTH_CACHE_TIMEOUT:
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Basic Auth is disabled for this build " \
+                   "of GNU libmicrohttpd.\n"));
+#endif /* HAVE_MESSAGES */
+      return MHD_NO;
+#endif /* ! BAUTH_SUPPORT */
     case MHD_OPTION_LISTEN_SOCKET:
       params->listen_fd = va_arg (ap,
                                   MHD_socket);
@@ -7073,6 +9241,61 @@ parse_options_va (struct MHD_Daemon *daemon,
       daemon->thread_stack_size = va_arg (ap,
                                           size_t);
       break;
+    case MHD_OPTION_THREAD_REUSE_MAX_IDLE:
+      daemon->conn_threads_idle_max = va_arg (ap,
+                                              unsigned int);
+      if ( (0 != daemon->conn_threads_idle_max) &&
+           (! MHD_D_IS_USING_THREAD_PER_CONN_ (daemon)) )
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("MHD_OPTION_THREAD_REUSE_MAX_IDLE option is specified " \
+                     "but MHD_USE_THREAD_PER_CONNECTION flag is not " \
+                     "specified.\n"));
+#endif
+        return MHD_NO;
+      }
+      break;
+    case MHD_OPTION_THREAD_REUSE_MIN_IDLE:
+      daemon->conn_threads_idle_min = va_arg (ap,
+                                              unsigned int);
+      break;
+    case MHD_OPTION_THREAD_REUSE_IDLE_TIMEOUT:
+      daemon->conn_threads_idle_timeout = va_arg (ap,
+                                                  unsigned int);
+      break;
+    case MHD_OPTION_HANDLER_OFFLOAD_THREADS:
+      daemon->handler_offload_threads = va_arg (ap,
+                                                unsigned int);
+      if ( (0 != daemon->handler_offload_threads) &&
+           (MHD_D_IS_USING_THREAD_PER_CONN_ (daemon)) )
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("MHD_OPTION_HANDLER_OFFLOAD_THREADS option cannot be " \
+                     "used with MHD_USE_THREAD_PER_CONNECTION.\n"));
+#endif
+        return MHD_NO;
+      }
+      break;
+    case MHD_OPTION_HANDLER_OFFLOAD_QUEUE_LIMIT:
+      daemon->handler_offload_queue_limit = va_arg (ap,
+                                                    unsigned int);
+      break;
+    case MHD_OPTION_FILE_READ_THREADS:
+      daemon->file_read_threads = va_arg (ap,
+                                          unsigned int);
+      if ( (0 != daemon->file_read_threads) &&
+           (MHD_D_IS_USING_THREAD_PER_CONN_ (daemon)) )
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("MHD_OPTION_FILE_READ_THREADS option cannot be " \
+                     "used with MHD_USE_THREAD_PER_CONNECTION.\n"));
+#endif
+        return MHD_NO;
+      }
+      break;
 #endif
     case MHD_OPTION_TCP_FASTOPEN_QUEUE_SIZE:
 #ifdef TCP_FASTOPEN
@@ -7137,6 +9360,8 @@ parse_options_va (struct MHD_Daemon *daemon,
         case MHD_OPTION_CONNECTION_MEMORY_LIMIT:
         case MHD_OPTION_CONNECTION_MEMORY_INCREMENT:
         case MHD_OPTION_THREAD_STACK_SIZE:
+        case MHD_OPTION_ZEROCOPY_THRESHOLD:
+        case MHD_OPTION_CONNECTION_MEMORY_SLAB_SIZE:
           if (MHD_NO == parse_options (daemon,
                                        params,
                                        opt,
@@ -7150,12 +9375,24 @@ parse_options_va (struct MHD_Daemon *daemon,
         case MHD_OPTION_CONNECTION_TIMEOUT:
         case MHD_OPTION_PER_IP_CONNECTION_LIMIT:
         case MHD_OPTION_THREAD_POOL_SIZE:
+        case MHD_OPTION_THREAD_REUSE_MAX_IDLE:
+        case MHD_OPTION_THREAD_REUSE_MIN_IDLE:
+        case MHD_OPTION_THREAD_REUSE_IDLE_TIMEOUT:
+        case MHD_OPTION_HANDLER_OFFLOAD_THREADS:
+        case MHD_OPTION_HANDLER_OFFLOAD_QUEUE_LIMIT:
+        case MHD_OPTION_FILE_READ_THREADS:
+        case MHD_OPTION_CONNECTION_MEMORY_HUGE_PAGES:
+        case MHD_OPTION_CONNECTION_MEMORY_PROFILE:
+        case MHD_OPTION_EPOLL_BUSY_POLL:
+        case MHD_OPTION_EPOLL_EVENTS_SIZE:
         case MHD_OPTION_TCP_FASTOPEN_QUEUE_SIZE:
         case MHD_OPTION_LISTENING_ADDRESS_REUSE:
         case MHD_OPTION_LISTEN_BACKLOG_SIZE:
         case MHD_OPTION_SERVER_INSANITY:
         case MHD_OPTION_DIGEST_AUTH_NONCE_BIND_TYPE:
         case MHD_OPTION_DIGEST_AUTH_DEFAULT_NONCE_TIMEOUT:
+        case MHD_OPTION_BASIC_AUTH_CACHE_SIZE:
+        case MHD_OPTION_BASIC_AUTH_CACHE_TIMEOUT:
           if (MHD_NO == parse_options (daemon,
                                        params,
                                        opt,
@@ -7217,6 +9454,7 @@ parse_options_va (struct MHD_Daemon *daemon,
         case MHD_OPTION_ARRAY:
         case MHD_OPTION_HTTPS_CERT_CALLBACK:
         case MHD_OPTION_HTTPS_CERT_CALLBACK2:
+        case MHD_OPTION_ROUTES:
           if (MHD_NO == parse_options (daemon,
                                        params,
                                        opt,
@@ -7227,10 +9465,15 @@ parse_options_va (struct MHD_Daemon *daemon,
         /* all options taking two pointers */
         case MHD_OPTION_NOTIFY_COMPLETED:
         case MHD_OPTION_NOTIFY_CONNECTION:
+        case MHD_OPTION_WATCH_SOCKET_CALLBACK:
+        case MHD_OPTION_WATCH_TIMER_CALLBACK:
         case MHD_OPTION_URI_LOG_CALLBACK:
         case MHD_OPTION_EXTERNAL_LOGGER:
         case MHD_OPTION_UNESCAPE_CALLBACK:
         case MHD_OPTION_GNUTLS_PSK_CRED_HANDLER:
+        case MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK:
+        case MHD_OPTION_DRAIN_CALLBACK:
+        case MHD_OPTION_DRAIN_HANDOFF_CALLBACK:
           if (MHD_NO == parse_options (daemon,
                                        params,
                                        opt,
@@ -7394,7 +9637,7 @@ setup_epoll_fd (struct MHD_Daemon *daemon)
 /**
  * Setup epoll() FD for the daemon and initialize it to listen
  * on the listen FD.
- * @remark To be called only from MHD_start_daemon_va()
+ * @remark To be called only from MHD_start_daemon_va() or worker_start_()
  *
  * @param daemon daemon to initialize for epoll()
  * @return #MHD_YES on success, #MHD_NO on failure
@@ -7477,6 +9720,18 @@ setup_epoll_to_listen (struct MHD_Daemon *daemon)
       return MHD_NO;
     }
   }
+  mhd_assert (NULL == daemon->epoll_events);
+  daemon->epoll_events =
+    (struct epoll_event *) malloc (sizeof (struct epoll_event)
+                                   * daemon->epoll_events_size);
+  if (NULL == daemon->epoll_events)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to allocate memory for epoll events.\n"));
+#endif
+    return MHD_NO;
+  }
   return MHD_YES;
 }
 
@@ -7640,6 +9895,140 @@ process_interim_params (struct MHD_Daemon *d,
 }
 
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+/**
+ * Create the ITC and the epoll FD of the prepared worker daemon and
+ * spawn the worker thread.
+ * @remark To be called from MHD_start_daemon_va() or under the lock of
+ *         MHD_Daemon::worker_start_lock of the master daemon
+ *
+ * @param d the worker daemon to start
+ * @return true on success, false on failure (the worker is left prepared,
+ *         but not started)
+ */
+static bool
+worker_start_ (struct MHD_Daemon *d)
+{
+  struct MHD_Daemon *const daemon = d->master;
+
+  mhd_assert (NULL != daemon);
+  mhd_assert (MHD_ITC_IS_INVALID_ (d->itc));
+  if (0 != (d->options & MHD_USE_ITC))
+  {
+    if (! MHD_itc_init_ (d->itc))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to create worker inter-thread " \
+                   "communication channel: %s\n"),
+                MHD_itc_last_strerror_ () );
+#endif
+      MHD_itc_set_invalid_ (d->itc);
+      return false;
+    }
+    if (MHD_D_IS_USING_SELECT_ (d) &&
+        (! MHD_D_DOES_SCKT_FIT_FDSET_ (MHD_itc_r_fd_ (d->itc), daemon)) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("File descriptor for worker inter-thread " \
+                   "communication channel exceeds maximum value.\n"));
+#endif
+      MHD_itc_destroy_chk_ (d->itc);
+      MHD_itc_set_invalid_ (d->itc);
+      return false;
+    }
+  }
+
+#ifdef HAVE_LISTEN_SHUTDOWN
+  mhd_assert ((MHD_ITC_IS_VALID_ (d->itc)) || \
+              (MHD_INVALID_SOCKET != d->listen_fd));
+#else  /* ! HAVE_LISTEN_SHUTDOWN */
+  mhd_assert (MHD_ITC_IS_VALID_ (d->itc));
+#endif /* ! HAVE_LISTEN_SHUTDOWN */
+
+#ifdef EPOLL_SUPPORT
+  if (MHD_D_IS_USING_EPOLL_ (d) &&
+      (MHD_NO == setup_epoll_to_listen (d)) )
+    goto start_failed;
+#endif
+
+  /* Spawn the worker thread */
+  if (! MHD_create_named_thread_ (&d->tid,
+                                  "MHD-worker",
+                                  daemon->thread_stack_size,
+                                  &MHD_polling_thread,
+                                  d))
+  {
+#ifdef HAVE_MESSAGES
+#ifdef EAGAIN
+    if (EAGAIN == errno)
+      MHD_DLOG (daemon,
+                _ ("Failed to create a new pool thread because it would " \
+                   "have exceeded the system limit on the number of " \
+                   "threads or no system resources available.\n"));
+    else
+#endif /* EAGAIN */
+    MHD_DLOG (daemon,
+              _ ("Failed to create pool thread: %s\n"),
+              MHD_strerror_ (errno));
+#endif
+    goto start_failed;
+  }
+  return true;
+
+start_failed:
+#ifdef EPOLL_SUPPORT
+  if (-1 != d->epoll_fd)
+    MHD_socket_close_chk_ (d->epoll_fd);
+  d->epoll_fd = -1;
+  d->listen_socket_in_epoll = false;
+#if defined(HTTPS_SUPPORT) && defined(UPGRADE_SUPPORT)
+  if (-1 != d->epoll_upgrade_fd)
+    MHD_socket_close_chk_ (d->epoll_upgrade_fd);
+  d->epoll_upgrade_fd = -1;
+#endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
+#endif /* EPOLL_SUPPORT */
+  if (MHD_ITC_IS_VALID_ (d->itc))
+    MHD_itc_destroy_chk_ (d->itc);
+  MHD_itc_set_invalid_ (d->itc);
+  return false;
+}
+
+
+/**
+ * Start the next worker of the pool if @a worker is the last started
+ * worker: the started worker without connections is always available
+ * to accept new connections, even when the other workers are busy.
+ * @remark To be called only from the worker's thread
+ *
+ * @param worker the worker daemon that has got a new connection
+ */
+static void
+worker_pool_grow_ (struct MHD_Daemon *worker)
+{
+  struct MHD_Daemon *const master = worker->master;
+  struct MHD_Daemon *next;
+
+  mhd_assert (NULL != master);
+  mhd_assert (MHD_thread_handle_ID_is_current_thread_ (worker->tid));
+  next = worker + 1;
+  if (master->worker_pool + master->worker_pool_size == next)
+    return; /* The last worker in the pool */
+  MHD_mutex_lock_chk_ (&master->worker_start_lock);
+  if ( (master->worker_pool + master->worker_pool_started == next) &&
+       (! master->shutdown) &&
+       (! next->was_quiesced) )
+  {
+    if (worker_start_ (next))
+      master->worker_pool_started++;
+  }
+  MHD_mutex_unlock_chk_ (&master->worker_start_lock);
+}
+
+
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
 /**
  * Start a webserver on the given port.
  *
@@ -7811,9 +10200,14 @@ MHD_start_daemon_va (unsigned int flags,
   daemon->pool_increment = MHD_BUF_INC_SIZE;
   daemon->unescape_callback = &unescape_wrapper;
   daemon->connection_timeout_ms = 0;       /* no timeout */
+#ifdef EPOLL_SUPPORT
+  daemon->epoll_events_size = MAX_EVENTS;
+#endif /* EPOLL_SUPPORT */
   MHD_itc_set_invalid_ (daemon->itc);
+  MHD_itc_set_invalid_ (daemon->drain_itc);
 #ifdef MHD_USE_THREADS
   MHD_thread_handle_ID_set_invalid_ (&daemon->tid);
+  daemon->conn_threads_idle_timeout = 60;
 #endif /* MHD_USE_THREADS */
 #ifdef SOMAXCONN
   daemon->listen_backlog_size = SOMAXCONN;
@@ -7845,6 +10239,11 @@ MHD_start_daemon_va (unsigned int flags,
   daemon->dauth_def_nonce_timeout = MHD_DAUTH_DEF_TIMEOUT_;
   daemon->dauth_def_max_nc = MHD_DAUTH_DEF_MAX_NC_;
 #endif
+#ifdef BAUTH_SUPPORT
+  daemon->bauth_cache_size = 0;
+  daemon->bauth_cache_timeout_ms =
+    ((uint64_t) MHD_BAUTH_CACHE_DEF_TIMEOUT_) * 1000;
+#endif /* BAUTH_SUPPORT */
 #ifdef HTTPS_SUPPORT
   if (0 != (*pflags & MHD_USE_TLS))
   {
@@ -7893,12 +10292,47 @@ MHD_start_daemon_va (unsigned int flags,
   {
 #ifdef HAVE_MESSAGES
     MHD_DLOG (daemon,
-              _ ("Failed to initialise GnuTLS priorities.\n"));
+              _ ("Failed to initialise GnuTLS priorities.\n"));
+#endif /* HAVE_MESSAGES */
+    free (daemon);
+    return NULL;
+  }
+#endif /* HTTPS_SUPPORT */
+
+  if (MHD_D_IS_USING_WATCH_ (daemon))
+  {
+    bool watch_supported;
+
+    if (0 != (*pflags & MHD_USE_AUTO))
+      *pflags &= ~((enum MHD_FLAG) MHD_USE_EPOLL); /* Polled by the app */
+    watch_supported = (! MHD_D_IS_USING_THREADS_ (daemon)) &&
+                      (! MHD_D_IS_USING_EPOLL_ (daemon));
+#if defined(HTTPS_SUPPORT) && defined(UPGRADE_SUPPORT)
+    if ( (0 != (*pflags & MHD_USE_TLS)) &&
+         (0 != (*pflags & MHD_ALLOW_UPGRADE)) )
+      watch_supported = false;
+#endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
+    if (! watch_supported)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("MHD_OPTION_WATCH_SOCKET_CALLBACK cannot be used with " \
+                   "internal threads, with epoll or with TLS upgrade.\n"));
+#endif /* HAVE_MESSAGES */
+#ifdef HTTPS_SUPPORT
+      if (NULL != daemon->priority_cache)
+        gnutls_priority_deinit (daemon->priority_cache);
+#endif /* HTTPS_SUPPORT */
+      free (daemon);
+      return NULL;
+    }
+  }
+#ifdef HAVE_MESSAGES
+  else if (NULL != daemon->watch_timer_cb)
+    MHD_DLOG (daemon,
+              _ ("MHD_OPTION_WATCH_TIMER_CALLBACK is ignored without " \
+                 "MHD_OPTION_WATCH_SOCKET_CALLBACK.\n"));
 #endif /* HAVE_MESSAGES */
-    free (daemon);
-    return NULL;
-  }
-#endif /* HTTPS_SUPPORT */
 
 #ifdef HAVE_MESSAGES
   if ( (0 != (flags & MHD_USE_THREAD_PER_CONNECTION)) &&
@@ -7917,6 +10351,11 @@ MHD_start_daemon_va (unsigned int flags,
       && ((NULL != daemon->notify_completed)
           || (NULL != daemon->notify_connection)) )
     *pflags |= MHD_USE_ITC; /* requires ITC */
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if ( (0 != daemon->handler_offload_threads) ||
+       (0 != daemon->file_read_threads) )
+    *pflags |= MHD_ALLOW_SUSPEND_RESUME; /* Offloaded calls suspend connections */
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
 
 #ifdef _DEBUG
 #ifdef HAVE_MESSAGES
@@ -7957,6 +10396,27 @@ MHD_start_daemon_va (unsigned int flags,
 #ifdef HTTPS_SUPPORT
       if (NULL != daemon->priority_cache)
         gnutls_priority_deinit (daemon->priority_cache);
+#endif /* HTTPS_SUPPORT */
+      free (daemon);
+      return NULL;
+    }
+    if (MHD_D_IS_USING_THREAD_PER_CONN_ (daemon) &&
+        ( (! MHD_itc_init_ (daemon->drain_itc)) ||
+          (MHD_D_IS_USING_SELECT_ (daemon) &&
+           (! MHD_D_DOES_SCKT_FIT_FDSET_ (MHD_itc_r_fd_ (daemon->drain_itc),
+                                          daemon))) ) )
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to create inter-thread communication channel " \
+                   "for draining.\n"));
+#endif
+      if (MHD_ITC_IS_VALID_ (daemon->drain_itc))
+        MHD_itc_destroy_chk_ (daemon->drain_itc);
+      MHD_itc_destroy_chk_ (daemon->itc);
+#ifdef HTTPS_SUPPORT
+      if (NULL != daemon->priority_cache)
+        gnutls_priority_deinit (daemon->priority_cache);
 #endif /* HTTPS_SUPPORT */
       free (daemon);
       return NULL;
@@ -7999,42 +10459,151 @@ MHD_start_daemon_va (unsigned int flags,
       free (daemon);
       return NULL;
     }
-    daemon->nnc = MHD_calloc_ (daemon->nonce_nc_size,
-                               sizeof (struct MHD_NonceNc));
-    if (NULL == daemon->nnc)
+    /* The nonce-nc map is allocated when the first nonce is generated */
+  }
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (! MHD_mutex_init_ (&daemon->nnc_lock))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("MHD failed to initialize nonce-nc mutex.\n"));
+#endif
+#ifdef HTTPS_SUPPORT
+    if (0 != (*pflags & MHD_USE_TLS))
+      gnutls_priority_deinit (daemon->priority_cache);
+#endif /* HTTPS_SUPPORT */
+    free (daemon->digest_auth_random_copy);
+    free (daemon->nnc);
+    free (daemon);
+    return NULL;
+  }
+#endif
+#endif
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+  if (0 != daemon->bauth_cache_size)
+  {
+    daemon->bauth_cache =
+      MHD_calloc_ (daemon->bauth_cache_size,
+                   sizeof (struct MHD_BAuthCacheEntry));
+    if (NULL == daemon->bauth_cache)
     {
 #ifdef HAVE_MESSAGES
       MHD_DLOG (daemon,
-                _ ("Failed to allocate memory for nonce-nc map: %s\n"),
+                _ ("Failed to allocate memory for Basic Auth cache: %s\n"),
                 MHD_strerror_ (errno));
 #endif
 #ifdef HTTPS_SUPPORT
       if (0 != (*pflags & MHD_USE_TLS))
         gnutls_priority_deinit (daemon->priority_cache);
 #endif /* HTTPS_SUPPORT */
+#ifdef DAUTH_SUPPORT
+      free (daemon->digest_auth_random_copy);
+      free (daemon->nnc);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+      MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
+#endif
+#endif /* DAUTH_SUPPORT */
+      free (daemon);
+      return NULL;
+    }
+    /* The key must be secret: the cached hashes are fast to compute
+       for the guessed credentials */
+    if (! MHD_get_random_bytes_ (daemon->bauth_cache_key,
+                                 sizeof(daemon->bauth_cache_key)))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to get the random key for Basic Auth cache.\n"));
+#endif
+#ifdef HTTPS_SUPPORT
+      if (0 != (*pflags & MHD_USE_TLS))
+        gnutls_priority_deinit (daemon->priority_cache);
+#endif /* HTTPS_SUPPORT */
+#ifdef DAUTH_SUPPORT
       free (daemon->digest_auth_random_copy);
+      free (daemon->nnc);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+      MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
+#endif
+#endif /* DAUTH_SUPPORT */
+      free (daemon->bauth_cache);
       free (daemon);
       return NULL;
     }
   }
-
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-  if (! MHD_mutex_init_ (&daemon->nnc_lock))
+  if (! MHD_mutex_init_ (&daemon->bauth_cache_lock))
   {
 #ifdef HAVE_MESSAGES
     MHD_DLOG (daemon,
-              _ ("MHD failed to initialize nonce-nc mutex.\n"));
+              _ ("MHD failed to initialize Basic Auth cache mutex.\n"));
+#endif
+#ifdef HTTPS_SUPPORT
+    if (0 != (*pflags & MHD_USE_TLS))
+      gnutls_priority_deinit (daemon->priority_cache);
+#endif /* HTTPS_SUPPORT */
+#ifdef DAUTH_SUPPORT
+    free (daemon->digest_auth_random_copy);
+    free (daemon->nnc);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+    MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
+#endif
+#endif /* DAUTH_SUPPORT */
+    free (daemon->bauth_cache);
+    free (daemon);
+    return NULL;
+  }
+#endif
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (! MHD_mutex_init_ (&daemon->drain_lock))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("MHD failed to initialize draining mutex.\n"));
 #endif
 #ifdef HTTPS_SUPPORT
     if (0 != (*pflags & MHD_USE_TLS))
       gnutls_priority_deinit (daemon->priority_cache);
 #endif /* HTTPS_SUPPORT */
+#ifdef DAUTH_SUPPORT
     free (daemon->digest_auth_random_copy);
     free (daemon->nnc);
+    MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
+#endif /* DAUTH_SUPPORT */
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+    free (daemon->bauth_cache);
+    MHD_mutex_destroy_chk_ (&daemon->bauth_cache_lock);
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
     free (daemon);
     return NULL;
   }
 #endif
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (! MHD_mutex_init_ (&daemon->worker_start_lock))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("MHD failed to initialize worker start mutex.\n"));
+#endif
+#ifdef HTTPS_SUPPORT
+    if (0 != (*pflags & MHD_USE_TLS))
+      gnutls_priority_deinit (daemon->priority_cache);
+#endif /* HTTPS_SUPPORT */
+#ifdef DAUTH_SUPPORT
+    free (daemon->digest_auth_random_copy);
+    free (daemon->nnc);
+    MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
+#endif /* DAUTH_SUPPORT */
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+    free (daemon->bauth_cache);
+    MHD_mutex_destroy_chk_ (&daemon->bauth_cache_lock);
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+    MHD_mutex_destroy_chk_ (&daemon->drain_lock);
+    free (daemon);
+    return NULL;
+  }
 #endif
 
   /* Thread polling currently works only with internal select thread mode */
@@ -8713,7 +11282,52 @@ MHD_start_daemon_va (unsigned int flags,
     goto free_and_fail;
   }
 #endif /* HTTPS_SUPPORT */
+  if (NULL != daemon->routes)
+  {
+    daemon->router = MHD_router_compile_ (daemon,
+                                          daemon->routes);
+    daemon->routes = NULL;
+    if (NULL == daemon->router)
+    {
+      if (MHD_INVALID_SOCKET != listen_fd)
+        MHD_socket_close_chk_ (listen_fd);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+      MHD_mutex_destroy_chk_ (&daemon->per_ip_connection_mutex);
+#endif
+      goto free_and_fail;
+    }
+  }
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  /* The offload threads must be ready before any connection is accepted */
+  if (0 != daemon->handler_offload_threads)
+  {
+    daemon->handler_offload =
+      offload_threads_start_ (daemon,
+                              daemon->handler_offload_threads,
+                              daemon->handler_offload_queue_limit,
+                              &handler_offload_call_,
+                              "MHD-handler");
+    if (NULL == daemon->handler_offload)
+    {
+      MHD_mutex_destroy_chk_ (&daemon->per_ip_connection_mutex);
+      goto free_and_fail;
+    }
+  }
+  if (0 != daemon->file_read_threads)
+  {
+    daemon->file_read_offload =
+      offload_threads_start_ (daemon,
+                              daemon->file_read_threads,
+                              0,
+                              &file_read_offload_call_,
+                              "MHD-file-read");
+    if (NULL == daemon->file_read_offload)
+    {
+      MHD_mutex_destroy_chk_ (&daemon->per_ip_connection_mutex);
+      goto free_and_fail;
+    }
+  }
+
   /* Start threads if requested by parameters */
   if (MHD_D_IS_USING_THREADS_ (daemon))
   {
@@ -8801,7 +11415,7 @@ MHD_start_daemon_va (unsigned int flags,
       if (NULL == daemon->worker_pool)
         goto thread_failed;
 
-      /* Start the workers in the pool */
+      /* Prepare the workers in the pool */
       for (i = 0; i < daemon->worker_pool_size; ++i)
       {
         /* Create copy of the Daemon object for each worker */
@@ -8814,6 +11428,9 @@ MHD_start_daemon_va (unsigned int flags,
         d->master = daemon;
         d->worker_pool_size = 0;
         d->worker_pool = NULL;
+        /* The offload threads are used via the master daemon */
+        d->handler_offload = NULL;
+        d->file_read_offload = NULL;
         if (! MHD_mutex_init_ (&d->cleanup_connection_mutex))
         {
 #ifdef HAVE_MESSAGES
@@ -8831,43 +11448,14 @@ MHD_start_daemon_va (unsigned int flags,
           MHD_mutex_destroy_chk_ (&d->cleanup_connection_mutex);
           goto thread_failed;
         }
-        if (0 != (*pflags & MHD_USE_ITC))
-        {
-          if (! MHD_itc_init_ (d->itc))
-          {
-#ifdef HAVE_MESSAGES
-            MHD_DLOG (daemon,
-                      _ ("Failed to create worker inter-thread " \
-                         "communication channel: %s\n"),
-                      MHD_itc_last_strerror_ () );
-#endif
-            MHD_mutex_destroy_chk_ (&d->new_connections_mutex);
-            MHD_mutex_destroy_chk_ (&d->cleanup_connection_mutex);
-            goto thread_failed;
-          }
-          if (MHD_D_IS_USING_SELECT_ (d) &&
-              (! MHD_D_DOES_SCKT_FIT_FDSET_ (MHD_itc_r_fd_ (d->itc), daemon)) )
-          {
-#ifdef HAVE_MESSAGES
-            MHD_DLOG (daemon,
-                      _ ("File descriptor for worker inter-thread " \
-                         "communication channel exceeds maximum value.\n"));
-#endif
-            MHD_itc_destroy_chk_ (d->itc);
-            MHD_mutex_destroy_chk_ (&d->new_connections_mutex);
-            MHD_mutex_destroy_chk_ (&d->cleanup_connection_mutex);
-            goto thread_failed;
-          }
-        }
-        else
-          MHD_itc_set_invalid_ (d->itc);
-
-#ifdef HAVE_LISTEN_SHUTDOWN
-        mhd_assert ((MHD_ITC_IS_VALID_ (d->itc)) || \
-                    (MHD_INVALID_SOCKET != d->listen_fd));
-#else  /* ! HAVE_LISTEN_SHUTDOWN */
-        mhd_assert (MHD_ITC_IS_VALID_ (d->itc));
-#endif /* ! HAVE_LISTEN_SHUTDOWN */
+        /* The ITC and the epoll FD are created when the worker is started */
+        mhd_assert (MHD_ITC_IS_INVALID_ (d->itc));
+#ifdef EPOLL_SUPPORT
+        mhd_assert (-1 == d->epoll_fd);
+#if defined(HTTPS_SUPPORT) && defined(UPGRADE_SUPPORT)
+        mhd_assert (-1 == d->epoll_upgrade_fd);
+#endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
+#endif /* EPOLL_SUPPORT */
 
         /* Divide available connections evenly amongst the threads.
          * Thread indexes in [0, leftover_conns) each get one of the
@@ -8875,17 +11463,6 @@ MHD_start_daemon_va (unsigned int flags,
         d->connection_limit = conns_per_thread;
         if (i < leftover_conns)
           ++d->connection_limit;
-#ifdef EPOLL_SUPPORT
-        if (MHD_D_IS_USING_EPOLL_ (d) &&
-            (MHD_NO == setup_epoll_to_listen (d)) )
-        {
-          if (MHD_ITC_IS_VALID_ (d->itc))
-            MHD_itc_destroy_chk_ (d->itc);
-          MHD_mutex_destroy_chk_ (&d->new_connections_mutex);
-          MHD_mutex_destroy_chk_ (&d->cleanup_connection_mutex);
-          goto thread_failed;
-        }
-#endif
         /* Some members must be used only in master daemon */
 #if defined(MHD_USE_THREADS)
         memset (&d->per_ip_connection_mutex, 0x7F,
@@ -8899,37 +11476,22 @@ MHD_start_daemon_va (unsigned int flags,
         memset (&d->nnc_lock, 0x7F, sizeof(d->nnc_lock));
 #endif /* MHD_USE_THREADS */
 #endif /* DAUTH_SUPPORT */
-
-        /* Spawn the worker thread */
-        if (! MHD_create_named_thread_ (&d->tid,
-                                        "MHD-worker",
-                                        daemon->thread_stack_size,
-                                        &MHD_polling_thread,
-                                        d))
-        {
-#ifdef HAVE_MESSAGES
-#ifdef EAGAIN
-          if (EAGAIN == errno)
-            MHD_DLOG (daemon,
-                      _ ("Failed to create a new pool thread because it would " \
-                         "have exceeded the system limit on the number of " \
-                         "threads or no system resources available.\n"));
-          else
-#endif /* EAGAIN */
-          MHD_DLOG (daemon,
-                    _ ("Failed to create pool thread: %s\n"),
-                    MHD_strerror_ (errno));
-#endif
-          /* Free memory for this worker; cleanup below handles
-           * all previously-created workers. */
-          MHD_mutex_destroy_chk_ (&d->cleanup_connection_mutex);
-          if (MHD_ITC_IS_VALID_ (d->itc))
-            MHD_itc_destroy_chk_ (d->itc);
-          MHD_mutex_destroy_chk_ (&d->new_connections_mutex);
-          MHD_mutex_destroy_chk_ (&d->cleanup_connection_mutex);
-          goto thread_failed;
-        }
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+        d->bauth_cache = NULL;
+        d->bauth_cache_size = 0;
+#if defined(MHD_USE_THREADS)
+        memset (&d->bauth_cache_lock, 0x7F, sizeof(d->bauth_cache_lock));
+#endif /* MHD_USE_THREADS */
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+        memset (&d->drain_lock, 0x7F, sizeof(d->drain_lock));
+        memset (&d->worker_start_lock, 0x7F, sizeof(d->worker_start_lock));
       }
+
+      /* Spawn the first worker thread, the other workers are started
+       * when the load rises. */
+      if (! worker_start_ (daemon->worker_pool))
+        goto thread_failed;
+      daemon->worker_pool_started = 1;
     }
   }
   else
@@ -8965,37 +11527,51 @@ MHD_start_daemon_va (unsigned int flags,
   daemon->https_key_password = NULL;
 #endif /* HTTPS_SUPPORT */
 
+  if (! MHD_D_IS_USING_THREADS_ (daemon))
+    daemon_init_pool_slabs_ (daemon);
+
+  if (MHD_D_IS_USING_WATCH_ (daemon))
+  {
+    watch_daemon_update_sockets_ (daemon);
+    watch_daemon_update_timer_ (daemon);
+  }
+
   return daemon;
 
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
 thread_failed:
-  /* If no worker threads created, then shut down normally. Calling
-     MHD_stop_daemon (as we do below) doesn't work here since it
-     assumes a 0-sized thread pool means we had been in the default
-     MHD_USE_INTERNAL_POLLING_THREAD mode. */
-  if (0 == i)
+  /* No worker threads are running as the first worker thread is started
+     only when all workers are prepared.  Destroy the prepared workers. */
+  while (0 != i)
   {
-    if (MHD_INVALID_SOCKET != listen_fd)
-      MHD_socket_close_chk_ (listen_fd);
-    listen_fd = MHD_INVALID_SOCKET;
-    MHD_mutex_destroy_chk_ (&daemon->per_ip_connection_mutex);
-    if (NULL != daemon->worker_pool)
-      free (daemon->worker_pool);
-    goto free_and_fail;
+    --i;
+    MHD_mutex_destroy_chk_ (&daemon->worker_pool[i].new_connections_mutex);
+    MHD_mutex_destroy_chk_ (&daemon->worker_pool[i].cleanup_connection_mutex);
   }
-
-  /* Shutdown worker threads we've already created. Pretend
-     as though we had fully initialized our daemon, but
-     with a smaller number of threads than had been
-     requested. */
-  daemon->worker_pool_size = i;
-  MHD_stop_daemon (daemon);
-  return NULL;
+  if (MHD_INVALID_SOCKET != listen_fd)
+    MHD_socket_close_chk_ (listen_fd);
+  listen_fd = MHD_INVALID_SOCKET;
+  MHD_mutex_destroy_chk_ (&daemon->per_ip_connection_mutex);
+  if (NULL != daemon->worker_pool)
+    free (daemon->worker_pool);
+  goto free_and_fail;
 #endif
 
 free_and_fail:
   /* clean up basic memory state in 'daemon' and return NULL to
      indicate failure */
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (NULL != daemon->handler_offload)
+  {
+    offload_threads_stop_ (daemon->handler_offload);
+    offload_threads_free_ (daemon->handler_offload);
+  }
+  if (NULL != daemon->file_read_offload)
+  {
+    offload_threads_stop_ (daemon->file_read_offload);
+    offload_threads_free_ (daemon->file_read_offload);
+  }
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
 #ifdef EPOLL_SUPPORT
 #if defined(HTTPS_SUPPORT) && defined(UPGRADE_SUPPORT)
   if (daemon->upgrade_fd_in_epoll)
@@ -9014,6 +11590,7 @@ free_and_fail:
   if (-1 != daemon->epoll_upgrade_fd)
     close (daemon->epoll_upgrade_fd);
 #endif /* HTTPS_SUPPORT && UPGRADE_SUPPORT */
+  free (daemon->epoll_events);
 #endif /* EPOLL_SUPPORT */
 #ifdef DAUTH_SUPPORT
   free (daemon->digest_auth_random_copy);
@@ -9022,6 +11599,16 @@ free_and_fail:
   MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
 #endif
 #endif
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+  free (daemon->bauth_cache);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_destroy_chk_ (&daemon->bauth_cache_lock);
+#endif
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_destroy_chk_ (&daemon->drain_lock);
+  MHD_mutex_destroy_chk_ (&daemon->worker_start_lock);
+#endif
 #ifdef HTTPS_SUPPORT
   if (0 != (*pflags & MHD_USE_TLS))
   {
@@ -9032,8 +11619,11 @@ free_and_fail:
       gnutls_psk_free_server_credentials (daemon->psk_cred);
   }
 #endif /* HTTPS_SUPPORT */
+  MHD_router_destroy_ (daemon->router);
   if (MHD_ITC_IS_VALID_ (daemon->itc))
     MHD_itc_destroy_chk_ (daemon->itc);
+  if (MHD_ITC_IS_VALID_ (daemon->drain_itc))
+    MHD_itc_destroy_chk_ (daemon->drain_itc);
   if (MHD_INVALID_SOCKET != listen_fd)
     (void) MHD_socket_close_ (listen_fd);
   if ((MHD_INVALID_SOCKET != daemon->listen_fd) &&
@@ -9177,7 +11767,14 @@ close_all_connections (struct MHD_Daemon *daemon)
       /* Any connection found here is "upgraded" connection, normal suspended
        * connections are already removed from this list. */
       mhd_assert (NULL != pos->urh);
-      if (! pos->thread_joined)
+      if (MHD_D_IS_REUSING_CONN_THREADS_ (daemon))
+      {
+        /* The reusable thread releases the connection when "upgraded"
+         * processing is finished. */
+        if (! pos->thread_joined)
+          conn_thread_join_connection_ (pos);
+      }
+      else if (! pos->thread_joined)
       {
         /* While "cleanup" list is not manipulated by "upgraded"
          * connection, "cleanup" mutex is required for call of
@@ -9208,7 +11805,16 @@ close_all_connections (struct MHD_Daemon *daemon)
 
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   /* now, collect per-connection threads */
-  if (used_thr_p_c)
+  if (used_thr_p_c && MHD_D_IS_REUSING_CONN_THREADS_ (daemon))
+  {
+    /* Every connection is released by the reusable thread before
+     * the thread is parked or exited. */
+    MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+    conn_threads_join_ (daemon,
+                        true);
+    MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+  }
+  else if (used_thr_p_c)
   {
     pos = daemon->connections_tail;
     while (NULL != pos)
@@ -9255,6 +11861,9 @@ close_all_connections (struct MHD_Daemon *daemon)
     close_connection (pos);
   }
   MHD_cleanup_connections (daemon);
+#ifdef MHD_USE_ZEROCOPY_SEND
+  MHD_send_zc_reap_ (daemon, true);
+#endif /* MHD_USE_ZEROCOPY_SEND */
 }
 
 
@@ -9270,6 +11879,7 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
   MHD_socket fd;
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   unsigned int i;
+  unsigned int started;
 #endif
 
   if (NULL == daemon)
@@ -9287,8 +11897,18 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
   /* Slave daemons must be stopped by master daemon. */
   mhd_assert ( (NULL == daemon->master) || (daemon->shutdown) );
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  /* Finish offloaded handler calls and file reads while connections
+   * can be resumed and responses can be queued.  The stopped offload
+   * threads are freed when all daemon's threads are joined. */
+  if (NULL != daemon->handler_offload)
+    offload_threads_stop_ (daemon->handler_offload);
+  if (NULL != daemon->file_read_offload)
+    offload_threads_stop_ (daemon->file_read_offload);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
   daemon->shutdown = true;
-  if (daemon->was_quiesced)
+  if (daemon->was_quiesced && ! daemon->drain_close_listen)
     fd = MHD_INVALID_SOCKET; /* Do not use FD if daemon was quiesced */
   else
     fd = daemon->listen_fd;
@@ -9299,8 +11919,14 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
     mhd_assert (1 < daemon->worker_pool_size);
     mhd_assert (MHD_D_IS_USING_THREADS_ (daemon));
 
+    /* The workers are not started anymore as the master daemon has
+       the 'shutdown' flag set. */
+    MHD_mutex_lock_chk_ (&daemon->worker_start_lock);
+    started = daemon->worker_pool_started;
+    MHD_mutex_unlock_chk_ (&daemon->worker_start_lock);
+
     /* Let workers shutdown in parallel. */
-    for (i = 0; i < daemon->worker_pool_size; ++i)
+    for (i = 0; i < started; ++i)
     {
       daemon->worker_pool[i].shutdown = true;
       if (MHD_ITC_IS_VALID_ (daemon->worker_pool[i].itc))
@@ -9320,10 +11946,16 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
                        SHUT_RDWR);
     }
 #endif /* HAVE_LISTEN_SHUTDOWN */
-    for (i = 0; i < daemon->worker_pool_size; ++i)
+    for (i = 0; i < started; ++i)
     {
       MHD_stop_daemon (&daemon->worker_pool[i]);
     }
+    for (i = started; i < daemon->worker_pool_size; ++i)
+    { /* The worker thread has never been started */
+      mhd_assert (MHD_ITC_IS_INVALID_ (daemon->worker_pool[i].itc));
+      MHD_mutex_destroy_chk_ (&daemon->worker_pool[i].new_connections_mutex);
+      MHD_mutex_destroy_chk_ (&daemon->worker_pool[i].cleanup_connection_mutex);
+    }
     free (daemon->worker_pool);
     mhd_assert (MHD_ITC_IS_INVALID_ (daemon->itc));
 #ifdef EPOLL_SUPPORT
@@ -9373,6 +12005,8 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
     {
       /* No internal threads are used for polling sockets. */
       close_all_connections (daemon);
+      if (MHD_D_IS_USING_WATCH_ (daemon))
+        watch_daemon_remove_all_ (daemon);
     }
     mhd_assert (NULL == daemon->connections_head);
     mhd_assert (NULL == daemon->cleanup_head);
@@ -9382,10 +12016,23 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
     mhd_assert (NULL == daemon->urh_head);
 #endif /* UPGRADE_SUPPORT && HTTPS_SUPPORT */
 
+    MHD_pool_slabs_destroy (daemon->pool_slabs);
+    daemon->pool_slabs = NULL;
+
     if (MHD_ITC_IS_VALID_ (daemon->itc))
       MHD_itc_destroy_chk_ (daemon->itc);
+    if (MHD_ITC_IS_VALID_ (daemon->drain_itc))
+      MHD_itc_destroy_chk_ (daemon->drain_itc);
+
+#ifdef HAVE_POLL
+    free (daemon->poll_fds);
+    daemon->poll_fds = NULL;
+    daemon->poll_fds_size = 0;
+#endif /* HAVE_POLL */
 
 #ifdef EPOLL_SUPPORT
+    free (daemon->epoll_events);
+    daemon->epoll_events = NULL;
     if (MHD_D_IS_USING_EPOLL_ (daemon) &&
         (-1 != daemon->epoll_fd) )
       MHD_socket_close_chk_ (daemon->epoll_fd);
@@ -9425,6 +12072,7 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
         gnutls_psk_free_server_credentials (daemon->psk_cred);
     }
 #endif /* HTTPS_SUPPORT */
+    MHD_router_destroy_ (daemon->router);
 
 #ifdef DAUTH_SUPPORT
     free (daemon->digest_auth_random_copy);
@@ -9433,7 +12081,19 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
     MHD_mutex_destroy_chk_ (&daemon->nnc_lock);
 #endif
 #endif
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+    free (daemon->bauth_cache);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+    MHD_mutex_destroy_chk_ (&daemon->bauth_cache_lock);
+#endif
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+    MHD_mutex_destroy_chk_ (&daemon->drain_lock);
+    MHD_mutex_destroy_chk_ (&daemon->worker_start_lock);
+    if (NULL != daemon->handler_offload)
+      offload_threads_free_ (daemon->handler_offload);
+    if (NULL != daemon->file_read_offload)
+      offload_threads_free_ (daemon->file_read_offload);
     MHD_mutex_destroy_chk_ (&daemon->per_ip_connection_mutex);
 #endif
     free (daemon);
@@ -9441,6 +12101,68 @@ MHD_stop_daemon (struct MHD_Daemon *daemon)
 }
 
 
+/**
+ * Add the histograms of the connection memory use of the @a src to
+ * the @a dst.
+ *
+ * @param dst the histograms to update
+ * @param src the histograms to add
+ */
+static void
+memory_profile_add_ (struct MHD_MemoryProfile *dst,
+                     const struct MHD_MemoryProfile *src)
+{
+  unsigned int i;
+
+  dst->num_requests += src->num_requests;
+  for (i = 0; i < MHD_MEMORY_PROFILE_BUCKETS; ++i)
+  {
+    dst->read_buffer[i] += src->read_buffer[i];
+    dst->write_buffer[i] += src->write_buffer[i];
+    dst->headers[i] += src->headers[i];
+    dst->app_alloc[i] += src->app_alloc[i];
+    dst->pool[i] += src->pool[i];
+  }
+}
+
+
+/**
+ * Collect the histograms of the connection memory use of the @a daemon
+ * (and of all its workers) to the daemon's info storage.
+ *
+ * @param daemon the master or the single daemon
+ */
+static void
+daemon_collect_memory_profile_ (struct MHD_Daemon *daemon)
+{
+  struct MHD_MemoryProfile *const res = &daemon->daemon_info_memory_profile;
+
+  mhd_assert (NULL == daemon->master);
+  memset (res, 0, sizeof(*res));
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (NULL != daemon->worker_pool)
+  {
+    unsigned int i;
+    for (i = 0; i < daemon->worker_pool_size; i++)
+    {
+      struct MHD_Daemon *const worker = daemon->worker_pool + i;
+      MHD_mutex_lock_chk_ (&worker->cleanup_connection_mutex);
+      memory_profile_add_ (res,
+                           &worker->pool_profile_stats);
+      MHD_mutex_unlock_chk_ (&worker->cleanup_connection_mutex);
+    }
+    return;
+  }
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  memory_profile_add_ (res,
+                       &daemon->pool_profile_stats);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+}
+
+
 /**
  * Obtain information about the given daemon.
  * The returned pointer is invalidated with the next call of this function or
@@ -9509,6 +12231,13 @@ MHD_get_daemon_info (struct MHD_Daemon *daemon,
   case MHD_DAEMON_INFO_BIND_PORT:
     daemon->daemon_info_dummy_port.port = daemon->port;
     return &daemon->daemon_info_dummy_port;
+  case MHD_DAEMON_INFO_MEMORY_PROFILE:
+    if (! daemon->pool_profile)
+      return NULL;
+    daemon_collect_memory_profile_ (daemon);
+    daemon->daemon_info_dummy_memory_profile.memory_profile =
+      &daemon->daemon_info_memory_profile;
+    return &daemon->daemon_info_dummy_memory_profile;
   default:
     return NULL;
   }
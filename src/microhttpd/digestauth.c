@@ -33,6 +33,7 @@
 #include "mhd_limits.h"
 #include "internal.h"
 #include "response.h"
+#include "connection.h"
 #ifdef MHD_MD5_SUPPORT
 #  include "mhd_md5_wrap.h"
 #endif /* MHD_MD5_SUPPORT */
@@ -853,10 +854,17 @@ check_nonce_nc (struct MHD_Connection *connection,
   if (nc >= UINT32_MAX - 64)
     return MHD_CHECK_NONCENC_STALE;  /* Overflow, unrealistically high value */
 
-  nn = &daemon->nnc[get_nonce_nc_idx (mod, nonce, noncelen)];
-
   MHD_mutex_lock_chk_ (&daemon->nnc_lock);
 
+  if (NULL == daemon->nnc)
+  {
+    /* No nonce has been generated yet, while the client's nonce value
+     * should be recorded when it was generated by MHD */
+    MHD_mutex_unlock_chk_ (&daemon->nnc_lock);
+    return MHD_CHECK_NONCENC_WRONG;
+  }
+  nn = &daemon->nnc[get_nonce_nc_idx (mod, nonce, noncelen)];
+
   mhd_assert (0 == nn->nonce[noncelen]); /* The old value must be valid */
 
   if ( (0 != memcmp (nn->nonce, nonce, noncelen)) ||
@@ -1710,6 +1718,9 @@ calculate_add_nonce (struct MHD_Connection *const connection,
   mhd_assert (MAX_DIGEST_NONCE_LENGTH >= nonce_size);
   mhd_assert (0 != nonce_size);
 
+  if (0 != (daemon->dauth_bind_type & MHD_DAUTH_BIND_NONCE_URI_PARAMS))
+    MHD_connection_parse_deferred_ (connection,
+                                    MHD_GET_ARGUMENT_KIND);
   calculate_nonce (timestamp,
                    connection->rq.http_mthd,
                    connection->rq.method,
@@ -1737,11 +1748,26 @@ calculate_add_nonce (struct MHD_Connection *const connection,
   /* Sanity check for values */
   mhd_assert (MAX_DIGEST_NONCE_LENGTH == NONCE_STD_LEN (MAX_DIGEST));
 
+  MHD_mutex_lock_chk_ (&daemon->nnc_lock);
+  if (NULL == daemon->nnc)
+  {
+    /* Allocate the map on the first use to keep the daemon start fast */
+    daemon->nnc = (struct MHD_NonceNc *)
+                  MHD_calloc_ (daemon->nonce_nc_size,
+                               sizeof (struct MHD_NonceNc));
+    if (NULL == daemon->nnc)
+    {
+      MHD_mutex_unlock_chk_ (&daemon->nnc_lock);
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to allocate memory for nonce-nc map.\n"));
+#endif /* HAVE_MESSAGES */
+      return false;
+    }
+  }
   nn = daemon->nnc + get_nonce_nc_idx (daemon->nonce_nc_size,
                                        nonce,
                                        nonce_size);
-
-  MHD_mutex_lock_chk_ (&daemon->nnc_lock);
   if (is_slot_available (nn, timestamp, nonce, nonce_size))
   {
     memcpy (nn->nonce,
@@ -2223,6 +2249,8 @@ check_argument_match (struct MHD_Connection *connection,
   enum MHD_Result ret;
   struct test_header_param param;
 
+  MHD_connection_parse_deferred_ (connection,
+                                  MHD_GET_ARGUMENT_KIND);
   param.connection = connection;
   param.num_headers = 0;
   ret = MHD_parse_arguments_ (connection,
@@ -3012,6 +3040,9 @@ digest_auth_check_all_inner (struct MHD_Connection *connection,
        by MHD. */
     mhd_assert (! da->hashing);
     digest_reset (da);
+    if (0 != (daemon->dauth_bind_type & MHD_DAUTH_BIND_NONCE_URI_PARAMS))
+      MHD_connection_parse_deferred_ (connection,
+                                      MHD_GET_ARGUMENT_KIND);
     calculate_nonce (nonce_time,
                      connection->rq.http_mthd,
                      connection->rq.method,
@@ -242,6 +242,58 @@ enum MHD_ConnectionEventLoopInfo
 } _MHD_FIXED_ENUM;
 
 
+/**
+ * State of the access handler call offloaded to the handler threads.
+ * @see #MHD_OPTION_HANDLER_OFFLOAD_THREADS
+ */
+enum MHD_HandlerOffloadState
+{
+  /**
+   * The handler is not offloaded.
+   */
+  MHD_HANDLER_OFFLOAD_NONE = 0,
+
+  /**
+   * The handler call is waiting in the queue.
+   */
+  MHD_HANDLER_OFFLOAD_QUEUED = 1,
+
+  /**
+   * The handler is being called by the handler thread.
+   */
+  MHD_HANDLER_OFFLOAD_RUNNING = 2,
+
+  /**
+   * The handler call is finished, the result must be processed
+   * by the daemon's thread.
+   */
+  MHD_HANDLER_OFFLOAD_DONE = 3
+} _MHD_FIXED_ENUM;
+
+
+/**
+ * The result of submission of the access handler call to the handler
+ * threads.
+ */
+enum MHD_HandlerOffloadSubmit
+{
+  /**
+   * The call is queued, the connection is suspended.
+   */
+  MHD_HANDLER_OFFLOAD_SUBMITTED = 0,
+
+  /**
+   * The queue is full, the call is not queued.
+   */
+  MHD_HANDLER_OFFLOAD_BUSY = 1,
+
+  /**
+   * The handler threads are being stopped, the call is not queued.
+   */
+  MHD_HANDLER_OFFLOAD_STOPPED = 2
+} _MHD_FIXED_ENUM;
+
+
 /**
  * Additional test value for enum MHD_FLAG to check only for MHD_ALLOW_SUSPEND_RESUME and
  * NOT for MHD_USE_ITC.
@@ -299,6 +351,30 @@ struct MHD_NonceNc
 
 };
 
+#if defined(BAUTH_SUPPORT) && defined(MHD_SHA256_SUPPORT)
+/**
+ * The cache of the verified Basic Authentication credentials is supported
+ */
+#define MHD_BAUTH_CACHE_SUPPORT 1
+
+/**
+ * The entry of the cache of the verified Basic Authentication credentials
+ */
+struct MHD_BAuthCacheEntry
+{
+  /**
+   * The keyed hash of the value of the "Authorization" header
+   */
+  uint8_t hash[MHD_SHA256_DIGEST_SIZE];
+
+  /**
+   * The monotonic time (in milliseconds) when the entry expires,
+   * zero for unused entry
+   */
+  uint64_t expires;
+};
+#endif /* BAUTH_SUPPORT && MHD_SHA256_SUPPORT */
+
 #ifdef HAVE_MESSAGES
 /**
  * fprintf()-like helper function for logging debug
@@ -591,6 +667,45 @@ struct MHD_Response
    * Number of elements in data_iov.
    */
   unsigned int data_iovcnt;
+
+  /**
+   * The segments of the response body, used with
+   * MHD_create_response_from_segments(), NULL for other responses.
+   * Zero-sized segments are not included.
+   */
+  struct MHD_ResponseSegment *data_segs;
+
+  /**
+   * Number of elements in data_segs.
+   */
+  unsigned int data_segs_cnt;
+
+  /**
+   * The application's callback to clean up the segments data.
+   */
+  MHD_ContentReaderFreeCallback segs_free_cb;
+
+  /**
+   * The closure for @e segs_free_cb.
+   */
+  void *segs_free_cls;
+
+  /**
+   * The application's callback returning the borrowed response data,
+   * used with MHD_create_response_from_borrow_callback(), NULL for
+   * other responses.
+   */
+  MHD_ContentBorrowCallback bcb;
+
+  /**
+   * The closure for @e bcb and @e bcb_free.
+   */
+  void *bcb_cls;
+
+  /**
+   * The application's callback to clean up @e bcb_cls.
+   */
+  MHD_ContentReaderFreeCallback bcb_free;
 };
 
 
@@ -1061,6 +1176,33 @@ union MHD_StartOrSize
   size_t size;
 };
 
+/**
+ * The high-water marks of the connection memory use by the request.
+ * Used only when the memory profiling is enabled.
+ */
+struct MHD_RequestMemProfile
+{
+  /**
+   * The largest amount of data held in the read buffer
+   */
+  size_t read_buffer;
+
+  /**
+   * The largest amount of data held in the write buffer
+   */
+  size_t write_buffer;
+
+  /**
+   * The memory allocated before the first call of the access handler
+   */
+  size_t headers;
+
+  /**
+   * The memory allocated after the first call of the access handler
+   */
+  size_t app_alloc;
+};
+
 /**
  * Request-specific values.
  *
@@ -1115,6 +1257,42 @@ struct MHD_Request
    */
   struct MHD_HTTP_Req_Header *headers_received_tail;
 
+  /**
+   * The GET arguments string (after '?' in the request target),
+   * which is not parsed yet.
+   * The arguments are parsed on the first access.
+   * NULL if arguments have been parsed or the request has no arguments.
+   */
+  char *args_deferred;
+
+  /**
+   * Set to 'true' if the pool had no space for the arguments parsed on
+   * the first access.
+   * The error is replied when the access handler returns.
+   */
+  bool args_no_space;
+
+#ifdef COOKIE_SUPPORT
+  /**
+   * Set to 'true' if the "Cookie:" header is not parsed yet.
+   * The cookies are parsed on the first access.
+   */
+  bool cookies_deferred;
+
+  /**
+   * Set to 'true' if the pool had no space for the cookies parsed on
+   * the first access.
+   * The error is replied when the access handler returns.
+   */
+  bool cookies_no_space;
+
+  /**
+   * The element of @a headers_received after which the parsed cookies
+   * must be inserted.
+   */
+  struct MHD_HTTP_Req_Header *cookies_pos;
+#endif /* COOKIE_SUPPORT */
+
   /**
    * Number of bytes we had in the HTTP header, set once we
    * pass #MHD_CONNECTION_HEADERS_RECEIVED.
@@ -1191,6 +1369,28 @@ struct MHD_Request
    */
   void *client_context;
 
+  /**
+   * The access handler for this request.
+   * The handler of the matched route or the default handler.
+   */
+  MHD_AccessHandlerCallback handler;
+
+  /**
+   * Closure argument to @e handler.
+   */
+  void *handler_cls;
+
+  /**
+   * The path parameters captured by the router.
+   * Allocated in the connection's pool.
+   */
+  const struct MHD_RouteParam *route_params;
+
+  /**
+   * The number of elements in @e route_params.
+   */
+  size_t num_route_params;
+
   /**
    * Did we ever call the "default_handler" on this request?
    * This flag determines if we have called the #MHD_OPTION_NOTIFY_COMPLETED
@@ -1239,6 +1439,12 @@ struct MHD_Request
    * The data of the request line / request headers processing
    */
   union MHD_HeadersProcessing hdrs;
+
+  /**
+   * The memory use of the request, used only when the memory profiling
+   * is enabled
+   */
+  struct MHD_RequestMemProfile mem_profile;
 };
 
 
@@ -1302,10 +1508,76 @@ struct MHD_Reply
    */
   struct MHD_iovec_track_ resp_iov;
 
+  /**
+   * The iovec elements of the current chunk: the chunk header (in the
+   * write buffer), the chunk payload (in the response's memory) and the
+   * chunk's terminating CRLF.
+   * Used for chunked replies with the response data in memory and for
+   * the data borrowed from the application (the single element is used
+   * for non-chunked replies).
+   */
+  MHD_iovec_ chunk_iov_buf[3];
+
+  /**
+   * The tracking of the @a chunk_iov_buf send.
+   * The @a cnt member is zero if the chunk is in the write buffer.
+   */
+  struct MHD_iovec_track_ chunk_iov;
+
+  /**
+   * The function to release the data borrowed from the application
+   * by the response's borrow callback, NULL if no data is borrowed.
+   */
+  MHD_ContentReaderFreeCallback borrow_release;
+
+  /**
+   * The argument for @a borrow_release.
+   */
+  void *borrow_release_cls;
+
 #if defined(_MHD_HAVE_SENDFILE)
   enum MHD_resp_sender_ resp_sender;
 #endif /* _MHD_HAVE_SENDFILE */
 
+  /**
+   * Set to 'true' if the response's content reader is called without
+   * the response's lock and the data is read into the connection's
+   * write buffer instead of the shared response's buffer.
+   * @see #MHD_RF_CONTENT_READER_THREAD_SAFE
+   */
+  bool crc_unlocked;
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  /**
+   * Set to 'true' if the response data is read by the file read threads
+   * into the connection's write buffer.
+   * @see #MHD_OPTION_FILE_READ_THREADS
+   */
+  bool fr_offload;
+
+  /**
+   * Set to 'true' by the file read thread when the read is finished
+   * and @a fr_result is valid.
+   */
+  bool fr_done;
+
+  /**
+   * The buffer for the data being read by the file read thread.
+   */
+  char *fr_buf;
+
+  /**
+   * The size of the @a fr_buf.
+   */
+  size_t fr_size;
+
+  /**
+   * The value returned by the response's content reader called
+   * by the file read thread.
+   */
+  ssize_t fr_result;
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
   /**
    * Reply-specific properties
    */
@@ -1317,28 +1589,99 @@ struct MHD_Reply
  */
 struct MHD_Connection
 {
+  /* The members used by the event loop for every connection on every
+     pass are placed first to keep them in the first cache lines.
+     Do not put rarely used members before @a keepalive. */
 
-#ifdef EPOLL_SUPPORT
   /**
-   * Next pointer for the EDLL listing connections that are epoll-ready.
+   * Next pointer for the DLL describing our IO state.
    */
-  struct MHD_Connection *nextE;
+  struct MHD_Connection *next;
 
   /**
-   * Previous pointer for the EDLL listing connections that are epoll-ready.
+   * Previous pointer for the DLL describing our IO state.
    */
-  struct MHD_Connection *prevE;
+  struct MHD_Connection *prev;
+
+  /**
+   * Socket for this connection.  Set to #MHD_INVALID_SOCKET if
+   * this connection has died (daemon should clean
+   * up in that case).
+   */
+  MHD_socket socket_fd;
+
+  /**
+   * What is this connection waiting for?
+   */
+  enum MHD_ConnectionEventLoopInfo event_loop_info;
+
+  /**
+   * State in the FSM for this connection.
+   */
+  enum MHD_CONNECTION_STATE state;
+
+#ifdef EPOLL_SUPPORT
+  /**
+   * What is the state of this socket in relation to epoll?
+   */
+  enum MHD_EpollState epoll_state;
 #endif
 
   /**
-   * Next pointer for the DLL describing our IO state.
+   * Is the connection suspended?
    */
-  struct MHD_Connection *next;
+  bool suspended;
 
   /**
-   * Previous pointer for the DLL describing our IO state.
+   * Is the connection wanting to resume?
    */
-  struct MHD_Connection *prev;
+  volatile bool resuming;
+
+  /**
+   * Are we currently inside the "idle" handler (to avoid recursively
+   * invoking it).
+   */
+  bool in_idle;
+
+  /**
+   * Connection is in the cleanup DL-linked list.
+   */
+  bool in_cleanup;
+
+  /**
+   * Has this socket been closed for reading (i.e.  other side closed
+   * the connection)?  If so, we must completely close the connection
+   * once we are done sending our response (and stop trying to read
+   * from this socket).
+   */
+  bool read_closed;
+
+  /**
+   * Some error happens during processing the connection therefore this
+   * connection must be closed.
+   * The error may come from the client side (like wrong request format),
+   * from the application side (like data callback returned error), or from
+   * the OS side (like out-of-memory).
+   */
+  bool stop_with_error;
+
+  /**
+   * The connection is closed by draining and its socket must be given
+   * to the application instead of closing.
+   */
+  bool drain_handoff;
+
+#ifdef EPOLL_SUPPORT
+  /**
+   * Next pointer for the EDLL listing connections that are epoll-ready.
+   */
+  struct MHD_Connection *nextE;
+
+  /**
+   * Previous pointer for the EDLL listing connections that are epoll-ready.
+   */
+  struct MHD_Connection *prevE;
+#endif
 
   /**
    * Next pointer for the XDLL organizing connections by timeout.
@@ -1360,14 +1703,17 @@ struct MHD_Connection
   struct MHD_Daemon *daemon;
 
   /**
-   * Request-specific data
+   * Last time this connection had any activity
+   * (reading or writing).
    */
-  struct MHD_Request rq;
+  uint64_t last_activity;
 
   /**
-   * Reply-specific data
+   * After how many milliseconds of inactivity should
+   * this connection time out?
+   * Zero for no timeout.
    */
-  struct MHD_Reply rp;
+  uint64_t connection_timeout_ms;
 
   /**
    * The memory pool is created whenever we first read from the TCP
@@ -1379,22 +1725,6 @@ struct MHD_Connection
    */
   struct MemoryPool *pool;
 
-  /**
-   * We allow the main application to associate some pointer with the
-   * TCP connection (which may span multiple HTTP requests).  Here is
-   * where we store it.  (MHD does not know or care what it is).
-   * The location is given to the #MHD_NotifyConnectionCallback and
-   * also accessible via #MHD_CONNECTION_INFO_SOCKET_CONTEXT.
-   */
-  void *socket_context;
-
-  /**
-   * Close connection after sending response?
-   * Functions may change value from "Unknown" or "KeepAlive" to "Must close",
-   * but no functions reset value "Must Close" to any other value.
-   */
-  enum MHD_ConnKeepAlive keepalive;
-
   /**
    * Buffer for reading requests.  Allocated in pool.  Actually one
    * byte larger than @e read_buffer_size (if non-NULL) to allow for
@@ -1408,20 +1738,6 @@ struct MHD_Connection
    */
   char *write_buffer;
 
-  /**
-   * Foreign address (of length @e addr_len).  MALLOCED (not
-   * in pool!).
-   */
-  struct sockaddr_storage *addr;
-
-#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
-  /**
-   * Thread handle for this connection (if we are using
-   * one thread per connection).
-   */
-  MHD_thread_handle_ID_ tid;
-#endif
-
   /**
    * Size of @e read_buffer (in bytes).
    * This value indicates how many bytes we're willing to read
@@ -1452,35 +1768,82 @@ struct MHD_Connection
   size_t write_buffer_append_offset;
 
   /**
-   * Position in the 100 CONTINUE message that
-   * we need to send when receiving http 1.1 requests.
+   * Function used for reading HTTP request stream.
    */
-  size_t continue_message_write_offset;
+  ReceiveCallback recv_cls;
 
   /**
-   * Length of the foreign address.
+   * Close connection after sending response?
+   * Functions may change value from "Unknown" or "KeepAlive" to "Must close",
+   * but no functions reset value "Must Close" to any other value.
    */
-  socklen_t addr_len;
+  enum MHD_ConnKeepAlive keepalive;
+
+  /* The members below are used less frequently */
 
   /**
-   * Last time this connection had any activity
-   * (reading or writing).
+   * Next pointer for the WDLL listing connections that need processing
+   * without any network activity.
+   * Used only with #MHD_OPTION_WATCH_SOCKET_CALLBACK.
    */
-  uint64_t last_activity;
+  struct MHD_Connection *nextW;
 
   /**
-   * After how many milliseconds of inactivity should
-   * this connection time out?
-   * Zero for no timeout.
+   * Previous pointer for the WDLL listing connections that need processing
+   * without any network activity.
+   * Used only with #MHD_OPTION_WATCH_SOCKET_CALLBACK.
    */
-  uint64_t connection_timeout_ms;
+  struct MHD_Connection *prevW;
 
   /**
-   * Socket for this connection.  Set to #MHD_INVALID_SOCKET if
-   * this connection has died (daemon should clean
-   * up in that case).
+   * We allow the main application to associate some pointer with the
+   * TCP connection (which may span multiple HTTP requests).  Here is
+   * where we store it.  (MHD does not know or care what it is).
+   * The location is given to the #MHD_NotifyConnectionCallback and
+   * also accessible via #MHD_CONNECTION_INFO_SOCKET_CONTEXT.
    */
-  MHD_socket socket_fd;
+  void *socket_context;
+
+  /**
+   * Response queued early, before the request is fully processed,
+   * the client upload is rejected.
+   * The connection cannot be reused for additional requests as the current
+   * request is incompletely read and it is unclear where is the initial
+   * byte of the next request.
+   */
+  bool discard_request;
+
+  /**
+   * Are we currently in the #MHD_AccessHandlerCallback
+   * for this connection (and thus eligible to receive
+   * calls to #MHD_queue_response()?).
+   */
+  bool in_access_handler;
+
+  /**
+   * Foreign address (of length @e addr_len).  MALLOCED (not
+   * in pool!).
+   */
+  struct sockaddr_storage *addr;
+
+  /**
+   * Length of the foreign address.
+   */
+  socklen_t addr_len;
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  /**
+   * Thread handle for this connection (if we are using
+   * one thread per connection).
+   */
+  MHD_thread_handle_ID_ tid;
+#endif
+
+  /**
+   * Position in the 100 CONTINUE message that
+   * we need to send when receiving http 1.1 requests.
+   */
+  size_t continue_message_write_offset;
 
   /**
    * true if @e socket_fd is not TCP/IP (a UNIX domain socket, a pipe),
@@ -1508,71 +1871,90 @@ struct MHD_Connection
    */
   enum MHD_tristate sk_nodelay;
 
+#ifdef MHD_USE_ZEROCOPY_SEND
   /**
-   * Has this socket been closed for reading (i.e.  other side closed
-   * the connection)?  If so, we must completely close the connection
-   * once we are done sending our response (and stop trying to read
-   * from this socket).
+   * The response held until the kernel reports completion of all
+   * zero-copy sends of its data, NULL if no zero-copy sends are pending.
    */
-  bool read_closed;
+  struct MHD_Response *zc_response;
 
   /**
-   * Some error happens during processing the connection therefore this
-   * connection must be closed.
-   * The error may come from the client side (like wrong request format),
-   * from the application side (like data callback returned error), or from
-   * the OS side (like out-of-memory).
+   * The number of zero-copy sends performed on the socket.
+   * Wraps around like the kernel's notification counter.
    */
-  bool stop_with_error;
+  uint32_t zc_sent;
 
   /**
-   * Response queued early, before the request is fully processed,
-   * the client upload is rejected.
-   * The connection cannot be reused for additional requests as the current
-   * request is incompletely read and it is unclear where is the initial
-   * byte of the next request.
+   * The number of zero-copy sends reported as completed by the kernel.
    */
-  bool discard_request;
+  uint32_t zc_done;
+
+  /**
+   * Tracks SO_ZEROCOPY of the connection socket.
+   */
+  enum MHD_tristate sk_zerocopy;
+
+  /**
+   * Set to true when the current body send is performed in the
+   * zero-copy mode.
+   */
+  bool zc_send;
+#endif /* MHD_USE_ZEROCOPY_SEND */
 
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   /**
    * Set to `true` if the thread has been joined.
    */
   bool thread_joined;
-#endif
 
   /**
-   * Are we currently inside the "idle" handler (to avoid recursively
-   * invoking it).
+   * Next connection in the queue of the offloaded handler calls or
+   * of the offloaded file reads.
    */
-  bool in_idle;
+  struct MHD_Connection *nextO;
 
   /**
-   * Connection is in the cleanup DL-linked list.
+   * The state of the offloaded access handler call.
+   * Protected by daemon's "cleanup_connection_mutex".
    */
-  bool in_cleanup;
+  enum MHD_HandlerOffloadState offload_state;
 
-#ifdef EPOLL_SUPPORT
   /**
-   * What is the state of this socket in relation to epoll?
+   * The value returned by the offloaded access handler.
    */
-  enum MHD_EpollState epoll_state;
+  enum MHD_Result offload_result;
+
+  /**
+   * Set to `true` if the application suspended the connection in the
+   * offloaded access handler and has not resumed it yet.
+   * Protected by daemon's "cleanup_connection_mutex".
+   */
+  bool offload_app_suspended;
 #endif
 
   /**
-   * State in the FSM for this connection.
+   * The application's context for the socket, as set by
+   * the #MHD_WatchSocketCallback.
    */
-  enum MHD_CONNECTION_STATE state;
+  void *watch_app_ctx;
 
   /**
-   * What is this connection waiting for?
+   * The network events last reported to the application by
+   * the #MHD_WatchSocketCallback.
    */
-  enum MHD_ConnectionEventLoopInfo event_loop_info;
+  enum MHD_WatchEvents watch_interest;
 
   /**
-   * Function used for reading HTTP request stream.
+   * 'true' if the socket has been reported to the application by
+   * the #MHD_WatchSocketCallback and not yet removed.
    */
-  ReceiveCallback recv_cls;
+  bool watch_registered;
+
+  /**
+   * 'true' if the connection is in the WDLL of connections that need
+   * processing without any network activity.
+   */
+  bool watch_pending;
 
 #ifdef UPGRADE_SUPPORT
   /**
@@ -1604,21 +1986,14 @@ struct MHD_Connection
 #endif /* HTTPS_SUPPORT */
 
   /**
-   * Is the connection suspended?
-   */
-  bool suspended;
-
-  /**
-   * Are we currently in the #MHD_AccessHandlerCallback
-   * for this connection (and thus eligible to receive
-   * calls to #MHD_queue_response()?).
+   * Request-specific data
    */
-  bool in_access_handler;
+  struct MHD_Request rq;
 
   /**
-   * Is the connection wanting to resume?
+   * Reply-specific data
    */
-  volatile bool resuming;
+  struct MHD_Reply rp;
 
   /**
    * Special member to be returned by #MHD_get_connection_info()
@@ -1851,6 +2226,206 @@ typedef size_t
                     char *uri);
 
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+/**
+ * Reusable connection thread, used when #MHD_USE_THREAD_PER_CONNECTION
+ * is combined with #MHD_OPTION_THREAD_REUSE_MAX_IDLE.
+ * When connection is finished the thread is parked and waits for
+ * the next connection instead of exiting.
+ */
+struct MHD_ConnectionThread
+{
+  /**
+   * Next thread in the list of all reusable threads of the daemon.
+   */
+  struct MHD_ConnectionThread *next;
+
+  /**
+   * Previous thread in the list of all reusable threads of the daemon.
+   */
+  struct MHD_ConnectionThread *prev;
+
+  /**
+   * Next thread in the list of the parked threads.
+   */
+  struct MHD_ConnectionThread *nextX;
+
+  /**
+   * Previous thread in the list of the parked threads.
+   */
+  struct MHD_ConnectionThread *prevX;
+
+  /**
+   * The daemon this thread belongs to.
+   */
+  struct MHD_Daemon *daemon;
+
+  /**
+   * The connection assigned to this thread, NULL if thread is parked.
+   * Protected by daemon's "cleanup_connection_mutex".
+   */
+  struct MHD_Connection *connection;
+
+  /**
+   * The thread handle.
+   */
+  MHD_thread_handle_ID_ tid;
+
+  /**
+   * Inter-thread communication channel used to wake up parked thread.
+   */
+  struct MHD_itc_ itc;
+
+  /**
+   * Set to 'true' when thread is going to exit and must be joined.
+   * Protected by daemon's "cleanup_connection_mutex".
+   */
+  bool exited;
+};
+
+
+/**
+ * The thread calling the offloaded access handlers.
+ */
+struct MHD_HandlerOffloadThread
+{
+  /**
+   * Next thread in the list of the idle threads.
+   */
+  struct MHD_HandlerOffloadThread *nextX;
+
+  /**
+   * Previous thread in the list of the idle threads.
+   */
+  struct MHD_HandlerOffloadThread *prevX;
+
+  /**
+   * The handler threads set this thread belongs to.
+   */
+  struct MHD_HandlerOffload *offload;
+
+  /**
+   * The thread handle.
+   */
+  MHD_thread_handle_ID_ tid;
+
+  /**
+   * Inter-thread communication channel used to wake up idle thread.
+   */
+  struct MHD_itc_ itc;
+
+  /**
+   * Set to 'true' if the thread is in the list of the idle threads.
+   */
+  bool idle;
+};
+
+
+/**
+ * The set of the threads processing the connections offloaded from
+ * the daemon's threads and the queue of the pending connections.
+ * @see #MHD_OPTION_HANDLER_OFFLOAD_THREADS
+ * @see #MHD_OPTION_FILE_READ_THREADS
+ */
+struct MHD_HandlerOffload
+{
+  /**
+   * Mutex for access to the queue and to the list of the idle threads.
+   */
+  MHD_mutex_ mutex;
+
+  /**
+   * The function called by the threads for each connection taken
+   * from the queue.
+   */
+  void (*call)(struct MHD_Connection *connection);
+
+  /**
+   * The first connection in the queue.
+   */
+  struct MHD_Connection *queue_head;
+
+  /**
+   * The last connection in the queue.
+   */
+  struct MHD_Connection *queue_tail;
+
+  /**
+   * The number of connections in the queue, including the connections
+   * being added to the queue.
+   */
+  unsigned int queue_len;
+
+  /**
+   * The maximum number of connections in the queue, zero for no limit.
+   */
+  unsigned int queue_limit;
+
+  /**
+   * The head of the list of the idle threads.
+   */
+  struct MHD_HandlerOffloadThread *idle_head;
+
+  /**
+   * The tail of the list of the idle threads.
+   */
+  struct MHD_HandlerOffloadThread *idle_tail;
+
+  /**
+   * The array of the threads.
+   */
+  struct MHD_HandlerOffloadThread *threads;
+
+  /**
+   * The number of the started threads.
+   */
+  unsigned int num_threads;
+
+  /**
+   * Set to 'true' when the threads are being stopped.
+   */
+  bool stopping;
+};
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
+
+#ifdef MHD_USE_ZEROCOPY_SEND
+/**
+ * The response data of the closed connection still used by the kernel
+ * for the zero-copy sends.
+ * The socket is kept open until the kernel reports completion of all
+ * zero-copy sends, the notifications are lost when the socket is closed.
+ */
+struct MHD_ZcPending
+{
+  /**
+   * The next entry in the list.
+   */
+  struct MHD_ZcPending *next;
+
+  /**
+   * The response used by the zero-copy sends.
+   */
+  struct MHD_Response *response;
+
+  /**
+   * The duplicate of the socket of the closed connection.
+   */
+  MHD_socket socket_fd;
+
+  /**
+   * The number of zero-copy sends performed on the socket.
+   */
+  uint32_t zc_sent;
+
+  /**
+   * The number of zero-copy sends reported as completed by the kernel.
+   */
+  uint32_t zc_done;
+};
+#endif /* MHD_USE_ZEROCOPY_SEND */
+
+
 /**
  * State kept for each MHD daemon.  All connections are kept in two
  * doubly-linked lists.  The first one reflects the state of the
@@ -1936,18 +2511,57 @@ struct MHD_Daemon
   struct MHD_Connection *eready_tail;
 
   /**
-   * File descriptor associated with our epoll loop.
-   *
-   * @remark Keep this member after pointer value to keep it
-   * properly aligned as it will be used as member of union MHD_DaemonInfo.
+   * File descriptor associated with our epoll loop.
+   *
+   * @remark Keep this member after pointer value to keep it
+   * properly aligned as it will be used as member of union MHD_DaemonInfo.
+   */
+  int epoll_fd;
+
+  /**
+   * true if the @e listen_fd socket is in the 'epoll' set,
+   * false if not.
+   */
+  bool listen_socket_in_epoll;
+
+  /**
+   * The number of epoll_ctl() calls made for the connections sockets
+   * in the @e epoll_fd set.
+   * Used for testing and debugging only.
+   */
+  size_t epoll_ctl_conn_calls;
+
+  /**
+   * The busy polling time in microseconds for the epoll event loop.
+   * Zero if busy polling is not used.
+   */
+  unsigned int epoll_busy_poll_usec;
+
+  /**
+   * The number of the busy polling rounds that have got the events
+   * before the end of the busy polling time.
+   * Used for testing and debugging only.
+   */
+  size_t epoll_busy_poll_hits;
+
+  /**
+   * The number of the busy polling rounds that have got no events
+   * and fallen back to the blocking wait.
+   * Used for testing and debugging only.
+   */
+  size_t epoll_busy_poll_misses;
+
+  /**
+   * The array of the events used by MHD_epoll().
+   * Allocated when the epoll FD is set up, kept until the daemon is
+   * stopped.  Used only by the thread that polls the daemon's sockets.
    */
-  int epoll_fd;
+  struct epoll_event *epoll_events;
 
   /**
-   * true if the @e listen_fd socket is in the 'epoll' set,
-   * false if not.
+   * The number of elements in the @e epoll_events array.
    */
-  bool listen_socket_in_epoll;
+  unsigned int epoll_events_size;
 
 #ifdef UPGRADE_SUPPORT
 #ifdef HTTPS_SUPPORT
@@ -2061,6 +2675,18 @@ struct MHD_Daemon
    */
   void *uri_log_callback_cls;
 
+  /**
+   * The routes specified by #MHD_OPTION_ROUTES.
+   * Used only during the daemon start.
+   */
+  const struct MHD_Route *routes;
+
+  /**
+   * The compiled routes, NULL if routing is not used.
+   * Used only by the master daemon.
+   */
+  struct MHD_Router *router;
+
   /**
    * Function to call when we unescape escape sequences.
    */
@@ -2140,6 +2766,44 @@ struct MHD_Daemon
    */
   size_t pool_increment;
 
+  /**
+   * The size of the memory slabs for the per-connection memory pools,
+   * zero if the pools are allocated separately.
+   */
+  size_t pool_slab_size;
+
+  /**
+   * The huge pages mode for the memory slabs.
+   */
+  enum MHD_HugePagesMode pool_huge_pages;
+
+  /**
+   * The memory slabs for the memory pools of the connections processed
+   * by this daemon, NULL if not used.
+   * Each worker daemon has its own slabs.
+   */
+  struct MHD_PoolSlabs *pool_slabs;
+
+  /**
+   * If set to 'true', the histograms of the connection memory use
+   * are collected.
+   */
+  bool pool_profile;
+
+  /**
+   * If set to 'true', every connection memory pool is followed by
+   * the guard page.
+   */
+  bool pool_guard_pages;
+
+  /**
+   * The histograms of the connection memory use of the requests
+   * processed by this daemon.
+   * Each worker daemon has its own histograms, protected by
+   * @a cleanup_connection_mutex.
+   */
+  struct MHD_MemoryProfile pool_profile_stats;
+
 #if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
   /**
    * Size of threads created by MHD.
@@ -2151,6 +2815,21 @@ struct MHD_Daemon
    */
   unsigned int worker_pool_size;
 
+  /**
+   * Number of worker daemons with the started threads.
+   * The workers are started in the order of the pool, the next worker is
+   * started when the last started worker gets a connection.
+   * Used only by the master daemon, protected by @a worker_start_lock.
+   */
+  unsigned int worker_pool_started;
+
+  /**
+   * The mutex to serialise the start of the worker threads with
+   * the daemon stop and quiesce.
+   * Used only by the master daemon.
+   */
+  MHD_mutex_ worker_start_lock;
+
   /**
    * The select thread handle (if we have internal select)
    */
@@ -2171,6 +2850,89 @@ struct MHD_Daemon
    * Mutex for any access to the "new connections" DL-list.
    */
   MHD_mutex_ new_connections_mutex;
+
+  /**
+   * Head of the list of all reusable connection threads.
+   * Protected by "cleanup_connection_mutex".
+   */
+  struct MHD_ConnectionThread *conn_threads_head;
+
+  /**
+   * Tail of the list of all reusable connection threads.
+   * Protected by "cleanup_connection_mutex".
+   */
+  struct MHD_ConnectionThread *conn_threads_tail;
+
+  /**
+   * Head of the list of the parked connection threads.
+   * Protected by "cleanup_connection_mutex".
+   */
+  struct MHD_ConnectionThread *conn_threads_idle_head;
+
+  /**
+   * Tail of the list of the parked connection threads.
+   * Protected by "cleanup_connection_mutex".
+   */
+  struct MHD_ConnectionThread *conn_threads_idle_tail;
+
+  /**
+   * The maximum number of the parked connection threads.
+   * Zero if connection threads are not reused.
+   */
+  unsigned int conn_threads_idle_max;
+
+  /**
+   * The number of the parked connection threads which are not
+   * terminated when idle timeout expires.
+   */
+  unsigned int conn_threads_idle_min;
+
+  /**
+   * The idle timeout of the parked connection threads (in seconds),
+   * zero if parked threads are never terminated.
+   */
+  unsigned int conn_threads_idle_timeout;
+
+  /**
+   * The current number of the parked connection threads.
+   * Protected by "cleanup_connection_mutex".
+   */
+  unsigned int conn_threads_idle_num;
+
+  /**
+   * The number of the exited connection threads which must be joined.
+   * Protected by "cleanup_connection_mutex".
+   */
+  unsigned int conn_threads_exited;
+
+  /**
+   * The number of the threads calling the offloaded access handlers,
+   * zero if access handler is called by the daemon's thread.
+   */
+  unsigned int handler_offload_threads;
+
+  /**
+   * The maximum number of the queued access handler calls.
+   */
+  unsigned int handler_offload_queue_limit;
+
+  /**
+   * The threads calling the offloaded access handlers.
+   * Used only by the master daemon.
+   */
+  struct MHD_HandlerOffload *handler_offload;
+
+  /**
+   * The number of the threads reading the file data for the responses,
+   * zero if the data is read by the daemon's thread.
+   */
+  unsigned int file_read_threads;
+
+  /**
+   * The threads reading the file data for the responses.
+   * Used only by the master daemon.
+   */
+  struct MHD_HandlerOffload *file_read_offload;
 #endif
 
   /**
@@ -2209,6 +2971,64 @@ struct MHD_Daemon
    */
   volatile bool was_quiesced;
 
+  /**
+   * Is the daemon draining the connections after #MHD_drain_daemon()?
+   * Set together with @e drain_deadline under @e cleanup_connection_mutex
+   * (except the master daemon of the thread pool).
+   */
+  volatile bool draining;
+
+  /**
+   * Set to true if the listen socket has been removed by
+   * #MHD_drain_daemon(), but must be closed by #MHD_stop_daemon().
+   * Used only by the master daemon.
+   */
+  bool drain_close_listen;
+
+  /**
+   * The monotonic time (in milliseconds) when the connections not
+   * closed by draining are closed forcibly.
+   * Must be read by #MHD_get_drain_deadline_().
+   */
+  uint64_t drain_deadline;
+
+  /**
+   * The inter-thread communication channel to wake up the connection
+   * threads when draining is started.
+   * Activated once by #MHD_drain_daemon() and never cleared, so the
+   * connection threads cannot miss the signal.
+   * Used only with #MHD_USE_THREAD_PER_CONNECTION and #MHD_USE_ITC.
+   */
+  struct MHD_itc_ drain_itc;
+
+  /**
+   * The callback to report the draining progress.
+   */
+  MHD_DrainCallback drain_cb;
+
+  /**
+   * The closure for @a drain_cb.
+   */
+  void *drain_cb_cls;
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  /**
+   * The mutex to serialise the calls of @a drain_cb.
+   * Used only by the master daemon.
+   */
+  MHD_mutex_ drain_lock;
+#endif
+
+  /**
+   * The callback to take over the idle connections while draining.
+   */
+  MHD_HandoffCallback drain_handoff_cb;
+
+  /**
+   * The closure for @a drain_handoff_cb.
+   */
+  void *drain_handoff_cb_cls;
+
   /**
    * Did we hit some system or process-wide resource limit while
    * trying to accept() the last time? If so, we don't accept new
@@ -2240,6 +3060,97 @@ struct MHD_Daemon
    */
   bool data_already_pending;
 
+  /**
+   * The function to call when the set of the watched sockets or the
+   * interest for any watched socket is changed.
+   * If not NULL, the sockets are watched by the application.
+   * @see #MHD_OPTION_WATCH_SOCKET_CALLBACK
+   */
+  MHD_WatchSocketCallback watch_socket_cb;
+
+  /**
+   * The closure for @e watch_socket_cb.
+   */
+  void *watch_socket_cb_cls;
+
+  /**
+   * The function to call when the time of the next required processing
+   * is changed.
+   * @see #MHD_OPTION_WATCH_TIMER_CALLBACK
+   */
+  MHD_WatchTimerCallback watch_timer_cb;
+
+  /**
+   * The closure for @e watch_timer_cb.
+   */
+  void *watch_timer_cb_cls;
+
+  /**
+   * Head of WDLL of connections that need processing without any network
+   * activity (when the sockets are watched by the application).
+   */
+  struct MHD_Connection *watch_pending_head;
+
+  /**
+   * Tail of WDLL of connections that need processing without any network
+   * activity (when the sockets are watched by the application).
+   */
+  struct MHD_Connection *watch_pending_tail;
+
+  /**
+   * The application's context for the listen socket.
+   */
+  void *watch_listen_app_ctx;
+
+  /**
+   * The application's context for the ITC.
+   */
+  void *watch_itc_app_ctx;
+
+  /**
+   * The last reported (absolute) time of the timer, valid only if
+   * @e watch_timer_set is 'true'.
+   */
+  uint64_t watch_timer_deadline;
+
+  /**
+   * The interest for the listen socket last reported to the application.
+   */
+  enum MHD_WatchEvents watch_listen_interest;
+
+  /**
+   * 'true' if the listen socket has been reported to the application and
+   * not yet removed.
+   */
+  bool watch_listen_registered;
+
+  /**
+   * 'true' if the ITC has been reported to the application and
+   * not yet removed.
+   */
+  bool watch_itc_registered;
+
+  /**
+   * 'true' if the timer has been set by the application and has not
+   * fired yet.
+   */
+  bool watch_timer_set;
+
+#ifdef HAVE_POLL
+  /**
+   * The array of 'pollfd' structures used by MHD_poll_all().
+   * Kept between iterations of the poll() loop and grown on demand to
+   * avoid allocation of a new array on each iteration.
+   * Used only by the thread that polls the daemon's sockets.
+   */
+  struct pollfd *poll_fds;
+
+  /**
+   * The number of elements allocated in the @e poll_fds array.
+   */
+  size_t poll_fds_size;
+#endif /* HAVE_POLL */
+
   /**
    * Limit on the number of parallel connections.
    */
@@ -2252,6 +3163,15 @@ struct MHD_Daemon
    */
   uint64_t connection_timeout_ms;
 
+  /**
+   * The value of the monotonic clock sampled once per iteration of
+   * the event loop.
+   * Used as the time of the connections activity to avoid reading of
+   * the clock on every read and write.
+   * Not used with the "thread per connection" mode.
+   */
+  uint64_t loop_time_ms;
+
   /**
    * Maximum number of connections per IP, or 0 for
    * unlimited.
@@ -2264,6 +3184,21 @@ struct MHD_Daemon
    */
   int client_discipline;
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+  /**
+   * The minimal size of the response body data to send in the zero-copy
+   * mode, zero if zero-copy send is disabled.
+   * @see #MHD_OPTION_ZEROCOPY_THRESHOLD
+   */
+  size_t zerocopy_threshold;
+
+  /**
+   * The list of the responses of the closed connections waiting for
+   * completion of the zero-copy sends.
+   */
+  struct MHD_ZcPending *zc_pending_head;
+#endif /* MHD_USE_ZEROCOPY_SEND */
+
 #ifdef HAS_FD_SETSIZE_OVERRIDABLE
   /**
    * The value of FD_SETSIZE used by the daemon.
@@ -2410,6 +3345,7 @@ struct MHD_Daemon
 
   /**
    * An array that contains the map nonce-nc.
+   * Allocated when the first nonce is generated, protected by @a nnc_lock.
    */
   struct MHD_NonceNc *nnc;
 
@@ -2441,6 +3377,48 @@ struct MHD_Daemon
   uint32_t dauth_def_max_nc;
 #endif
 
+#ifdef BAUTH_SUPPORT
+  /**
+   * The callback to verify the Basic Authentication credentials
+   */
+  MHD_BasicAuthVerifyCallback bauth_verify_cb;
+
+  /**
+   * The closure for @a bauth_verify_cb
+   */
+  void *bauth_verify_cb_cls;
+
+#ifdef MHD_BAUTH_CACHE_SUPPORT
+  /**
+   * The cache of the verified credentials, used only by the master daemon.
+   * NULL if the cache is not used.
+   */
+  struct MHD_BAuthCacheEntry *bauth_cache;
+
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  /**
+   * The lock for synchronizing access to @e bauth_cache.
+   */
+  MHD_mutex_ bauth_cache_lock;
+#endif
+
+  /**
+   * The random key for the hashes of the cached credentials
+   */
+  uint8_t bauth_cache_key[MHD_SHA256_DIGEST_SIZE];
+#endif /* MHD_BAUTH_CACHE_SUPPORT */
+
+  /**
+   * The number of entries in the @a bauth_cache
+   */
+  unsigned int bauth_cache_size;
+
+  /**
+   * The lifetime of the cached credentials, in milliseconds
+   */
+  uint64_t bauth_cache_timeout_ms;
+#endif /* BAUTH_SUPPORT */
+
 #ifdef TCP_FASTOPEN
   /**
    * The queue size for incoming SYN + DATA packets.
@@ -2481,6 +3459,17 @@ struct MHD_Daemon
    */
   union MHD_DaemonInfo daemon_info_dummy_port;
 
+  /**
+   * The value to be returned by #MHD_get_daemon_info()
+   */
+  union MHD_DaemonInfo daemon_info_dummy_memory_profile;
+
+  /**
+   * The histograms returned by #MHD_get_daemon_info(), collected from
+   * all workers
+   */
+  struct MHD_MemoryProfile daemon_info_memory_profile;
+
 #if defined(_DEBUG) && defined(HAVE_ACCEPT4)
   /**
    * If set to 'true', accept() function will be used instead of accept4() even
@@ -2500,7 +3489,8 @@ struct MHD_Daemon
  * Checks whether the @a d daemon is using select()
  */
 #define MHD_D_IS_USING_SELECT_(d) \
-  (0 == (d->options & (MHD_USE_POLL | MHD_USE_EPOLL)))
+  ((0 == (d->options & (MHD_USE_POLL | MHD_USE_EPOLL))) && \
+   (NULL == (d)->watch_socket_cb))
 /**
  * Checks whether the @a d daemon is using poll()
  */
@@ -2513,7 +3503,8 @@ struct MHD_Daemon
 /**
  * Checks whether the @a d daemon is using select()
  */
-#define MHD_D_IS_USING_SELECT_(d) (0 == ((d)->options & MHD_USE_POLL))
+#define MHD_D_IS_USING_SELECT_(d) \
+  ((0 == ((d)->options & MHD_USE_POLL)) && (NULL == (d)->watch_socket_cb))
 /**
  * Checks whether the @a d daemon is using poll()
  */
@@ -2526,7 +3517,8 @@ struct MHD_Daemon
 /**
  * Checks whether the @a d daemon is using select()
  */
-#define MHD_D_IS_USING_SELECT_(d) (0 == ((d)->options & MHD_USE_EPOLL))
+#define MHD_D_IS_USING_SELECT_(d) \
+  ((0 == ((d)->options & MHD_USE_EPOLL)) && (NULL == (d)->watch_socket_cb))
 /**
  * Checks whether the @a d daemon is using poll()
  */
@@ -2539,7 +3531,7 @@ struct MHD_Daemon
 /**
  * Checks whether the @a d daemon is using select()
  */
-#define MHD_D_IS_USING_SELECT_(d) ((void) (d), ! 0)
+#define MHD_D_IS_USING_SELECT_(d) (NULL == (d)->watch_socket_cb)
 /**
  * Checks whether the @a d daemon is using poll()
  */
@@ -2550,6 +3542,12 @@ struct MHD_Daemon
 #define MHD_D_IS_USING_EPOLL_(d) ((void) (d), 0)
 #endif /* select() only */
 
+/**
+ * Checks whether the @a d daemon's sockets are watched by the application
+ * @see #MHD_OPTION_WATCH_SOCKET_CALLBACK
+ */
+#define MHD_D_IS_USING_WATCH_(d) (NULL != (d)->watch_socket_cb)
+
 #if defined(MHD_USE_THREADS)
 /**
  * Checks whether the @a d daemon is using internal polling thread
@@ -2562,6 +3560,13 @@ struct MHD_Daemon
 #define MHD_D_IS_USING_THREAD_PER_CONN_(d) \
   (0 != ((d)->options & MHD_USE_THREAD_PER_CONNECTION))
 
+/**
+ * Checks whether the @a d daemon reuses connection threads
+ * @see #MHD_OPTION_THREAD_REUSE_MAX_IDLE
+ */
+#define MHD_D_IS_REUSING_CONN_THREADS_(d) \
+  (0 != (d)->conn_threads_idle_max)
+
 /**
  * Check whether the @a d daemon has thread-safety enabled.
  */
@@ -2577,6 +3582,11 @@ struct MHD_Daemon
  */
 #define MHD_D_IS_USING_THREAD_PER_CONN_(d) ((void) d, 0)
 
+/**
+ * Checks whether the @a d daemon reuses connection threads
+ */
+#define MHD_D_IS_REUSING_CONN_THREADS_(d) ((void) d, 0)
+
 /**
  * Check whether the @a d daemon has thread-safety enabled.
  */
@@ -2784,6 +3794,49 @@ struct MHD_RqDAuth
     (element)->prevE = NULL; } while (0)
 
 
+/**
+ * Insert an element at the head of a WDLL. Assumes that head, tail and
+ * element are structs with prevW and nextW fields.
+ *
+ * @param head pointer to the head of the WDLL
+ * @param tail pointer to the tail of the WDLL
+ * @param element element to insert
+ */
+#define WDLL_insert(head,tail,element) do { \
+    (element)->nextW = (head); \
+    (element)->prevW = NULL;   \
+    if ((tail) == NULL) {      \
+      (tail) = element;        \
+    } else {                   \
+      (head)->prevW = element; \
+    }                          \
+    (head) = (element); } while (0)
+
+
+/**
+ * Remove an element from a WDLL. Assumes
+ * that head, tail and element are structs
+ * with prevW and nextW fields.
+ *
+ * @param head pointer to the head of the WDLL
+ * @param tail pointer to the tail of the WDLL
+ * @param element element to remove
+ */
+#define WDLL_remove(head,tail,element) do {       \
+    if ((element)->prevW == NULL) {               \
+      (head) = (element)->nextW;                  \
+    } else {                                      \
+      (element)->prevW->nextW = (element)->nextW; \
+    }                                             \
+    if ((element)->nextW == NULL) {               \
+      (tail) = (element)->prevW;                  \
+    } else {                                      \
+      (element)->nextW->prevW = (element)->prevW; \
+    }                                             \
+    (element)->nextW = NULL;                      \
+    (element)->prevW = NULL; } while (0)
+
+
 /**
  * Convert all occurrences of '+' to ' '.
  *
@@ -2889,6 +3942,46 @@ void
 internal_suspend_connection_ (struct MHD_Connection *connection);
 
 
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+/**
+ * Suspend the connection and queue the call of the access handler
+ * to the handler threads.
+ * The connection is resumed when the handler returns.
+ *
+ * @remark To be called only from thread that process connection's
+ * recv(), send() and response.
+ *
+ * @param connection the connection to suspend
+ * @return #MHD_HANDLER_OFFLOAD_SUBMITTED if the call is queued,
+ *         other values if the handler must not be offloaded
+ */
+enum MHD_HandlerOffloadSubmit
+MHD_handler_offload_submit_ (struct MHD_Connection *connection);
+
+
+/**
+ * Suspend the connection and queue the read of the next block of
+ * the response data to the file read threads.
+ * The connection is resumed when the data is read.
+ *
+ * @remark To be called only from thread that process connection's
+ * recv(), send() and response.
+ *
+ * @param connection the connection to suspend
+ * @param buf the buffer for the data, must stay valid until the
+ *            connection is resumed
+ * @param size the size of the @a buf
+ * @return 'true' if the read is queued,
+ *         'false' if the file read threads are being stopped
+ */
+bool
+MHD_file_read_offload_submit_ (struct MHD_Connection *connection,
+                               char *buf,
+                               size_t size);
+
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+
+
 /**
  * Trace up to and return master daemon. If the supplied daemon
  * is a master, then return the daemon itself.
@@ -2911,6 +4004,33 @@ MHD_get_master (struct MHD_Daemon *const daemon)
 }
 
 
+/**
+ * Get the draining deadline of the daemon.
+ * The lock makes the deadline set by #MHD_drain_daemon() visible
+ * together with MHD_Daemon::draining.
+ *
+ * @param daemon the draining daemon
+ * @return the monotonic time (in milliseconds) of the draining deadline
+ */
+_MHD_static_inline uint64_t
+MHD_get_drain_deadline_ (struct MHD_Daemon *daemon)
+{
+  uint64_t ret;
+
+  mhd_assert (daemon->draining);
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  if (NULL != daemon->worker_pool)
+    return daemon->drain_deadline; /* The master has no connections */
+  MHD_mutex_lock_chk_ (&daemon->cleanup_connection_mutex);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  ret = daemon->drain_deadline;
+#if defined(MHD_USE_POSIX_THREADS) || defined(MHD_USE_W32_THREADS)
+  MHD_mutex_unlock_chk_ (&daemon->cleanup_connection_mutex);
+#endif /* MHD_USE_POSIX_THREADS || MHD_USE_W32_THREADS */
+  return ret;
+}
+
+
 #ifdef UPGRADE_SUPPORT
 /**
  * Mark upgraded connection as closed by application.
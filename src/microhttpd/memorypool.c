@@ -31,6 +31,8 @@
 #include <string.h>
 #include <stdint.h>
 #include "mhd_assert.h"
+#include "mhd_panic.h"
+#include "mhd_locks.h"
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
@@ -226,6 +228,334 @@ MHD_init_mem_pools_ (void)
 }
 
 
+#if defined(MAP_ANONYMOUS) && ! defined(_WIN32)
+/**
+ * Defined if the memory slabs are supported on this platform
+ */
+#define MHD_POOL_SLABS_SUPPORTED_ 1
+#endif /* MAP_ANONYMOUS && ! _WIN32 */
+
+/**
+ * The size of the huge memory page, used to round up the size of the slabs
+ * backed by huge pages
+ */
+#define MHD_HUGE_PAGE_SIZE_ ((size_t) 2 * 1024 * 1024)
+
+/**
+ * The memory slab, the large memory area divided into the blocks
+ * used as the memory of the pools.
+ */
+struct MHD_PoolSlab_
+{
+  /**
+   * The next slab in the list
+   */
+  struct MHD_PoolSlab_ *next;
+
+  /**
+   * The memory of the slab
+   */
+  void *memory;
+
+  /**
+   * The size of the @a memory
+   */
+  size_t size;
+};
+
+/**
+ * The unused block of the slab.
+ * The blocks are linked by the pointers stored in the blocks themselves.
+ */
+struct MHD_PoolSlabBlock_
+{
+  /**
+   * The next unused block
+   */
+  struct MHD_PoolSlabBlock_ *next;
+};
+
+/**
+ * The set of the memory slabs used as the memory of the pools
+ */
+struct MHD_PoolSlabs
+{
+  /**
+   * The list of the slabs
+   */
+  struct MHD_PoolSlab_ *slabs;
+
+  /**
+   * The list of the unused blocks
+   */
+  struct MHD_PoolSlabBlock_ *free_blocks;
+
+  /**
+   * The size of the single block (the size of the pool)
+   */
+  size_t block_size;
+
+  /**
+   * The size of the single slab
+   */
+  size_t slab_size;
+
+  /**
+   * Use the huge pages for the slabs
+   */
+  bool huge_pages;
+
+  /**
+   * Use the explicit (not transparent) huge pages for the slabs
+   */
+  bool explicit_huge_pages;
+
+#ifdef MHD_USE_THREADS
+  /**
+   * The lock for the lists.
+   * The pools could be destroyed by the connection threads.
+   */
+  MHD_mutex_ lock;
+#endif /* MHD_USE_THREADS */
+};
+
+
+#ifdef MHD_POOL_SLABS_SUPPORTED_
+/**
+ * Map the new slab and add all its blocks to the list of unused blocks.
+ * The memory is pre-faulted (when supported by the platform) so the pools
+ * never cause the page faults on the first access.
+ * Must be called with the slabs lock held.
+ *
+ * @param slabs the slabs to extend
+ * @return true if succeed,
+ *         false if failed
+ */
+static bool
+slabs_add_slab (struct MHD_PoolSlabs *slabs)
+{
+  struct MHD_PoolSlab_ *slab;
+  uint8_t *mem;
+  size_t pos;
+  int flags;
+
+  slab = malloc (sizeof (struct MHD_PoolSlab_));
+  if (NULL == slab)
+    return false;
+  flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+  flags |= MAP_POPULATE;
+#endif /* MAP_POPULATE */
+  mem = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (slabs->explicit_huge_pages)
+    mem = mmap (NULL,
+                slabs->slab_size,
+                PROT_READ | PROT_WRITE,
+                flags | MAP_HUGETLB,
+                -1,
+                0);
+#endif /* MAP_HUGETLB */
+  if (MAP_FAILED == mem)
+  {
+#if defined(MADV_HUGEPAGE) && defined(MAP_POPULATE)
+    if (slabs->huge_pages)
+      flags &= ~MAP_POPULATE; /* Populate after madvise() */
+#endif /* MADV_HUGEPAGE && MAP_POPULATE */
+    mem = mmap (NULL,
+                slabs->slab_size,
+                PROT_READ | PROT_WRITE,
+                flags,
+                -1,
+                0);
+    if (MAP_FAILED == mem)
+    {
+      free (slab);
+      return false;
+    }
+#ifdef MADV_HUGEPAGE
+    if (slabs->huge_pages)
+    {
+      (void) madvise (mem,
+                      slabs->slab_size,
+                      MADV_HUGEPAGE);
+      /* Fault in all pages now */
+      for (pos = 0; pos < slabs->slab_size; pos += MHD_sys_page_size_)
+        mem[pos] = 0;
+    }
+#endif /* MADV_HUGEPAGE */
+  }
+  slab->memory = mem;
+  slab->size = slabs->slab_size;
+  slab->next = slabs->slabs;
+  slabs->slabs = slab;
+  for (pos = slabs->slab_size - slabs->slab_size % slabs->block_size;
+       0 != pos;
+       pos -= slabs->block_size)
+  {
+    struct MHD_PoolSlabBlock_ *const blk =
+      (struct MHD_PoolSlabBlock_ *) (void *) (mem + pos - slabs->block_size);
+
+    blk->next = slabs->free_blocks;
+    slabs->free_blocks = blk;
+  }
+  return true;
+}
+
+
+#endif /* MHD_POOL_SLABS_SUPPORTED_ */
+
+
+/**
+ * Create the set of the memory slabs for the pools of the same size.
+ *
+ * The first slab is allocated and pre-faulted immediately, the next
+ * slabs are allocated when all blocks of the existing slabs are used.
+ *
+ * @param pool_size the size of the pools
+ * @param slab_size the size of the single slab, rounded up as needed
+ * @param huge_pages use the huge pages for the slabs if supported
+ * @param explicit_huge_pages use the explicit (not transparent) huge pages,
+ *                            fall back to the transparent huge pages if
+ *                            the explicit huge pages are not available
+ * @return the pointer to the slabs,
+ *         NULL if the slabs are not supported or the memory allocation
+ *         failed
+ */
+struct MHD_PoolSlabs *
+MHD_pool_slabs_create (size_t pool_size,
+                       size_t slab_size,
+                       bool huge_pages,
+                       bool explicit_huge_pages)
+{
+#ifdef MHD_POOL_SLABS_SUPPORTED_
+  struct MHD_PoolSlabs *slabs;
+  size_t granularity;
+
+  mhd_assert (0 < pool_size);
+  slabs = malloc (sizeof (struct MHD_PoolSlabs));
+  if (NULL == slabs)
+    return NULL;
+  slabs->slabs = NULL;
+  slabs->free_blocks = NULL;
+  slabs->block_size = ROUND_TO_ALIGN (pool_size);
+  slabs->huge_pages = huge_pages || explicit_huge_pages;
+  slabs->explicit_huge_pages = explicit_huge_pages;
+  granularity = slabs->huge_pages ? MHD_HUGE_PAGE_SIZE_ : MHD_sys_page_size_;
+  if (slab_size < slabs->block_size)
+    slab_size = slabs->block_size;
+  if (SIZE_MAX - granularity < slab_size)
+  {
+    free (slabs);
+    return NULL;
+  }
+  slab_size += granularity - 1;
+  slab_size -= slab_size % granularity;
+  slabs->slab_size = slab_size;
+#ifdef MHD_USE_THREADS
+  if (! MHD_mutex_init_ (&slabs->lock))
+  {
+    free (slabs);
+    return NULL;
+  }
+#endif /* MHD_USE_THREADS */
+  if (! slabs_add_slab (slabs))
+  {
+    MHD_pool_slabs_destroy (slabs);
+    return NULL;
+  }
+  return slabs;
+#else  /* ! MHD_POOL_SLABS_SUPPORTED_ */
+  (void) pool_size; (void) slab_size; /* Mute compiler warning */
+  (void) huge_pages; (void) explicit_huge_pages;
+  return NULL;
+#endif /* ! MHD_POOL_SLABS_SUPPORTED_ */
+}
+
+
+/**
+ * Destroy the set of the memory slabs.
+ * All pools created with the @a slabs must be destroyed already.
+ *
+ * @param slabs the slabs to destroy, could be NULL
+ */
+void
+MHD_pool_slabs_destroy (struct MHD_PoolSlabs *slabs)
+{
+  if (NULL == slabs)
+    return;
+#ifdef MHD_POOL_SLABS_SUPPORTED_
+  while (NULL != slabs->slabs)
+  {
+    struct MHD_PoolSlab_ *const slab = slabs->slabs;
+
+    slabs->slabs = slab->next;
+    munmap (slab->memory,
+            slab->size);
+    free (slab);
+  }
+#endif /* MHD_POOL_SLABS_SUPPORTED_ */
+#ifdef MHD_USE_THREADS
+  MHD_mutex_destroy_chk_ (&slabs->lock);
+#endif /* MHD_USE_THREADS */
+  free (slabs);
+}
+
+
+/**
+ * Get the unused block from the slabs.
+ *
+ * @param slabs the slabs to use
+ * @return the pointer to the block,
+ *         NULL if no block is available and the new slab cannot be allocated
+ */
+static void *
+slabs_get_block (struct MHD_PoolSlabs *slabs)
+{
+  struct MHD_PoolSlabBlock_ *blk;
+
+#ifdef MHD_USE_THREADS
+  MHD_mutex_lock_chk_ (&slabs->lock);
+#endif /* MHD_USE_THREADS */
+  blk = slabs->free_blocks;
+#ifdef MHD_POOL_SLABS_SUPPORTED_
+  if ( (NULL == blk) &&
+       slabs_add_slab (slabs) )
+    blk = slabs->free_blocks;
+#endif /* MHD_POOL_SLABS_SUPPORTED_ */
+  if (NULL != blk)
+    slabs->free_blocks = blk->next;
+#ifdef MHD_USE_THREADS
+  MHD_mutex_unlock_chk_ (&slabs->lock);
+#endif /* MHD_USE_THREADS */
+  return blk;
+}
+
+
+/**
+ * Return the block to the slabs.
+ *
+ * @param slabs the slabs to use
+ * @param block the block obtained by #slabs_get_block()
+ */
+static void
+slabs_put_block (struct MHD_PoolSlabs *slabs,
+                 void *block)
+{
+  struct MHD_PoolSlabBlock_ *const blk =
+    (struct MHD_PoolSlabBlock_ *) block;
+
+#ifdef MHD_USE_THREADS
+  MHD_mutex_lock_chk_ (&slabs->lock);
+#endif /* MHD_USE_THREADS */
+  blk->next = slabs->free_blocks;
+  slabs->free_blocks = blk;
+#ifdef MHD_USE_THREADS
+  MHD_mutex_unlock_chk_ (&slabs->lock);
+#endif /* MHD_USE_THREADS */
+}
+
+
 /**
  * Handle for a memory pool.  Pools are not reentrant and must not be
  * used by multiple threads.
@@ -257,17 +587,58 @@ struct MemoryPool
    * 'false' if pool was malloc'ed, 'true' if mmapped (VirtualAlloc'ed for W32).
    */
   bool is_mmap;
+
+  /**
+   * The slabs of the pool's memory, NULL if the memory is not from
+   * the slabs.
+   */
+  struct MHD_PoolSlabs *slabs;
+
+  /**
+   * The size of the inaccessible guard page after the pool's memory,
+   * zero if the pool has no guard page.
+   */
+  size_t guard_size;
+
+  /**
+   * The peak number of bytes used since the creation or the last reset.
+   */
+  size_t peak;
 };
 
 
+/**
+ * Update the peak usage of the @a pool after the allocation.
+ *
+ * @param pool the pool to update
+ */
+_MHD_static_inline void
+mp_update_peak_ (struct MemoryPool *pool)
+{
+  const size_t used = pool->pos + (pool->size - pool->end);
+
+  if (pool->peak < used)
+    pool->peak = used;
+}
+
+
 /**
  * Create a memory pool.
  *
  * @param max maximum size of the pool
+ * @param slabs the slabs to take the pool's memory from, could be NULL;
+ *              the pools must have the same size as used to create
+ *              the @a slabs
+ * @param guard_page put the inaccessible page right after the pool's
+ *                   memory (if supported by the platform) so any
+ *                   overrun is caught immediately; the @a slabs are
+ *                   not used if set to 'true'
  * @return NULL on error
  */
 struct MemoryPool *
-MHD_pool_create (size_t max)
+MHD_pool_create (size_t max,
+                 struct MHD_PoolSlabs *slabs,
+                 bool guard_page)
 {
   struct MemoryPool *pool;
   size_t alloc_size;
@@ -277,29 +648,71 @@ MHD_pool_create (size_t max)
   pool = malloc (sizeof (struct MemoryPool));
   if (NULL == pool)
     return NULL;
+  pool->slabs = NULL;
+  pool->guard_size = 0;
+  pool->peak = 0;
+  if ( (NULL != slabs) &&
+       (! guard_page) )
+  {
+    mhd_assert (ROUND_TO_ALIGN (max) == slabs->block_size);
+    pool->memory = slabs_get_block (slabs);
+    if (NULL != pool->memory)
+    {
+      pool->slabs = slabs;
+      pool->is_mmap = false;
+      pool->pos = 0;
+      pool->end = slabs->block_size;
+      pool->size = slabs->block_size;
+      _MHD_POISON_MEMORY (pool->memory, pool->size);
+      return pool;
+    }
+    /* Fall back to the separate allocation */
+  }
 #if defined(MAP_ANONYMOUS) || defined(_WIN32)
-  if ( (max <= 32 * 1024) ||
-       (max < MHD_sys_page_size_ * 4 / 3) )
+  if ( (! guard_page) &&
+       ( (max <= 32 * 1024) ||
+         (max < MHD_sys_page_size_ * 4 / 3) ) )
   {
     pool->memory = MAP_FAILED;
   }
   else
   {
+    const size_t guard_size = guard_page ? MHD_sys_page_size_ : 0;
     /* Round up allocation to page granularity. */
     alloc_size = max + MHD_sys_page_size_ - 1;
     alloc_size -= alloc_size % MHD_sys_page_size_;
 #if defined(MAP_ANONYMOUS) && ! defined(_WIN32)
     pool->memory = mmap (NULL,
-                         alloc_size,
+                         alloc_size + guard_size,
                          PROT_READ | PROT_WRITE,
                          MAP_PRIVATE | MAP_ANONYMOUS,
                          -1,
                          0);
+    if ( (MAP_FAILED != pool->memory) &&
+         (0 != guard_size) )
+    {
+      pool->guard_size = guard_size;
+      /* The guard page is a debugging aid, the pool is usable without it */
+      (void) mprotect (pool->memory + alloc_size,
+                       guard_size,
+                       PROT_NONE);
+    }
 #elif defined(_WIN32)
     pool->memory = VirtualAlloc (NULL,
-                                 alloc_size,
+                                 alloc_size + guard_size,
                                  MEM_COMMIT | MEM_RESERVE,
                                  PAGE_READWRITE);
+    if ( (MAP_FAILED != pool->memory) &&
+         (0 != guard_size) )
+    {
+      DWORD old_prot;
+      pool->guard_size = guard_size;
+      /* The guard page is a debugging aid, the pool is usable without it */
+      (void) VirtualProtect (pool->memory + alloc_size,
+                             guard_size,
+                             PAGE_NOACCESS,
+                             &old_prot);
+    }
 #endif /* _WIN32 */
   }
 #else  /* ! _WIN32 && ! MAP_ANONYMOUS */
@@ -347,12 +760,15 @@ MHD_pool_destroy (struct MemoryPool *pool)
   mhd_assert (pool->size >= pool->end - pool->pos);
   mhd_assert (pool->pos == ROUND_TO_ALIGN (pool->pos));
   _MHD_UNPOISON_MEMORY (pool->memory, pool->size);
-  if (! pool->is_mmap)
+  if (NULL != pool->slabs)
+    slabs_put_block (pool->slabs,
+                     pool->memory);
+  else if (! pool->is_mmap)
     free (pool->memory);
   else
 #if defined(MAP_ANONYMOUS) && ! defined(_WIN32)
     munmap (pool->memory,
-            pool->size);
+            pool->size + pool->guard_size);
 #elif defined(_WIN32)
     VirtualFree (pool->memory,
                  0,
@@ -384,6 +800,21 @@ MHD_pool_get_free (struct MemoryPool *pool)
 }
 
 
+/**
+ * Get the largest amount of memory used in the @a pool at once since
+ * the pool creation or the last pool reset.
+ *
+ * @param pool pool to check
+ * @return the peak number of bytes used in the @a pool
+ */
+size_t
+MHD_pool_get_peak (struct MemoryPool *pool)
+{
+  mhd_assert (pool->peak <= pool->size);
+  return pool->peak;
+}
+
+
 /**
  * Allocate size bytes from the pool.
  *
@@ -421,6 +852,7 @@ MHD_pool_allocate (struct MemoryPool *pool,
     ret = &pool->memory[pool->pos];
     pool->pos += asize;
   }
+  mp_update_peak_ (pool);
   _MHD_UNPOISON_MEMORY (ret, size);
   return ret;
 }
@@ -507,6 +939,7 @@ MHD_pool_try_alloc (struct MemoryPool *pool,
   *required_bytes = 0;
   ret = &pool->memory[pool->end - asize];
   pool->end -= asize;
+  mp_update_peak_ (pool);
   _MHD_UNPOISON_MEMORY (ret, size);
   return ret;
 }
@@ -580,6 +1013,7 @@ MHD_pool_reallocate (struct MemoryPool *pool,
       }
       /* Resized in-place */
       pool->pos = new_apos;
+      mp_update_peak_ (pool);
       _MHD_UNPOISON_MEMORY (old, new_size);
       return old;
     }
@@ -595,6 +1029,7 @@ MHD_pool_reallocate (struct MemoryPool *pool,
 
   new_blc = pool->memory + pool->pos;
   pool->pos += asize;
+  mp_update_peak_ (pool);
 
   _MHD_UNPOISON_MEMORY (new_blc, new_size);
   if (0 != old_size)
@@ -790,6 +1225,7 @@ MHD_pool_reset (struct MemoryPool *pool,
   }
   pool->pos = ROUND_TO_ALIGN_PLUS_RED_ZONE (new_size);
   pool->end = pool->size;
+  pool->peak = pool->pos;
   _MHD_POISON_MEMORY (((uint8_t *) pool->memory) + new_size, \
                       pool->size - new_size);
   return pool->memory;
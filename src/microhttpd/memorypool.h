@@ -45,6 +45,12 @@
  */
 struct MemoryPool;
 
+/**
+ * Opaque handle for a set of the memory slabs, the large pre-allocated
+ * memory areas used as the memory of the pools.
+ */
+struct MHD_PoolSlabs;
+
 /**
  * Initialize values for memory pools
  */
@@ -52,14 +58,56 @@ void
 MHD_init_mem_pools_ (void);
 
 
+/**
+ * Create the set of the memory slabs for the pools of the same size.
+ *
+ * The first slab is allocated and pre-faulted immediately, the next
+ * slabs are allocated when all blocks of the existing slabs are used.
+ *
+ * @param pool_size the size of the pools
+ * @param slab_size the size of the single slab, rounded up as needed
+ * @param huge_pages use the huge pages for the slabs if supported
+ * @param explicit_huge_pages use the explicit (not transparent) huge pages,
+ *                            fall back to the transparent huge pages if
+ *                            the explicit huge pages are not available
+ * @return the pointer to the slabs,
+ *         NULL if the slabs are not supported or the memory allocation
+ *         failed
+ */
+struct MHD_PoolSlabs *
+MHD_pool_slabs_create (size_t pool_size,
+                       size_t slab_size,
+                       bool huge_pages,
+                       bool explicit_huge_pages);
+
+
+/**
+ * Destroy the set of the memory slabs.
+ * All pools created with the @a slabs must be destroyed already.
+ *
+ * @param slabs the slabs to destroy, could be NULL
+ */
+void
+MHD_pool_slabs_destroy (struct MHD_PoolSlabs *slabs);
+
+
 /**
  * Create a memory pool.
  *
  * @param max maximum size of the pool
+ * @param slabs the slabs to take the pool's memory from, could be NULL;
+ *              the pools must have the same size as used to create
+ *              the @a slabs
+ * @param guard_page put the inaccessible page right after the pool's
+ *                   memory (if supported by the platform) so any
+ *                   overrun is caught immediately; the @a slabs are
+ *                   not used if set to 'true'
  * @return NULL on error
  */
 struct MemoryPool *
-MHD_pool_create (size_t max);
+MHD_pool_create (size_t max,
+                 struct MHD_PoolSlabs *slabs,
+                 bool guard_page);
 
 
 /**
@@ -161,6 +209,17 @@ size_t
 MHD_pool_get_free (struct MemoryPool *pool);
 
 
+/**
+ * Get the largest amount of memory used in the @a pool at once since
+ * the pool creation or the last pool reset.
+ *
+ * @param pool pool to check
+ * @return the peak number of bytes used in the @a pool
+ */
+size_t
+MHD_pool_get_peak (struct MemoryPool *pool);
+
+
 /**
  * Deallocate a block of memory obtained from the pool.
  *
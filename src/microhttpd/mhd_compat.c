@@ -37,6 +37,14 @@
 #ifndef HAVE_CALLOC
 #include <string.h> /* for memset() */
 #endif /* ! HAVE_CALLOC */
+#ifdef HAVE_GETRANDOM
+#include <sys/random.h>
+#endif /* HAVE_GETRANDOM */
+#if ! defined(_WIN32) || defined(__CYGWIN__)
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* ! _WIN32 || __CYGWIN__ */
 
 #if defined(_WIN32) && ! defined(__CYGWIN__)
 
@@ -116,3 +124,52 @@ MHD_calloc_ (size_t nelem, size_t elsize)
 
 
 #endif /* ! HAVE_CALLOC */
+
+
+int
+MHD_get_random_bytes_ (void *buf, size_t size)
+{
+  char *const out = (char *) buf;
+  size_t done = 0;
+#if ! defined(_WIN32) || defined(__CYGWIN__)
+  int fd;
+#endif /* ! _WIN32 || __CYGWIN__ */
+
+#ifdef HAVE_GETRANDOM
+  while (done < size)
+  {
+    const ssize_t res = getrandom (out + done, size - done, 0);
+    if (0 > res)
+    {
+      if (EINTR == errno)
+        continue;
+      break; /* Not supported by the kernel, try the device */
+    }
+    done += (size_t) res;
+  }
+  if (done == size)
+    return ! 0;
+#endif /* HAVE_GETRANDOM */
+#if ! defined(_WIN32) || defined(__CYGWIN__)
+  fd = open ("/dev/urandom", O_RDONLY);
+  if (0 > fd)
+    return 0;
+  while (done < size)
+  {
+    const ssize_t res = read (fd, out + done, size - done);
+    if (0 > res)
+    {
+      if (EINTR == errno)
+        continue;
+      break;
+    }
+    if (0 == res)
+      break;
+    done += (size_t) res;
+  }
+  (void) close (fd);
+#else  /* _WIN32 && ! __CYGWIN__ */
+  (void) out; /* No entropy source is used on W32 */
+#endif /* _WIN32 && ! __CYGWIN__ */
+  return (done == size) ? ! 0 : 0;
+}
@@ -77,6 +77,17 @@ int W32_snprintf (char *__restrict s, size_t n, const char *__restrict format,
 #endif /* HAVE_RAND */
 #endif /* HAVE_RANDOM */
 
+/**
+ * Fill the buffer with the random bytes from the system entropy source
+ * (getrandom() or "/dev/urandom").
+ * @param buf the buffer to fill
+ * @param size the size of the @a buf
+ * @return non-zero on success,
+ *         zero if the system entropy source is not available
+ */
+int
+MHD_get_random_bytes_ (void *buf, size_t size);
+
 #ifdef HAVE_CALLOC
 /**
  * MHD_calloc_ is platform-independent calloc()
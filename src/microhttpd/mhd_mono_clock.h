@@ -70,4 +70,18 @@ MHD_monotonic_sec_counter (void);
 uint64_t
 MHD_monotonic_msec_counter (void);
 
+
+/**
+ * Monotonic microseconds counter, useful for short time intervals
+ * measurement.
+ * Tries to be not affected by manually setting the system real time
+ * clock or adjustments by NTP synchronization.
+ * The actual resolution depends on the platform and could be as low as
+ * milliseconds or even seconds.
+ *
+ * @return number of microseconds from some fixed moment
+ */
+uint64_t
+MHD_monotonic_usec_counter (void);
+
 #endif /* MHD_MONO_CLOCK_H */
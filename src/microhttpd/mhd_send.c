@@ -51,6 +51,11 @@
 #include <unistd.h>
 #endif /* HAVE_SYSCONF */
 #include "mhd_assert.h"
+#include "response.h"
+#ifdef MHD_USE_ZEROCOPY_SEND
+#include <linux/errqueue.h>
+#include <unistd.h>
+#endif /* MHD_USE_ZEROCOPY_SEND */
 
 #include "mhd_limits.h"
 
@@ -307,6 +312,263 @@ MHD_connection_set_cork_state_ (struct MHD_Connection *connection,
 }
 
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+
+/**
+ * Check whether the data is sent in the zero-copy mode.
+ * Only the response body data is sent in the zero-copy mode, the reply
+ * header and the chunked encoding elements are located in the connection's
+ * memory pool which is reused for the next request.
+ */
+#define zc_is_active(c) \
+  ((c)->zc_send && (MHD_CONNECTION_NORMAL_BODY_READY == (c)->state))
+
+/**
+ * The flags for send() of the response body data
+ */
+#define zc_send_flags(c) (zc_is_active (c) ? MSG_ZEROCOPY : 0)
+
+/**
+ * Check whether the failed zero-copy send could be retried as the usual
+ * send.
+ * The kernel refuses zero-copy send with ENOBUFS when the socket's limit
+ * of the memory for the completion notifications is reached.  The rest of
+ * the response is sent without zero-copy in this case.
+ * @param connection the connection to use
+ * @param err the error code of the failed send
+ * @return true if the send should be retried, false otherwise
+ */
+static bool
+zc_send_failed (struct MHD_Connection *connection,
+                int err)
+{
+  if (! zc_is_active (connection))
+    return false;
+  if (! MHD_SCKT_ERR_IS_ (err, ENOBUFS))
+    return false;
+  connection->zc_send = false;
+  return true;
+}
+
+
+bool
+MHD_send_zc_enable_ (struct MHD_Connection *connection)
+{
+  const int on_val = 1;
+
+  if (_MHD_UNKNOWN != connection->sk_zerocopy)
+    return (_MHD_ON == connection->sk_zerocopy);
+  if ( (_MHD_YES != connection->is_nonip) &&
+       (0 == setsockopt (connection->socket_fd,
+                         SOL_SOCKET,
+                         SO_ZEROCOPY,
+                         (const void *) &on_val,
+                         sizeof (on_val))) )
+  {
+    connection->sk_zerocopy = _MHD_ON;
+    return true;
+  }
+  /* Not a TCP socket or not supported by the kernel */
+  connection->sk_zerocopy = _MHD_OFF;
+  return false;
+}
+
+
+/**
+ * Read the zero-copy send completion notifications from the socket error
+ * queue.
+ * @param sk the socket to use
+ * @param[in,out] zc_done the number of the completed zero-copy sends,
+ *                        updated with the reported completions
+ * @param[out] copied set to true if the kernel has copied the data
+ *                    instead of zero-copy send, could be NULL
+ * @return true if any notification has been processed, false otherwise
+ */
+static bool
+zc_read_notifications (MHD_socket sk,
+                       uint32_t *zc_done,
+                       bool *copied)
+{
+  bool processed = false;
+
+  while (1)
+  {
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    union
+    {
+      char buf[CMSG_SPACE (sizeof (struct sock_extended_err))
+               + CMSG_SPACE (sizeof (struct sockaddr_in6))];
+      struct cmsghdr align;
+    } control;
+
+    memset (&msg, 0, sizeof(msg));
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    if (0 > recvmsg (sk,
+                     &msg,
+                     MSG_ERRQUEUE | MSG_DONTWAIT))
+      break; /* The error queue is empty */
+
+    for (cmsg = CMSG_FIRSTHDR (&msg); NULL != cmsg;
+         cmsg = CMSG_NXTHDR (&msg, cmsg))
+    {
+      const struct sock_extended_err *serr;
+
+      if (CMSG_LEN (sizeof (struct sock_extended_err)) > cmsg->cmsg_len)
+        continue;
+      serr = (const struct sock_extended_err *) (void *) CMSG_DATA (cmsg);
+      if ( (SO_EE_ORIGIN_ZEROCOPY != serr->ee_origin) ||
+           (0 != serr->ee_errno) )
+        continue;
+      /* The notification reports the range of the completed sends */
+      *zc_done += serr->ee_data - serr->ee_info + 1;
+      if ( (NULL != copied) &&
+           (0 != (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)) )
+        *copied = true;
+      processed = true;
+    }
+  }
+  return processed;
+}
+
+
+bool
+MHD_send_zc_complete_ (struct MHD_Connection *connection)
+{
+  bool processed;
+  bool copied = false;
+  int sk_err;
+  socklen_t sk_err_len;
+
+  if (MHD_INVALID_SOCKET == connection->socket_fd)
+    return false;
+  processed = zc_read_notifications (connection->socket_fd,
+                                     &connection->zc_done,
+                                     &copied);
+  if (copied)
+  {
+    /* The kernel has copied the data anyway (for example, for
+       the loopback interface), zero-copy is only an overhead
+       for this socket. */
+    connection->sk_zerocopy = _MHD_OFF;
+  }
+  if ( (connection->zc_done == connection->zc_sent) &&
+       (! connection->zc_send) &&
+       (NULL != connection->zc_response) )
+  {
+    struct MHD_Response *const resp = connection->zc_response;
+
+    connection->zc_response = NULL;
+    MHD_destroy_response (resp);
+  }
+  if (! processed)
+    return false;
+
+  /* The notifications signal the socket error condition, check whether
+     the real socket error is pending as well. */
+  sk_err = 0;
+  sk_err_len = (socklen_t) sizeof (sk_err);
+  if (0 != getsockopt (connection->socket_fd,
+                       SOL_SOCKET,
+                       SO_ERROR,
+                       (void *) &sk_err,
+                       &sk_err_len))
+    return false;
+  return (0 == sk_err);
+}
+
+
+void
+MHD_send_zc_release_ (struct MHD_Connection *connection)
+{
+  struct MHD_Daemon *const daemon = connection->daemon;
+  struct MHD_Response *const resp = connection->zc_response;
+  struct MHD_ZcPending *pending;
+
+  if (NULL == resp)
+    return;
+  connection->zc_send = false;
+  (void) MHD_send_zc_complete_ (connection);
+  if (NULL == connection->zc_response)
+    return;
+  connection->zc_response = NULL;
+  /* The kernel still uses the data, keep the socket open to receive
+     the notifications.  The connection's descriptor is closed or handed
+     off by the caller, the duplicate keeps the socket. */
+  pending = (struct MHD_ZcPending *) malloc (sizeof (struct MHD_ZcPending));
+  if (NULL != pending)
+  {
+    pending->socket_fd = dup (connection->socket_fd);
+    if (MHD_INVALID_SOCKET == pending->socket_fd)
+    {
+      free (pending);
+      pending = NULL;
+    }
+  }
+  if (NULL == pending)
+  {
+    /* Cannot wait, the sent data could be still unsent */
+    connection->zc_done = connection->zc_sent;
+    MHD_destroy_response (resp);
+    return;
+  }
+  if (! connection->drain_handoff)
+  {
+    /* The duplicate keeps the connection open, close it for the client */
+    (void) shutdown (pending->socket_fd, SHUT_WR);
+  }
+  pending->response = resp;
+  pending->zc_sent = connection->zc_sent;
+  pending->zc_done = connection->zc_done;
+  pending->next = daemon->zc_pending_head;
+  daemon->zc_pending_head = pending;
+}
+
+
+void
+MHD_send_zc_reap_ (struct MHD_Daemon *daemon,
+                   bool force)
+{
+  struct MHD_ZcPending **pprev;
+  struct MHD_ZcPending *pending;
+
+  pprev = &daemon->zc_pending_head;
+  while (NULL != (pending = *pprev))
+  {
+    (void) zc_read_notifications (pending->socket_fd,
+                                  &pending->zc_done,
+                                  NULL);
+    if ( (pending->zc_done != pending->zc_sent) &&
+         (! force) )
+    {
+      pprev = &pending->next;
+      continue;
+    }
+    if (pending->zc_done != pending->zc_sent)
+    {
+      /* Reset the connection: the kernel drops the unsent data
+         before the response is freed. */
+      struct linger lng;
+
+      lng.l_onoff = 1;
+      lng.l_linger = 0;
+      (void) setsockopt (pending->socket_fd,
+                         SOL_SOCKET,
+                         SO_LINGER,
+                         (const void *) &lng,
+                         sizeof (lng));
+    }
+    *pprev = pending->next;
+    MHD_socket_close_chk_ (pending->socket_fd);
+    MHD_destroy_response (pending->response);
+    free (pending);
+  }
+}
+
+#endif /* MHD_USE_ZEROCOPY_SEND */
+
+
 /**
  * Handle pre-send setsockopt calls.
  *
@@ -836,7 +1098,12 @@ MHD_send_data_ (struct MHD_Connection *connection,
     }
 
     pre_send_setopt (connection, (! tls_conn), push_data);
-#ifdef MHD_USE_MSG_MORE
+#ifdef MHD_USE_ZEROCOPY_SEND
+    ret = MHD_send4_ (s,
+                      buffer,
+                      buffer_size,
+                      (push_data ? 0 : MSG_MORE) | zc_send_flags (connection));
+#elif defined(MHD_USE_MSG_MORE)
     ret = MHD_send4_ (s,
                       buffer,
                       buffer_size,
@@ -847,11 +1114,19 @@ MHD_send_data_ (struct MHD_Connection *connection,
                       buffer_size,
                       0);
 #endif
+#ifdef MHD_USE_ZEROCOPY_SEND
+    if ( (0 < ret) && zc_is_active (connection) )
+      connection->zc_sent++;
+#endif /* MHD_USE_ZEROCOPY_SEND */
 
     if (0 > ret)
     {
       const int err = MHD_socket_get_error_ ();
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+      if (zc_send_failed (connection, err))
+        return MHD_ERR_AGAIN_;
+#endif /* MHD_USE_ZEROCOPY_SEND */
       if (MHD_SCKT_ERR_IS_EAGAIN_ (err))
       {
 #ifdef EPOLL_SUPPORT
@@ -1175,11 +1450,73 @@ MHD_send_hdr_and_body_ (struct MHD_Connection *connection,
 
 
 #if defined(_MHD_HAVE_SENDFILE)
+/**
+ * The maximum number of the memory segments sent by a single call
+ */
+#define MHD_SEGMENTS_IOV_MAX_ 16
+
+/**
+ * Send the consecutive memory segments of the response with
+ * a single vectored send.
+ *
+ * @param connection the MHD connection structure
+ * @param seg_idx the index of the first segment to send
+ * @param seg_pos the position within the first segment
+ * @return actual number of bytes sent
+ */
+static ssize_t
+send_mem_segments (struct MHD_Connection *connection,
+                   unsigned int seg_idx,
+                   uint64_t seg_pos)
+{
+  const struct MHD_Response *const resp = connection->rp.response;
+  MHD_iovec_ iov[MHD_SEGMENTS_IOV_MAX_];
+  struct MHD_iovec_track_ iov_track;
+  size_t cnt;
+  size_t total;
+  bool push_data;
+
+  cnt = 0;
+  total = 0;
+  push_data = false;
+  while ( (seg_idx < resp->data_segs_cnt) &&
+          (-1 == resp->data_segs[seg_idx].fd) &&
+          (MHD_SEGMENTS_IOV_MAX_ > cnt) &&
+          (MHD_SCKT_SEND_MAX_SIZE_ > total) )
+  {
+    const struct MHD_ResponseSegment *const seg = resp->data_segs + seg_idx;
+    size_t len = (size_t) (seg->size - seg_pos);
+
+    mhd_assert (seg->size > seg_pos);
+    if (MHD_SCKT_SEND_MAX_SIZE_ - total < len)
+      len = MHD_SCKT_SEND_MAX_SIZE_ - total; /* Incomplete segment */
+    else if (resp->data_segs_cnt == seg_idx + 1)
+      push_data = true; /* The final piece of data */
+    iov[cnt].iov_base = _MHD_DROP_CONST ((const char *) seg->data
+                                         + (size_t) seg_pos);
+    iov[cnt].iov_len = (MHD_iov_size_) len;
+    total += len;
+    cnt++;
+    seg_idx++;
+    seg_pos = 0;
+  }
+  mhd_assert (0 != cnt);
+  iov_track.iov = iov;
+  iov_track.cnt = cnt;
+  iov_track.sent = 0;
+  return MHD_send_iovec_ (connection,
+                          &iov_track,
+                          push_data);
+}
+
+
 ssize_t
 MHD_send_sendfile_ (struct MHD_Connection *connection)
 {
   ssize_t ret;
-  const int file_fd = connection->rp.response->fd;
+  const struct MHD_Response *const resp = connection->rp.response;
+  int file_fd = resp->fd;
+  bool last_part = true;
   uint64_t left;
   uint64_t offsetu64;
 #ifndef HAVE_SENDFILE64
@@ -1210,17 +1547,36 @@ MHD_send_sendfile_ (struct MHD_Connection *connection)
   mhd_assert (MHD_resp_sender_sendfile == connection->rp.resp_sender);
   mhd_assert (0 == (connection->daemon->options & MHD_USE_TLS));
 
-  offsetu64 = connection->rp.rsp_write_position
-              + connection->rp.response->fd_off;
+  if (NULL != resp->data_segs)
+  {
+    const struct MHD_ResponseSegment *seg;
+    unsigned int seg_idx;
+    uint64_t seg_pos;
+
+    seg_idx = MHD_response_find_segment_ (resp,
+                                          connection->rp.rsp_write_position,
+                                          &seg_pos);
+    seg = resp->data_segs + seg_idx;
+    if (-1 == seg->fd)
+      return send_mem_segments (connection,
+                                seg_idx,
+                                seg_pos);
+    file_fd = seg->fd;
+    offsetu64 = seg->offset + seg_pos;
+    left = seg->size - seg_pos;
+    last_part = (resp->data_segs_cnt == seg_idx + 1);
+  }
+  else
+  {
+    offsetu64 = connection->rp.rsp_write_position + resp->fd_off;
+    left = resp->total_size - connection->rp.rsp_write_position;
+  }
   if (max_off_t < offsetu64)
   {   /* Retry to send with standard 'send()'. */
     connection->rp.resp_sender = MHD_resp_sender_std;
     return MHD_ERR_AGAIN_;
   }
 
-  left = connection->rp.response->total_size
-         - connection->rp.rsp_write_position;
-
   if ( (uint64_t) SSIZE_MAX < left)
     left = SSIZE_MAX;
 
@@ -1234,7 +1590,8 @@ MHD_send_sendfile_ (struct MHD_Connection *connection)
   else
   {
     send_size = (size_t) left;
-    push_data = true; /* Final piece of data, need to push to the network. */
+    /* Final piece of data, need to push to the network. */
+    push_data = last_part;
   }
   pre_send_setopt (connection, false, push_data);
 
@@ -1438,7 +1795,13 @@ send_iov_nontls (struct MHD_Connection *connection,
   msg.msg_iovlen = items_to_send;
 
   pre_send_setopt (connection, true, push_data);
-#ifdef MHD_USE_MSG_MORE
+#ifdef MHD_USE_ZEROCOPY_SEND
+  res = sendmsg (connection->socket_fd, &msg,
+                 MSG_NOSIGNAL_OR_ZERO | (push_data ? 0 : MSG_MORE)
+                 | zc_send_flags (connection));
+  if ( (0 < res) && zc_is_active (connection) )
+    connection->zc_sent++;
+#elif defined(MHD_USE_MSG_MORE)
   res = sendmsg (connection->socket_fd, &msg,
                  MSG_NOSIGNAL_OR_ZERO | (push_data ? 0 : MSG_MORE));
 #else  /* ! MHD_USE_MSG_MORE */
@@ -1476,6 +1839,10 @@ send_iov_nontls (struct MHD_Connection *connection,
   {
     const int err = MHD_socket_get_error_ ();
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+    if (zc_send_failed (connection, err))
+      return MHD_ERR_AGAIN_;
+#endif /* MHD_USE_ZEROCOPY_SEND */
     if (MHD_SCKT_ERR_IS_EAGAIN_ (err))
     {
 #ifdef EPOLL_SUPPORT
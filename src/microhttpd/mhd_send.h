@@ -160,4 +160,65 @@ MHD_send_iovec_ (struct MHD_Connection *connection,
                  bool push_data);
 
 
+#ifdef MHD_USE_ZEROCOPY_SEND
+/**
+ * The maximum interval, in milliseconds, of the checks of the zero-copy
+ * send completions of the closed connections.
+ */
+#define MHD_ZC_REAP_INTERVAL_MS 100
+
+/**
+ * Enable zero-copy send on the connection socket, if not enabled yet.
+ *
+ * @param connection the connection to manipulate
+ * @return true if zero-copy send is enabled,
+ *         false if failed or not supported for the socket
+ */
+bool
+MHD_send_zc_enable_ (struct MHD_Connection *connection);
+
+
+/**
+ * Process zero-copy send completion notifications from the socket
+ * error queue.
+ *
+ * The response held for zero-copy sends is released when all sends are
+ * completed and no zero-copy sends are in progress.
+ *
+ * @param connection the connection to process
+ * @return true if any notification has been processed and no socket
+ *         error is pending, false otherwise
+ */
+bool
+MHD_send_zc_complete_ (struct MHD_Connection *connection);
+
+
+/**
+ * Release the response held for zero-copy sends of the connection being
+ * closed.
+ *
+ * If some sends are not reported as completed, the response and
+ * the duplicate of the socket are moved to the daemon's list and kept
+ * until the completion is reported.
+ *
+ * @param connection the connection to process
+ */
+void
+MHD_send_zc_release_ (struct MHD_Connection *connection);
+
+
+/**
+ * Release the responses of the closed connections when all zero-copy
+ * sends are reported as completed.
+ *
+ * @param daemon the daemon to process
+ * @param force set to true to reset the sockets and release all
+ *              responses, used when the daemon is stopped
+ */
+void
+MHD_send_zc_reap_ (struct MHD_Daemon *daemon,
+                   bool force);
+
+#endif /* MHD_USE_ZEROCOPY_SEND */
+
 #endif /* MHD_SEND_H */
@@ -297,6 +297,16 @@ typedef SOCKET MHD_socket;
 #endif /* __linux__ */
 #endif /* MSG_MORE */
 
+#if defined(MHD_USE_MSG_MORE) && defined(HAVE_LINUX_ERRQUEUE_H) && \
+  defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+/**
+ * Indicate that MSG_ZEROCOPY send() with the completion notifications
+ * in the socket error queue is supported.
+ */
+#define MHD_USE_ZEROCOPY_SEND 1
+#endif /* MHD_USE_MSG_MORE && HAVE_LINUX_ERRQUEUE_H && MSG_ZEROCOPY
+          && SO_ZEROCOPY */
+
 
 /**
  * MHD_SCKT_OPT_BOOL_ is type for bool parameters for setsockopt()/getsockopt()
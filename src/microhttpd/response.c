@@ -1073,28 +1073,25 @@ MHD_set_response_options (struct MHD_Response *response,
 
 
 /**
- * Given a file descriptor, read data from the file
- * to generate the response.
+ * Read data from the file at the specified position.
  *
- * @param cls pointer to the response
- * @param pos offset in the file to access
+ * @param fd the file descriptor to read
+ * @param offset64 the offset in the file to access
  * @param buf where to write the data
  * @param max number of bytes to write at most
  * @return number of bytes written
  */
 static ssize_t
-file_reader (void *cls,
-             uint64_t pos,
-             char *buf,
-             size_t max)
+file_read_at (int fd,
+              int64_t offset64,
+              char *buf,
+              size_t max)
 {
-  struct MHD_Response *response = cls;
 #if ! defined(_WIN32) || defined(__CYGWIN__)
   ssize_t n;
 #else  /* _WIN32 && !__CYGWIN__ */
-  const HANDLE fh = (HANDLE) (uintptr_t) _get_osfhandle (response->fd);
+  const HANDLE fh = (HANDLE) (uintptr_t) _get_osfhandle (fd);
 #endif /* _WIN32 && !__CYGWIN__ */
-  const int64_t offset64 = (int64_t) (pos + response->fd_off);
 
   if (offset64 < 0)
     return MHD_CONTENT_READER_END_WITH_ERROR; /* seek to required position is not possible */
@@ -1104,16 +1101,16 @@ file_reader (void *cls,
     max = SSIZE_MAX; /* Clamp to maximum return value. */
 
 #if defined(HAVE_PREAD64)
-  n = pread64 (response->fd, buf, max, offset64);
+  n = pread64 (fd, buf, max, offset64);
 #elif defined(HAVE_PREAD)
   if ( (sizeof(off_t) < sizeof (uint64_t)) &&
        (offset64 > (uint64_t) INT32_MAX) )
     return MHD_CONTENT_READER_END_WITH_ERROR; /* Read at required position is not possible. */
 
-  n = pread (response->fd, buf, max, (off_t) offset64);
+  n = pread (fd, buf, max, (off_t) offset64);
 #else  /* ! HAVE_PREAD */
 #if defined(HAVE_LSEEK64)
-  if (lseek64 (response->fd,
+  if (lseek64 (fd,
                offset64,
                SEEK_SET) != offset64)
     return MHD_CONTENT_READER_END_WITH_ERROR; /* can't seek to required position */
@@ -1122,12 +1119,12 @@ file_reader (void *cls,
        (offset64 > (uint64_t) INT32_MAX) )
     return MHD_CONTENT_READER_END_WITH_ERROR; /* seek to required position is not possible */
 
-  if (lseek (response->fd,
+  if (lseek (fd,
              (off_t) offset64,
              SEEK_SET) != (off_t) offset64)
     return MHD_CONTENT_READER_END_WITH_ERROR; /* can't seek to required position */
 #endif /* ! HAVE_LSEEK64 */
-  n = read (response->fd,
+  n = read (fd,
             buf,
             max);
 
@@ -1139,7 +1136,7 @@ file_reader (void *cls,
   return n;
 #else /* _WIN32 && !__CYGWIN__ */
   if (INVALID_HANDLE_VALUE == fh)
-    return MHD_CONTENT_READER_END_WITH_ERROR; /* Value of 'response->fd' is not valid. */
+    return MHD_CONTENT_READER_END_WITH_ERROR; /* Value of 'fd' is not valid. */
   else
   {
     OVERLAPPED f_ol = {0, 0, {{0, 0}}, 0};   /* Initialize to zero. */
@@ -1160,6 +1157,31 @@ file_reader (void *cls,
 }
 
 
+/**
+ * Given a file descriptor, read data from the file
+ * to generate the response.
+ *
+ * @param cls pointer to the response
+ * @param pos offset in the file to access
+ * @param buf where to write the data
+ * @param max number of bytes to write at most
+ * @return number of bytes written
+ */
+static ssize_t
+file_reader (void *cls,
+             uint64_t pos,
+             char *buf,
+             size_t max)
+{
+  struct MHD_Response *response = cls;
+
+  return file_read_at (response->fd,
+                       (int64_t) (pos + response->fd_off),
+                       buf,
+                       max);
+}
+
+
 /**
  * Given a pipe descriptor, read data from the pipe
  * to generate the response.
@@ -1807,6 +1829,315 @@ MHD_create_response_from_iovec (const struct MHD_IoVec *iov,
 }
 
 
+unsigned int
+MHD_response_find_segment_ (const struct MHD_Response *response,
+                            uint64_t pos,
+                            uint64_t *seg_pos)
+{
+  unsigned int i;
+
+  mhd_assert (NULL != response->data_segs);
+  mhd_assert (pos < response->total_size);
+  for (i = 0; i < response->data_segs_cnt - 1; ++i)
+  {
+    if (pos < response->data_segs[i].size)
+      break;
+    pos -= response->data_segs[i].size;
+  }
+  mhd_assert (pos < response->data_segs[i].size);
+  *seg_pos = pos;
+  return i;
+}
+
+
+/**
+ * Read data from the segments of the response.
+ * Used when the data cannot be sent directly from the segments.
+ *
+ * @param cls pointer to the response
+ * @param pos offset in the response body
+ * @param buf where to write the data
+ * @param max number of bytes to write at most
+ * @return number of bytes written
+ */
+static ssize_t
+segments_reader (void *cls,
+                 uint64_t pos,
+                 char *buf,
+                 size_t max)
+{
+  struct MHD_Response *response = cls;
+  const struct MHD_ResponseSegment *seg;
+  uint64_t seg_pos;
+
+  if (pos >= response->total_size)
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  seg = response->data_segs
+        + MHD_response_find_segment_ (response, pos, &seg_pos);
+  if (seg->size - seg_pos < max)
+    max = (size_t) (seg->size - seg_pos);
+  if (SSIZE_MAX < max)
+    max = SSIZE_MAX; /* Clamp to maximum return value. */
+  if (-1 != seg->fd)
+    return file_read_at (seg->fd,
+                         (int64_t) (seg->offset + seg_pos),
+                         buf,
+                         max);
+  memcpy (buf,
+          (const char *) seg->data + (size_t) seg_pos,
+          max);
+  return (ssize_t) max;
+}
+
+
+/**
+ * Destroy the segments of the response and call the application's
+ * clean up callback.
+ *
+ * @param cls pointer to the response
+ */
+static void
+segments_free_callback (void *cls)
+{
+  struct MHD_Response *response = cls;
+
+  if (NULL != response->segs_free_cb)
+    response->segs_free_cb (response->segs_free_cls);
+  if (NULL != response->data_segs)
+    free (response->data_segs);
+  response->data_segs = NULL;
+}
+
+
+/**
+ * Create a response object with the body composed of the file regions
+ * and the memory buffers.
+ *
+ * The response body is the concatenation of all segments, in the order
+ * of the @a segments array.  Useful for "multipart/byteranges" replies,
+ * for concatenation of the media segments or for the archive-like bundles.
+ * The file segments are sent with sendfile() when possible, the
+ * consecutive memory segments are sent with a single vectored send.
+ * When sendfile() cannot be used (for example for TLS connections), the
+ * data is read from the files.
+ *
+ * The file descriptors are not closed by MHD, the application should
+ * close them (if needed) in @a free_cb.  The file descriptors should be
+ * in 'blocking' mode and must not be used for reading by the
+ * application while the response exists.
+ *
+ * The response object can be extended with header information and then
+ * be used any number of times.
+ *
+ * If response object is used to answer HEAD request then the body
+ * of the response is not used, while all headers (including automatic
+ * headers) are used.
+ *
+ * @param segments the array of the segments, an internal copy of this
+ *        will be made
+ * @param num_segments the number of elements in @a segments
+ * @param free_cb the callback to clean up any data associated with
+ *        @a segments (to close the files, to free the memory) when the
+ *        response is destroyed, could be NULL
+ * @param cls the argument passed to @a free_cb
+ * @return NULL on error (i.e. invalid arguments, out of memory)
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_create_response_from_segments (const struct MHD_ResponseSegment *segments,
+                                   unsigned int num_segments,
+                                   MHD_ContentReaderFreeCallback free_cb,
+                                   void *cls)
+{
+  struct MHD_Response *response;
+  struct MHD_ResponseSegment *segs_copy;
+  uint64_t total_size;
+  unsigned int num_copy;
+  unsigned int i;
+
+  if ((NULL == segments) && (0 < num_segments))
+    return NULL;
+
+  total_size = 0;
+  num_copy = 0;
+  for (i = 0; i < num_segments; ++i)
+  {
+    const struct MHD_ResponseSegment *const seg = segments + i;
+
+    if (0 == seg->size)
+      continue; /* skip zero-sized segments */
+    if (-1 == seg->fd)
+    {
+      if ( (NULL == seg->data) ||
+           ((uint64_t) SIZE_MAX < seg->size) )
+        return NULL;
+    }
+    else
+    {
+      if (0 > seg->fd)
+        return NULL;
+#if ! defined(HAVE___LSEEKI64) && ! defined(HAVE_LSEEK64)
+      if ( (sizeof(uint64_t) > sizeof(off_t)) &&
+           ( (seg->size > (uint64_t) INT32_MAX) ||
+             (seg->offset > (uint64_t) INT32_MAX) ||
+             ((seg->size + seg->offset) >= (uint64_t) INT32_MAX) ) )
+        return NULL;
+#endif
+      if ( ((int64_t) seg->offset < 0) ||
+           ((int64_t) (seg->size + seg->offset) < 0) )
+        return NULL;
+    }
+    if ( ((int64_t) seg->size < 0) ||
+         ((int64_t) (total_size + seg->size) < 0) )
+      return NULL; /* overflow */
+    total_size += seg->size;
+    num_copy++;
+  }
+
+  segs_copy = NULL;
+  if (0 != num_copy)
+  {
+    segs_copy = MHD_calloc_ (num_copy,
+                             sizeof (struct MHD_ResponseSegment));
+    if (NULL == segs_copy)
+      return NULL;
+    num_copy = 0;
+    for (i = 0; i < num_segments; ++i)
+    {
+      if (0 == segments[i].size)
+        continue; /* skip zero-sized segments */
+      segs_copy[num_copy++] = segments[i];
+    }
+  }
+
+  response = MHD_create_response_from_callback (total_size,
+                                                MHD_FILE_READ_BLOCK_SIZE,
+                                                &segments_reader,
+                                                NULL,
+                                                &segments_free_callback);
+  if (NULL == response)
+  {
+    if (NULL != segs_copy)
+      free (segs_copy);
+    return NULL;
+  }
+  response->crc_cls = response;
+  response->data_segs = segs_copy;
+  response->data_segs_cnt = num_copy;
+  response->segs_free_cb = free_cb;
+  response->segs_free_cls = cls;
+  return response;
+}
+
+
+/**
+ * Copy the data borrowed from the application to the buffer.
+ * Used when the borrowed data cannot be sent directly.
+ *
+ * @param cls pointer to the response
+ * @param pos offset in the response body
+ * @param buf where to write the data
+ * @param max number of bytes to write at most
+ * @return number of bytes written
+ */
+static ssize_t
+borrow_reader (void *cls,
+               uint64_t pos,
+               char *buf,
+               size_t max)
+{
+  struct MHD_Response *response = cls;
+  const void *data;
+  MHD_ContentReaderFreeCallback release;
+  void *release_cls;
+  ssize_t ret;
+
+  data = NULL;
+  release = NULL;
+  release_cls = NULL;
+  ret = response->bcb (response->bcb_cls,
+                       pos,
+                       &data,
+                       &release,
+                       &release_cls);
+  if (0 >= ret)
+    return ret;
+  if (max < (size_t) ret)
+    ret = (ssize_t) max;
+  memcpy (buf,
+          data,
+          (size_t) ret);
+  if (NULL != release)
+    release (release_cls);
+  return ret;
+}
+
+
+/**
+ * Call the application's clean up callback for the borrow callback.
+ *
+ * @param cls pointer to the response
+ */
+static void
+borrow_free_callback (void *cls)
+{
+  struct MHD_Response *response = cls;
+
+  if (NULL != response->bcb_free)
+    response->bcb_free (response->bcb_cls);
+}
+
+
+/**
+ * Create a response object with the body provided by the application
+ * in its own buffers.
+ *
+ * Similar to #MHD_create_response_from_callback(), but the data is not
+ * copied to the MHD buffer: @a bcb returns the pointers to the
+ * application's data, the data is sent directly from the application's
+ * memory and released by the callback provided by @a bcb after
+ * the data has been sent (or when the connection is closed).
+ * Useful when the response data is already available in the
+ * application's (refcounted) buffers.
+ *
+ * The response object can be extended with header information and then
+ * be used any number of times.
+ *
+ * @param size size of the data portion of the response, #MHD_SIZE_UNKNOWN
+ *        for unknown
+ * @param bcb callback to use to obtain the response data
+ * @param bcb_cls extra argument to @a bcb
+ * @param crfc callback to call to free @a bcb_cls resources
+ * @return NULL on error (i.e. invalid arguments, out of memory)
+ * @note Available since #MHD_VERSION 0x01000102
+ * @ingroup response
+ */
+_MHD_EXTERN struct MHD_Response *
+MHD_create_response_from_borrow_callback (uint64_t size,
+                                          MHD_ContentBorrowCallback bcb,
+                                          void *bcb_cls,
+                                          MHD_ContentReaderFreeCallback crfc)
+{
+  struct MHD_Response *response;
+
+  if (NULL == bcb)
+    return NULL;
+  response = MHD_create_response_from_callback (size,
+                                                MHD_FILE_READ_BLOCK_SIZE,
+                                                &borrow_reader,
+                                                NULL,
+                                                &borrow_free_callback);
+  if (NULL == response)
+    return NULL;
+  response->crc_cls = response;
+  response->bcb = bcb;
+  response->bcb_cls = bcb_cls;
+  response->bcb_free = crfc;
+  return response;
+}
+
+
 /**
  * Create a response object with empty (zero size) body.
  *
@@ -38,6 +38,23 @@ void
 MHD_increment_response_rc (struct MHD_Response *response);
 
 
+/**
+ * Find the segment of the response with the data at the specified
+ * position.
+ *
+ * The response must be created by MHD_create_response_from_segments()
+ * and the position must be less than the size of the response.
+ * @param response the response to use
+ * @param pos the position in the response body
+ * @param[out] seg_pos set to the position within the found segment
+ * @return the index of the found segment
+ */
+unsigned int
+MHD_response_find_segment_ (const struct MHD_Response *response,
+                            uint64_t pos,
+                            uint64_t *seg_pos);
+
+
 /**
  * We are done sending the header of a given response
  * to the client.  Now it is time to perform the upgrade
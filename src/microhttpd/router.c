@@ -0,0 +1,764 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/router.c
+ * @brief  The built-in radix-tree URL router
+ * @author agent
+ *
+ * The routes are compiled into the radix tree at the daemon start.
+ * Every node of the tree may have:
+ * + any number of children with the static labels (the first characters
+ *   of the labels are different for all children),
+ * + one parameter child (":name" in the route path), which matches one
+ *   non-empty path segment,
+ * + one wildcard child ("*name" in the route path), which matches
+ *   the rest of the path,
+ * + the list of the endpoints (the handlers with the methods masks).
+ * The lookup prefers the static labels, then the parameters, then
+ * the wildcards, and backtracks if the preferred branch has no match.
+ */
+
+#include "router.h"
+#include "internal.h"
+#include "memorypool.h"
+#include "mhd_compat.h"
+#include "mhd_assert.h"
+
+
+/**
+ * The endpoint of the route: the handler for some methods
+ */
+struct RouterEndpoint
+{
+  /**
+   * The next endpoint on the same node
+   */
+  struct RouterEndpoint *next;
+
+  /**
+   * The set of #MHD_RouteMethod flags
+   */
+  unsigned int methods;
+
+  /**
+   * The request handler
+   */
+  MHD_AccessHandlerCallback handler;
+
+  /**
+   * The closure for the @a handler
+   */
+  void *handler_cls;
+};
+
+
+/**
+ * The node of the radix tree
+ */
+struct RouterNode
+{
+  /**
+   * The label of the node, for the static children only.
+   * Points to the router's strings.
+   */
+  const char *label;
+
+  /**
+   * The length of the @a label
+   */
+  size_t label_len;
+
+  /**
+   * The first static child
+   */
+  struct RouterNode *child;
+
+  /**
+   * The next static sibling
+   */
+  struct RouterNode *sibling;
+
+  /**
+   * The parameter child, matching one non-empty path segment
+   */
+  struct RouterNode *param;
+
+  /**
+   * The wildcard child, matching the rest of the path
+   */
+  struct RouterNode *wildcard;
+
+  /**
+   * The name of the parameter or the wildcard, zero-terminated,
+   * for the parameter and the wildcard nodes only.
+   * Points to the router's strings.
+   */
+  const char *name;
+
+  /**
+   * The endpoints of the routes ending at this node
+   */
+  struct RouterEndpoint *endpoints;
+};
+
+
+/**
+ * The compiled routes
+ */
+struct MHD_Router
+{
+  /**
+   * The root of the tree, with empty label
+   */
+  struct RouterNode root;
+
+  /**
+   * The copies of the routes paths and the parameters names
+   */
+  char *strings;
+};
+
+
+/**
+ * Captured parameters during the lookup
+ */
+struct RouterCaptures
+{
+  /**
+   * The captured values, point to the request URL
+   */
+  struct MHD_RouteParam params[MHD_ROUTER_MAX_PARAMS];
+
+  /**
+   * The number of used elements in @a params
+   */
+  size_t num;
+};
+
+
+/**
+ * Allocate new empty node.
+ * @return the new node, NULL if no memory
+ */
+static struct RouterNode *
+router_node_new_ (void)
+{
+  return (struct RouterNode *) MHD_calloc_ (1, sizeof(struct RouterNode));
+}
+
+
+/**
+ * Free all children, siblings and endpoints of the node.
+ * The node itself is not freed.
+ * @param node the node to process
+ */
+static void
+router_node_clear_ (struct RouterNode *node)
+{
+  struct RouterNode *child;
+  struct RouterEndpoint *ep;
+
+  while (NULL != (child = node->child))
+  {
+    node->child = child->sibling;
+    router_node_clear_ (child);
+    free (child);
+  }
+  if (NULL != node->param)
+  {
+    router_node_clear_ (node->param);
+    free (node->param);
+  }
+  if (NULL != node->wildcard)
+  {
+    router_node_clear_ (node->wildcard);
+    free (node->wildcard);
+  }
+  while (NULL != (ep = node->endpoints))
+  {
+    node->endpoints = ep->next;
+    free (ep);
+  }
+}
+
+
+/**
+ * Insert the static part of the path into the tree.
+ * Splits existing nodes if needed.
+ * @param node the node to start from
+ * @param str the static string to insert, points to the router's strings
+ * @param len the length of the @a str
+ * @return the node corresponding to the end of @a str,
+ *         NULL if no memory
+ */
+static struct RouterNode *
+router_insert_static_ (struct RouterNode *node,
+                       const char *str,
+                       size_t len)
+{
+  while (0 != len)
+  {
+    struct RouterNode *child;
+    size_t common;
+
+    for (child = node->child; NULL != child; child = child->sibling)
+      if (child->label[0] == str[0])
+        break;
+
+    if (NULL == child)
+    {
+      child = router_node_new_ ();
+      if (NULL == child)
+        return NULL;
+      child->label = str;
+      child->label_len = len;
+      child->sibling = node->child;
+      node->child = child;
+      return child;
+    }
+
+    for (common = 1; common < len && common < child->label_len; ++common)
+      if (child->label[common] != str[common])
+        break;
+
+    if (common < child->label_len)
+    {
+      /* Split the node: move the tail of the label to the new node */
+      struct RouterNode *tail;
+
+      tail = router_node_new_ ();
+      if (NULL == tail)
+        return NULL;
+      tail->label = child->label + common;
+      tail->label_len = child->label_len - common;
+      tail->child = child->child;
+      tail->param = child->param;
+      tail->wildcard = child->wildcard;
+      tail->endpoints = child->endpoints;
+      child->label_len = common;
+      child->child = tail;
+      child->param = NULL;
+      child->wildcard = NULL;
+      child->endpoints = NULL;
+    }
+    node = child;
+    str += common;
+    len -= common;
+  }
+  return node;
+}
+
+
+/**
+ * Get the existing or create the new parameter or wildcard child.
+ * @param daemon the daemon to use for logging
+ * @param pchild the pointer to the child pointer
+ * @param name the name of the parameter, zero-terminated,
+ *             points to the router's strings
+ * @param path the path of the route, for logging
+ * @return the child node,
+ *         NULL if no memory or if the existing node has different name
+ */
+static struct RouterNode *
+router_get_named_child_ (struct MHD_Daemon *daemon,
+                         struct RouterNode **pchild,
+                         const char *name,
+                         const char *path)
+{
+  if (NULL != *pchild)
+  {
+    if (0 == strcmp ((*pchild)->name, name))
+      return *pchild;
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("The route '%s' uses parameter name '%s' where other " \
+                 "route uses name '%s'.\n"),
+              path,
+              name,
+              (*pchild)->name);
+#else  /* ! HAVE_MESSAGES */
+    (void) daemon; /* Mute compiler warning */
+    (void) path;   /* Mute compiler warning */
+#endif /* ! HAVE_MESSAGES */
+    return NULL;
+  }
+  *pchild = router_node_new_ ();
+  if (NULL == *pchild)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to allocate memory for the routes.\n"));
+#endif /* HAVE_MESSAGES */
+    return NULL;
+  }
+  (*pchild)->name = name;
+  return *pchild;
+}
+
+
+/**
+ * Add a single route to the tree.
+ * @param daemon the daemon to use for logging
+ * @param router the router to use
+ * @param route the route to add
+ * @param[in,out] pstr the pointer to the free space in the router's
+ *                     strings, updated
+ * @return true if succeed, false otherwise
+ */
+static bool
+router_add_route_ (struct MHD_Daemon *daemon,
+                   struct MHD_Router *router,
+                   const struct MHD_Route *route,
+                   char **pstr)
+{
+  const char *names[MHD_ROUTER_MAX_PARAMS];
+  size_t num_names;
+  struct RouterNode *node;
+  struct RouterEndpoint *ep;
+  const char *path;
+  size_t path_len;
+  size_t pos;
+  unsigned int methods;
+
+  if ('/' != route->path[0])
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("The route '%s' does not start with '/'.\n"),
+              route->path);
+#endif /* HAVE_MESSAGES */
+    return false;
+  }
+  if (NULL == route->handler)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("The route '%s' has no handler.\n"),
+              route->path);
+#endif /* HAVE_MESSAGES */
+    return false;
+  }
+  methods = (0 == route->methods) ?
+            ((unsigned int) MHD_ROUTE_ANY) : route->methods;
+  if (0 != (methods & ~((unsigned int) MHD_ROUTE_ANY)))
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("The route '%s' has unknown methods flags.\n"),
+              route->path);
+#endif /* HAVE_MESSAGES */
+    return false;
+  }
+
+  /* Keep the copy of the path, the static labels point to it */
+  path_len = strlen (route->path);
+  path = *pstr;
+  memcpy (*pstr, route->path, path_len + 1);
+  *pstr += path_len + 1;
+
+  node = &router->root;
+  num_names = 0;
+  pos = 0;
+  while (path_len > pos)
+  {
+    size_t static_start;
+    size_t name_start;
+    size_t name_len;
+    char *name;
+    bool is_wildcard;
+    size_t i;
+
+    /* Find the start of the next parameter */
+    static_start = pos;
+    while (path_len > pos)
+    {
+      if ( (0 != pos) && ('/' == path[pos - 1]) &&
+           ((':' == path[pos]) || ('*' == path[pos])) )
+        break;
+      pos++;
+    }
+    node = router_insert_static_ (node,
+                                  path + static_start,
+                                  pos - static_start);
+    if (NULL == node)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to allocate memory for the routes.\n"));
+#endif /* HAVE_MESSAGES */
+      return false;
+    }
+    if (path_len == pos)
+      break;
+
+    is_wildcard = ('*' == path[pos]);
+    name_start = ++pos;
+    while (path_len > pos && '/' != path[pos])
+      pos++;
+    name_len = pos - name_start;
+    if (0 == name_len)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("The route '%s' has a parameter without the name.\n"),
+                route->path);
+#endif /* HAVE_MESSAGES */
+      return false;
+    }
+    if (is_wildcard && (path_len != pos))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("The route '%s' has the wildcard not at the end.\n"),
+                route->path);
+#endif /* HAVE_MESSAGES */
+      return false;
+    }
+    if (MHD_ROUTER_MAX_PARAMS == num_names)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("The route '%s' has more than %u parameters.\n"),
+                route->path,
+                (unsigned int) MHD_ROUTER_MAX_PARAMS);
+#endif /* HAVE_MESSAGES */
+      return false;
+    }
+    name = *pstr;
+    memcpy (name, path + name_start, name_len);
+    name[name_len] = 0;
+    *pstr += name_len + 1;
+    for (i = 0; i < num_names; ++i)
+    {
+      if (0 == strcmp (names[i], name))
+      {
+#ifdef HAVE_MESSAGES
+        MHD_DLOG (daemon,
+                  _ ("The route '%s' has duplicated parameter '%s'.\n"),
+                  route->path,
+                  name);
+#endif /* HAVE_MESSAGES */
+        return false;
+      }
+    }
+    names[num_names++] = name;
+
+    node = router_get_named_child_ (daemon,
+                                    is_wildcard ? &node->wildcard :
+                                    &node->param,
+                                    name,
+                                    route->path);
+    if (NULL == node)
+      return false;
+  }
+
+  for (ep = node->endpoints; NULL != ep; ep = ep->next)
+  {
+    if (0 != (ep->methods & methods))
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("The route '%s' conflicts with other route.\n"),
+                route->path);
+#endif /* HAVE_MESSAGES */
+      return false;
+    }
+  }
+  ep = (struct RouterEndpoint *) malloc (sizeof(struct RouterEndpoint));
+  if (NULL == ep)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to allocate memory for the routes.\n"));
+#endif /* HAVE_MESSAGES */
+    return false;
+  }
+  ep->methods = methods;
+  ep->handler = route->handler;
+  ep->handler_cls = route->handler_cls;
+  ep->next = node->endpoints;
+  node->endpoints = ep;
+  return true;
+}
+
+
+struct MHD_Router *
+MHD_router_compile_ (struct MHD_Daemon *daemon,
+                     const struct MHD_Route *routes)
+{
+  struct MHD_Router *router;
+  const struct MHD_Route *r;
+  size_t strings_size;
+  char *str;
+
+  strings_size = 0;
+  for (r = routes; NULL != r->path; ++r)
+  {
+    /* The path copy and the names copies: each name is shorter than
+       the path part it was taken from */
+    strings_size += (strlen (r->path) + 1) * 2;
+  }
+
+  router = (struct MHD_Router *) MHD_calloc_ (1, sizeof(struct MHD_Router));
+  if (NULL == router)
+  {
+#ifdef HAVE_MESSAGES
+    MHD_DLOG (daemon,
+              _ ("Failed to allocate memory for the routes.\n"));
+#endif /* HAVE_MESSAGES */
+    return NULL;
+  }
+  if (0 != strings_size)
+  {
+    router->strings = (char *) malloc (strings_size);
+    if (NULL == router->strings)
+    {
+#ifdef HAVE_MESSAGES
+      MHD_DLOG (daemon,
+                _ ("Failed to allocate memory for the routes.\n"));
+#endif /* HAVE_MESSAGES */
+      free (router);
+      return NULL;
+    }
+  }
+
+  str = router->strings;
+  for (r = routes; NULL != r->path; ++r)
+  {
+    if (! router_add_route_ (daemon,
+                             router,
+                             r,
+                             &str))
+    {
+      MHD_router_destroy_ (router);
+      return NULL;
+    }
+  }
+  mhd_assert ((size_t) (str - router->strings) <= strings_size);
+  return router;
+}
+
+
+void
+MHD_router_destroy_ (struct MHD_Router *router)
+{
+  if (NULL == router)
+    return;
+  router_node_clear_ (&router->root);
+  if (NULL != router->strings)
+    free (router->strings);
+  free (router);
+}
+
+
+/**
+ * Find the endpoint for the remaining part of the URL.
+ * @param node the node to start from, the label of the node is
+ *             already matched
+ * @param url the remaining part of the URL
+ * @param method the #MHD_RouteMethod flag of the request method
+ * @param[in,out] caps the captured parameters
+ * @return the found endpoint, NULL if no match
+ */
+static const struct RouterEndpoint *
+router_match_ (const struct RouterNode *node,
+               const char *url,
+               unsigned int method,
+               struct RouterCaptures *caps)
+{
+  const struct RouterEndpoint *ep;
+  const struct RouterNode *child;
+
+  if (0 == url[0])
+  {
+    for (ep = node->endpoints; NULL != ep; ep = ep->next)
+      if (0 != (ep->methods & method))
+        return ep;
+  }
+  else
+  {
+    /* Static labels */
+    for (child = node->child; NULL != child; child = child->sibling)
+    {
+      if (child->label[0] != url[0])
+        continue;
+      if (0 == strncmp (child->label, url, child->label_len))
+      {
+        ep = router_match_ (child,
+                            url + child->label_len,
+                            method,
+                            caps);
+        if (NULL != ep)
+          return ep;
+      }
+      break; /* Only one child can start with the same character */
+    }
+
+    /* Parameter */
+    if ((NULL != node->param) && ('/' != url[0]))
+    {
+      size_t seg_len;
+
+      mhd_assert (MHD_ROUTER_MAX_PARAMS > caps->num);
+      for (seg_len = 1; 0 != url[seg_len] && '/' != url[seg_len]; ++seg_len)
+        (void) 0;
+      caps->params[caps->num].name = node->param->name;
+      caps->params[caps->num].value = url;
+      caps->params[caps->num].value_len = seg_len;
+      caps->num++;
+      ep = router_match_ (node->param,
+                          url + seg_len,
+                          method,
+                          caps);
+      if (NULL != ep)
+        return ep;
+      caps->num--;
+    }
+  }
+
+  /* Wildcard, including the empty remaining part */
+  if (NULL != node->wildcard)
+  {
+    for (ep = node->wildcard->endpoints; NULL != ep; ep = ep->next)
+    {
+      if (0 != (ep->methods & method))
+      {
+        mhd_assert (MHD_ROUTER_MAX_PARAMS > caps->num);
+        caps->params[caps->num].name = node->wildcard->name;
+        caps->params[caps->num].value = url;
+        caps->params[caps->num].value_len = strlen (url);
+        caps->num++;
+        return ep;
+      }
+    }
+  }
+  return NULL;
+}
+
+
+/**
+ * Get the #MHD_RouteMethod flag for the request method.
+ * @param c the connection to use
+ * @return the flag of the method
+ */
+static unsigned int
+router_get_method_flag_ (struct MHD_Connection *c)
+{
+  switch (c->rq.http_mthd)
+  {
+  case MHD_HTTP_MTHD_GET:
+    return MHD_ROUTE_GET;
+  case MHD_HTTP_MTHD_HEAD:
+    return MHD_ROUTE_HEAD;
+  case MHD_HTTP_MTHD_POST:
+    return MHD_ROUTE_POST;
+  case MHD_HTTP_MTHD_PUT:
+    return MHD_ROUTE_PUT;
+  case MHD_HTTP_MTHD_DELETE:
+    return MHD_ROUTE_DELETE;
+  case MHD_HTTP_MTHD_CONNECT:
+    return MHD_ROUTE_CONNECT;
+  case MHD_HTTP_MTHD_OPTIONS:
+    return MHD_ROUTE_OPTIONS;
+  case MHD_HTTP_MTHD_TRACE:
+    return MHD_ROUTE_TRACE;
+  case MHD_HTTP_MTHD_OTHER:
+  case MHD_HTTP_MTHD_NO_METHOD:
+  default:
+    break;
+  }
+  return MHD_ROUTE_OTHER;
+}
+
+
+bool
+MHD_router_route_ (struct MHD_Connection *c)
+{
+  struct MHD_Daemon *const daemon = c->daemon;
+  const struct MHD_Router *const router = MHD_get_master (daemon)->router;
+  const struct RouterEndpoint *ep;
+  struct RouterCaptures caps;
+  struct MHD_RouteParam *params;
+  size_t i;
+
+  c->rq.handler = daemon->default_handler;
+  c->rq.handler_cls = daemon->default_handler_cls;
+  c->rq.route_params = NULL;
+  c->rq.num_route_params = 0;
+
+  if (NULL == router)
+    return true;
+  mhd_assert (NULL != c->rq.url);
+
+  caps.num = 0;
+  ep = router_match_ (&router->root,
+                      c->rq.url,
+                      router_get_method_flag_ (c),
+                      &caps);
+  if (NULL == ep)
+    return true;
+
+  if (0 != caps.num)
+  {
+    params = (struct MHD_RouteParam *)
+             MHD_pool_allocate (c->pool,
+                                sizeof(struct MHD_RouteParam) * caps.num,
+                                true);
+    if (NULL == params)
+      return false;
+    for (i = 0; i < caps.num; ++i)
+    {
+      char *value;
+
+      value = (char *) MHD_pool_allocate (c->pool,
+                                          caps.params[i].value_len + 1,
+                                          true);
+      if (NULL == value)
+        return false;
+      memcpy (value, caps.params[i].value, caps.params[i].value_len);
+      value[caps.params[i].value_len] = 0;
+      params[i].name = caps.params[i].name;
+      params[i].value = value;
+      params[i].value_len = caps.params[i].value_len;
+    }
+    c->rq.route_params = params;
+    c->rq.num_route_params = caps.num;
+  }
+  c->rq.handler = ep->handler;
+  c->rq.handler_cls = ep->handler_cls;
+  return true;
+}
+
+
+_MHD_EXTERN const char *
+MHD_get_route_param (struct MHD_Connection *connection,
+                     const char *name)
+{
+  size_t i;
+
+  if ((NULL == connection) || (NULL == name))
+    return NULL;
+  for (i = 0; i < connection->rq.num_route_params; ++i)
+  {
+    if (0 == strcmp (connection->rq.route_params[i].name, name))
+      return connection->rq.route_params[i].value;
+  }
+  return NULL;
+}
@@ -0,0 +1,105 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/router.h
+ * @brief  Declarations for the built-in URL router
+ * @author agent
+ */
+
+#ifndef MHD_ROUTER_H
+#define MHD_ROUTER_H 1
+
+#include "mhd_options.h"
+#ifdef HAVE_STDDEF_H
+#include <stddef.h>
+#endif /* HAVE_STDDEF_H */
+#ifdef HAVE_STDBOOL_H
+#include <stdbool.h>
+#endif /* HAVE_STDBOOL_H */
+
+/* Forward declarations to avoid include of the large headers */
+struct MHD_Daemon;
+struct MHD_Connection;
+struct MHD_Route;
+struct MHD_Router;
+
+/**
+ * The maximum number of path parameters in a single route.
+ */
+#define MHD_ROUTER_MAX_PARAMS 16
+
+/**
+ * Path parameter captured by the router for the current request.
+ * Allocated in the connection's pool.
+ */
+struct MHD_RouteParam
+{
+  /**
+   * The name of the parameter, points to the router's memory.
+   */
+  const char *name;
+
+  /**
+   * The value of the parameter, zero-terminated, allocated in
+   * the connection's pool.
+   */
+  const char *value;
+
+  /**
+   * The length of the @a value, not including zero-termination.
+   */
+  size_t value_len;
+};
+
+/**
+ * Compile the application-provided routes into the radix tree.
+ *
+ * @param daemon the daemon to use for logging
+ * @param routes the array of routes, terminated by the entry with
+ *               NULL path
+ * @return the pointer to the compiled router,
+ *         NULL if the routes are invalid, conflicting or if no memory
+ */
+struct MHD_Router *
+MHD_router_compile_ (struct MHD_Daemon *daemon,
+                     const struct MHD_Route *routes);
+
+/**
+ * Free the router and all its resources.
+ *
+ * @param router the router to free, could be NULL
+ */
+void
+MHD_router_destroy_ (struct MHD_Router *router);
+
+/**
+ * Resolve the request handler for the connection's current request.
+ *
+ * Must be called when the request URL and method are already known.
+ * Sets the request's handler and (if any) the path parameters.
+ * If no route matches, then the default handler is used.
+ * @param c the connection to process
+ * @return true if succeed,
+ *         false if no memory in the connection's pool
+ */
+bool
+MHD_router_route_ (struct MHD_Connection *c);
+
+#endif /* ! MHD_ROUTER_H */
@@ -0,0 +1,99 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_conn_layout.c
+ * @brief  Check the memory layout of struct MHD_Connection: the members
+ *         used by the event loop must fit the first cache lines
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <stddef.h>
+#include "internal.h"
+
+/**
+ * The assumed size of the CPU cache line
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * The maximum number of the cache lines used by the members
+ * accessed by the event loop
+ */
+#define HOT_CACHE_LINES 3
+
+/**
+ * The offset of the first byte after the member of the connection
+ */
+#define CONN_MEMBER_END(member) \
+  (offsetof (struct MHD_Connection, member) \
+   + sizeof(((struct MHD_Connection *) NULL)->member))
+
+/**
+ * Check that the member is placed in the "hot" part of the connection
+ */
+#define CHECK_HOT_MEMBER(member) \
+  check_hot_member (#member, CONN_MEMBER_END (member))
+
+
+static unsigned int
+check_hot_member (const char *name, size_t end_offset)
+{
+  if (CACHE_LINE_SIZE * HOT_CACHE_LINES >= end_offset)
+    return 0;
+  fprintf (stderr, "The member '%s' of struct MHD_Connection ends at "
+           "the offset %u, which is beyond the first %u cache lines.\n",
+           name, (unsigned int) end_offset, (unsigned int) HOT_CACHE_LINES);
+  return 1;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned int errcount = 0;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  errcount += CHECK_HOT_MEMBER (next);
+  errcount += CHECK_HOT_MEMBER (socket_fd);
+  errcount += CHECK_HOT_MEMBER (event_loop_info);
+  errcount += CHECK_HOT_MEMBER (state);
+#ifdef EPOLL_SUPPORT
+  errcount += CHECK_HOT_MEMBER (epoll_state);
+  errcount += CHECK_HOT_MEMBER (nextE);
+#endif /* EPOLL_SUPPORT */
+  errcount += CHECK_HOT_MEMBER (suspended);
+  errcount += CHECK_HOT_MEMBER (resuming);
+  errcount += CHECK_HOT_MEMBER (nextX);
+  errcount += CHECK_HOT_MEMBER (daemon);
+  errcount += CHECK_HOT_MEMBER (last_activity);
+  errcount += CHECK_HOT_MEMBER (connection_timeout_ms);
+  errcount += CHECK_HOT_MEMBER (read_buffer_offset);
+  errcount += CHECK_HOT_MEMBER (write_buffer_append_offset);
+  errcount += CHECK_HOT_MEMBER (keepalive);
+
+  if (0 == errcount)
+    printf ("struct MHD_Connection: %u bytes, the event loop members "
+            "use %u bytes.\n",
+            (unsigned int) sizeof(struct MHD_Connection),
+            (unsigned int) CONN_MEMBER_END (keepalive));
+  return (0 == errcount) ? 0 : 1;
+}
@@ -0,0 +1,738 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_drain.c
+ * @brief  Check MHD_drain_daemon(): the idle keep-alive connections must be
+ *         closed, the request in progress must be completed with
+ *         "Connection: close" and the request not completed before
+ *         the deadline must be closed forcibly; the idle connection must
+ *         be handed off to another daemon without closing
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "microhttpd.h"
+
+#ifndef MHD_STATICSTR_LEN_
+/**
+ * Determine length of static string / macro strings at compile time.
+ */
+#define MHD_STATICSTR_LEN_(macro) (sizeof(macro) / sizeof(char) - 1)
+#endif /* ! MHD_STATICSTR_LEN_ */
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+#define REQ_GET "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define REQ_GET_LATE "GET /late HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define REQ_PUT_HDR "PUT / HTTP/1.1\r\nHost: localhost\r\n" \
+  "Content-Length: 5\r\n\r\n"
+#define REQ_PUT_BODY1 "ab"
+#define REQ_PUT_BODY2 "cde"
+#define RESP_BODY "OK"
+
+/**
+ * Set to non-zero when the request is started to be processed
+ */
+static volatile int request_started;
+
+/**
+ * The number of the completed requests
+ */
+static volatile unsigned int requests_completed;
+
+/**
+ * The daemon to drain when the reply for "/late" is being sent
+ */
+static struct MHD_Daemon *late_drain_daemon;
+
+/**
+ * The result of MHD_drain_daemon() called when the reply for "/late" is
+ * being sent
+ */
+static volatile enum MHD_Result late_drain_res;
+
+/**
+ * The number of calls of the drain callback
+ */
+static volatile unsigned int drain_calls;
+
+/**
+ * The last number of connections reported by the drain callback
+ */
+static volatile unsigned int drain_left;
+
+/**
+ * Set to non-zero while the drain callback is running
+ */
+static volatile int in_drain_cb;
+
+/**
+ * The number of calls of the drain callback made while another call
+ * was running
+ */
+static volatile unsigned int drain_overlaps;
+
+/**
+ * The local socket used to send the handed off connections
+ */
+static int handoff_sock;
+
+/**
+ * The number of the connections handed off successfully
+ */
+static volatile unsigned int handoff_calls;
+
+
+static void
+drain_cb (void *cls,
+          unsigned int connections_left)
+{
+  (void) cls; /* Unused. Silence compiler warning. */
+  if (in_drain_cb)
+    drain_overlaps++;
+  in_drain_cb = ! 0;
+  /* Give other threads the chance to call the callback at the same time */
+  (void) usleep (1000);
+  drain_left = connections_left;
+  drain_calls++;
+  in_drain_cb = 0;
+}
+
+
+static void
+handoff_cb (void *cls,
+            MHD_socket sock,
+            const struct sockaddr *addr,
+            socklen_t addrlen)
+{
+  (void) cls; (void) addr; (void) addrlen; /* Unused. Silence compiler warning. */
+  if (MHD_YES == MHD_handoff_send_socket (handoff_sock, sock))
+    handoff_calls++;
+  else
+    fprintf (stderr, "MHD_handoff_send_socket() failed: %s\n",
+             strerror (errno));
+  close (sock);
+}
+
+
+static void
+completed_cb (void *cls,
+              struct MHD_Connection *connection,
+              void **req_cls,
+              enum MHD_RequestTerminationCode toe)
+{
+  (void) cls; (void) connection; (void) req_cls; /* Unused. Silence compiler warning. */
+  if (MHD_REQUEST_TERMINATED_COMPLETED_OK == toe)
+    requests_completed++;
+}
+
+
+/**
+ * Provide the reply body and start draining: the reply header has been
+ * built already without "Connection: close"
+ */
+static ssize_t
+late_reader (void *cls,
+             uint64_t pos,
+             char *buf,
+             size_t max)
+{
+  (void) cls; /* Unused. Silence compiler warning. */
+  if ((0 != pos) || (MHD_STATICSTR_LEN_ (RESP_BODY) > max))
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  late_drain_res = MHD_drain_daemon (late_drain_daemon, TIMEOUT_SEC * 1000);
+  memcpy (buf, RESP_BODY, MHD_STATICSTR_LEN_ (RESP_BODY));
+  return (ssize_t) MHD_STATICSTR_LEN_ (RESP_BODY);
+}
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; /* Unused. Silence compiler warning. */
+
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    request_started = ! 0;
+    return MHD_YES;
+  }
+  if (0 != *upload_data_size)
+  {
+    *upload_data_size = 0;
+    return MHD_YES;
+  }
+  if (0 == strcmp (url, "/late"))
+    response =
+      MHD_create_response_from_callback (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                         1024, &late_reader, NULL, NULL);
+  else
+    response =
+      MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                              RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+connect_to (uint16_t port)
+{
+  struct sockaddr_in sa;
+  struct timeval tv;
+  int s;
+
+  s = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > s)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return -1;
+  }
+  tv.tv_sec = TIMEOUT_SEC;
+  tv.tv_usec = 0;
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != connect (s, (struct sockaddr *) &sa, sizeof(sa))) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (s);
+    return -1;
+  }
+  return s;
+}
+
+
+static int
+send_str (int s, const char *str)
+{
+  if ((ssize_t) strlen (str) == send (s, str, strlen (str), 0))
+    return 0;
+  fprintf (stderr, "send() failed: %s\n", strerror (errno));
+  return 1;
+}
+
+
+/**
+ * Receive the full reply
+ * @param s the socket to use
+ * @param must_close set to non-zero if "Connection: close" header is
+ *                   required in the reply, to zero if the header must
+ *                   not be used
+ * @return zero on success, non-zero otherwise
+ */
+static int
+get_reply (int s, int must_close)
+{
+  char buf[1024];
+  size_t len = 0;
+
+  while (sizeof(buf) - 1 > len)
+  {
+    const char *hdr_end;
+    ssize_t res;
+
+    res = recv (s, buf + len, sizeof(buf) - 1 - len, 0);
+    if (0 >= res)
+    {
+      fprintf (stderr, "Failed to receive the reply: %s\n",
+               (0 == res) ? "connection closed" : strerror (errno));
+      return 1;
+    }
+    len += (size_t) res;
+    buf[len] = 0;
+    hdr_end = strstr (buf, "\r\n\r\n");
+    if ( (NULL != hdr_end) &&
+         (0 == strcmp (hdr_end + 4, RESP_BODY)) )
+    {
+      if ((NULL != strstr (buf, "\r\nConnection: close\r\n")) ==
+          (0 != must_close))
+        return 0;
+      fprintf (stderr, "Wrong 'Connection' header in the reply:\n%s\n", buf);
+      return 1;
+    }
+  }
+  fprintf (stderr, "The reply is too large.\n");
+  return 1;
+}
+
+
+/**
+ * Check that the connection has been closed by the server
+ * @param s the socket to check
+ * @param allow_reset set to non-zero to accept the reset of the connection
+ * @return zero if connection has been closed, non-zero otherwise
+ */
+static int
+check_closed (int s, int allow_reset)
+{
+  char c;
+  ssize_t res;
+
+  res = recv (s, &c, 1, 0);
+  if (0 == res)
+    return 0;
+  if ((0 > res) && allow_reset && (ECONNRESET == errno))
+    return 0;
+  fprintf (stderr, "The connection has not been closed by the server: %s\n",
+           (0 < res) ? "unexpected data" : strerror (errno));
+  return 1;
+}
+
+
+static int
+wait_for_request (void)
+{
+  const time_t start = time (NULL);
+
+  while (! request_started)
+  {
+    if (TIMEOUT_SEC < time (NULL) - start)
+    {
+      fprintf (stderr, "Timeout waiting for the request processing.\n");
+      return 1;
+    }
+    usleep (1000);
+  }
+  return 0;
+}
+
+
+/**
+ * Wait until the server has finished the requests.
+ * The completion is notified when the connection is being reset, after
+ * the decision to keep the connection alive, so the connection becomes
+ * idle regardless of the start of draining after this point.
+ * @param num the number of the completed requests to wait for
+ * @return zero on success, non-zero on timeout
+ */
+static int
+wait_for_completed (unsigned int num)
+{
+  const time_t start = time (NULL);
+
+  while (num > requests_completed)
+  {
+    if (TIMEOUT_SEC < time (NULL) - start)
+    {
+      fprintf (stderr, "Timeout waiting for the request completion.\n");
+      return 1;
+    }
+    usleep (1000);
+  }
+  return 0;
+}
+
+
+static int
+wait_for_drained (void)
+{
+  const time_t start = time (NULL);
+
+  while ((0 == drain_calls) || (0 != drain_left))
+  {
+    if (TIMEOUT_SEC < time (NULL) - start)
+    {
+      fprintf (stderr, "Timeout waiting for draining, %u connections "
+               "reported.\n", (unsigned int) drain_left);
+      return 1;
+    }
+    usleep (1000);
+  }
+  if (0 != drain_overlaps)
+  {
+    fprintf (stderr, "The drain callback has been called %u times while "
+             "running already.\n", (unsigned int) drain_overlaps);
+    return 1;
+  }
+  return 0;
+}
+
+
+static struct MHD_Daemon *
+start_daemon (unsigned int flags, unsigned int pool_size, int handoff,
+              uint16_t *port)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+
+  request_started = 0;
+  requests_completed = 0;
+  late_drain_res = MHD_NO;
+  drain_calls = 0;
+  drain_left = 0;
+  in_drain_cb = 0;
+  drain_overlaps = 0;
+  handoff_calls = 0;
+  d = MHD_start_daemon (flags | MHD_USE_INTERNAL_POLLING_THREAD
+                        | MHD_USE_ITC | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_NOTIFY_COMPLETED, &completed_cb, NULL,
+                        MHD_OPTION_DRAIN_CALLBACK, &drain_cb, NULL,
+                        MHD_OPTION_DRAIN_HANDOFF_CALLBACK,
+                        handoff ? &handoff_cb : NULL, NULL,
+                        MHD_OPTION_THREAD_POOL_SIZE, pool_size,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return NULL;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return NULL;
+  }
+  *port = dinfo->port;
+  return d;
+}
+
+
+/**
+ * Check closing of the idle connection and completing of the request
+ * in progress.
+ */
+static unsigned int
+test_graceful (unsigned int flags, unsigned int pool_size)
+{
+  struct MHD_Daemon *d;
+  uint16_t port;
+  int idle_s;
+  int active_s;
+  unsigned int ret = 1;
+
+  d = start_daemon (flags, pool_size, 0, &port);
+  if (NULL == d)
+    return 1;
+  idle_s = connect_to (port);
+  active_s = connect_to (port);
+  if ((0 > idle_s) || (0 > active_s))
+    goto cleanup;
+  if ( (0 != send_str (idle_s, REQ_GET)) ||
+       (0 != get_reply (idle_s, 0)) ||
+       (0 != wait_for_completed (1)) )
+    goto cleanup;
+  request_started = 0;
+  if ( (0 != send_str (active_s, REQ_PUT_HDR REQ_PUT_BODY1)) ||
+       (0 != wait_for_request ()) )
+    goto cleanup;
+  if (MHD_YES != MHD_drain_daemon (d, TIMEOUT_SEC * 1000))
+  {
+    fprintf (stderr, "MHD_drain_daemon() failed.\n");
+    goto cleanup;
+  }
+  if (MHD_NO != MHD_drain_daemon (d, TIMEOUT_SEC * 1000))
+  {
+    fprintf (stderr, "The repeated MHD_drain_daemon() succeed.\n");
+    goto cleanup;
+  }
+  if (0 != check_closed (idle_s, 0))
+    goto cleanup;
+  if ( (0 != send_str (active_s, REQ_PUT_BODY2)) ||
+       (0 != get_reply (active_s, ! 0)) ||
+       (0 != check_closed (active_s, 0)) )
+    goto cleanup;
+  if (0 != wait_for_drained ())
+    goto cleanup;
+  ret = 0;
+
+cleanup:
+  if (0 <= idle_s)
+    close (idle_s);
+  if (0 <= active_s)
+    close (active_s);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+/**
+ * Check closing of the request not completed before the deadline.
+ */
+static unsigned int
+test_deadline (unsigned int flags, unsigned int pool_size)
+{
+  struct MHD_Daemon *d;
+  uint16_t port;
+  int s;
+  unsigned int ret = 1;
+
+  d = start_daemon (flags, pool_size, 0, &port);
+  if (NULL == d)
+    return 1;
+  s = connect_to (port);
+  if (0 > s)
+    goto cleanup;
+  if ( (0 != send_str (s, REQ_PUT_HDR REQ_PUT_BODY1)) ||
+       (0 != wait_for_request ()) )
+    goto cleanup;
+  if (MHD_YES != MHD_drain_daemon (d, 100))
+  {
+    fprintf (stderr, "MHD_drain_daemon() failed.\n");
+    goto cleanup;
+  }
+  if ( (0 != check_closed (s, ! 0)) ||
+       (0 != wait_for_drained ()) )
+    goto cleanup;
+  ret = 0;
+
+cleanup:
+  if (0 <= s)
+    close (s);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+/**
+ * Check handing off of the idle connection to another daemon.
+ * @param late set to non-zero to start draining when the reply is being
+ *             sent with the keep-alive connection, before the connection
+ *             is reset to the idle state
+ */
+static unsigned int
+test_handoff (unsigned int flags, unsigned int pool_size, int late)
+{
+  struct MHD_Daemon *d;
+  struct MHD_Daemon *d2 = NULL;
+  uint16_t port;
+  int pair[2];
+  int s = -1;
+  MHD_socket conn;
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  unsigned int ret = 1;
+
+  if (0 != socketpair (AF_UNIX, SOCK_STREAM, 0, pair))
+  {
+    fprintf (stderr, "socketpair() failed: %s\n", strerror (errno));
+    return 1;
+  }
+  handoff_sock = pair[0];
+  d = start_daemon (flags, pool_size, ! 0, &port);
+  if (NULL == d)
+    goto cleanup;
+  s = connect_to (port);
+  if (0 > s)
+    goto cleanup;
+  late_drain_daemon = d;
+  if ( (0 != send_str (s, late ? REQ_GET_LATE : REQ_GET)) ||
+       (0 != get_reply (s, 0)) ||
+       (0 != wait_for_completed (1)) )
+    goto cleanup;
+  if (late ? (MHD_YES != late_drain_res) :
+      (MHD_YES != MHD_drain_daemon (d, TIMEOUT_SEC * 1000)))
+  {
+    fprintf (stderr, "MHD_drain_daemon() failed.\n");
+    goto cleanup;
+  }
+  if (0 != wait_for_drained ())
+    goto cleanup;
+  if (1 != handoff_calls)
+  {
+    fprintf (stderr, "The connection has not been handed off.\n");
+    goto cleanup;
+  }
+  MHD_stop_daemon (d);
+  d = NULL;
+
+  conn = MHD_handoff_receive_socket (pair[1]);
+  if (MHD_INVALID_SOCKET == conn)
+  {
+    fprintf (stderr, "MHD_handoff_receive_socket() failed.\n");
+    goto cleanup;
+  }
+  d2 = MHD_start_daemon (flags | MHD_USE_INTERNAL_POLLING_THREAD
+                         | MHD_USE_ITC | MHD_USE_NO_LISTEN_SOCKET
+                         | MHD_USE_ERROR_LOG,
+                         0, NULL, NULL,
+                         &ahc_echo, NULL,
+                         MHD_OPTION_THREAD_POOL_SIZE, pool_size,
+                         MHD_OPTION_END);
+  if ( (NULL == d2) ||
+       (0 != getpeername (conn, (struct sockaddr *) &addr, &addrlen)) ||
+       (MHD_YES != MHD_add_connection (d2, conn,
+                                       (struct sockaddr *) &addr, addrlen)) )
+  {
+    fprintf (stderr, "Failed to add the handed off connection.\n");
+    close (conn);
+    goto cleanup;
+  }
+  /* The same client connection is served by the new daemon */
+  if ( (0 != send_str (s, REQ_GET)) ||
+       (0 != get_reply (s, 0)) )
+    goto cleanup;
+  ret = 0;
+
+cleanup:
+  if (0 <= s)
+    close (s);
+  if (NULL != d)
+    MHD_stop_daemon (d);
+  if (NULL != d2)
+    MHD_stop_daemon (d2);
+  close (pair[0]);
+  close (pair[1]);
+  return ret;
+}
+
+
+/**
+ * Check that the wrong handoff message is rejected and the sockets
+ * received with it are closed.
+ * @param num_fds the number of the sockets to send in the message
+ */
+static unsigned int
+test_handoff_wrong (unsigned int num_fds)
+{
+  union
+  {
+    struct cmsghdr hdr;
+    char buf[CMSG_SPACE (sizeof(int) * 4)];
+  } ctrl;
+  struct msghdr msg;
+  struct iovec iov;
+  struct cmsghdr *cmsg;
+  char marker = 'h';
+  int pair[2];
+  int payload[2];
+  unsigned int i;
+  unsigned int ret = 0;
+  char c;
+
+  if ( (0 != socketpair (AF_UNIX, SOCK_STREAM, 0, pair)) ||
+       (0 != socketpair (AF_UNIX, SOCK_STREAM, 0, payload)) )
+  {
+    fprintf (stderr, "socketpair() failed: %s\n", strerror (errno));
+    return 1;
+  }
+  memset (&msg, 0, sizeof(msg));
+  memset (&ctrl, 0, sizeof(ctrl));
+  iov.iov_base = &marker;
+  iov.iov_len = sizeof(marker);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl.buf;
+  msg.msg_controllen = CMSG_SPACE (sizeof(int) * num_fds);
+  cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof(int) * num_fds);
+  for (i = 0; i < num_fds; ++i)
+    memcpy (CMSG_DATA (cmsg) + sizeof(int) * i, &payload[1], sizeof(int));
+  if (sizeof(marker) != sendmsg (pair[0], &msg, 0))
+  {
+    fprintf (stderr, "sendmsg() failed: %s\n", strerror (errno));
+    ret = 1;
+  }
+  close (payload[1]);
+  if ( (0 == ret) &&
+       (MHD_INVALID_SOCKET != MHD_handoff_receive_socket (pair[1])) )
+  {
+    fprintf (stderr, "The message with %u sockets has been accepted.\n",
+             num_fds);
+    ret = 1;
+  }
+  /* All copies of the sent socket must be closed */
+  if ( (0 == ret) &&
+       (0 != recv (payload[0], &c, 1, MSG_DONTWAIT)) )
+  {
+    fprintf (stderr, "The sockets received with the wrong message "
+             "have not been closed.\n");
+    ret = 1;
+  }
+  close (payload[0]);
+  close (pair[0]);
+  close (pair[1]);
+  return ret;
+}
+
+
+static unsigned int
+test_mode (const char *name, unsigned int flags, unsigned int pool_size)
+{
+  unsigned int errcount = 0;
+
+  errcount += test_graceful (flags, pool_size);
+  errcount += test_deadline (flags, pool_size);
+  errcount += test_handoff (flags, pool_size, 0);
+  errcount += test_handoff (flags, pool_size, ! 0);
+  if (0 != errcount)
+    fprintf (stderr, "Draining failed with %s.\n", name);
+  return errcount;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned int errcount = 0;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  /* The marker with two sockets and with the truncated control data */
+  errcount += test_handoff_wrong (2);
+  errcount += test_handoff_wrong (4);
+  errcount += test_mode ("select()", MHD_USE_SELECT_INTERNALLY, 0);
+  errcount += test_mode ("thread per connection",
+                         MHD_USE_THREAD_PER_CONNECTION, 0);
+  if (MHD_NO != MHD_is_feature_supported (MHD_FEATURE_POLL))
+  {
+    errcount += test_mode ("poll()", MHD_USE_POLL, 0);
+    errcount += test_mode ("thread per connection with poll()",
+                           MHD_USE_THREAD_PER_CONNECTION | MHD_USE_POLL, 0);
+  }
+  if (MHD_NO != MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+  {
+    errcount += test_mode ("epoll", MHD_USE_EPOLL, 0);
+    errcount += test_mode ("epoll with thread pool", MHD_USE_EPOLL, 2);
+  }
+  return (0 == errcount) ? 0 : 1;
+}
@@ -0,0 +1,402 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_epoll_busy_poll.c
+ * @brief  Check that the epoll event loop spins for the busy polling time:
+ *         the data arrived within the busy polling time is picked up
+ *         without the blocking wait, and the loop blocks for the rest of
+ *         the timeout when no data arrived
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "internal.h"
+#include "mhd_mono_clock.h"
+
+/**
+ * The busy polling time, in microseconds
+ */
+#define BUSY_POLL_USEC 100000
+
+/**
+ * The delay of the request, in milliseconds, shorter than the busy
+ * polling time
+ */
+#define REQUEST_DELAY_MS 20
+
+/**
+ * The timeout of the event loop, in milliseconds, longer than the busy
+ * polling time
+ */
+#define LOOP_TIMEOUT_MS 300
+
+/**
+ * The allowed inaccuracy of the time measurements, in milliseconds
+ */
+#define TIME_SLACK_MS 10
+
+/**
+ * The number of attempts to send the request within the busy polling time
+ */
+#define SEND_ATTEMPTS 5
+
+/**
+ * The exit code of the child process which has sent the request too late
+ */
+#define CHILD_LATE 2
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+#define REQ_NORMAL "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define RESP_BODY "OK"
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) url; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    return MHD_YES;
+  }
+  response =
+    MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                            RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Run the daemon until the full reply is received by the client
+ * @return zero on success, non-zero otherwise
+ */
+static int
+get_reply (struct MHD_Daemon *d, int clnt)
+{
+  char buf[1024];
+  size_t len = 0;
+  const time_t start = time (NULL);
+
+  while (TIMEOUT_SEC >= time (NULL) - start)
+  {
+    const char *hdr_end;
+    ssize_t res;
+
+    res = recv (clnt, buf + len, sizeof(buf) - 1 - len, 0);
+    if (0 == res)
+    {
+      fprintf (stderr, "The connection has been closed by the server.\n");
+      return 1;
+    }
+    if (0 > res)
+    {
+      if ((EAGAIN != errno) && (EWOULDBLOCK != errno) && (EINTR != errno))
+      {
+        fprintf (stderr, "recv() failed: %s\n", strerror (errno));
+        return 1;
+      }
+      if (MHD_YES != MHD_run_wait (d, 10))
+      {
+        fprintf (stderr, "MHD_run_wait() failed.\n");
+        return 1;
+      }
+      continue;
+    }
+    len += (size_t) res;
+    buf[len] = 0;
+    hdr_end = strstr (buf, "\r\n\r\n");
+    if ( (NULL != hdr_end) &&
+         (0 == strcmp (hdr_end + 4, RESP_BODY)) )
+      return 0;
+    if (sizeof(buf) - 1 == len)
+    {
+      fprintf (stderr, "The reply is too large.\n");
+      return 1;
+    }
+  }
+  fprintf (stderr, "Timeout waiting for the reply.\n");
+  return 1;
+}
+
+
+/**
+ * Send the request from the child process after the delay
+ * @param clnt the client socket
+ * @param start_ms the start time of the test, taken before the fork
+ * @return the PID of the child process, -1 on error
+ */
+static pid_t
+send_delayed (int clnt, uint64_t start_ms)
+{
+  pid_t pid;
+
+  pid = fork ();
+  if (0 != pid)
+    return pid;
+  (void) usleep (REQUEST_DELAY_MS * 1000);
+  if ((ssize_t) MHD_STATICSTR_LEN_ (REQ_NORMAL) !=
+      send (clnt, REQ_NORMAL, MHD_STATICSTR_LEN_ (REQ_NORMAL), 0))
+    _exit (1);
+  /* The child may be scheduled late, for example on the single CPU
+     occupied by the busy polling */
+  if (MHD_monotonic_msec_counter () - start_ms + TIME_SLACK_MS >
+      BUSY_POLL_USEC / 1000)
+    _exit (CHILD_LATE);
+  _exit (0);
+}
+
+
+static unsigned int
+test_busy_poll (struct MHD_Daemon *d, uint16_t port, bool busy_poll)
+{
+  struct sockaddr_in sa;
+  size_t hits;
+  size_t misses;
+  uint64_t start_ms;
+  uint64_t elapsed_ms;
+  pid_t child;
+  int child_status;
+  int clnt;
+  unsigned int attempt;
+  unsigned int ret;
+
+  clnt = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > clnt)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return 1;
+  }
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != connect (clnt, (struct sockaddr *) &sa, sizeof(sa))) ||
+       (0 != fcntl (clnt, F_SETFL, fcntl (clnt, F_GETFL) | O_NONBLOCK)) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (clnt);
+    return 1;
+  }
+  start_ms = MHD_monotonic_msec_counter ();
+  while ( (NULL == d->connections_head) &&
+          (TIMEOUT_SEC * 1000 >= MHD_monotonic_msec_counter () - start_ms) )
+  {
+    if (MHD_YES != MHD_run_wait (d, 10))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      close (clnt);
+      return 1;
+    }
+  }
+  if (NULL == d->connections_head)
+  {
+    fprintf (stderr, "The connection has not been accepted.\n");
+    close (clnt);
+    return 1;
+  }
+  /* Process all pending events without waiting */
+  (void) MHD_run (d);
+
+  ret = 0;
+  for (attempt = 1; attempt <= SEND_ATTEMPTS; ++attempt)
+  {
+    bool child_late;
+
+    hits = d->epoll_busy_poll_hits;
+    misses = d->epoll_busy_poll_misses;
+    start_ms = MHD_monotonic_msec_counter ();
+    child = send_delayed (clnt, start_ms);
+    if (0 > child)
+    {
+      fprintf (stderr, "fork() failed: %s\n", strerror (errno));
+      close (clnt);
+      return 1;
+    }
+    if (MHD_YES != MHD_run_wait (d, LOOP_TIMEOUT_MS))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      ret = 1;
+    }
+    elapsed_ms = MHD_monotonic_msec_counter () - start_ms;
+    child_late = false;
+    if ( (child != waitpid (child, &child_status, 0)) ||
+         ! WIFEXITED (child_status) )
+    {
+      fprintf (stderr, "Failed to send the request.\n");
+      ret = 1;
+    }
+    else if (CHILD_LATE == WEXITSTATUS (child_status))
+      child_late = true;
+    else if (0 != WEXITSTATUS (child_status))
+    {
+      fprintf (stderr, "Failed to send the request.\n");
+      ret = 1;
+    }
+    if (0 != ret)
+    {
+      close (clnt);
+      return ret;
+    }
+    if (elapsed_ms + TIME_SLACK_MS < REQUEST_DELAY_MS)
+    {
+      fprintf (stderr, "The event loop has returned before the request "
+               "was sent.\n");
+      ret = 1;
+    }
+    if (busy_poll && ! child_late &&
+        ( (hits + 1 != d->epoll_busy_poll_hits) ||
+          (misses != d->epoll_busy_poll_misses) ) )
+    {
+      fprintf (stderr, "The request sent within the busy polling time "
+               "has not been picked up by the busy polling: "
+               "%u hits, %u misses.\n",
+               (unsigned int) (d->epoll_busy_poll_hits - hits),
+               (unsigned int) (d->epoll_busy_poll_misses - misses));
+      ret = 1;
+    }
+    if (0 != get_reply (d, clnt))
+      ret = 1;
+    if (0 != ret)
+    {
+      close (clnt);
+      return ret;
+    }
+    if (! child_late)
+      break;
+    fprintf (stderr, "The request has been sent after the busy polling "
+             "time, retrying.\n");
+  }
+  if (SEND_ATTEMPTS < attempt)
+    fprintf (stderr, "The request has never been sent within the busy "
+             "polling time, the busy polling hit is not checked.\n");
+
+  /* No data: the busy polling time is over, then the loop blocks */
+  hits = d->epoll_busy_poll_hits;
+  misses = d->epoll_busy_poll_misses;
+  start_ms = MHD_monotonic_msec_counter ();
+  if (MHD_YES != MHD_run_wait (d, LOOP_TIMEOUT_MS))
+  {
+    fprintf (stderr, "MHD_run_wait() failed.\n");
+    ret = 1;
+  }
+  elapsed_ms = MHD_monotonic_msec_counter () - start_ms;
+  if (elapsed_ms + TIME_SLACK_MS < LOOP_TIMEOUT_MS)
+  {
+    fprintf (stderr, "The event loop without the events has returned "
+             "after %u ms instead of %u ms.\n", (unsigned int) elapsed_ms,
+             (unsigned int) LOOP_TIMEOUT_MS);
+    ret = 1;
+  }
+  if (busy_poll &&
+      ( (hits != d->epoll_busy_poll_hits) ||
+        (misses + 1 != d->epoll_busy_poll_misses) ) )
+  {
+    fprintf (stderr, "The busy polling without the events has not fallen "
+             "back to the blocking wait: %u hits, %u misses.\n",
+             (unsigned int) (d->epoll_busy_poll_hits - hits),
+             (unsigned int) (d->epoll_busy_poll_misses - misses));
+    ret = 1;
+  }
+  if (! busy_poll &&
+      ( (0 != d->epoll_busy_poll_hits) ||
+        (0 != d->epoll_busy_poll_misses) ) )
+  {
+    fprintf (stderr, "The busy polling has been used while not "
+             "enabled.\n");
+    ret = 1;
+  }
+  close (clnt);
+  return ret;
+}
+
+
+static unsigned int
+run_test (bool busy_poll)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  unsigned int errcount;
+
+  d = MHD_start_daemon (MHD_USE_EPOLL | MHD_USE_TURBO | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_EPOLL_BUSY_POLL,
+                        (unsigned int) (busy_poll ? BUSY_POLL_USEC : 0),
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 99;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 99;
+  }
+  errcount = test_busy_poll (d, dinfo->port, busy_poll);
+  MHD_stop_daemon (d);
+  return errcount;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned int errcount;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  MHD_monotonic_sec_counter_init ();
+  errcount = run_test (true);
+  errcount += run_test (false);
+  MHD_monotonic_sec_counter_finish ();
+  return (0 == errcount) ? 0 : 1;
+}
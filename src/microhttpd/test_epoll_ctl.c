@@ -0,0 +1,269 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_epoll_ctl.c
+ * @brief  Check the number of epoll_ctl() calls made for the connection
+ *         socket: the socket must be added once and removed once,
+ *         regardless of the number of requests and suspend/resume cycles
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "internal.h"
+
+/**
+ * The number of requests sent over the single connection
+ */
+#define NUM_REQUESTS 4
+
+/**
+ * The index of the request which is suspended and resumed
+ */
+#define SUSPENDED_REQUEST 1
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+#define REQ_NORMAL "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define REQ_SUSPEND "GET /suspend HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define RESP_BODY "OK"
+
+/**
+ * The connection suspended by the access handler
+ */
+static struct MHD_Connection *suspended_conn;
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker_first;
+  static int marker_suspended;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  if (NULL == *req_cls)
+  {
+    /* Do not queue the response "early" to keep the connection alive */
+    *req_cls = &marker_first;
+    return MHD_YES;
+  }
+  if ( (0 == strcmp (url, "/suspend")) &&
+       (&marker_suspended != *req_cls) )
+  {
+    *req_cls = &marker_suspended;
+    suspended_conn = connection;
+    MHD_suspend_connection (connection);
+    return MHD_YES;
+  }
+  response =
+    MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                            RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Run the daemon until the full reply is received by the client
+ * @return zero on success, non-zero otherwise
+ */
+static int
+get_reply (struct MHD_Daemon *d, int clnt)
+{
+  char buf[1024];
+  size_t len = 0;
+  const time_t start = time (NULL);
+
+  while (TIMEOUT_SEC >= time (NULL) - start)
+  {
+    const char *hdr_end;
+    ssize_t res;
+
+    if (MHD_YES != MHD_run_wait (d, 10))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      return 1;
+    }
+    if (NULL != suspended_conn)
+    {
+      MHD_resume_connection (suspended_conn);
+      suspended_conn = NULL;
+    }
+    res = recv (clnt, buf + len, sizeof(buf) - 1 - len, 0);
+    if (0 == res)
+    {
+      fprintf (stderr, "The connection has been closed by the server.\n");
+      return 1;
+    }
+    if (0 > res)
+    {
+      if ((EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno))
+        continue;
+      fprintf (stderr, "recv() failed: %s\n", strerror (errno));
+      return 1;
+    }
+    len += (size_t) res;
+    buf[len] = 0;
+    hdr_end = strstr (buf, "\r\n\r\n");
+    if ( (NULL != hdr_end) &&
+         (0 == strcmp (hdr_end + 4, RESP_BODY)) )
+      return 0;
+    if (sizeof(buf) - 1 == len)
+    {
+      fprintf (stderr, "The reply is too large.\n");
+      return 1;
+    }
+  }
+  fprintf (stderr, "Timeout waiting for the reply.\n");
+  return 1;
+}
+
+
+static unsigned int
+test_epoll_ctl_calls (struct MHD_Daemon *d, uint16_t port)
+{
+  struct sockaddr_in sa;
+  int clnt;
+  unsigned int i;
+  time_t start;
+
+  clnt = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > clnt)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return 1;
+  }
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != connect (clnt, (struct sockaddr *) &sa, sizeof(sa))) ||
+       (0 != fcntl (clnt, F_SETFL, fcntl (clnt, F_GETFL) | O_NONBLOCK)) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (clnt);
+    return 1;
+  }
+  for (i = 0; i < NUM_REQUESTS; ++i)
+  {
+    const char *req = (SUSPENDED_REQUEST == i) ? REQ_SUSPEND : REQ_NORMAL;
+
+    if ((ssize_t) strlen (req) != send (clnt, req, strlen (req), 0))
+    {
+      fprintf (stderr, "send() failed: %s\n", strerror (errno));
+      close (clnt);
+      return 1;
+    }
+    if (0 != get_reply (d, clnt))
+    {
+      close (clnt);
+      return 1;
+    }
+  }
+  if (1 != d->epoll_ctl_conn_calls)
+  {
+    fprintf (stderr, "%u epoll_ctl() calls were made for %u requests over "
+             "the single connection, while one call is expected.\n",
+             (unsigned int) d->epoll_ctl_conn_calls,
+             (unsigned int) NUM_REQUESTS);
+    close (clnt);
+    return 1;
+  }
+  close (clnt);
+
+  start = time (NULL);
+  while ( (NULL != d->connections_head) &&
+          (TIMEOUT_SEC >= time (NULL) - start) )
+  {
+    if (MHD_YES != MHD_run_wait (d, 10))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      return 1;
+    }
+  }
+  if (NULL != d->connections_head)
+  {
+    fprintf (stderr, "Timeout waiting for the connection cleanup.\n");
+    return 1;
+  }
+  if (2 != d->epoll_ctl_conn_calls)
+  {
+    fprintf (stderr, "%u epoll_ctl() calls were made for the connection "
+             "lifetime, while two calls are expected.\n",
+             (unsigned int) d->epoll_ctl_conn_calls);
+    return 1;
+  }
+  return 0;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  unsigned int errcount;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  d = MHD_start_daemon (MHD_USE_EPOLL | MHD_ALLOW_SUSPEND_RESUME
+                        | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 99;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 99;
+  }
+  errcount = test_epoll_ctl_calls (d, dinfo->port);
+  MHD_stop_daemon (d);
+  return (0 == errcount) ? 0 : 1;
+}
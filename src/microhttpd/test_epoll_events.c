@@ -0,0 +1,396 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_epoll_events.c
+ * @brief  Check that a single round of the epoll event loop serves all
+ *         ready connections when the events array is smaller than
+ *         the number of the connections, that the data is received
+ *         for all ready connections before the access handler is called
+ *         and that the connections closed by the clients are cleaned up
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "internal.h"
+
+/**
+ * The number of the connections with the requests sent at once
+ */
+#define NUM_CONNS 4
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+#define REQ_NORMAL "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define RESP_BODY "OK"
+
+/**
+ * The number of the connections that had no received data at the first
+ * call of the access handler, -1 if the handler has not been called
+ */
+static int not_received;
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) url; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  if (0 > not_received)
+  {
+    struct MHD_Connection *pos;
+
+    not_received = 0;
+    for (pos = connection->daemon->connections_head; NULL != pos;
+         pos = pos->next)
+    {
+      if ( (MHD_CONNECTION_INIT == pos->state) &&
+           (0 == pos->read_buffer_offset) )
+        not_received++;
+    }
+  }
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    return MHD_YES;
+  }
+  response =
+    MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                            RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+/**
+ * Check that the full reply is available to the client
+ * @return zero if the reply has been received, non-zero otherwise
+ */
+static int
+check_reply (int clnt)
+{
+  char buf[1024];
+  const char *hdr_end;
+  ssize_t res;
+
+  res = recv (clnt, buf, sizeof(buf) - 1, 0);
+  if (0 >= res)
+    return 1;
+  buf[res] = 0;
+  hdr_end = strstr (buf, "\r\n\r\n");
+  if ( (NULL == hdr_end) ||
+       (0 != strcmp (hdr_end + 4, RESP_BODY)) )
+    return 1;
+  return 0;
+}
+
+
+static unsigned int
+test_events (struct MHD_Daemon *d, uint16_t port)
+{
+  struct sockaddr_in sa;
+  int clnts[NUM_CONNS];
+  unsigned int num_conns;
+  unsigned int ret;
+  unsigned int i;
+  time_t start;
+
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  ret = 0;
+  for (i = 0; i < NUM_CONNS; ++i)
+  {
+    clnts[i] = socket (AF_INET, SOCK_STREAM, 0);
+    if ( (0 > clnts[i]) ||
+         (0 != connect (clnts[i], (struct sockaddr *) &sa, sizeof(sa))) ||
+         (0 != fcntl (clnts[i], F_SETFL, fcntl (clnts[i], F_GETFL)
+                      | O_NONBLOCK)) )
+    {
+      fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+      if (0 <= clnts[i])
+        close (clnts[i]);
+      while (0 != i)
+        close (clnts[--i]);
+      return 1;
+    }
+  }
+
+  /* Accept all connections and process all events */
+  start = time (NULL);
+  do
+  {
+    struct MHD_Connection *pos;
+
+    if (MHD_YES != MHD_run_wait (d, 10))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      ret = 1;
+      break;
+    }
+    num_conns = 0;
+    for (pos = d->connections_head; NULL != pos; pos = pos->next)
+      num_conns++;
+  } while ( (NUM_CONNS > num_conns) &&
+            (TIMEOUT_SEC >= time (NULL) - start) );
+  if ( (0 == ret) && (NUM_CONNS != num_conns) )
+  {
+    fprintf (stderr, "Only %u connections of %u have been accepted.\n",
+             num_conns, (unsigned int) NUM_CONNS);
+    ret = 1;
+  }
+  (void) MHD_run (d);
+
+  for (i = 0; (0 == ret) && (i < NUM_CONNS); ++i)
+  {
+    if ((ssize_t) MHD_STATICSTR_LEN_ (REQ_NORMAL) !=
+        send (clnts[i], REQ_NORMAL, MHD_STATICSTR_LEN_ (REQ_NORMAL), 0))
+    {
+      fprintf (stderr, "send() failed: %s\n", strerror (errno));
+      ret = 1;
+    }
+  }
+  /* Let the data reach the server sockets */
+  (void) usleep (10000);
+  if (0 == ret)
+  {
+    not_received = -1;
+    /* All requests must be served by the single round */
+    (void) MHD_run (d);
+    if (0 > not_received)
+    {
+      fprintf (stderr, "The access handler has not been called.\n");
+      ret = 1;
+    }
+    else if (0 != not_received)
+    {
+      fprintf (stderr, "%d connections had no received data when "
+               "the access handler was called.\n", not_received);
+      ret = 1;
+    }
+  }
+  for (i = 0; (0 == ret) && (i < NUM_CONNS); ++i)
+  {
+    if (0 != check_reply (clnts[i]))
+    {
+      fprintf (stderr, "The reply has not been sent to the connection "
+               "#%u in the single round of the event loop.\n", i);
+      ret = 1;
+    }
+  }
+  for (i = 0; i < NUM_CONNS; ++i)
+    close (clnts[i]);
+  return ret;
+}
+
+
+static unsigned int
+count_conns (struct MHD_Daemon *d)
+{
+  struct MHD_Connection *pos;
+  unsigned int num_conns;
+
+  num_conns = 0;
+  for (pos = d->connections_head; NULL != pos; pos = pos->next)
+    num_conns++;
+  return num_conns;
+}
+
+
+/**
+ * Run the daemon until the number of the connections is @a num
+ * @return zero on success, non-zero on timeout or error
+ */
+static int
+run_until_conns (struct MHD_Daemon *d, unsigned int num)
+{
+  const time_t start = time (NULL);
+
+  while (num != count_conns (d))
+  {
+    if (TIMEOUT_SEC < time (NULL) - start)
+      return 1;
+    if (MHD_YES != MHD_run_wait (d, 10))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+/**
+ * Check that the keep-alive connection closed by the client is cleaned
+ * up by the event loop.  The idle connection with the older activity
+ * stops the walk over the connections for the timeout check, so the
+ * closed connection is not cleaned up by that walk.
+ */
+static unsigned int
+test_client_close (struct MHD_Daemon *d, uint16_t port)
+{
+  struct sockaddr_in sa;
+  int idle_clnt;
+  int clnt;
+  unsigned int ret;
+  time_t start;
+
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if (0 != run_until_conns (d, 0))
+  {
+    fprintf (stderr, "The connections closed by the clients have not been "
+             "cleaned up, %u connections left.\n", count_conns (d));
+    return 1;
+  }
+  idle_clnt = socket (AF_INET, SOCK_STREAM, 0);
+  if ( (0 > idle_clnt) ||
+       (0 != connect (idle_clnt, (struct sockaddr *) &sa, sizeof(sa))) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    if (0 <= idle_clnt)
+      close (idle_clnt);
+    return 1;
+  }
+  if (0 != run_until_conns (d, 1))
+  {
+    fprintf (stderr, "The idle connection has not been accepted.\n");
+    close (idle_clnt);
+    return 1;
+  }
+  clnt = socket (AF_INET, SOCK_STREAM, 0);
+  if ( (0 > clnt) ||
+       (0 != connect (clnt, (struct sockaddr *) &sa, sizeof(sa))) ||
+       (0 != fcntl (clnt, F_SETFL, fcntl (clnt, F_GETFL) | O_NONBLOCK)) ||
+       ((ssize_t) MHD_STATICSTR_LEN_ (REQ_NORMAL) !=
+        send (clnt, REQ_NORMAL, MHD_STATICSTR_LEN_ (REQ_NORMAL), 0)) )
+  {
+    fprintf (stderr, "Failed to send the request: %s\n", strerror (errno));
+    if (0 <= clnt)
+      close (clnt);
+    close (idle_clnt);
+    return 1;
+  }
+  ret = 1;
+  start = time (NULL);
+  while (TIMEOUT_SEC >= time (NULL) - start)
+  {
+    if (MHD_YES != MHD_run_wait (d, 10))
+    {
+      fprintf (stderr, "MHD_run_wait() failed.\n");
+      break;
+    }
+    if (0 == check_reply (clnt))
+    {
+      ret = 0;
+      break;
+    }
+  }
+  close (clnt);
+  if (0 != ret)
+    fprintf (stderr, "The reply has not been received.\n");
+  else if (0 != run_until_conns (d, 1))
+  {
+    fprintf (stderr, "The connection closed by the client has not been "
+             "cleaned up, %u connections left.\n", count_conns (d));
+    ret = 1;
+  }
+  close (idle_clnt);
+  return ret;
+}
+
+
+static unsigned int
+run_test (unsigned int flags, unsigned int events_size)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  unsigned int errcount;
+
+  d = MHD_start_daemon (flags | MHD_USE_EPOLL | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_EPOLL_EVENTS_SIZE, events_size,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 99;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 99;
+  }
+  errcount = test_events (d, dinfo->port);
+  if (0 == errcount)
+    errcount = test_client_close (d, dinfo->port);
+  if (0 != errcount)
+    fprintf (stderr, "The test failed with %u events in the array%s.\n",
+             events_size,
+             (0 != (flags & MHD_USE_TURBO)) ? " in turbo mode" : "");
+  MHD_stop_daemon (d);
+  return errcount;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned int errcount;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  errcount = run_test (MHD_NO_FLAG, 1);
+  errcount += run_test (MHD_NO_FLAG, NUM_CONNS - 1);
+  errcount += run_test (MHD_NO_FLAG, 0);
+  errcount += run_test (MHD_USE_TURBO, 1);
+  errcount += run_test (MHD_USE_TURBO, 0);
+  return (0 == errcount) ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_http2_refuse.c
+ * @brief  Check that the HTTP/2 connection with prior knowledge is refused
+ *         with the SETTINGS and the GOAWAY (HTTP_1_1_REQUIRED) frames and
+ *         then closed, while the HTTP/1.1 requests are still processed
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "microhttpd.h"
+
+#ifndef MHD_STATICSTR_LEN_
+/**
+ * Determine length of static string / macro strings at compile time.
+ */
+#define MHD_STATICSTR_LEN_(macro) (sizeof(macro) / sizeof(char) - 1)
+#endif /* ! MHD_STATICSTR_LEN_ */
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+/**
+ * The HTTP/2 client connection preface followed by an empty SETTINGS frame
+ */
+#define H2_CLIENT_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" \
+  "\x00\x00\x00\x04\x00\x00\x00\x00\x00"
+
+#define REQ_GET "GET / HTTP/1.1\r\nHost: localhost\r\n" \
+  "Connection: close\r\n\r\n"
+#define RESP_BODY "OK"
+
+/**
+ * The frames expected from the server
+ */
+static const unsigned char expected_frames[] = {
+  /* SETTINGS: length 0, type 0x4, no flags, stream 0 */
+  0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+  /* GOAWAY: length 8, type 0x7, no flags, stream 0 */
+  0x00, 0x00, 0x08, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00,
+  /* Last-Stream-ID: 0 */
+  0x00, 0x00, 0x00, 0x00,
+  /* Error code: HTTP_1_1_REQUIRED (0xd) */
+  0x00, 0x00, 0x00, 0x0d
+};
+
+/**
+ * The number of the calls of the access handler
+ */
+static volatile unsigned int handler_calls;
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) url; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  handler_calls++;
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    return MHD_YES;
+  }
+  response =
+    MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                            RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+connect_to (uint16_t port)
+{
+  struct sockaddr_in sa;
+  struct timeval tv;
+  int s;
+
+  s = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > s)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return -1;
+  }
+  tv.tv_sec = TIMEOUT_SEC;
+  tv.tv_usec = 0;
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != connect (s, (struct sockaddr *) &sa, sizeof(sa))) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (s);
+    return -1;
+  }
+  return s;
+}
+
+
+/**
+ * Receive all data until the connection is closed by the server
+ * @param s the socket to use
+ * @param buf the buffer for the data
+ * @param buf_size the size of the @a buf
+ * @param[out] len set to the size of the received data
+ * @return zero if the connection has been closed, non-zero otherwise
+ */
+static int
+recv_until_closed (int s, unsigned char *buf, size_t buf_size, size_t *len)
+{
+  *len = 0;
+  while (buf_size > *len)
+  {
+    ssize_t res;
+
+    res = recv (s, buf + *len, buf_size - *len, 0);
+    if (0 == res)
+      return 0;
+    if (0 > res)
+    {
+      /* The unread client data may cause the reset of the connection */
+      if (ECONNRESET == errno)
+        return 0;
+      fprintf (stderr, "Failed to receive the data: %s\n", strerror (errno));
+      return 1;
+    }
+    *len += (size_t) res;
+  }
+  fprintf (stderr, "Too much data received.\n");
+  return 1;
+}
+
+
+static int
+test_refuse (uint16_t port)
+{
+  unsigned char buf[256];
+  size_t len;
+  int s;
+
+  s = connect_to (port);
+  if (0 > s)
+    return 1;
+  if ((ssize_t) MHD_STATICSTR_LEN_ (H2_CLIENT_PREFACE) !=
+      send (s, H2_CLIENT_PREFACE, MHD_STATICSTR_LEN_ (H2_CLIENT_PREFACE), 0))
+  {
+    fprintf (stderr, "send() failed: %s\n", strerror (errno));
+    close (s);
+    return 1;
+  }
+  if (0 != recv_until_closed (s, buf, sizeof(buf), &len))
+  {
+    close (s);
+    return 1;
+  }
+  close (s);
+  if ( (sizeof(expected_frames) != len) ||
+       (0 != memcmp (expected_frames, buf, len)) )
+  {
+    size_t i;
+    fprintf (stderr, "Wrong reply for HTTP/2 preface (%u bytes):",
+             (unsigned int) len);
+    for (i = 0; i < len; ++i)
+      fprintf (stderr, " %02x", (unsigned int) buf[i]);
+    fprintf (stderr, "\n");
+    return 1;
+  }
+  if (0 != handler_calls)
+  {
+    fprintf (stderr, "The access handler has been called for HTTP/2 "
+             "preface.\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+static int
+test_http11 (uint16_t port)
+{
+  char buf[1024];
+  size_t len;
+  int s;
+
+  s = connect_to (port);
+  if (0 > s)
+    return 1;
+  if ((ssize_t) MHD_STATICSTR_LEN_ (REQ_GET) !=
+      send (s, REQ_GET, MHD_STATICSTR_LEN_ (REQ_GET), 0))
+  {
+    fprintf (stderr, "send() failed: %s\n", strerror (errno));
+    close (s);
+    return 1;
+  }
+  if (0 != recv_until_closed (s, (unsigned char *) buf, sizeof(buf) - 1,
+                              &len))
+  {
+    close (s);
+    return 1;
+  }
+  close (s);
+  buf[len] = 0;
+  if ( (0 != strncmp (buf, "HTTP/1.1 200 ",
+                      MHD_STATICSTR_LEN_ ("HTTP/1.1 200 "))) ||
+       (NULL == strstr (buf, "\r\n\r\n" RESP_BODY)) )
+  {
+    fprintf (stderr, "Wrong reply for HTTP/1.1 request:\n%s\n", buf);
+    return 1;
+  }
+  return 0;
+}
+
+
+static int
+run_tests (unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  uint16_t port;
+  int ret;
+
+  handler_calls = 0;
+  d = MHD_start_daemon (flags | MHD_USE_INTERNAL_POLLING_THREAD,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 1;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 1;
+  }
+  port = dinfo->port;
+  ret = test_refuse (port);
+  if (0 == ret)
+    ret = test_http11 (port);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  int ret;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  ret = run_tests (MHD_NO_FLAG);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+    ret |= run_tests (MHD_USE_POLL);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    ret |= run_tests (MHD_USE_EPOLL);
+  return ret;
+}
@@ -0,0 +1,237 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_pool_slabs.c
+ * @brief  Check that the memory pools are allocated as the blocks of
+ *         the memory slabs, the released blocks are reused and the new
+ *         slab is added when all blocks are used
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include "memorypool.h"
+
+/**
+ * The size of the pool, the multiple of the alignment
+ */
+#define POOL_SIZE (16 * 1024)
+
+/**
+ * The requested size of the slab
+ */
+#define SLAB_SIZE (64 * 1024)
+
+/**
+ * The number of the pools in the single slab
+ */
+#define POOLS_PER_SLAB (SLAB_SIZE / POOL_SIZE)
+
+
+/**
+ * Get the start of the memory of the empty pool
+ * @param pool the pool to use
+ * @return the pointer to the memory of the pool, NULL if the whole pool
+ *         cannot be allocated
+ */
+static uint8_t *
+pool_memory (struct MemoryPool *pool)
+{
+  uint8_t *mem;
+
+  mem = (uint8_t *) MHD_pool_allocate (pool, POOL_SIZE, false);
+  if (NULL != mem)
+  {
+    /* The whole block must be usable */
+    memset (mem, 0xA5, POOL_SIZE);
+    MHD_pool_deallocate (pool, mem, POOL_SIZE);
+  }
+  return mem;
+}
+
+
+/**
+ * Check whether @a mem is in the range of the @a slab_size bytes
+ * starting at @a slab_start
+ */
+static bool
+is_in_slab (const uint8_t *mem, const uint8_t *slab_start, size_t slab_size)
+{
+  return (slab_start <= mem) &&
+         ((size_t) (mem - slab_start) < slab_size);
+}
+
+
+static unsigned int
+test_slabs (struct MHD_PoolSlabs *slabs)
+{
+  struct MemoryPool *pools[POOLS_PER_SLAB];
+  uint8_t *mems[POOLS_PER_SLAB];
+  struct MemoryPool *extra;
+  struct MemoryPool *guarded;
+  uint8_t *mem;
+  uint8_t *slab_start;
+  unsigned int ret;
+  unsigned int i;
+
+  ret = 0;
+  slab_start = NULL;
+  for (i = 0; i < POOLS_PER_SLAB; ++i)
+  {
+    pools[i] = MHD_pool_create (POOL_SIZE, slabs, false);
+    if (NULL == pools[i])
+    {
+      fprintf (stderr, "Failed to create the pool #%u.\n", i);
+      while (0 != i)
+        MHD_pool_destroy (pools[--i]);
+      return 1;
+    }
+    mems[i] = pool_memory (pools[i]);
+    if (NULL == mems[i])
+    {
+      fprintf (stderr, "The pool #%u cannot allocate %u bytes.\n", i,
+               (unsigned int) POOL_SIZE);
+      ret = 1;
+    }
+    else if ( (NULL == slab_start) || (slab_start > mems[i]) )
+      slab_start = mems[i];
+  }
+  if (0 != ret)
+    goto cleanup;
+
+  /* All pools must be the different blocks of the same slab */
+  for (i = 0; i < POOLS_PER_SLAB; ++i)
+  {
+    unsigned int j;
+
+    if (! is_in_slab (mems[i], slab_start, SLAB_SIZE) ||
+        (0 != (size_t) (mems[i] - slab_start) % POOL_SIZE))
+    {
+      fprintf (stderr, "The pool #%u is not the block of the slab: "
+               "offset %ld from the first block.\n", i,
+               (long) (mems[i] - slab_start));
+      ret = 1;
+    }
+    for (j = 0; j < i; ++j)
+    {
+      if (mems[i] == mems[j])
+      {
+        fprintf (stderr, "The pools #%u and #%u use the same memory.\n",
+                 j, i);
+        ret = 1;
+      }
+    }
+  }
+  if (0 != ret)
+    goto cleanup;
+
+  /* The released block must be reused by the next pool */
+  MHD_pool_destroy (pools[1]);
+  pools[1] = MHD_pool_create (POOL_SIZE, slabs, false);
+  if (NULL == pools[1])
+  {
+    fprintf (stderr, "Failed to re-create the pool.\n");
+    ret = 1;
+    goto cleanup;
+  }
+  mem = pool_memory (pools[1]);
+  if (mems[1] != mem)
+  {
+    fprintf (stderr, "The released block of the slab has not been "
+             "reused.\n");
+    ret = 1;
+    goto cleanup;
+  }
+
+  /* All blocks are used, the new slab must be added */
+  extra = MHD_pool_create (POOL_SIZE, slabs, false);
+  if (NULL == extra)
+  {
+    fprintf (stderr, "Failed to create the pool in the new slab.\n");
+    ret = 1;
+    goto cleanup;
+  }
+  mem = pool_memory (extra);
+  if ( (NULL == mem) ||
+       is_in_slab (mem, slab_start, SLAB_SIZE) )
+  {
+    fprintf (stderr, "The pool above the slab capacity has not been "
+             "allocated from the new slab.\n");
+    ret = 1;
+  }
+
+  /* The pools with the guard page are never taken from the slabs */
+  MHD_pool_destroy (pools[2]);
+  guarded = MHD_pool_create (POOL_SIZE, slabs, true);
+  pools[2] = MHD_pool_create (POOL_SIZE, slabs, false);
+  if ( (NULL == guarded) || (NULL == pools[2]) )
+  {
+    fprintf (stderr, "Failed to create the pools.\n");
+    ret = 1;
+  }
+  else
+  {
+    if (is_in_slab (pool_memory (guarded), slab_start, SLAB_SIZE))
+    {
+      fprintf (stderr, "The pool with the guard page has been allocated "
+               "from the slab.\n");
+      ret = 1;
+    }
+    if (mems[2] != pool_memory (pools[2]))
+    {
+      fprintf (stderr, "The block of the slab has been taken by the pool "
+               "with the guard page.\n");
+      ret = 1;
+    }
+  }
+  if (NULL != guarded)
+    MHD_pool_destroy (guarded);
+  MHD_pool_destroy (extra);
+
+cleanup:
+  for (i = 0; i < POOLS_PER_SLAB; ++i)
+  {
+    if (NULL != pools[i])
+      MHD_pool_destroy (pools[i]);
+  }
+  return ret;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  struct MHD_PoolSlabs *slabs;
+  unsigned int ret;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  MHD_init_mem_pools_ ();
+  slabs = MHD_pool_slabs_create (POOL_SIZE, SLAB_SIZE, false, false);
+  if (NULL == slabs)
+  {
+    fprintf (stderr, "The memory slabs are not supported.\n");
+    return 77;
+  }
+  ret = test_slabs (slabs);
+  MHD_pool_slabs_destroy (slabs);
+  return (0 == ret) ? 0 : 1;
+}
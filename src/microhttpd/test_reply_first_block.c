@@ -0,0 +1,366 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_reply_first_block.c
+ * @brief  Check that the first block of the callback response is read
+ *         before the reply header is sent, and that the reply is complete
+ *         when the first block is not ready or cannot be read
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "microhttpd.h"
+
+#ifndef MHD_STATICSTR_LEN_
+/**
+ * Determine length of static string / macro strings at compile time.
+ */
+#define MHD_STATICSTR_LEN_(macro) (sizeof(macro) / sizeof(char) - 1)
+#endif /* ! MHD_STATICSTR_LEN_ */
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+/**
+ * The number of the content reader calls returning no data
+ */
+#define NOT_READY_CALLS 3
+
+#define REQ_GET "GET / HTTP/1.1\r\nHost: localhost\r\n" \
+  "Connection: close\r\n\r\n"
+#define RESP_BODY "The dynamically generated body"
+
+/**
+ * The behaviour of the content reader at the start of the body
+ */
+enum ReaderMode
+{
+  /**
+   * The data is ready at the first call
+   */
+  READER_DATA_READY = 0,
+
+  /**
+   * The first calls return no data
+   */
+  READER_DATA_NOT_READY,
+
+  /**
+   * The first call reports the error
+   */
+  READER_ERROR
+};
+
+static enum ReaderMode reader_mode;
+
+/**
+ * The client socket, checked by the content reader
+ */
+static volatile int client_sckt = -1;
+
+/**
+ * The number of the content reader calls at the start of the body
+ */
+static volatile unsigned int first_calls;
+
+/**
+ * The number of bytes available to the client at the first call of
+ * the content reader
+ */
+static volatile int pending_first;
+
+
+static int
+client_pending (void)
+{
+  int avail;
+
+  if (0 != ioctl (client_sckt, FIONREAD, &avail))
+  {
+    fprintf (stderr, "ioctl() failed: %s\n", strerror (errno));
+    _exit (99);
+  }
+  return avail;
+}
+
+
+static ssize_t
+crc (void *cls,
+     uint64_t pos,
+     char *buf,
+     size_t max)
+{
+  (void) cls; /* Unused. Silence compiler warning. */
+
+  if (MHD_STATICSTR_LEN_ (RESP_BODY) <= pos)
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  if (0 == pos)
+  {
+    if (0 == first_calls++)
+    {
+      pending_first = client_pending ();
+      if (READER_ERROR == reader_mode)
+        return MHD_CONTENT_READER_END_WITH_ERROR;
+    }
+    if ( (READER_DATA_NOT_READY == reader_mode) &&
+         (NOT_READY_CALLS >= first_calls) )
+      return 0;
+  }
+  if (max > MHD_STATICSTR_LEN_ (RESP_BODY) - (size_t) pos)
+    max = MHD_STATICSTR_LEN_ (RESP_BODY) - (size_t) pos;
+  memcpy (buf, RESP_BODY + pos, max);
+  return (ssize_t) max;
+}
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) url; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    return MHD_YES;
+  }
+  response =
+    MHD_create_response_from_callback (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                       1024,
+                                       &crc,
+                                       NULL,
+                                       NULL);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+connect_to (uint16_t port)
+{
+  struct sockaddr_in sa;
+  struct timeval tv;
+  int s;
+
+  s = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > s)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return -1;
+  }
+  tv.tv_sec = TIMEOUT_SEC;
+  tv.tv_usec = 0;
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != connect (s, (struct sockaddr *) &sa, sizeof(sa))) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (s);
+    return -1;
+  }
+  return s;
+}
+
+
+/**
+ * Receive all data until the connection is closed by the server
+ * @param s the socket to use
+ * @param buf the buffer for the data
+ * @param buf_size the size of the @a buf
+ * @param[out] len set to the size of the received data
+ * @return zero if the connection has been closed, non-zero otherwise
+ */
+static int
+recv_until_closed (int s, char *buf, size_t buf_size, size_t *len)
+{
+  *len = 0;
+  while (buf_size > *len)
+  {
+    ssize_t res;
+
+    res = recv (s, buf + *len, buf_size - *len, 0);
+    if (0 == res)
+      return 0;
+    if (0 > res)
+    {
+      fprintf (stderr, "Failed to receive the data: %s\n", strerror (errno));
+      return 1;
+    }
+    *len += (size_t) res;
+  }
+  fprintf (stderr, "Too much data received.\n");
+  return 1;
+}
+
+
+static int
+test_reply (uint16_t port, enum ReaderMode mode)
+{
+  char buf[1024];
+  size_t len;
+  int s;
+
+  reader_mode = mode;
+  first_calls = 0;
+  pending_first = -1;
+  s = connect_to (port);
+  if (0 > s)
+    return 1;
+  client_sckt = s;
+  if ((ssize_t) MHD_STATICSTR_LEN_ (REQ_GET) !=
+      send (s, REQ_GET, MHD_STATICSTR_LEN_ (REQ_GET), 0))
+  {
+    fprintf (stderr, "send() failed: %s\n", strerror (errno));
+    close (s);
+    return 1;
+  }
+  if (0 != recv_until_closed (s, buf, sizeof(buf) - 1, &len))
+  {
+    close (s);
+    return 1;
+  }
+  client_sckt = -1;
+  close (s);
+  buf[len] = 0;
+  if (0 == first_calls)
+  {
+    fprintf (stderr, "The content reader has not been called.\n");
+    return 1;
+  }
+  if (0 != pending_first)
+  {
+    fprintf (stderr, "The reply data has been sent before the first "
+             "block of the body was read.\n");
+    return 1;
+  }
+  if (READER_ERROR == mode)
+  {
+    if (0 != len)
+    {
+      fprintf (stderr, "The data has been sent while the content reader "
+               "reported the error:\n%s\n", buf);
+      return 1;
+    }
+    return 0;
+  }
+  if ( (0 != strncmp (buf, "HTTP/1.1 200 ",
+                      MHD_STATICSTR_LEN_ ("HTTP/1.1 200 "))) ||
+       (NULL == strstr (buf, "\r\n\r\n" RESP_BODY)) ||
+       (0 != strcmp (strstr (buf, "\r\n\r\n") + 4, RESP_BODY)) )
+  {
+    fprintf (stderr, "Wrong reply:\n%s\n", buf);
+    return 1;
+  }
+  if (READER_DATA_NOT_READY == mode)
+  {
+    if (NOT_READY_CALLS + 1 != first_calls)
+    {
+      fprintf (stderr, "The content reader has been called %u times at "
+               "the start of the body instead of %u.\n", first_calls,
+               (unsigned int) (NOT_READY_CALLS + 1));
+      return 1;
+    }
+  }
+  else if (1 != first_calls)
+  {
+    fprintf (stderr, "The first block of the body has been read %u "
+             "times.\n", first_calls);
+    return 1;
+  }
+  return 0;
+}
+
+
+static int
+run_tests (unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  uint16_t port;
+  int ret;
+
+  d = MHD_start_daemon (flags | MHD_USE_INTERNAL_POLLING_THREAD,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 1;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 1;
+  }
+  port = dinfo->port;
+  ret = test_reply (port, READER_DATA_READY);
+  if (0 == ret)
+    ret = test_reply (port, READER_DATA_NOT_READY);
+  if (0 == ret)
+    ret = test_reply (port, READER_ERROR);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  int ret;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  ret = run_tests (MHD_NO_FLAG);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+    ret |= run_tests (MHD_USE_POLL);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    ret |= run_tests (MHD_USE_EPOLL);
+  return ret;
+}
@@ -0,0 +1,248 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_slow_handler.c
+ * @brief  Check that the connection is not closed by the timeout when
+ *         the access handler takes longer than the connection timeout:
+ *         the reply must be sent and the connection must be kept alive
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "microhttpd.h"
+
+#ifndef MHD_STATICSTR_LEN_
+/**
+ * Determine length of static string / macro strings at compile time.
+ */
+#define MHD_STATICSTR_LEN_(macro) (sizeof(macro) / sizeof(char) - 1)
+#endif /* ! MHD_STATICSTR_LEN_ */
+
+/**
+ * The connection timeout, in seconds
+ */
+#define CONN_TIMEOUT_SEC 1
+
+/**
+ * The time spent by the access handler, in milliseconds, longer than
+ * the connection timeout
+ */
+#define HANDLER_TIME_MS 1300
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+#define REQ_SLOW "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"
+#define REQ_FAST "GET /fast HTTP/1.1\r\nHost: localhost\r\n" \
+  "Connection: close\r\n\r\n"
+#define RESP_BODY "OK"
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    return MHD_YES;
+  }
+  if (0 == strcmp (url, "/slow"))
+    (void) usleep (HANDLER_TIME_MS * 1000);
+  response =
+    MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                            RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+connect_to (uint16_t port)
+{
+  struct sockaddr_in sa;
+  struct timeval tv;
+  int s;
+
+  s = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > s)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return -1;
+  }
+  tv.tv_sec = TIMEOUT_SEC;
+  tv.tv_usec = 0;
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != connect (s, (struct sockaddr *) &sa, sizeof(sa))) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (s);
+    return -1;
+  }
+  return s;
+}
+
+
+/**
+ * Send the request and receive the full reply
+ * @param s the socket to use
+ * @param req the request to send
+ * @return zero on success, non-zero otherwise
+ */
+static int
+do_request (int s, const char *req)
+{
+  char buf[1024];
+  size_t len;
+
+  if ((ssize_t) strlen (req) != send (s, req, strlen (req), 0))
+  {
+    fprintf (stderr, "send() failed: %s\n", strerror (errno));
+    return 1;
+  }
+  len = 0;
+  while (sizeof(buf) - 1 > len)
+  {
+    const char *hdr_end;
+    ssize_t res;
+
+    res = recv (s, buf + len, sizeof(buf) - 1 - len, 0);
+    if (0 == res)
+    {
+      fprintf (stderr, "The connection has been closed by the server "
+               "before the end of the reply.\n");
+      return 1;
+    }
+    if (0 > res)
+    {
+      fprintf (stderr, "Failed to receive the reply: %s\n",
+               strerror (errno));
+      return 1;
+    }
+    len += (size_t) res;
+    buf[len] = 0;
+    hdr_end = strstr (buf, "\r\n\r\n");
+    if ( (NULL != hdr_end) &&
+         (0 == strcmp (hdr_end + 4, RESP_BODY)) )
+    {
+      if (0 != strncmp (buf, "HTTP/1.1 200 ",
+                        MHD_STATICSTR_LEN_ ("HTTP/1.1 200 ")))
+      {
+        fprintf (stderr, "Wrong reply:\n%s\n", buf);
+        return 1;
+      }
+      return 0;
+    }
+  }
+  fprintf (stderr, "The reply is too large.\n");
+  return 1;
+}
+
+
+static int
+run_test (unsigned int flags, unsigned int num_threads)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  int ret;
+  int s;
+
+  d = MHD_start_daemon (flags | MHD_USE_INTERNAL_POLLING_THREAD
+                        | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_CONNECTION_TIMEOUT,
+                        (unsigned int) CONN_TIMEOUT_SEC,
+                        MHD_OPTION_THREAD_POOL_SIZE, num_threads,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 1;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 1;
+  }
+  s = connect_to (dinfo->port);
+  if (0 > s)
+  {
+    MHD_stop_daemon (d);
+    return 1;
+  }
+  ret = do_request (s, REQ_SLOW);
+  /* The connection must be still alive */
+  if (0 == ret)
+    ret = do_request (s, REQ_FAST);
+  close (s);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  int ret;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  ret = run_test (MHD_NO_FLAG, 0);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+    ret |= run_test (MHD_USE_POLL, 0);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+  {
+    ret |= run_test (MHD_USE_EPOLL, 0);
+    ret |= run_test (MHD_USE_EPOLL, 2);
+  }
+  return ret;
+}
@@ -195,6 +195,10 @@ static int test_timeout = 5;
 
 static uint16_t global_port;
 
+/* The maximum number of the parked threads with thread-per-connection,
+   zero to create a new thread for every connection */
+static unsigned int thread_reuse;
+
 static const void *rclient_msg;
 
 static size_t rclient_msg_size;
@@ -1897,6 +1901,7 @@ test_upgrade (unsigned int flags,
                           MHD_OPTION_NOTIFY_CONNECTION, &notify_connection_cb,
                           NULL,
                           MHD_OPTION_THREAD_POOL_SIZE, pool,
+                          MHD_OPTION_THREAD_REUSE_MAX_IDLE, thread_reuse,
                           MHD_OPTION_CONNECTION_TIMEOUT, test_timeout,
                           MHD_OPTION_CONNECTION_MEMORY_LIMIT, mem_limit,
                           MHD_OPTION_END);
@@ -1915,6 +1920,7 @@ test_upgrade (unsigned int flags,
                           MHD_OPTION_HTTPS_MEM_KEY, srv_signed_key_pem,
                           MHD_OPTION_HTTPS_MEM_CERT, srv_signed_cert_pem,
                           MHD_OPTION_THREAD_POOL_SIZE, pool,
+                          MHD_OPTION_THREAD_REUSE_MAX_IDLE, thread_reuse,
                           MHD_OPTION_CONNECTION_TIMEOUT, test_timeout,
                           MHD_OPTION_CONNECTION_MEMORY_LIMIT, mem_limit,
                           MHD_OPTION_END);
@@ -2288,6 +2294,21 @@ main (int argc,
   else if (verbose)
     printf ("PASSED: Upgrade with thread per connection.\n");
 
+  thread_reuse = 2;
+  res = test_upgrade (MHD_USE_INTERNAL_POLLING_THREAD
+                      | MHD_USE_THREAD_PER_CONNECTION,
+                      0);
+  thread_reuse = 0;
+  fflush_allstd ();
+  error_count += res;
+  if (res)
+    fprintf (stderr,
+             "FAILED: Upgrade with reused connection threads, "
+             "return code %u.\n",
+             res);
+  else if (verbose)
+    printf ("PASSED: Upgrade with reused connection threads.\n");
+
   res = test_upgrade (MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD
                       | MHD_USE_THREAD_PER_CONNECTION,
                       0);
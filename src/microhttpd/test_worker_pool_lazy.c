@@ -0,0 +1,341 @@
+/*
+  This file is part of libmicrohttpd
+  Copyright (C) 2026 agent
+
+  This test tool is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This test tool is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+ * @file microhttpd/test_worker_pool_lazy.c
+ * @brief  Check that only the first worker of the thread pool is started
+ *         with the daemon and the next workers are started with the load:
+ *         the new connection must be served while all other started
+ *         workers are busy
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "internal.h"
+
+/**
+ * The number of the threads in the pool
+ */
+#define POOL_SIZE 4
+
+/**
+ * The maximum time to wait for the network operations, in seconds
+ */
+#define TIMEOUT_SEC 5
+
+#define REQ_BLOCK "GET /block HTTP/1.1\r\nHost: localhost\r\n" \
+  "Connection: close\r\n\r\n"
+#define REQ_NORMAL "GET / HTTP/1.1\r\nHost: localhost\r\n" \
+  "Connection: close\r\n\r\n"
+#define RESP_BODY "OK"
+
+/**
+ * The pipe to report that the blocking handler has been called
+ */
+static int entered_pipe[2];
+
+/**
+ * The pipe to release the blocking handler
+ */
+static int release_pipe[2];
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data,
+          size_t *upload_data_size,
+          void **req_cls)
+{
+  static int marker;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls; (void) method; (void) version; /* Unused. Silence compiler warning. */
+  (void) upload_data; (void) upload_data_size; /* Unused. Silence compiler warning. */
+
+  if (NULL == *req_cls)
+  {
+    *req_cls = &marker;
+    return MHD_YES;
+  }
+  if (0 == strcmp (url, "/block"))
+  {
+    struct pollfd p;
+    char c;
+
+    /* Keep the worker busy until the test releases it */
+    if (1 != write (entered_pipe[1], "e", 1))
+      return MHD_NO;
+    p.fd = release_pipe[0];
+    p.events = POLLIN;
+    if ( (1 != poll (&p, 1, TIMEOUT_SEC * 1000)) ||
+         (1 != read (release_pipe[0], &c, 1)) )
+      return MHD_NO;
+  }
+  response =
+    MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (RESP_BODY),
+                                            RESP_BODY);
+  if (NULL == response)
+    return MHD_NO;
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  return ret;
+}
+
+
+static int
+connect_to (uint16_t port)
+{
+  struct sockaddr_in sa;
+  struct timeval tv;
+  int s;
+
+  s = socket (AF_INET, SOCK_STREAM, 0);
+  if (0 > s)
+  {
+    fprintf (stderr, "socket() failed: %s\n", strerror (errno));
+    return -1;
+  }
+  tv.tv_sec = TIMEOUT_SEC;
+  tv.tv_usec = 0;
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  if ( (0 != setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != connect (s, (struct sockaddr *) &sa, sizeof(sa))) )
+  {
+    fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+    close (s);
+    return -1;
+  }
+  return s;
+}
+
+
+static int
+send_request (int s, const char *req)
+{
+  if ((ssize_t) strlen (req) != send (s, req, strlen (req), 0))
+  {
+    fprintf (stderr, "send() failed: %s\n", strerror (errno));
+    return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Receive the full reply
+ * @param s the socket to use
+ * @return zero on success, non-zero otherwise
+ */
+static int
+get_reply (int s)
+{
+  char buf[1024];
+  size_t len;
+
+  len = 0;
+  while (sizeof(buf) - 1 > len)
+  {
+    const char *hdr_end;
+    ssize_t res;
+
+    res = recv (s, buf + len, sizeof(buf) - 1 - len, 0);
+    if (0 == res)
+    {
+      fprintf (stderr, "The connection has been closed by the server "
+               "before the end of the reply.\n");
+      return 1;
+    }
+    if (0 > res)
+    {
+      fprintf (stderr, "Failed to receive the reply: %s\n",
+               strerror (errno));
+      return 1;
+    }
+    len += (size_t) res;
+    buf[len] = 0;
+    hdr_end = strstr (buf, "\r\n\r\n");
+    if ( (NULL != hdr_end) &&
+         (0 == strcmp (hdr_end + 4, RESP_BODY)) )
+      return 0;
+  }
+  fprintf (stderr, "The reply is too large.\n");
+  return 1;
+}
+
+
+static unsigned int
+get_started (struct MHD_Daemon *d)
+{
+  unsigned int started;
+
+  if (! MHD_mutex_lock_ (&d->worker_start_lock))
+  {
+    fprintf (stderr, "Failed to lock the mutex.\n");
+    return 0;
+  }
+  started = d->worker_pool_started;
+  if (! MHD_mutex_unlock_ (&d->worker_start_lock))
+  {
+    fprintf (stderr, "Failed to unlock the mutex.\n");
+    return 0;
+  }
+  return started;
+}
+
+
+static int
+run_test (unsigned int flags)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  struct pollfd p;
+  unsigned int started;
+  int ret;
+  int s_block;
+  int s_normal;
+  char c;
+
+  d = MHD_start_daemon (flags | MHD_USE_INTERNAL_POLLING_THREAD
+                        | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_THREAD_POOL_SIZE,
+                        (unsigned int) POOL_SIZE,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 1;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ( (NULL == dinfo) || (0 == dinfo->port) )
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 1;
+  }
+  started = get_started (d);
+  if (1 != started)
+  {
+    fprintf (stderr, "%u workers have been started with the daemon "
+             "instead of 1.\n", started);
+    MHD_stop_daemon (d);
+    return 1;
+  }
+
+  /* Block the only started worker */
+  s_block = connect_to (dinfo->port);
+  if (0 > s_block)
+  {
+    MHD_stop_daemon (d);
+    return 1;
+  }
+  ret = send_request (s_block, REQ_BLOCK);
+  p.fd = entered_pipe[0];
+  p.events = POLLIN;
+  if ( (0 == ret) &&
+       ( (1 != poll (&p, 1, TIMEOUT_SEC * 1000)) ||
+         (1 != read (entered_pipe[0], &c, 1)) ) )
+  {
+    fprintf (stderr, "The blocking request has not been processed.\n");
+    ret = 1;
+  }
+
+  /* The next worker must serve the new connection */
+  if (0 == ret)
+  {
+    s_normal = connect_to (dinfo->port);
+    if (0 > s_normal)
+      ret = 1;
+    else
+    {
+      ret = send_request (s_normal, REQ_NORMAL);
+      if (0 == ret)
+        ret = get_reply (s_normal);
+      if (0 != ret)
+        fprintf (stderr, "The connection has not been served while "
+                 "the first worker is busy.\n");
+      close (s_normal);
+    }
+  }
+
+  if (1 != write (release_pipe[1], "r", 1))
+  {
+    fprintf (stderr, "Failed to release the blocking request.\n");
+    ret = 1;
+  }
+  else if ( (0 == ret) &&
+            (0 != get_reply (s_block)) )
+    ret = 1;
+  close (s_block);
+
+  /* Each worker that has got a connection has started the next worker */
+  started = get_started (d);
+  if ( (0 == ret) &&
+       (3 != started) )
+  {
+    fprintf (stderr, "%u workers have been started instead of 3.\n",
+             started);
+    ret = 1;
+  }
+  MHD_stop_daemon (d);
+  /* Drop the release byte if the handler has not consumed it */
+  p.fd = release_pipe[0];
+  p.events = POLLIN;
+  if (1 == poll (&p, 1, 0))
+    (void) read (release_pipe[0], &c, 1);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  int ret;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  if ( (0 != pipe (entered_pipe)) ||
+       (0 != pipe (release_pipe)) )
+  {
+    fprintf (stderr, "pipe() failed: %s\n", strerror (errno));
+    return 99;
+  }
+  ret = run_test (MHD_NO_FLAG);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+    ret |= run_test (MHD_USE_POLL);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+    ret |= run_test (MHD_USE_EPOLL);
+  return ret;
+}
@@ -233,12 +233,16 @@ _checkCURLE_OK_func (CURLcode code, const char *curlFunc,
 #define REALM "TestRealm"
 #define USERNAME "Aladdin"
 #define PASSWORD "open sesame"
+/* The second password accepted by the verify callback */
+#define PASSWORD2 "close sesame"
 
 
 #define PAGE \
   "<html><head><title>libmicrohttpd demo page</title>" \
   "</head><body>Access granted</body></html>"
 
+#define CACHE_TIMEOUT_SEC 1
+
 #define DENIED \
   "<html><head><title>libmicrohttpd - Access denied</title>" \
   "</head><body>Access denied</body></html>"
@@ -253,6 +257,12 @@ struct CBC
 static int verbose;
 static int preauth;
 static int oldapi;
+static int verifyapi;
+
+/**
+ * The number of calls of the verify callback
+ */
+static unsigned int verify_calls;
 
 static size_t
 copyBuffer (void *ptr,
@@ -270,6 +280,66 @@ copyBuffer (void *ptr,
 }
 
 
+/**
+ * Pause execution for specified number of milliseconds.
+ * @param ms the number of milliseconds to sleep
+ */
+static void
+_MHD_sleep (uint32_t ms)
+{
+#if defined(_WIN32)
+  Sleep (ms);
+#elif defined(HAVE_NANOSLEEP)
+  struct timespec slp = {ms / 1000, (ms % 1000) * 1000000};
+  struct timespec rmn;
+  int num_retries = 0;
+  while (0 != nanosleep (&slp, &rmn))
+  {
+    if (num_retries++ > 8)
+      break;
+    slp = rmn;
+  }
+#elif defined(HAVE_USLEEP)
+  uint64_t us = ms * 1000;
+  do
+  {
+    uint64_t this_sleep;
+    if (999999 < us)
+      this_sleep = 999999;
+    else
+      this_sleep = us;
+    /* Ignore return value as it could be void */
+    usleep (this_sleep);
+    us -= this_sleep;
+  } while (us > 0);
+#else
+  fprintf (stderr, "No sleep function available on this system.\n");
+#endif
+}
+
+
+static enum MHD_Result
+verify_cb (void *cls,
+           const struct MHD_BasicAuthInfo *info)
+{
+  (void) cls; /* Unused. Silent compiler warning. */
+
+  verify_calls++;
+  if ((MHD_STATICSTR_LEN_ (USERNAME) != info->username_len) ||
+      (0 != memcmp (info->username, USERNAME, info->username_len)))
+    mhdErrorExitDesc ("Wrong 'username' in the verify callback");
+  if (NULL == info->password)
+    return MHD_NO;
+  if ((MHD_STATICSTR_LEN_ (PASSWORD) == info->password_len) &&
+      (0 == memcmp (info->password, PASSWORD, info->password_len)))
+    return MHD_YES;
+  if ((MHD_STATICSTR_LEN_ (PASSWORD2) == info->password_len) &&
+      (0 == memcmp (info->password, PASSWORD2, info->password_len)))
+    return MHD_YES;
+  return MHD_NO;
+}
+
+
 static enum MHD_Result
 ahc_echo (void *cls,
           struct MHD_Connection *connection,
@@ -298,7 +368,33 @@ ahc_echo (void *cls,
     mhdErrorExitDesc ("Unexpected HTTP method");
 
   /* require: USERNAME with password PASSWORD */
-  if (! oldapi)
+  if (verifyapi)
+  {
+    if (MHD_YES == MHD_basic_auth_verify (connection))
+    {
+      response =
+        MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (PAGE),
+                                                (const void *) PAGE);
+      if (NULL == response)
+        mhdErrorExitDesc ("Response creation failed");
+      ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+      if (MHD_YES != ret)
+        mhdErrorExitDesc ("'MHD_queue_response()' failed");
+    }
+    else
+    {
+      response =
+        MHD_create_response_from_buffer_static (MHD_STATICSTR_LEN_ (DENIED),
+                                                (const void *) DENIED);
+      if (NULL == response)
+        mhdErrorExitDesc ("Response creation failed");
+      ret = MHD_queue_basic_auth_required_response3 (connection, REALM, MHD_YES,
+                                                     response);
+      if (MHD_YES != ret)
+        mhdErrorExitDesc ("'MHD_queue_basic_auth_required_response3()' failed");
+    }
+  }
+  else if (! oldapi)
   {
     struct MHD_BasicAuthInfo *creds;
 
@@ -632,6 +728,74 @@ check_result (CURLcode curl_code, struct CBC *pcbc)
 }
 
 
+/**
+ * Perform the request with the specified credentials and check the number
+ * of the verify callback calls made while processing the request.
+ * @param d the daemon to use
+ * @param port the port of the daemon
+ * @param userpwd the credentials in the "username:password" form
+ * @param expect_ok non-zero if the access must be granted
+ * @param expected_calls the expected number of the verify callback calls
+ * @param desc the description of the request for the log
+ * @return zero if succeed, non-zero if failed
+ */
+static unsigned int
+verifyRequest (struct MHD_Daemon *d, uint16_t port, const char *userpwd,
+               int expect_ok, unsigned int expected_calls, const char *desc)
+{
+  struct CBC cbc;
+  char buf[2048];
+  CURL *c;
+  CURLcode curl_res;
+  unsigned int calls_before;
+  unsigned int failed = 0;
+
+  cbc.buf = buf;
+  cbc.size = sizeof (buf);
+  cbc.pos = 0;
+  memset (cbc.buf, 0, cbc.size);
+  c = setupCURL (&cbc, port, libcurl_errbuf);
+  if (CURLE_OK != curl_easy_setopt (c, CURLOPT_USERPWD, userpwd))
+    libcurlErrorExitDesc ("curl_easy_setopt() failed");
+  calls_before = verify_calls;
+  curl_res = performQueryExternal (d, c);
+  if (expect_ok)
+  {
+    if (! check_result (curl_res, &cbc))
+      failed = 1;
+  }
+  else
+  {
+    long code;
+
+    if (CURLE_HTTP_RETURNED_ERROR != curl_res)
+    {
+      fprintf (stderr, "%s: the request has not been rejected, "
+               "libcurl result: '%s'.\n", desc, curl_easy_strerror (curl_res));
+      failed = 1;
+    }
+    else if ((CURLE_OK != curl_easy_getinfo (c, CURLINFO_RESPONSE_CODE,
+                                             &code)) ||
+             (MHD_HTTP_UNAUTHORIZED != code))
+    {
+      fprintf (stderr, "%s: wrong HTTP response code.\n", desc);
+      failed = 1;
+    }
+  }
+  curl_easy_cleanup (c);
+  if (expected_calls != verify_calls - calls_before)
+  {
+    fprintf (stderr, "%s: the verify callback has been called %u times, "
+             "while %u calls expected.\n", desc,
+             verify_calls - calls_before, expected_calls);
+    failed = 1;
+  }
+  if (! failed && verbose)
+    printf ("%s: request successful.\n", desc);
+  return failed;
+}
+
+
 static unsigned int
 testBasicAuth (void)
 {
@@ -651,6 +815,12 @@ testBasicAuth (void)
                         port, NULL, NULL,
                         &ahc_echo, NULL,
                         MHD_OPTION_APP_FD_SETSIZE, (int) FD_SETSIZE,
+                        MHD_OPTION_BASIC_AUTH_VERIFY_CALLBACK,
+                        &verify_cb, NULL,
+                        MHD_OPTION_BASIC_AUTH_CACHE_SIZE,
+                        (unsigned int) (verifyapi ? 16 : 0),
+                        MHD_OPTION_BASIC_AUTH_CACHE_TIMEOUT,
+                        (unsigned int) CACHE_TIMEOUT_SEC,
                         MHD_OPTION_END);
   if (d == NULL)
     return 1;
@@ -701,6 +871,45 @@ testBasicAuth (void)
     failed = 1;
   }
   curl_easy_cleanup (c);
+  if (verifyapi)
+  {
+    /* Without SHA-256 support the cache is not available */
+    const unsigned int expected_calls =
+      (MHD_NO != MHD_is_feature_supported (MHD_FEATURE_DIGEST_AUTH_SHA256)) ?
+      1 : 2;
+
+    if (expected_calls != verify_calls)
+    {
+      fprintf (stderr, "The verify callback has been called %u times, "
+               "while %u calls expected.\n", verify_calls, expected_calls);
+      failed = 1;
+    }
+
+    /* The failed checks must never be cached */
+    if (0 != verifyRequest (d, port, USERNAME ":wrong", 0, 1,
+                            "Wrong password"))
+      failed = 1;
+    if (0 != verifyRequest (d, port, USERNAME ":wrong", 0, 1,
+                            "Repeated wrong password"))
+      failed = 1;
+    /* The different token must be checked by the callback */
+    if (0 != verifyRequest (d, port, USERNAME ":" PASSWORD2, 1, 1,
+                            "Different password"))
+      failed = 1;
+    if (0 != verifyRequest (d, port, USERNAME ":" PASSWORD2, 1,
+                            expected_calls - 1,
+                            "Repeated different password"))
+      failed = 1;
+    if (0 != verifyRequest (d, port, USERNAME ":" PASSWORD, 1,
+                            expected_calls - 1,
+                            "Repeated first password"))
+      failed = 1;
+    /* The cached entry must expire */
+    _MHD_sleep (CACHE_TIMEOUT_SEC * 1000 + 500);
+    if (0 != verifyRequest (d, port, USERNAME ":" PASSWORD, 1, 1,
+                            "Request after the cache timeout"))
+      failed = 1;
+  }
   MHD_stop_daemon (d);
   return failed ? 1 : 0;
 }
@@ -735,6 +944,7 @@ main (int argc, char *const *argv)
 #endif
 #endif /* MHD_HTTPS_REQUIRE_GCRYPT */
   oldapi = has_in_name (argv[0], "_oldapi");
+  verifyapi = has_in_name (argv[0], "_verify");
   if (0 != curl_global_init (CURL_GLOBAL_WIN32))
     return 2;
   errorCount += testBasicAuth ();
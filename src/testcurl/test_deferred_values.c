@@ -0,0 +1,491 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_deferred_values.c
+ * @brief  Testcase for the GET arguments and the cookies parsed on
+ *         the first access
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+/**
+ * The number of the arguments or the cookies that do not fit the pool
+ */
+#define NUM_LARGE_VALUES 200
+
+/**
+ * The connection's memory pool size used to check the pool exhaustion
+ */
+#define SMALL_POOL_SIZE 4096
+
+/**
+ * The maximum number of the values recorded by the handler
+ */
+#define MAX_VALUES 32
+
+/**
+ * The name of the value added by the application
+ */
+#define APP_VALUE_NAME "X-App-Value"
+
+enum TestMode
+{
+  /**
+   * The handler does not access the arguments and the cookies
+   */
+  MODE_NO_ACCESS = 0,
+
+  /**
+   * The handler gets the arguments
+   */
+  MODE_ARGS,
+
+  /**
+   * The handler gets the cookies
+   */
+  MODE_COOKIES,
+
+  /**
+   * The handler adds the value, then gets the arguments, then the cookies
+   */
+  MODE_ORDER_ARGS_FIRST,
+
+  /**
+   * The handler adds the value, then gets the cookies, then the arguments
+   */
+  MODE_ORDER_COOKIES_FIRST
+};
+
+struct RecordedValue
+{
+  enum MHD_ValueKind kind;
+  char key[32];
+};
+
+static uint16_t global_port;
+
+static enum TestMode test_mode;
+
+/**
+ * Non-zero if the cookies are parsed by MHD
+ */
+static int use_cookies;
+
+static struct RecordedValue values[MAX_VALUES];
+
+static unsigned int num_values;
+
+/**
+ * The number of the arguments or the cookies found by the handler
+ */
+static int num_found;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static enum MHD_Result
+record_value (void *cls,
+              enum MHD_ValueKind kind,
+              const char *key,
+              const char *value)
+{
+  (void) cls;
+  (void) value;
+  if (MAX_VALUES <= num_values)
+    return MHD_NO;
+  values[num_values].kind = kind;
+  strncpy (values[num_values].key, key, sizeof(values[0].key) - 1);
+  values[num_values].key[sizeof(values[0].key) - 1] = 0;
+  num_values++;
+  return MHD_YES;
+}
+
+
+static enum MHD_Result
+ahc_check (void *cls,
+           struct MHD_Connection *connection,
+           const char *url,
+           const char *method,
+           const char *version,
+           const char *upload_data, size_t *upload_data_size,
+           void **req_cls)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) url;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    switch (test_mode)
+    {
+    case MODE_NO_ACCESS:
+      break;
+    case MODE_ARGS:
+      num_found = MHD_get_connection_values (connection,
+                                             MHD_GET_ARGUMENT_KIND,
+                                             NULL, NULL);
+      break;
+    case MODE_COOKIES:
+      num_found = MHD_get_connection_values (connection,
+                                             MHD_COOKIE_KIND,
+                                             NULL, NULL);
+      break;
+    case MODE_ORDER_ARGS_FIRST:
+    case MODE_ORDER_COOKIES_FIRST:
+      if (MHD_YES != MHD_set_connection_value (connection,
+                                               MHD_HEADER_KIND,
+                                               APP_VALUE_NAME,
+                                               "1"))
+      {
+        fprintf (stderr, "Failed to add the value.\n");
+        _exit (99);
+      }
+      if (MODE_ORDER_COOKIES_FIRST == test_mode)
+        (void) MHD_lookup_connection_value (connection,
+                                            MHD_COOKIE_KIND,
+                                            "c1");
+      (void) MHD_lookup_connection_value (connection,
+                                          MHD_GET_ARGUMENT_KIND,
+                                          "a");
+      (void) MHD_lookup_connection_value (connection,
+                                          MHD_COOKIE_KIND,
+                                          "c1");
+      num_values = 0;
+      (void) MHD_get_connection_values (connection,
+                                        MHD_HEADER_KIND
+                                        | MHD_COOKIE_KIND
+                                        | MHD_GET_ARGUMENT_KIND,
+                                        &record_value, NULL);
+      break;
+    default:
+      abort ();
+    }
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  response = MHD_create_response_from_buffer_static (2, "OK");
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+/**
+ * Perform the request.
+ * @param pool_size the connection's memory pool size, zero for default
+ * @param url_path the path and the query of the request
+ * @param cookies the value of the "Cookie:" header, could be NULL
+ * @param[out] code set to the reply code
+ * @return zero on success, error code otherwise
+ */
+static unsigned int
+doGet (size_t pool_size,
+       const char *url_path,
+       const char *cookies,
+       long *code)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  char url[1024 * 4];
+  struct CBC cbc;
+  CURLcode errornum;
+  unsigned int ret;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+    global_port = 1670;
+  if (0 == pool_size)
+    pool_size = 32 * 1024;
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD,
+                        global_port, NULL, NULL,
+                        &ahc_check, NULL,
+                        MHD_OPTION_CONNECTION_MEMORY_LIMIT, pool_size,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 16;
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    global_port = dinfo->port;
+  }
+  snprintf (url, sizeof(url), "http://127.0.0.1%s", url_path);
+  cbc.buf = buf;
+  cbc.size = sizeof(buf);
+  cbc.pos = 0;
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  if (NULL != cookies)
+    curl_easy_setopt (c, CURLOPT_COOKIE, cookies);
+  ret = 0;
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+  {
+    fprintf (stderr,
+             "curl_easy_perform failed: `%s'\n",
+             curl_easy_strerror (errornum));
+    ret = 32;
+  }
+  else if (CURLE_OK != curl_easy_getinfo (c, CURLINFO_RESPONSE_CODE, code))
+    ret = 32;
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+/**
+ * Check the order of the values parsed on the first access.
+ * The arguments must precede the request headers, the cookies must follow
+ * the request headers and the value added by the application must be
+ * the last one, as if the values were parsed when the request was
+ * received.
+ */
+static unsigned int
+testValuesOrder (enum TestMode mode)
+{
+  static const char *const expected_args[] = { "a", "b" };
+  static const char *const expected_cookies[] = { "c1", "c2" };
+  unsigned int ret;
+  unsigned int i;
+  unsigned int pos;
+  long code;
+
+  test_mode = mode;
+  num_values = 0;
+  ret = doGet (0, "/p?a=1&b=2", "c1=v1; c2=v2", &code);
+  if (0 != ret)
+    return ret;
+  if (MHD_HTTP_OK != code)
+  {
+    fprintf (stderr, "Unexpected reply code: %ld\n", code);
+    return 64;
+  }
+  pos = 0;
+  for (i = 0; i < sizeof(expected_args) / sizeof(expected_args[0]); ++i)
+  {
+    if ( (pos >= num_values) ||
+         (MHD_GET_ARGUMENT_KIND != values[pos].kind) ||
+         (0 != strcmp (expected_args[i], values[pos].key)) )
+    {
+      fprintf (stderr, "The argument '%s' is not at position %u.\n",
+               expected_args[i], pos);
+      return 128;
+    }
+    pos++;
+  }
+  if ( (pos >= num_values) ||
+       (MHD_HEADER_KIND != values[pos].kind) )
+  {
+    fprintf (stderr, "No request headers after the arguments.\n");
+    return 128;
+  }
+  while ( (pos < num_values) &&
+          (MHD_HEADER_KIND == values[pos].kind) )
+  {
+    if (0 == strcmp (APP_VALUE_NAME, values[pos].key))
+    {
+      if (! use_cookies)
+        break; /* The cookies are not parsed */
+      fprintf (stderr, "The value added by the application precedes "
+               "the cookies.\n");
+      return 256;
+    }
+    pos++;
+  }
+  if (use_cookies)
+  {
+    for (i = 0; i < sizeof(expected_cookies) / sizeof(expected_cookies[0]);
+         ++i)
+    {
+      if ( (pos >= num_values) ||
+           (MHD_COOKIE_KIND != values[pos].kind) ||
+           (0 != strcmp (expected_cookies[i], values[pos].key)) )
+      {
+        fprintf (stderr, "The cookie '%s' is not at position %u.\n",
+                 expected_cookies[i], pos);
+        return 256;
+      }
+      pos++;
+    }
+  }
+  if ( (pos + 1 != num_values) ||
+       (MHD_HEADER_KIND != values[pos].kind) ||
+       (0 != strcmp (APP_VALUE_NAME, values[pos].key)) )
+  {
+    fprintf (stderr, "The value added by the application is not "
+             "the last one.\n");
+    return 256;
+  }
+  return 0;
+}
+
+
+/**
+ * Check the values not fitting the pool.
+ * The values are not parsed if the application does not use them,
+ * the error is replied if the application tries to use them.
+ */
+static unsigned int
+testNoSpace (void)
+{
+  static char url_path[16 + NUM_LARGE_VALUES * 8];
+  static char cookies[16 + NUM_LARGE_VALUES * 10];
+  size_t len;
+  unsigned int i;
+  unsigned int ret;
+  long code;
+
+  strcpy (url_path, "/p?");
+  len = strlen (url_path);
+  for (i = 0; i < NUM_LARGE_VALUES; ++i)
+    len += (size_t) snprintf (url_path + len, sizeof(url_path) - len,
+                              "%sa%u=1", (0 == i) ? "" : "&", i);
+  len = 0;
+  for (i = 0; i < NUM_LARGE_VALUES; ++i)
+    len += (size_t) snprintf (cookies + len, sizeof(cookies) - len,
+                              "%sc%u=1", (0 == i) ? "" : "; ", i);
+
+  test_mode = MODE_NO_ACCESS;
+  ret = doGet (SMALL_POOL_SIZE, url_path, cookies, &code);
+  if (0 != ret)
+    return ret;
+  if (MHD_HTTP_OK != code)
+  {
+    fprintf (stderr, "The values not used by the application have not "
+             "been ignored, the reply code: %ld\n", code);
+    return 512;
+  }
+
+  test_mode = MODE_ARGS;
+  num_found = 0;
+  ret = doGet (SMALL_POOL_SIZE, url_path, NULL, &code);
+  if (0 != ret)
+    return ret;
+  if (MHD_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE != code)
+  {
+    fprintf (stderr, "Wrong reply code for the arguments not fitting "
+             "the pool: %ld\n", code);
+    return 1024;
+  }
+  if ( (0 >= num_found) || (NUM_LARGE_VALUES <= num_found) )
+  {
+    fprintf (stderr, "Unexpected number of the arguments found: %d\n",
+             num_found);
+    return 1024;
+  }
+
+  if (! use_cookies)
+    return 0;
+  test_mode = MODE_COOKIES;
+  num_found = 0;
+  ret = doGet (SMALL_POOL_SIZE, "/p", cookies, &code);
+  if (0 != ret)
+    return ret;
+  if (MHD_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE != code)
+  {
+    fprintf (stderr, "Wrong reply code for the cookies not fitting "
+             "the pool: %ld\n", code);
+    return 2048;
+  }
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  use_cookies =
+    (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_COOKIE_PARSING));
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_THREADS))
+  {
+    errorCount += testValuesOrder (MODE_ORDER_ARGS_FIRST);
+    errorCount += testValuesOrder (MODE_ORDER_COOKIES_FIRST);
+    errorCount += testNoSpace ();
+  }
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
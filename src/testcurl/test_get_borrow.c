@@ -0,0 +1,485 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_borrow.c
+ * @brief  Testcase for the responses with the data borrowed from
+ *         the application (#MHD_create_response_from_borrow_callback())
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_has_in_name.h"
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+/**
+ * The size of the response body
+ */
+#define BORROW_BODY_SIZE (1024 * 1024)
+
+/**
+ * The size of the block returned by the borrow callback, larger than
+ * the connection's write buffer
+ */
+#define BORROW_BLOCK_SIZE (48 * 1024)
+
+/**
+ * The number of the requests sent over the same connection
+ */
+#define BORROW_REQUESTS 4
+
+/**
+ * The size of the socket buffers of the client and the server.
+ * With the small buffers every borrowed block is sent by several calls and
+ * the aborted transfers are closed before the end of the body.
+ */
+#define SOCKET_BUF_SIZE (4 * 1024)
+
+static int oneone;
+static uint16_t global_port;
+
+/**
+ * The number of the blocks returned by the borrow callback
+ */
+static volatile unsigned int borrowed;
+
+/**
+ * The number of the blocks released by MHD
+ */
+static volatile unsigned int released;
+
+/**
+ * Set to non-zero if the borrow callback is called while the previous
+ * block has not been released yet
+ */
+static volatile int borrowed_twice;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+/**
+ * Stop the transfer after the first part of the body is received.
+ */
+static size_t
+abortBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  (void) ptr; (void) size; (void) nmemb; /* Unused. Silence compiler warning. */
+  (void) ctx;  /* Unused. Silence compiler warning. */
+  return 0;
+}
+
+
+static int
+set_small_rcvbuf (void *clientp,
+                  curl_socket_t curlfd,
+                  curlsocktype purpose)
+{
+  int val = SOCKET_BUF_SIZE;
+  (void) clientp; /* Unused. Silence compiler warning. */
+
+  if (CURLSOCKTYPE_IPCXN != purpose)
+    return CURL_SOCKOPT_OK;
+  (void) setsockopt (curlfd, SOL_SOCKET, SO_RCVBUF,
+                     (const void *) &val, sizeof(val));
+  return CURL_SOCKOPT_OK;
+}
+
+
+static void
+set_small_sndbuf (void *cls,
+                  struct MHD_Connection *connection,
+                  void **socket_context,
+                  enum MHD_ConnectionNotificationCode toe)
+{
+  const union MHD_ConnectionInfo *cinfo;
+  int val = SOCKET_BUF_SIZE;
+  (void) cls; (void) socket_context; /* Unused. Silence compiler warning. */
+
+  if (MHD_CONNECTION_NOTIFY_STARTED != toe)
+    return;
+  cinfo = MHD_get_connection_info (connection,
+                                   MHD_CONNECTION_INFO_CONNECTION_FD);
+  if (NULL == cinfo)
+    _exit (99);
+  (void) setsockopt (cinfo->connect_fd, SOL_SOCKET, SO_SNDBUF,
+                     (const void *) &val, sizeof(val));
+}
+
+
+static void
+fill_body (char *buf, uint64_t pos, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; ++i)
+    buf[i] = (char) ('a' + ((pos + i) % 23));
+}
+
+
+/**
+ * The memory of the borrowed blocks, each block is placed at its position
+ * in the body
+ */
+static char borrow_body[BORROW_BODY_SIZE];
+
+
+/**
+ * The release callback of the borrowed block.
+ * The block is destroyed: if the block was released before it was sent
+ * completely, the client would get the damaged body.
+ * @param cls the borrowed block
+ */
+static void
+borrow_release_cb (void *cls)
+{
+  char *const block = (char *) cls;
+  size_t size;
+
+  size = BORROW_BODY_SIZE - (size_t) (block - borrow_body);
+  if (BORROW_BLOCK_SIZE < size)
+    size = BORROW_BLOCK_SIZE;
+  memset (block, 'X', size);
+  released++;
+}
+
+
+static ssize_t
+borrow_cb (void *cls,
+           uint64_t pos,
+           const void **data,
+           MHD_ContentReaderFreeCallback *release,
+           void **release_cls)
+{
+  size_t size;
+  char *block;
+  (void) cls; /* Unused. Silence compiler warning. */
+
+  if (BORROW_BODY_SIZE <= pos)
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  if (borrowed != released)
+    borrowed_twice = ! 0;
+  size = BORROW_BODY_SIZE - (size_t) pos;
+  if (BORROW_BLOCK_SIZE < size)
+    size = BORROW_BLOCK_SIZE;
+  block = borrow_body + (size_t) pos;
+  fill_body (block, pos, size);
+  *data = block;
+  *release = &borrow_release_cb;
+  *release_cls = block;
+  borrowed++;
+  return (ssize_t) size;
+}
+
+
+static enum MHD_Result
+ahc_borrow (void *cls,
+            struct MHD_Connection *connection,
+            const char *url,
+            const char *method,
+            const char *version,
+            const char *upload_data, size_t *upload_data_size,
+            void **req_cls)
+{
+  static int ptr;
+  static unsigned int num_req;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) url;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  /* Use the unknown size (chunked for HTTP/1.1) for every second reply */
+  response =
+    MHD_create_response_from_borrow_callback ((0 == (num_req++ % 2)) ?
+                                              BORROW_BODY_SIZE :
+                                              MHD_SIZE_UNKNOWN,
+                                              &borrow_cb,
+                                              NULL,
+                                              NULL);
+  if (NULL == response)
+  {
+    fprintf (stderr, "Failed to create response.\n");
+    _exit (19);
+  }
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+static struct MHD_Daemon *
+start_daemon (uint32_t flags)
+{
+  struct MHD_Daemon *d;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+  {
+    global_port = 1700;
+    if (oneone)
+      global_port += 5;
+  }
+
+  borrowed = 0;
+  released = 0;
+  borrowed_twice = 0;
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD
+                        | (enum MHD_FLAG) flags,
+                        global_port, NULL, NULL,
+                        &ahc_borrow, NULL,
+                        MHD_OPTION_NOTIFY_CONNECTION, &set_small_sndbuf, NULL,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return NULL;
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d);
+      return NULL;
+    }
+    global_port = dinfo->port;
+  }
+  return d;
+}
+
+
+static CURL *
+setup_curl (void)
+{
+  CURL *c;
+
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1" EXPECTED_URI_PATH);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_SOCKOPTFUNCTION, &set_small_rcvbuf);
+  curl_easy_setopt (c, CURLOPT_BUFFERSIZE, (long) SOCKET_BUF_SIZE);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  return c;
+}
+
+
+static unsigned int
+check_released (void)
+{
+  if (borrowed_twice)
+  {
+    fprintf (stderr, "The next block has been borrowed before the release "
+             "of the previous block.\n");
+    return 256;
+  }
+  if ( (0 == borrowed) ||
+       (borrowed != released) )
+  {
+    fprintf (stderr,
+             "The data borrowed %u times, released %u times.\n",
+             (unsigned int) borrowed, (unsigned int) released);
+    return 512;
+  }
+  return 0;
+}
+
+
+static unsigned int
+testBorrowGet (uint32_t poll_flag)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char *buf;
+  char *expected;
+  struct CBC cbc;
+  CURLcode errornum;
+  unsigned int ret;
+  unsigned int i;
+
+  buf = malloc (BORROW_BODY_SIZE);
+  expected = malloc (BORROW_BODY_SIZE);
+  if ( (NULL == buf) || (NULL == expected) )
+  {
+    free (buf);
+    free (expected);
+    return 1;
+  }
+  fill_body (expected, 0, BORROW_BODY_SIZE);
+  d = start_daemon (poll_flag | MHD_USE_ERROR_LOG);
+  if (NULL == d)
+  {
+    free (buf);
+    free (expected);
+    return 16;
+  }
+  c = setup_curl ();
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  /* Read slowly to get the borrowed blocks sent partially */
+  curl_easy_setopt (c, CURLOPT_MAX_RECV_SPEED_LARGE,
+                    (curl_off_t) (8 * 1024 * 1024));
+  ret = 0;
+  for (i = 0; i < BORROW_REQUESTS && 0 == ret; ++i)
+  {
+    cbc.buf = buf;
+    cbc.size = BORROW_BODY_SIZE;
+    cbc.pos = 0;
+    if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      ret = 32;
+    }
+    else if ( (cbc.pos != BORROW_BODY_SIZE) ||
+              (0 != memcmp (expected, cbc.buf, cbc.pos)) )
+    {
+      fprintf (stderr,
+               "Wrong reply body, received %u bytes.\n",
+               (unsigned int) cbc.pos);
+      ret = 64;
+    }
+  }
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  free (buf);
+  free (expected);
+  if (0 != ret)
+    return ret;
+  return check_released ();
+}
+
+
+/**
+ * Abort the transfers in the middle of the body.  The borrowed blocks
+ * must be released when the connections are closed.
+ * @param poll_flag the polling function flag for the daemon
+ * @return zero on success, error code otherwise
+ */
+static unsigned int
+testBorrowAbortGet (uint32_t poll_flag)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  unsigned int i;
+
+  /* Do not log the expected send errors */
+  d = start_daemon (poll_flag);
+  if (NULL == d)
+    return 16;
+  for (i = 0; i < 2; ++i)
+  {
+    c = setup_curl ();
+    curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &abortBuffer);
+    if (CURLE_WRITE_ERROR != curl_easy_perform (c))
+    {
+      fprintf (stderr, "The transfer has not been aborted.\n");
+      curl_easy_cleanup (c);
+      MHD_stop_daemon (d);
+      return 32;
+    }
+    curl_easy_cleanup (c);
+  }
+  MHD_stop_daemon (d);
+  return check_released ();
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  oneone = has_in_name (argv[0], "11");
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testBorrowGet (0);
+  errorCount += testBorrowAbortGet (0);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+  {
+    errorCount += testBorrowGet (MHD_USE_POLL);
+    errorCount += testBorrowAbortGet (MHD_USE_POLL);
+  }
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+  {
+    errorCount += testBorrowGet (MHD_USE_EPOLL);
+    errorCount += testBorrowAbortGet (MHD_USE_EPOLL);
+  }
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
@@ -66,6 +66,11 @@
 
 static int oneone;
 
+/**
+ * Force chunked reply by the response header?
+ */
+static int chunked_forced;
+
 static int readbuf[TESTSTR_SIZE * 2 / sizeof(int)];
 
 struct CBC
@@ -182,6 +187,13 @@ ahc_cont (void *cls,
                                              TESTSTR_IOVCNT,
                                              &iov_free_callback,
                                              data);
+  if (NULL == response)
+    abort ();
+  if (chunked_forced &&
+      (MHD_NO == MHD_add_response_header (response,
+                                          MHD_HTTP_HEADER_TRANSFER_ENCODING,
+                                          "chunked")))
+    abort ();
   ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
   MHD_destroy_response (response);
   if (ret == MHD_NO)
@@ -245,6 +257,13 @@ ahc_ncont (void *cls,
                                              TESTSTR_IOVCNT,
                                              &iovncont_free_callback,
                                              clear_cls);
+  if (NULL == response)
+    abort ();
+  if (chunked_forced &&
+      (MHD_NO == MHD_add_response_header (response,
+                                          MHD_HTTP_HEADER_TRANSFER_ENCODING,
+                                          "chunked")))
+    abort ();
   ret = MHD_queue_response (connection,
                             MHD_HTTP_OK,
                             response);
@@ -771,6 +790,14 @@ main (int argc, char *const *argv)
   {
     errorCount += testInternalGet (true);
     errorCount += testInternalGet (false);
+    if (oneone)
+    {
+      /* The chunks payload is sent directly from the response's iovec */
+      chunked_forced = ! 0;
+      errorCount += testInternalGet (true);
+      errorCount += testInternalGet (false);
+      chunked_forced = 0;
+    }
     errorCount += testMultithreadedGet ();
     errorCount += testMultithreadedPoolGet ();
     errorCount += testUnknownPortGet ();
@@ -0,0 +1,437 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_memory_profile.c
+ * @brief  Testcase for the histograms of the connection memory use
+ *         (#MHD_OPTION_CONNECTION_MEMORY_PROFILE)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#ifndef MHD_STATICSTR_LEN_
+/**
+ * Determine length of static string / macro strings at compile time.
+ */
+#define MHD_STATICSTR_LEN_(macro) (sizeof(macro) / sizeof(char) - 1)
+#endif /* ! MHD_STATICSTR_LEN_ */
+
+#define SMALL_URI_PATH "/small"
+#define BIG_URI_PATH "/big"
+
+/**
+ * The number of the requests without the additional headers
+ */
+#define SMALL_REQUESTS 2
+
+/**
+ * The number of the requests with the additional headers
+ */
+#define BIG_REQUESTS 3
+
+/**
+ * The number of the additional headers in the big requests
+ */
+#define BIG_HEADERS 32
+
+/**
+ * The value of every additional header
+ */
+#define BIG_HEADER_VALUE \
+  "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef" \
+  "0123456789abcdef0123456789abcdef"
+
+/**
+ * The number of the values added by the access handler for the big
+ * requests
+ */
+#define APP_VALUES 16
+
+/**
+ * The minimal size of the single header entry: the list pointers,
+ * the pointers and the sizes of the name and the value
+ */
+#define MIN_ENTRY_SIZE (6 * sizeof(void *))
+
+/**
+ * The size of the connection memory pool
+ */
+#define POOL_SIZE (32 * 1024)
+
+/**
+ * The size of the reply body
+ */
+#define REPLY_SIZE 64
+
+static uint16_t global_port;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static enum MHD_Result
+ahc_profile (void *cls,
+             struct MHD_Connection *connection,
+             const char *url,
+             const char *method,
+             const char *version,
+             const char *upload_data, size_t *upload_data_size,
+             void **req_cls)
+{
+  static int ptr;
+  static char reply[REPLY_SIZE];
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  if (0 == strcmp (url, BIG_URI_PATH))
+  {
+    unsigned int i;
+
+    /* The memory allocated after processing of the request headers */
+    for (i = 0; i < APP_VALUES; ++i)
+    {
+      if (MHD_YES != MHD_set_connection_value (connection,
+                                               MHD_HEADER_KIND,
+                                               "X-App-Value",
+                                               BIG_HEADER_VALUE))
+      {
+        fprintf (stderr, "Failed to add the connection value.\n");
+        _exit (19);
+      }
+    }
+  }
+  memset (reply, 'r', sizeof(reply));
+  response =
+    MHD_create_response_from_buffer_static (sizeof(reply), reply);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+/**
+ * Get the number of the histogram bucket for the @a value
+ */
+static unsigned int
+bucket_of (size_t value)
+{
+  unsigned int bucket;
+
+  for (bucket = 0; bucket < MHD_MEMORY_PROFILE_BUCKETS - 1; ++bucket)
+  {
+    value >>= 1;
+    if (0 == value)
+      break;
+  }
+  return bucket;
+}
+
+
+/**
+ * Count the requests in the histogram buckets
+ * @param hist the histogram to use
+ * @param first the first bucket to count
+ * @param last the last bucket to count
+ * @return the number of the requests in the buckets
+ */
+static unsigned int
+hist_count (const uint64_t *hist, unsigned int first, unsigned int last)
+{
+  unsigned int i;
+  uint64_t sum = 0;
+
+  for (i = first; i <= last && i < MHD_MEMORY_PROFILE_BUCKETS; ++i)
+    sum += hist[i];
+  return (unsigned int) sum;
+}
+
+
+/**
+ * Check that the histogram has @a num_small requests below the bucket of
+ * the @a big_min value and @a num_big requests in the bucket of
+ * the @a big_min value or above
+ * @return zero if the histogram is correct, non-zero otherwise
+ */
+static unsigned int
+check_hist (const char *name, const uint64_t *hist,
+            size_t big_min, unsigned int num_small, unsigned int num_big)
+{
+  const unsigned int big_bucket = bucket_of (big_min);
+  unsigned int i;
+
+  if ( (num_small != hist_count (hist, 0, big_bucket - 1)) ||
+       (num_big != hist_count (hist, big_bucket,
+                               MHD_MEMORY_PROFILE_BUCKETS - 1)) )
+  {
+    fprintf (stderr, "Wrong '%s' histogram, expected %u requests below "
+             "the bucket %u and %u requests in this bucket or above:",
+             name, num_small, big_bucket, num_big);
+    for (i = 0; i < MHD_MEMORY_PROFILE_BUCKETS; ++i)
+      fprintf (stderr, " %u", (unsigned int) hist[i]);
+    fprintf (stderr, "\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+static unsigned int
+check_profile (const struct MHD_MemoryProfile *prof)
+{
+  const size_t big_hdrs_size =
+    BIG_HEADERS * (MHD_STATICSTR_LEN_ ("X-Test-00: " BIG_HEADER_VALUE)
+                   + 2);
+  unsigned int ret;
+
+  if (SMALL_REQUESTS + BIG_REQUESTS != prof->num_requests)
+  {
+    fprintf (stderr, "Wrong number of profiled requests: %u.\n",
+             (unsigned int) prof->num_requests);
+    return 1;
+  }
+  ret = 0;
+  /* The whole request header is held in the read buffer */
+  ret |= check_hist ("read_buffer", prof->read_buffer, big_hdrs_size,
+                     SMALL_REQUESTS, BIG_REQUESTS);
+  /* Every header of the request has its own entry */
+  ret |= check_hist ("headers", prof->headers,
+                     BIG_HEADERS * MIN_ENTRY_SIZE,
+                     SMALL_REQUESTS, BIG_REQUESTS);
+  /* Only the big requests allocate memory in the access handler */
+  if (SMALL_REQUESTS != prof->app_alloc[0])
+  {
+    fprintf (stderr, "Wrong number of the requests without the memory "
+             "allocated in the access handler: %u.\n",
+             (unsigned int) prof->app_alloc[0]);
+    ret |= 1;
+  }
+  ret |= check_hist ("app_alloc", prof->app_alloc,
+                     APP_VALUES * MIN_ENTRY_SIZE,
+                     SMALL_REQUESTS, BIG_REQUESTS);
+  /* The read buffer grows to the whole pool, but not beyond it */
+  ret |= check_hist ("pool", prof->pool, big_hdrs_size,
+                     0, SMALL_REQUESTS + BIG_REQUESTS);
+  if (0 != hist_count (prof->pool, bucket_of (POOL_SIZE) + 1,
+                       MHD_MEMORY_PROFILE_BUCKETS - 1))
+  {
+    fprintf (stderr, "The pool use is larger than the pool size.\n");
+    ret |= 1;
+  }
+  /* Every reply has the status line and the body copied to the buffer */
+  ret |= check_hist ("write_buffer", prof->write_buffer,
+                     MHD_STATICSTR_LEN_ ("HTTP/1.1 200 OK\r\n") + REPLY_SIZE,
+                     0, SMALL_REQUESTS + BIG_REQUESTS);
+  return ret;
+}
+
+
+static unsigned int
+do_request (CURL *c, const char *path, struct curl_slist *headers)
+{
+  char buf[REPLY_SIZE * 2];
+  struct CBC cbc;
+  CURLcode errornum;
+
+  cbc.buf = buf;
+  cbc.size = sizeof(buf);
+  cbc.pos = 0;
+  curl_easy_setopt (c, CURLOPT_URL, path);
+  curl_easy_setopt (c, CURLOPT_HTTPHEADER, headers);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+  {
+    fprintf (stderr,
+             "curl_easy_perform failed: `%s'\n",
+             curl_easy_strerror (errornum));
+    return 32;
+  }
+  if (REPLY_SIZE != cbc.pos)
+  {
+    fprintf (stderr,
+             "Wrong reply body, received %u bytes.\n",
+             (unsigned int) cbc.pos);
+    return 64;
+  }
+  return 0;
+}
+
+
+static unsigned int
+testMemoryProfileGet (unsigned int profile_flags, unsigned int num_threads)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  struct curl_slist *headers;
+  const union MHD_DaemonInfo *dinfo;
+  const struct MHD_MemoryProfile *prof;
+  unsigned int ret;
+  unsigned int i;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+    global_port = 1710;
+
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
+                        global_port, NULL, NULL,
+                        &ahc_profile, NULL,
+                        MHD_OPTION_THREAD_POOL_SIZE, num_threads,
+                        MHD_OPTION_CONNECTION_MEMORY_LIMIT,
+                        (size_t) POOL_SIZE,
+                        MHD_OPTION_CONNECTION_MEMORY_PROFILE, profile_flags,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 16;
+  if (0 == global_port)
+  {
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    global_port = dinfo->port;
+  }
+  headers = NULL;
+  for (i = 0; i < BIG_HEADERS; ++i)
+  {
+    char hdr[] = "X-Test-00: " BIG_HEADER_VALUE;
+    struct curl_slist *tmp;
+
+    hdr[7] = (char) ('0' + i / 10);
+    hdr[8] = (char) ('0' + i % 10);
+    tmp = curl_slist_append (headers, hdr);
+    if (NULL == tmp)
+      abort ();
+    headers = tmp;
+  }
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  ret = 0;
+  for (i = 0; i < SMALL_REQUESTS + BIG_REQUESTS && 0 == ret; ++i)
+  {
+    if (0 == i % 2 && i / 2 < SMALL_REQUESTS)
+      ret = do_request (c, "http://127.0.0.1" SMALL_URI_PATH, NULL);
+    else
+      ret = do_request (c, "http://127.0.0.1" BIG_URI_PATH, headers);
+  }
+  curl_easy_cleanup (c);
+  curl_slist_free_all (headers);
+  if (0 != ret)
+  {
+    MHD_stop_daemon (d);
+    return ret;
+  }
+
+  /* The request is accounted by the daemon after sending the reply */
+  prof = NULL;
+  for (i = 0; i < 1000; ++i)
+  {
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_MEMORY_PROFILE);
+    if ( (NULL == dinfo) || (NULL == dinfo->memory_profile) )
+    {
+      fprintf (stderr, "Memory profile is not available.\n");
+      MHD_stop_daemon (d);
+      return 128;
+    }
+    prof = dinfo->memory_profile;
+    if (SMALL_REQUESTS + BIG_REQUESTS <= prof->num_requests)
+      break;
+#ifdef MHD_POSIX_SOCKETS
+    (void) usleep (1000);
+#else
+    Sleep (1);
+#endif
+  }
+  if (0 != check_profile (prof))
+    ret = 256;
+  MHD_stop_daemon (d);
+  return ret;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testMemoryProfileGet (MHD_MEMORY_PROFILE_COLLECT, 0);
+  errorCount += testMemoryProfileGet (MHD_MEMORY_PROFILE_COLLECT
+                                      | MHD_MEMORY_PROFILE_GUARD_PAGES, 4);
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
@@ -0,0 +1,425 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_offload.c
+ * @brief  Testcase for the access handler called in the offload threads
+ *         (#MHD_OPTION_HANDLER_OFFLOAD_THREADS)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_has_in_name.h"
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#if defined(MHD_CPU_COUNT) && (MHD_CPU_COUNT + 0) < 2
+#undef MHD_CPU_COUNT
+#endif
+#if ! defined(MHD_CPU_COUNT)
+#define MHD_CPU_COUNT 2
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+/**
+ * The number of the requests sent over the same connection
+ */
+#define NUM_REQUESTS 3
+
+/**
+ * The number of the daemons stopped while the handler is running
+ */
+#define NUM_STOPS 5
+
+static int oneone;
+static uint16_t global_port;
+
+/**
+ * The data of the request shared by the daemon's thread and the handler
+ */
+struct ReqData
+{
+  /**
+   * The thread processing the connection, set by the URI log callback
+   */
+  pthread_t conn_thread;
+
+  /**
+   * The number of the handler calls
+   */
+  unsigned int calls;
+};
+
+static pthread_mutex_t stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The number of the handler calls in the connection's thread
+ */
+static unsigned int calls_in_conn_thread;
+
+/**
+ * The number of the completed requests
+ */
+static unsigned int requests_done;
+
+/**
+ * The delay in the handler, in milliseconds
+ */
+static volatile unsigned int handler_delay_ms;
+
+/**
+ * Set to non-zero when the handler is entered for the first time
+ */
+static volatile int handler_entered;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static void *
+log_cb (void *cls,
+        const char *uri,
+        struct MHD_Connection *con)
+{
+  struct ReqData *rd;
+  (void) cls;
+  (void) uri;
+  (void) con;
+
+  rd = malloc (sizeof (struct ReqData));
+  if (NULL == rd)
+  {
+    fprintf (stderr, "malloc() failed.\n");
+    _exit (99);
+  }
+  rd->conn_thread = pthread_self ();
+  rd->calls = 0;
+  return rd;
+}
+
+
+static void
+request_completed (void *cls,
+                   struct MHD_Connection *connection,
+                   void **req_cls,
+                   enum MHD_RequestTerminationCode toe)
+{
+  (void) cls;
+  (void) connection;
+  (void) toe;
+  free (*req_cls);
+  *req_cls = NULL;
+}
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **req_cls)
+{
+  struct ReqData *const rd = *req_cls;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (0 != strcmp (MHD_HTTP_METHOD_GET, method))
+    return MHD_NO;              /* unexpected method */
+  if (NULL == rd)
+  {
+    fprintf (stderr, "The request data has not been set.\n");
+    _exit (99);
+  }
+  pthread_mutex_lock (&stat_mutex);
+  if (pthread_equal (rd->conn_thread, pthread_self ()))
+    calls_in_conn_thread++;
+  pthread_mutex_unlock (&stat_mutex);
+  handler_entered = ! 0;
+  if (0 != handler_delay_ms)
+    (void) usleep (handler_delay_ms * 1000);
+  if (0 == rd->calls++)
+    return MHD_YES;
+  response = MHD_create_response_from_buffer_copy (strlen (url),
+                                                   (const void *) url);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    /* The response is not queued if the daemon is being stopped */
+    if (0 != handler_delay_ms)
+      return MHD_NO;
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  pthread_mutex_lock (&stat_mutex);
+  requests_done++;
+  pthread_mutex_unlock (&stat_mutex);
+  return ret;
+}
+
+
+static struct MHD_Daemon *
+start_daemon (uint32_t flags)
+{
+  struct MHD_Daemon *d;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+  {
+    global_port = 1650;
+    if (oneone)
+      global_port += 5;
+  }
+
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | (enum MHD_FLAG) flags,
+                        global_port, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_THREAD_POOL_SIZE, MHD_CPU_COUNT,
+                        MHD_OPTION_HANDLER_OFFLOAD_THREADS, 2u,
+                        MHD_OPTION_HANDLER_OFFLOAD_QUEUE_LIMIT, 16u,
+                        MHD_OPTION_URI_LOG_CALLBACK, &log_cb, NULL,
+                        MHD_OPTION_NOTIFY_COMPLETED, &request_completed, NULL,
+                        MHD_OPTION_END);
+  if (NULL == d)
+    return NULL;
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d);
+      return NULL;
+    }
+    global_port = dinfo->port;
+  }
+  return d;
+}
+
+
+static CURL *
+setup_curl (struct CBC *cbc)
+{
+  CURL *c;
+
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1" EXPECTED_URI_PATH);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  return c;
+}
+
+
+static unsigned int
+testOffloadedGet (uint32_t poll_flag)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  struct CBC cbc;
+  CURLcode errornum;
+  unsigned int i;
+
+  calls_in_conn_thread = 0;
+  requests_done = 0;
+  handler_delay_ms = 0;
+  d = start_daemon (poll_flag | MHD_USE_ERROR_LOG);
+  if (NULL == d)
+    return 16;
+  c = setup_curl (&cbc);
+  /* With HTTP/1.1 the requests re-use the connection */
+  for (i = 0; i < NUM_REQUESTS; ++i)
+  {
+    cbc.buf = buf;
+    cbc.size = sizeof(buf);
+    cbc.pos = 0;
+    if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      curl_easy_cleanup (c);
+      MHD_stop_daemon (d);
+      return 32;
+    }
+    if ( (cbc.pos != strlen (EXPECTED_URI_PATH)) ||
+         (0 != strncmp (EXPECTED_URI_PATH, cbc.buf,
+                        strlen (EXPECTED_URI_PATH))) )
+    {
+      curl_easy_cleanup (c);
+      MHD_stop_daemon (d);
+      return 64;
+    }
+  }
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  if (NUM_REQUESTS != requests_done)
+  {
+    fprintf (stderr, "%u requests were completed instead of %u.\n",
+             requests_done, (unsigned int) NUM_REQUESTS);
+    return 128;
+  }
+  if (0 != calls_in_conn_thread)
+  {
+    fprintf (stderr, "The handler was called %u times in the thread "
+             "processing the connection.\n", calls_in_conn_thread);
+    return 256;
+  }
+  return 0;
+}
+
+
+/**
+ * Stop the daemon while the offloaded handler is running.
+ */
+static unsigned int
+testStopOffloadedGet (uint32_t poll_flag)
+{
+  unsigned int i;
+
+  for (i = 0; i < NUM_STOPS; ++i)
+  {
+    struct MHD_Daemon *d;
+    CURLM *multi;
+    CURL *c;
+    char buf[2048];
+    struct CBC cbc;
+    int running;
+    time_t start;
+
+    handler_entered = 0;
+    handler_delay_ms = 20;
+    /* The requests are aborted by the daemon stop, do not log the errors */
+    d = start_daemon (poll_flag);
+    if (NULL == d)
+      return 16;
+    cbc.buf = buf;
+    cbc.size = sizeof(buf);
+    cbc.pos = 0;
+    c = setup_curl (&cbc);
+    multi = curl_multi_init ();
+    if ( (NULL == multi) ||
+         (CURLM_OK != curl_multi_add_handle (multi, c)) )
+    {
+      fprintf (stderr, "curl_multi_init() failed.\n");
+      _exit (99);
+    }
+    start = time (NULL);
+    do
+    {
+      int numfds;
+      if (CURLM_OK != curl_multi_perform (multi, &running))
+        break;
+      (void) curl_multi_wait (multi, NULL, 0, 1, &numfds);
+    } while ((! handler_entered) && (0 != running) &&
+             (time (NULL) - start <= 10));
+    if (! handler_entered)
+    {
+      fprintf (stderr, "The handler has not been called.\n");
+      curl_multi_remove_handle (multi, c);
+      curl_easy_cleanup (c);
+      curl_multi_cleanup (multi);
+      MHD_stop_daemon (d);
+      return 512;
+    }
+    MHD_stop_daemon (d);
+    curl_multi_remove_handle (multi, c);
+    curl_easy_cleanup (c);
+    curl_multi_cleanup (multi);
+  }
+  handler_delay_ms = 0;
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  oneone = has_in_name (argv[0], "11");
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testOffloadedGet (0);
+  errorCount += testStopOffloadedGet (0);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+  {
+    errorCount += testOffloadedGet (MHD_USE_POLL);
+    errorCount += testStopOffloadedGet (MHD_USE_POLL);
+  }
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+  {
+    errorCount += testOffloadedGet (MHD_USE_EPOLL);
+    errorCount += testStopOffloadedGet (MHD_USE_EPOLL);
+  }
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
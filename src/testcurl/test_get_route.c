@@ -0,0 +1,381 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_route.c
+ * @brief  Testcase for the built-in URL router (#MHD_OPTION_ROUTES)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_has_in_name.h"
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+/**
+ * The size of the path parameter which does not fit the connection's pool
+ */
+#define LARGE_PARAM_SIZE 2500
+
+/**
+ * The connection's memory pool size used to check the pool exhaustion
+ */
+#define SMALL_POOL_SIZE 4096
+
+static int oneone;
+static uint16_t global_port;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **req_cls)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  response = MHD_create_response_from_buffer_copy (strlen (url),
+                                                   (const void *) url);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+static enum MHD_Result
+ahc_route (void *cls,
+           struct MHD_Connection *connection,
+           const char *url,
+           const char *method,
+           const char *version,
+           const char *upload_data, size_t *upload_data_size,
+           void **req_cls)
+{
+  static int ptr;
+  const char *tag = (const char *) cls;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  const char *v;
+  char reply[256];
+  (void) url;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  v = MHD_get_route_param (connection, "id");
+  if (NULL == v)
+    v = MHD_get_route_param (connection, "path");
+  if (NULL == v)
+    v = "";
+  snprintf (reply, sizeof (reply), "%s:%s", tag, v);
+  response = MHD_create_response_from_buffer_copy (strlen (reply),
+                                                   (const void *) reply);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+static unsigned int
+testRoutedGet (void)
+{
+  static const struct MHD_Route routes[] = {
+    { MHD_ROUTE_GET, "/users/:id", &ahc_route, (void *) "user" },
+    { MHD_ROUTE_GET, "/users/me", &ahc_route, (void *) "me" },
+    { 0, "/files/*path", &ahc_route, (void *) "file" },
+    { MHD_ROUTE_POST, "/hello_world", &ahc_route, (void *) "post" },
+    { 0, NULL, NULL, NULL }
+  };
+  static const struct MHD_Route bad_routes[] = {
+    { 0, "/files/*path/more", &ahc_route, NULL },
+    { 0, NULL, NULL, NULL }
+  };
+  static const struct
+  {
+    const char *uri;
+    const char *reply;
+  } checks[] = {
+    { "/users/42?a=b", "user:42" },
+    { "/users/me", "me:" },
+    { "/files/a/b%20c", "file:a/b c" },
+    { "/files/", "file:" },
+    /* Method mismatch: the default handler is used */
+    { EXPECTED_URI_PATH, "/hello_world" }
+  };
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  char url[256];
+  struct CBC cbc;
+  CURLcode errornum;
+  unsigned int i;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+  {
+    global_port = 1660;
+    if (oneone)
+      global_port += 5;
+  }
+
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD,
+                        global_port, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_ROUTES, bad_routes,
+                        MHD_OPTION_END);
+  if (d != NULL)
+  {
+    MHD_stop_daemon (d);
+    return 1024;
+  }
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
+                        global_port, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_ROUTES, routes,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 16;
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    global_port = dinfo->port;
+  }
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  for (i = 0; i < sizeof (checks) / sizeof (checks[0]); ++i)
+  {
+    snprintf (url, sizeof (url), "http://127.0.0.1%s", checks[i].uri);
+    curl_easy_setopt (c, CURLOPT_URL, url);
+    cbc.buf = buf;
+    cbc.size = 2048;
+    cbc.pos = 0;
+    if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      curl_easy_cleanup (c);
+      MHD_stop_daemon (d);
+      return 32;
+    }
+    if ( (cbc.pos != strlen (checks[i].reply)) ||
+         (0 != strncmp (checks[i].reply, cbc.buf, cbc.pos)) )
+    {
+      fprintf (stderr,
+               "Wrong reply for `%s': `%.*s'\n",
+               checks[i].uri,
+               (int) cbc.pos,
+               cbc.buf);
+      curl_easy_cleanup (c);
+      MHD_stop_daemon (d);
+      return 64;
+    }
+  }
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  return 0;
+}
+
+
+/**
+ * Check the reply when the path parameter does not fit the connection's
+ * memory pool.
+ */
+static unsigned int
+testRouteParamNoSpace (void)
+{
+  static const struct MHD_Route routes[] = {
+    { 0, "/files/*path", &ahc_route, (void *) "file" },
+    { 0, NULL, NULL, NULL }
+  };
+  static char url[sizeof("http://127.0.0.1/files/") + LARGE_PARAM_SIZE];
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  struct CBC cbc;
+  CURLcode errornum;
+  long code;
+
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD,
+                        global_port, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_ROUTES, routes,
+                        MHD_OPTION_CONNECTION_MEMORY_LIMIT,
+                        (size_t) SMALL_POOL_SIZE,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 16;
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    global_port = dinfo->port;
+  }
+  strcpy (url, "http://127.0.0.1/files/");
+  memset (url + strlen (url), 'a', LARGE_PARAM_SIZE);
+  url[sizeof(url) - 1] = 0;
+  cbc.buf = buf;
+  cbc.size = sizeof(buf);
+  cbc.pos = 0;
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, url);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+  {
+    fprintf (stderr,
+             "curl_easy_perform failed: `%s'\n",
+             curl_easy_strerror (errornum));
+    curl_easy_cleanup (c);
+    MHD_stop_daemon (d);
+    return 32;
+  }
+  if ( (CURLE_OK != curl_easy_getinfo (c, CURLINFO_RESPONSE_CODE, &code)) ||
+       (MHD_HTTP_REQUEST_HEADER_FIELDS_TOO_LARGE != code) )
+  {
+    fprintf (stderr, "Wrong reply code for the too large path parameter: "
+             "%ld\n", code);
+    curl_easy_cleanup (c);
+    MHD_stop_daemon (d);
+    return 2048;
+  }
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  oneone = has_in_name (argv[0], "11");
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_THREADS))
+  {
+    errorCount += testRoutedGet ();
+    errorCount += testRouteParamNoSpace ();
+  }
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
@@ -91,7 +91,6 @@ ahc_echo (void *cls,
   struct MHD_Response *response;
   enum MHD_Result ret;
   int fd;
-  (void) cls;
   (void) url; (void) version;                      /* Unused. Silent compiler warning. */
   (void) upload_data; (void) upload_data_size;     /* Unused. Silent compiler warning. */
 
@@ -112,6 +111,92 @@ ahc_echo (void *cls,
     exit (1);
   }
   response = MHD_create_response_from_fd (strlen (TESTSTR), fd);
+  if ( (NULL != cls) && oneone)
+  {
+    /* Chunked replies are not sent by sendfile() */
+    if (MHD_NO == MHD_add_response_header (response,
+                                           MHD_HTTP_HEADER_TRANSFER_ENCODING,
+                                           "chunked"))
+      abort ();
+  }
+  ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+    abort ();
+  return ret;
+}
+
+
+static void
+segments_free_cb (void *cls)
+{
+  int *fd = (int *) cls;
+
+  (void) close (*fd);
+  *fd = -1;
+}
+
+
+static enum MHD_Result
+ahc_segments (void *cls,
+              struct MHD_Connection *connection,
+              const char *url,
+              const char *method,
+              const char *version,
+              const char *upload_data, size_t *upload_data_size,
+              void **req_cls)
+{
+  static int ptr;
+  static int fd;
+  struct MHD_ResponseSegment segs[6];
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) url; (void) version;                      /* Unused. Silent compiler warning. */
+  (void) upload_data; (void) upload_data_size;     /* Unused. Silent compiler warning. */
+
+  if (0 != strcmp (MHD_HTTP_METHOD_GET, method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  fd = open (sourcefile, O_RDONLY);
+  if (fd == -1)
+  {
+    fprintf (stderr, "Failed to open `%s': %s\n",
+             sourcefile,
+             strerror (errno));
+    exit (1);
+  }
+  /* "<<" + TESTSTR[8..17] + "|" + "" + "--" + TESTSTR[0..6] */
+  memset (segs, 0, sizeof (segs));
+  segs[0].fd = -1;
+  segs[0].data = "<<";
+  segs[0].size = 2;
+  segs[1].fd = fd;
+  segs[1].offset = 8;
+  segs[1].size = 10;
+  segs[2].fd = -1;
+  segs[2].data = "|";
+  segs[2].size = 1;
+  segs[3].fd = -1;
+  segs[3].data = NULL;
+  segs[3].size = 0;
+  segs[4].fd = -1;
+  segs[4].data = "--";
+  segs[4].size = 2;
+  segs[5].fd = fd;
+  segs[5].offset = 0;
+  segs[5].size = 7;
+  response = MHD_create_response_from_segments (segs,
+                                                6,
+                                                &segments_free_cb,
+                                                &fd);
+  if (NULL == response)
+    abort ();
   ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
   MHD_destroy_response (response);
   if (ret == MHD_NO)
@@ -120,6 +205,77 @@ ahc_echo (void *cls,
 }
 
 
+static unsigned int
+testSegmentsGet (void)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  char expected[64];
+  struct CBC cbc;
+  CURLcode errornum;
+  uint16_t port;
+
+  if (MHD_NO != MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT))
+    port = 0;
+  else
+  {
+    port = 1205;
+    if (oneone)
+      port += 10;
+  }
+
+  snprintf (expected, sizeof (expected), "<<%.10s|--%.7s",
+            TESTSTR + 8, TESTSTR);
+  cbc.buf = buf;
+  cbc.size = 2048;
+  cbc.pos = 0;
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
+                        port, NULL, NULL, &ahc_segments, NULL, MHD_OPTION_END);
+  if (d == NULL)
+    return 1;
+  if (0 == port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    port = dinfo->port;
+  }
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1/");
+  curl_easy_setopt (c, CURLOPT_PORT, (long) port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+  {
+    fprintf (stderr,
+             "curl_easy_perform failed: `%s'\n",
+             curl_easy_strerror (errornum));
+    curl_easy_cleanup (c);
+    MHD_stop_daemon (d);
+    return 2;
+  }
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  if (cbc.pos != strlen (expected))
+    return 4;
+  if (0 != strncmp (expected, cbc.buf, strlen (expected)))
+    return 8;
+  return 0;
+}
+
+
 static unsigned int
 testInternalGet (void)
 {
@@ -191,6 +347,87 @@ testInternalGet (void)
 }
 
 
+static unsigned int
+testFileReadThreadsGet (void)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  struct CBC cbc;
+  CURLcode errornum;
+  uint16_t port;
+  unsigned int i;
+
+  if (MHD_NO != MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT))
+    port = 0;
+  else
+  {
+    port = 1206;
+    if (oneone)
+      port += 10;
+  }
+
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
+                        port, NULL, NULL, &ahc_echo, &oneone,
+                        MHD_OPTION_THREAD_POOL_SIZE, MHD_CPU_COUNT,
+                        MHD_OPTION_FILE_READ_THREADS, (unsigned int) 2,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 1;
+  if (0 == port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    port = dinfo->port;
+  }
+  for (i = 0; i < 3; ++i)
+  {
+    cbc.buf = buf;
+    cbc.size = 2048;
+    cbc.pos = 0;
+    c = curl_easy_init ();
+    curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1/");
+    curl_easy_setopt (c, CURLOPT_PORT, (long) port);
+    curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+    curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+    curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+    curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+    if (oneone)
+      curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    else
+      curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+    curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+    if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      curl_easy_cleanup (c);
+      MHD_stop_daemon (d);
+      return 2;
+    }
+    curl_easy_cleanup (c);
+    if (cbc.pos != strlen (TESTSTR))
+    {
+      MHD_stop_daemon (d);
+      return 4;
+    }
+    if (0 != strncmp (TESTSTR, cbc.buf, strlen (TESTSTR)))
+    {
+      MHD_stop_daemon (d);
+      return 8;
+    }
+  }
+  MHD_stop_daemon (d);
+  return 0;
+}
+
+
 static unsigned int
 testMultithreadedGet (void)
 {
@@ -658,6 +895,8 @@ main (int argc, char *const *argv)
   if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_THREADS))
   {
     errorCount += testInternalGet ();
+    errorCount += testSegmentsGet ();
+    errorCount += testFileReadThreadsGet ();
     errorCount += testMultithreadedGet ();
     errorCount += testMultithreadedPoolGet ();
     errorCount += testUnknownPortGet ();
@@ -0,0 +1,391 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_shared.c
+ * @brief  Testcase for one callback response served by several
+ *         threads at once (#MHD_RF_CONTENT_READER_THREAD_SAFE)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_has_in_name.h"
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+/**
+ * The size of the body of the shared response
+ */
+#define SHARED_BODY_SIZE (64 * 1024)
+
+/**
+ * The block size of the shared response
+ */
+#define SHARED_BLOCK_SIZE 4096
+
+/**
+ * The number of the simultaneous requests for the shared response,
+ * each request is processed by its own thread
+ */
+#define SHARED_CLIENTS 4
+
+/**
+ * The maximum time to wait for the overlapping content reader call,
+ * in milliseconds
+ */
+#define OVERLAP_WAIT_MS 200
+
+static int oneone;
+static uint16_t global_port;
+
+static struct MHD_Response *shared_response;
+
+static pthread_mutex_t stat_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * The number of the content reader calls running at the moment
+ */
+static unsigned int readers_active;
+
+/**
+ * The maximum number of the content reader calls running at once
+ */
+static unsigned int readers_max;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static void
+fill_body (char *buf, uint64_t pos, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; ++i)
+    buf[i] = (char) ('a' + ((pos + i) % 23));
+}
+
+
+/**
+ * The content reader shared by all connections.
+ * The first call for each connection waits for the call from another
+ * connection, the calls overlap unless they are serialised.
+ */
+static ssize_t
+shared_crc (void *cls,
+            uint64_t pos,
+            char *buf,
+            size_t max)
+{
+  unsigned int i;
+  (void) cls; /* Unused. Silence compiler warning. */
+
+  if (SHARED_BODY_SIZE <= pos)
+    return MHD_CONTENT_READER_END_OF_STREAM;
+  pthread_mutex_lock (&stat_mutex);
+  if (++readers_active > readers_max)
+    readers_max = readers_active;
+  pthread_mutex_unlock (&stat_mutex);
+  if (max > SHARED_BODY_SIZE - pos)
+    max = (size_t) (SHARED_BODY_SIZE - pos);
+  fill_body (buf, pos, max);
+  for (i = 0; (0 == pos) && (i < OVERLAP_WAIT_MS); ++i)
+  {
+    unsigned int num_max;
+
+    pthread_mutex_lock (&stat_mutex);
+    num_max = readers_max;
+    pthread_mutex_unlock (&stat_mutex);
+    if (1 < num_max)
+      break;
+    (void) usleep (1000);
+  }
+  pthread_mutex_lock (&stat_mutex);
+  readers_active--;
+  pthread_mutex_unlock (&stat_mutex);
+  return (ssize_t) max;
+}
+
+
+static enum MHD_Result
+ahc_shared (void *cls,
+            struct MHD_Connection *connection,
+            const char *url,
+            const char *method,
+            const char *version,
+            const char *upload_data, size_t *upload_data_size,
+            void **req_cls)
+{
+  static int ptr;
+  (void) cls;
+  (void) url;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  return MHD_queue_response (connection,
+                             MHD_HTTP_OK,
+                             shared_response);
+}
+
+
+/**
+ * Serve one response to several clients at once.
+ * @param poll_flag the polling function flag for the daemon
+ * @param thread_safe if non-zero, the response is marked with
+ *                    #MHD_RF_CONTENT_READER_THREAD_SAFE
+ * @return zero on success, error code otherwise
+ */
+static unsigned int
+testSharedCallbackGet (uint32_t poll_flag, int thread_safe)
+{
+  struct MHD_Daemon *d;
+  CURLM *multi;
+  CURL *c[SHARED_CLIENTS];
+  struct CBC cbc[SHARED_CLIENTS];
+  char *expected;
+  int running;
+  time_t start;
+  struct CURLMsg *msg;
+  unsigned int done;
+  unsigned int ret;
+  unsigned int i;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+  {
+    global_port = 1690;
+    if (oneone)
+      global_port += 5;
+  }
+
+  readers_active = 0;
+  readers_max = 0;
+  shared_response = MHD_create_response_from_callback (SHARED_BODY_SIZE,
+                                                       SHARED_BLOCK_SIZE,
+                                                       &shared_crc,
+                                                       NULL,
+                                                       NULL);
+  if (NULL == shared_response)
+    return 1;
+  if (thread_safe &&
+      (MHD_YES !=
+       MHD_set_response_options (shared_response,
+                                 MHD_RF_CONTENT_READER_THREAD_SAFE,
+                                 MHD_RO_END)))
+  {
+    MHD_destroy_response (shared_response);
+    return 2;
+  }
+  expected = malloc (SHARED_BODY_SIZE * (SHARED_CLIENTS + 1));
+  if (NULL == expected)
+  {
+    MHD_destroy_response (shared_response);
+    return 1;
+  }
+  fill_body (expected, 0, SHARED_BODY_SIZE);
+
+  d = MHD_start_daemon (MHD_USE_THREAD_PER_CONNECTION
+                        | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG
+                        | (enum MHD_FLAG) poll_flag,
+                        global_port, NULL, NULL,
+                        &ahc_shared, NULL,
+                        MHD_OPTION_END);
+  if (d == NULL)
+  {
+    MHD_destroy_response (shared_response);
+    free (expected);
+    return 16;
+  }
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d);
+      MHD_destroy_response (shared_response);
+      free (expected);
+      return 32;
+    }
+    global_port = dinfo->port;
+  }
+  multi = curl_multi_init ();
+  if (NULL == multi)
+    abort ();
+  for (i = 0; i < SHARED_CLIENTS; ++i)
+  {
+    cbc[i].buf = expected + SHARED_BODY_SIZE * (i + 1);
+    cbc[i].size = SHARED_BODY_SIZE;
+    cbc[i].pos = 0;
+    c[i] = curl_easy_init ();
+    if (NULL == c[i])
+      abort ();
+    curl_easy_setopt (c[i], CURLOPT_URL, "http://127.0.0.1" EXPECTED_URI_PATH);
+    curl_easy_setopt (c[i], CURLOPT_PORT, (long) global_port);
+    curl_easy_setopt (c[i], CURLOPT_WRITEFUNCTION, &copyBuffer);
+    curl_easy_setopt (c[i], CURLOPT_WRITEDATA, &cbc[i]);
+    curl_easy_setopt (c[i], CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt (c[i], CURLOPT_TIMEOUT, 150L);
+    if (oneone)
+      curl_easy_setopt (c[i], CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+    else
+      curl_easy_setopt (c[i], CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+    curl_easy_setopt (c[i], CURLOPT_CONNECTTIMEOUT, 150L);
+    curl_easy_setopt (c[i], CURLOPT_NOSIGNAL, 1L);
+    if (CURLM_OK != curl_multi_add_handle (multi, c[i]))
+      abort ();
+  }
+  ret = 0;
+  done = 0;
+  running = 1;
+  start = time (NULL);
+  while ( (0 != running) &&
+          (time (NULL) - start < 30) )
+  {
+    fd_set rs;
+    fd_set ws;
+    fd_set es;
+    int maxposixs = -1;
+    struct timeval tv;
+
+    FD_ZERO (&rs);
+    FD_ZERO (&ws);
+    FD_ZERO (&es);
+    if (CURLM_OK != curl_multi_perform (multi, &running))
+      abort ();
+    if (CURLM_OK != curl_multi_fdset (multi, &rs, &ws, &es, &maxposixs))
+      abort ();
+    tv.tv_sec = 0;
+    tv.tv_usec = 1000;
+    if (-1 != maxposixs)
+      (void) select (maxposixs + 1, &rs, &ws, &es, &tv);
+    else
+      (void) usleep (1000);
+  }
+  while (NULL != (msg = curl_multi_info_read (multi, &running)))
+  {
+    if (CURLMSG_DONE != msg->msg)
+      continue;
+    if (CURLE_OK != msg->data.result)
+    {
+      fprintf (stderr,
+               "Request failed: `%s'\n",
+               curl_easy_strerror (msg->data.result));
+      ret |= 64;
+    }
+    else
+      done++;
+  }
+  for (i = 0; i < SHARED_CLIENTS; ++i)
+  {
+    curl_multi_remove_handle (multi, c[i]);
+    curl_easy_cleanup (c[i]);
+    if ( (SHARED_BODY_SIZE != cbc[i].pos) ||
+         (0 != memcmp (expected, cbc[i].buf, SHARED_BODY_SIZE)) )
+    {
+      fprintf (stderr,
+               "Wrong reply body, received %u bytes.\n",
+               (unsigned int) cbc[i].pos);
+      ret |= 128;
+    }
+  }
+  curl_multi_cleanup (multi);
+  MHD_stop_daemon (d);
+  MHD_destroy_response (shared_response);
+  free (expected);
+  if (SHARED_CLIENTS != done)
+    ret |= 256;
+  if (0 != ret)
+    return ret;
+  if (thread_safe && (2 > readers_max))
+  {
+    fprintf (stderr, "The thread-safe content reader has never been "
+             "called by several threads at once.\n");
+    return 512;
+  }
+  if (! thread_safe && (1 != readers_max))
+  {
+    fprintf (stderr, "The content reader has been called by %u threads "
+             "at once while the response is not thread-safe.\n",
+             readers_max);
+    return 1024;
+  }
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  oneone = has_in_name (argv[0], "11");
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testSharedCallbackGet (0, ! 0);
+  errorCount += testSharedCallbackGet (0, 0);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+    errorCount += testSharedCallbackGet (MHD_USE_POLL, ! 0);
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
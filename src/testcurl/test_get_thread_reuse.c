@@ -0,0 +1,287 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_thread_reuse.c
+ * @brief  Testcase for the reuse of the connection threads
+ *         (#MHD_OPTION_THREAD_REUSE_MAX_IDLE)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_has_in_name.h"
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+/**
+ * The number of the requests, each request uses the new connection
+ */
+#define NUM_REQUESTS 5
+
+static int oneone;
+static uint16_t global_port;
+
+/**
+ * The key of the thread-specific marker set by the first request processed
+ * by the thread
+ */
+static pthread_key_t thread_marker;
+
+/**
+ * The number of the requests processed by the threads not used before
+ */
+static volatile unsigned int new_threads;
+
+/**
+ * The number of the requests processed by the threads used before
+ */
+static volatile unsigned int reused_threads;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **req_cls)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (0 != strcmp (MHD_HTTP_METHOD_GET, method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  /* Only one request is processed at any moment, no locking is needed */
+  if (NULL == pthread_getspecific (thread_marker))
+  {
+    new_threads++;
+    if (0 != pthread_setspecific (thread_marker, &ptr))
+    {
+      fprintf (stderr, "pthread_setspecific() failed.\n");
+      _exit (99);
+    }
+  }
+  else
+    reused_threads++;
+  response = MHD_create_response_from_buffer_copy (strlen (url),
+                                                   (const void *) url);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+static unsigned int
+doGet (void)
+{
+  CURL *c;
+  char buf[2048];
+  struct CBC cbc;
+  CURLcode errornum;
+
+  cbc.buf = buf;
+  cbc.size = sizeof(buf);
+  cbc.pos = 0;
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1" EXPECTED_URI_PATH);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_FORBID_REUSE, 1L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  if (CURLE_OK != (errornum = curl_easy_perform (c)))
+  {
+    fprintf (stderr,
+             "curl_easy_perform failed: `%s'\n",
+             curl_easy_strerror (errornum));
+    curl_easy_cleanup (c);
+    return 32;
+  }
+  curl_easy_cleanup (c);
+  if (cbc.pos != strlen (EXPECTED_URI_PATH))
+    return 64;
+  if (0 != strncmp (EXPECTED_URI_PATH, cbc.buf, strlen (EXPECTED_URI_PATH)))
+    return 128;
+  return 0;
+}
+
+
+/**
+ * Run the requests with the new connections one by one.
+ * @param poll_flag the polling function flag for the daemon
+ * @param max_idle the value for #MHD_OPTION_THREAD_REUSE_MAX_IDLE
+ * @return zero on success, error code otherwise
+ */
+static unsigned int
+testThreadReuseGet (uint32_t poll_flag, unsigned int max_idle)
+{
+  struct MHD_Daemon *d;
+  unsigned int i;
+  unsigned int ret;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+  {
+    global_port = 1640;
+    if (oneone)
+      global_port += 5;
+  }
+
+  new_threads = 0;
+  reused_threads = 0;
+  d = MHD_start_daemon (MHD_USE_THREAD_PER_CONNECTION
+                        | MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG
+                        | (enum MHD_FLAG) poll_flag,
+                        global_port, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_THREAD_REUSE_MAX_IDLE, max_idle,
+                        MHD_OPTION_THREAD_REUSE_MIN_IDLE, 0u,
+                        MHD_OPTION_THREAD_REUSE_IDLE_TIMEOUT, 60u,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 16;
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    global_port = dinfo->port;
+  }
+  ret = 0;
+  for (i = 0; i < NUM_REQUESTS && 0 == ret; ++i)
+  {
+    ret = doGet ();
+    /* Give the thread the time to finish the connection and to park */
+    (void) usleep (50000);
+  }
+  MHD_stop_daemon (d);
+  if (0 != ret)
+    return ret;
+  if (NUM_REQUESTS != new_threads + reused_threads)
+  {
+    fprintf (stderr, "Processed %u requests instead of %u.\n",
+             new_threads + reused_threads, (unsigned int) NUM_REQUESTS);
+    return 256;
+  }
+  if (0 == max_idle)
+  {
+    if (0 != reused_threads)
+    {
+      fprintf (stderr, "%u requests were processed by the reused threads, "
+               "while the reuse is disabled.\n", reused_threads);
+      return 512;
+    }
+  }
+  else if (1 != new_threads)
+  {
+    fprintf (stderr, "%u threads were started for %u sequential "
+             "connections, while one parked thread should be reused.\n",
+             new_threads, (unsigned int) NUM_REQUESTS);
+    return 1024;
+  }
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  oneone = has_in_name (argv[0], "11");
+  if (0 != pthread_key_create (&thread_marker, NULL))
+    return 99;
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testThreadReuseGet (0, 0);
+  errorCount += testThreadReuseGet (0, 2);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+    errorCount += testThreadReuseGet (MHD_USE_POLL, 2);
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  (void) pthread_key_delete (thread_marker);
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
@@ -0,0 +1,476 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_watch.c
+ * @brief  Testcase for the daemon driven by the sockets watched by
+ *         the application (#MHD_OPTION_WATCH_SOCKET_CALLBACK)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_has_in_name.h"
+#include "mhd_sockets.h" /* only macros used */
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif /* !WIN32_LEAN_AND_MEAN */
+#include <windows.h>
+#endif
+
+#ifndef WINDOWS
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+#define WATCH_MAX_SOCKETS 16
+
+/**
+ * The number of the requests sent by the client
+ */
+#define NUM_REQUESTS 4
+
+static int oneone;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+struct WatchedSocket
+{
+  MHD_socket fd;
+  void *mhd_ctx;
+  enum MHD_WatchEvents interest;
+  int used;
+};
+
+static struct WatchedSocket watched[WATCH_MAX_SOCKETS];
+
+/**
+ * The last value reported by the timer callback
+ */
+static int64_t watch_timer_ms;
+
+/**
+ * The number of calls of the timer callback with the positive timeout
+ */
+static unsigned int timer_positive_calls;
+
+/**
+ * The number of calls of the timer callback with zero timeout
+ */
+static unsigned int timer_zero_calls;
+
+/**
+ * The number of the processed network events on the watched sockets
+ */
+static unsigned int watched_runs;
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static enum MHD_Result
+ahc_echo (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **req_cls)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (0 != strcmp (MHD_HTTP_METHOD_GET, method))
+    return MHD_NO;              /* unexpected method */
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  response = MHD_create_response_from_buffer_copy (strlen (url),
+                                                   (const void *) url);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+static void
+watch_socket_cb (void *cls,
+                 MHD_socket fd,
+                 enum MHD_WatchEvents interest,
+                 void *mhd_sckt_ctx,
+                 void **app_sckt_ctx)
+{
+  struct WatchedSocket *ws = (struct WatchedSocket *) *app_sckt_ctx;
+  (void) cls;
+
+  if (NULL == ws)
+  {
+    unsigned int i;
+    if (MHD_WATCH_EVENT_REMOVE == interest)
+    {
+      fprintf (stderr, "Removal of not watched socket. Line: %d\n",
+               __LINE__);
+      abort ();
+    }
+    for (i = 0; i < WATCH_MAX_SOCKETS; ++i)
+    {
+      if (! watched[i].used)
+        break;
+    }
+    if (WATCH_MAX_SOCKETS == i)
+    {
+      fprintf (stderr, "Too many watched sockets. Line: %d\n", __LINE__);
+      abort ();
+    }
+    ws = watched + i;
+    ws->used = ! 0;
+    ws->fd = fd;
+    ws->mhd_ctx = mhd_sckt_ctx;
+    *app_sckt_ctx = ws;
+  }
+  if ((fd != ws->fd) || (mhd_sckt_ctx != ws->mhd_ctx))
+  {
+    fprintf (stderr, "Wrong socket context. Line: %d\n", __LINE__);
+    abort ();
+  }
+  if (MHD_WATCH_EVENT_REMOVE == interest)
+  {
+    ws->used = 0;
+    *app_sckt_ctx = NULL;
+    return;
+  }
+  ws->interest = interest;
+}
+
+
+static void
+watch_timer_cb (void *cls,
+                int64_t timeout_ms)
+{
+  (void) cls;
+  watch_timer_ms = timeout_ms;
+  if (0 < timeout_ms)
+    timer_positive_calls++;
+  else if (0 == timeout_ms)
+    timer_zero_calls++;
+}
+
+
+/**
+ * Run the watched sockets and the curl handle until the transfer is
+ * completed.
+ * @return zero on success, error code otherwise
+ */
+static unsigned int
+run_transfer (struct MHD_Daemon *d, CURLM *multi)
+{
+  fd_set rs;
+  fd_set ws;
+  fd_set es;
+  int maxposixs;
+  int running;
+  struct CURLMsg *msg;
+  time_t start;
+  struct timeval tv;
+  unsigned int i;
+
+  start = time (NULL);
+  while (time (NULL) - start < 5)
+  {
+    struct WatchedSocket snapshot[WATCH_MAX_SOCKETS];
+
+    maxposixs = -1;
+    FD_ZERO (&rs);
+    FD_ZERO (&ws);
+    FD_ZERO (&es);
+    curl_multi_perform (multi, &running);
+    if (CURLM_OK != curl_multi_fdset (multi, &rs, &ws, &es, &maxposixs))
+      return 2048;
+    for (i = 0; i < WATCH_MAX_SOCKETS; ++i)
+    {
+      if (! watched[i].used)
+        continue;
+      if (0 != (watched[i].interest & MHD_WATCH_EVENT_RECV))
+        FD_SET (watched[i].fd, &rs);
+      if (0 != (watched[i].interest & MHD_WATCH_EVENT_SEND))
+        FD_SET (watched[i].fd, &ws);
+#ifdef MHD_POSIX_SOCKETS
+      if (watched[i].fd > maxposixs)
+        maxposixs = watched[i].fd;
+#endif /* MHD_POSIX_SOCKETS */
+    }
+    tv.tv_sec = 0;
+    tv.tv_usec = 1000;
+    if (-1 == select (maxposixs + 1, &rs, &ws, &es, &tv))
+    {
+#ifdef MHD_POSIX_SOCKETS
+      if (EINTR != errno)
+      {
+        fprintf (stderr, "Unexpected select() error: %d. Line: %d\n",
+                 (int) errno, __LINE__);
+        fflush (stderr);
+        exit (99);
+      }
+#else
+      if ((WSAEINVAL != WSAGetLastError ()) ||
+          (0 != rs.fd_count) || (0 != ws.fd_count) || (0 != es.fd_count) )
+      {
+        fprintf (stderr, "Unexpected select() error: %d. Line: %d\n",
+                 (int) WSAGetLastError (), __LINE__);
+        fflush (stderr);
+        exit (99);
+      }
+      Sleep (1);
+#endif
+    }
+    /* The watched set may be changed by MHD_run_watched() */
+    memcpy (snapshot, watched, sizeof(snapshot));
+    for (i = 0; i < WATCH_MAX_SOCKETS; ++i)
+    {
+      unsigned int events = 0;
+      if (! snapshot[i].used)
+        continue;
+      if ((snapshot[i].interest & MHD_WATCH_EVENT_RECV) &&
+          FD_ISSET (snapshot[i].fd, &rs))
+        events |= MHD_WATCH_EVENT_RECV;
+      if ((snapshot[i].interest & MHD_WATCH_EVENT_SEND) &&
+          FD_ISSET (snapshot[i].fd, &ws))
+        events |= MHD_WATCH_EVENT_SEND;
+      if ((0 == events) ||
+          (! watched[i].used) ||
+          (watched[i].mhd_ctx != snapshot[i].mhd_ctx))
+        continue;
+      if (MHD_YES != MHD_run_watched (d, snapshot[i].mhd_ctx, events))
+        return 4096;
+      watched_runs++;
+    }
+    /* The connection timeout is much longer than the test, only
+       the immediate processing is requested by the timer */
+    if (0 == watch_timer_ms)
+    {
+      watch_timer_ms = -1;
+      MHD_run_watched (d, NULL, 0);
+    }
+    curl_multi_perform (multi, &running);
+    if (0 == running)
+    {
+      int pending;
+      int curl_fine = 0;
+      while (NULL != (msg = curl_multi_info_read (multi, &pending)))
+      {
+        if (msg->msg == CURLMSG_DONE)
+        {
+          if (msg->data.result == CURLE_OK)
+            curl_fine = 1;
+          else
+          {
+            fprintf (stderr,
+                     "%s failed at %s:%d: `%s'\n",
+                     "curl_multi_perform",
+                     __FILE__,
+                     __LINE__, curl_easy_strerror (msg->data.result));
+            abort ();
+          }
+        }
+      }
+      if (! curl_fine)
+      {
+        fprintf (stderr, "libcurl haven't returned OK code\n");
+        abort ();
+      }
+      return 0;
+    }
+  }
+  fprintf (stderr, "The transfer has not been completed in time.\n");
+  return 8192;
+}
+
+
+static unsigned int
+testWatchedGet (void)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char buf[2048];
+  struct CBC cbc;
+  CURLM *multi;
+  uint16_t port;
+  unsigned int i;
+  unsigned int ret = 0;
+
+  if (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT))
+    port = oneone ? 1620 : 1600;
+  else
+    port = 0;
+
+  memset (watched, 0, sizeof(watched));
+  watch_timer_ms = -1;
+  timer_positive_calls = 0;
+  timer_zero_calls = 0;
+  watched_runs = 0;
+  d = MHD_start_daemon (MHD_USE_ERROR_LOG,
+                        port, NULL, NULL,
+                        &ahc_echo, NULL,
+                        MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int) 60,
+                        MHD_OPTION_WATCH_SOCKET_CALLBACK,
+                        &watch_socket_cb, NULL,
+                        MHD_OPTION_WATCH_TIMER_CALLBACK,
+                        &watch_timer_cb, NULL,
+                        MHD_OPTION_END);
+  if (d == NULL)
+    return 256;
+  if (0 == port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); return 32;
+    }
+    port = dinfo->port;
+  }
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1" EXPECTED_URI_PATH);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  if (oneone)
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  else
+    curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_0);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+
+  multi = curl_multi_init ();
+  if (multi == NULL)
+  {
+    curl_easy_cleanup (c);
+    MHD_stop_daemon (d);
+    return 512;
+  }
+  /* With HTTP/1.1 the same connection is reused by all requests */
+  for (i = 0; (i < NUM_REQUESTS) && (0 == ret); ++i)
+  {
+    cbc.buf = buf;
+    cbc.size = sizeof(buf);
+    cbc.pos = 0;
+    if (CURLM_OK != curl_multi_add_handle (multi, c))
+    {
+      ret = 1024;
+      break;
+    }
+    ret = run_transfer (d, multi);
+    curl_multi_remove_handle (multi, c);
+    /* Let the time of the last activity be changed by the next request */
+#ifndef _WIN32
+    usleep (3000);
+#else
+    Sleep (3);
+#endif
+    if ( (0 == ret) &&
+         ((cbc.pos != strlen (EXPECTED_URI_PATH)) ||
+          (0 != strncmp (EXPECTED_URI_PATH, cbc.buf, cbc.pos))) )
+      ret = 16384;
+  }
+  curl_easy_cleanup (c);
+  curl_multi_cleanup (multi);
+  MHD_stop_daemon (d);
+  if (0 != ret)
+    return ret;
+  for (i = 0; i < WATCH_MAX_SOCKETS; ++i)
+  {
+    if (watched[i].used)
+      return 32768; /* The socket was not removed from the watched set */
+  }
+  if (0 == watched_runs)
+    return 65536; /* The daemon was not driven by the watched sockets */
+  /* The connection timeout deadline is moved later by every activity on
+     the connection, it must not be reported again while the timer already
+     set fires earlier.  The timer is re-armed only after it has fired. */
+  if (timer_positive_calls > timer_zero_calls + 1 + (oneone ? 0 : NUM_REQUESTS))
+  {
+    fprintf (stderr, "The timer callback has been called %u times with "
+             "positive timeout for %u processed network events.\n",
+             timer_positive_calls, watched_runs);
+    return 131072;
+  }
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc;   /* Unused. Silence compiler warning. */
+
+  if ((NULL == argv) || (0 == argv[0]))
+    return 99;
+  oneone = has_in_name (argv[0], "11");
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testWatchedGet ();
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
@@ -0,0 +1,471 @@
+/*
+     This file is part of libmicrohttpd
+     Copyright (C) 2026 agent
+
+     libmicrohttpd is free software; you can redistribute it and/or modify
+     it under the terms of the GNU General Public License as published
+     by the Free Software Foundation; either version 2, or (at your
+     option) any later version.
+
+     libmicrohttpd is distributed in the hope that it will be useful, but
+     WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     General Public License for more details.
+
+     You should have received a copy of the GNU General Public License
+     along with libmicrohttpd; see the file COPYING.  If not, write to the
+     Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+     Boston, MA 02110-1301, USA.
+*/
+/**
+ * @file test_get_zerocopy.c
+ * @brief  Testcase for the zero-copy send of the large in-memory bodies
+ *         (#MHD_OPTION_ZEROCOPY_THRESHOLD)
+ * @author agent
+ */
+#include "MHD_config.h"
+#include "platform.h"
+#include <curl/curl.h>
+#include <microhttpd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include "mhd_sockets.h" /* only macros used */
+
+#ifndef WINDOWS
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#define EXPECTED_URI_PATH "/hello_world"
+
+/**
+ * The size of the response body
+ */
+#define ZC_BODY_SIZE (1024 * 1024)
+
+/**
+ * The number of requests sent over the same connection
+ */
+#define ZC_REQUESTS 3
+
+/**
+ * The receive buffer size of the client socket.
+ * The client reads slowly with the small buffer, so the most of the reply
+ * is still queued in the server socket when the reply is complete for MHD.
+ */
+#define CLIENT_RCV_BUF (4 * 1024)
+
+/**
+ * The connection timeout, in seconds, used to close the connection while
+ * the reply is still queued in the server socket
+ */
+#define CONN_TIMEOUT_SEC 1
+
+static uint16_t global_port;
+
+/**
+ * The bodies of the replies, each reply uses its own body
+ */
+static char zc_bodies[ZC_REQUESTS][ZC_BODY_SIZE];
+
+/**
+ * The number of the replies created
+ */
+static volatile unsigned int zc_created;
+
+/**
+ * The number of the calls of the free callback
+ */
+static volatile unsigned int zc_freed;
+
+struct CBC
+{
+  char *buf;
+  size_t pos;
+  size_t size;
+};
+
+
+static size_t
+copyBuffer (void *ptr, size_t size, size_t nmemb, void *ctx)
+{
+  struct CBC *cbc = ctx;
+
+  if (cbc->pos + size * nmemb > cbc->size)
+    return 0;                   /* overflow */
+  memcpy (&cbc->buf[cbc->pos], ptr, size * nmemb);
+  cbc->pos += size * nmemb;
+  return size * nmemb;
+}
+
+
+static int
+set_small_rcvbuf (void *clientp,
+                  curl_socket_t curlfd,
+                  curlsocktype purpose)
+{
+  int val = CLIENT_RCV_BUF;
+  (void) clientp; /* Unused. Silence compiler warning. */
+
+  if (CURLSOCKTYPE_IPCXN != purpose)
+    return CURL_SOCKOPT_OK;
+  (void) setsockopt (curlfd, SOL_SOCKET, SO_RCVBUF,
+                     (const void *) &val, sizeof(val));
+  return CURL_SOCKOPT_OK;
+}
+
+
+static void
+fill_body (char *body)
+{
+  size_t i;
+
+  for (i = 0; i < ZC_BODY_SIZE; ++i)
+    body[i] = (char) ('a' + (i % 23));
+}
+
+
+/**
+ * The free callback of the response data.
+ * The data is destroyed: if the data was released while the kernel still
+ * used it for sending, the client would get the damaged body.
+ * @param cls the response data
+ */
+static void
+zc_free_cb (void *cls)
+{
+  memset (cls, 'X', ZC_BODY_SIZE);
+  zc_freed++;
+}
+
+
+static enum MHD_Result
+ahc_zerocopy (void *cls,
+              struct MHD_Connection *connection,
+              const char *url,
+              const char *method,
+              const char *version,
+              const char *upload_data, size_t *upload_data_size,
+              void **req_cls)
+{
+  static int ptr;
+  struct MHD_Response *response;
+  char *body;
+  enum MHD_Result ret;
+  (void) cls;
+  (void) url;
+  (void) method;
+  (void) version;
+  (void) upload_data;
+  (void) upload_data_size;       /* Unused. Silence compiler warning. */
+
+  if (&ptr != *req_cls)
+  {
+    *req_cls = &ptr;
+    return MHD_YES;
+  }
+  *req_cls = NULL;
+  if (ZC_REQUESTS <= zc_created)
+  {
+    fprintf (stderr, "Too many requests.\n");
+    _exit (19);
+  }
+  body = zc_bodies[zc_created++];
+  fill_body (body);
+  response =
+    MHD_create_response_from_buffer_with_free_callback_cls (ZC_BODY_SIZE,
+                                                            body,
+                                                            &zc_free_cb,
+                                                            body);
+  ret = MHD_queue_response (connection,
+                            MHD_HTTP_OK,
+                            response);
+  /* The data must be kept by MHD until the kernel has sent it */
+  MHD_destroy_response (response);
+  if (ret == MHD_NO)
+  {
+    fprintf (stderr, "Failed to queue response.\n");
+    _exit (19);
+  }
+  return ret;
+}
+
+
+static unsigned int
+testZeroCopyGet (uint32_t poll_flag)
+{
+  struct MHD_Daemon *d;
+  CURL *c;
+  char *buf;
+  char *expected;
+  struct CBC cbc;
+  CURLcode errornum;
+  unsigned int ret;
+  unsigned int i;
+
+  if ( (0 == global_port) &&
+       (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_AUTODETECT_BIND_PORT)) )
+    global_port = 1680;
+
+  zc_created = 0;
+  zc_freed = 0;
+  buf = malloc (ZC_BODY_SIZE);
+  expected = malloc (ZC_BODY_SIZE);
+  if ( (NULL == buf) || (NULL == expected) )
+  {
+    free (buf);
+    free (expected);
+    return 1;
+  }
+  fill_body (expected);
+
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG
+                        | (enum MHD_FLAG) poll_flag,
+                        global_port, NULL, NULL,
+                        &ahc_zerocopy, NULL,
+                        MHD_OPTION_ZEROCOPY_THRESHOLD, (size_t) (64 * 1024),
+                        MHD_OPTION_END);
+  if (d == NULL)
+  {
+    free (buf);
+    free (expected);
+    return 16;
+  }
+  if (0 == global_port)
+  {
+    const union MHD_DaemonInfo *dinfo;
+    dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+    if ((NULL == dinfo) || (0 == dinfo->port) )
+    {
+      MHD_stop_daemon (d); free (buf); free (expected); return 32;
+    }
+    global_port = dinfo->port;
+  }
+  c = curl_easy_init ();
+  curl_easy_setopt (c, CURLOPT_URL, "http://127.0.0.1" EXPECTED_URI_PATH);
+  curl_easy_setopt (c, CURLOPT_PORT, (long) global_port);
+  curl_easy_setopt (c, CURLOPT_WRITEFUNCTION, &copyBuffer);
+  curl_easy_setopt (c, CURLOPT_WRITEDATA, &cbc);
+  curl_easy_setopt (c, CURLOPT_SOCKOPTFUNCTION, &set_small_rcvbuf);
+  curl_easy_setopt (c, CURLOPT_BUFFERSIZE, (long) CLIENT_RCV_BUF);
+  /* Read slowly to keep the reply in the server socket buffers */
+  curl_easy_setopt (c, CURLOPT_MAX_RECV_SPEED_LARGE,
+                    (curl_off_t) (4 * 1024 * 1024));
+  curl_easy_setopt (c, CURLOPT_FAILONERROR, 1L);
+  curl_easy_setopt (c, CURLOPT_TIMEOUT, 150L);
+  /* Zero-copy is used only for the replies on the kept-alive connections */
+  curl_easy_setopt (c, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
+  curl_easy_setopt (c, CURLOPT_CONNECTTIMEOUT, 150L);
+  curl_easy_setopt (c, CURLOPT_NOSIGNAL, 1L);
+  ret = 0;
+  for (i = 0; i < ZC_REQUESTS && 0 == ret; ++i)
+  {
+    cbc.buf = buf;
+    cbc.size = ZC_BODY_SIZE;
+    cbc.pos = 0;
+    if (CURLE_OK != (errornum = curl_easy_perform (c)))
+    {
+      fprintf (stderr,
+               "curl_easy_perform failed: `%s'\n",
+               curl_easy_strerror (errornum));
+      ret = 32;
+    }
+    else if ( (cbc.pos != ZC_BODY_SIZE) ||
+              (0 != memcmp (expected, cbc.buf, cbc.pos)) )
+    {
+      fprintf (stderr,
+               "Wrong reply body, received %u bytes.\n",
+               (unsigned int) cbc.pos);
+      ret = 64;
+    }
+  }
+  curl_easy_cleanup (c);
+  MHD_stop_daemon (d);
+  free (buf);
+  free (expected);
+  if (0 != ret)
+    return ret;
+  if (ZC_REQUESTS != zc_freed)
+  {
+    fprintf (stderr,
+             "The response data freed %u times instead of %u.\n",
+             (unsigned int) zc_freed, (unsigned int) ZC_REQUESTS);
+    return 128;
+  }
+  return 0;
+}
+
+
+/**
+ * Check that the data of the connection closed by the timeout is not
+ * released while the kernel still sends it.
+ * The client does not read the reply until the connection is closed by
+ * the server, then the client reads the rest of the queued reply.
+ */
+static unsigned int
+testZeroCopyTimeout (uint32_t poll_flag)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  struct sockaddr_in sa;
+  struct timeval tv;
+  int rcvbuf = CLIENT_RCV_BUF;
+  int s;
+  char *buf;
+  char *expected;
+  const char *body;
+  size_t len;
+  size_t body_len;
+  unsigned int ret;
+  static const char req[] = "GET " EXPECTED_URI_PATH " HTTP/1.1\r\n"
+                            "Host: localhost\r\n\r\n";
+
+  zc_created = 0;
+  zc_freed = 0;
+  buf = malloc (ZC_BODY_SIZE + 1024);
+  expected = malloc (ZC_BODY_SIZE);
+  if ( (NULL == buf) || (NULL == expected) )
+  {
+    free (buf);
+    free (expected);
+    return 1;
+  }
+  fill_body (expected);
+  d = MHD_start_daemon (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG
+                        | (enum MHD_FLAG) poll_flag,
+                        0, NULL, NULL,
+                        &ahc_zerocopy, NULL,
+                        MHD_OPTION_ZEROCOPY_THRESHOLD, (size_t) (64 * 1024),
+                        MHD_OPTION_CONNECTION_TIMEOUT,
+                        (unsigned int) CONN_TIMEOUT_SEC,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    free (buf);
+    free (expected);
+    return 16;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  s = socket (AF_INET, SOCK_STREAM, 0);
+  if ( (NULL == dinfo) || (0 == dinfo->port) || (0 > s) )
+  {
+    if (0 <= s)
+      close (s);
+    MHD_stop_daemon (d); free (buf); free (expected); return 32;
+  }
+  tv.tv_sec = 5;
+  tv.tv_usec = 0;
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (dinfo->port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  (void) setsockopt (s, SOL_SOCKET, SO_RCVBUF,
+                     (const void *) &rcvbuf, sizeof(rcvbuf));
+  ret = 0;
+  if ( (0 != setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != connect (s, (struct sockaddr *) &sa, sizeof(sa))) ||
+       ((ssize_t) (sizeof(req) - 1) != send (s, req, sizeof(req) - 1, 0)) )
+  {
+    fprintf (stderr, "Failed to send the request: %s\n", strerror (errno));
+    ret = 32;
+  }
+  /* Let the server close the connection by the timeout */
+  if (0 == ret)
+    (void) usleep ((CONN_TIMEOUT_SEC * 1000 + 500) * 1000);
+  len = 0;
+  while ( (0 == ret) && (ZC_BODY_SIZE + 1024 > len) )
+  {
+    ssize_t res;
+
+    res = recv (s, buf + len, ZC_BODY_SIZE + 1024 - len, 0);
+    if (0 == res)
+      break;
+    if (0 > res)
+    {
+      fprintf (stderr, "Failed to receive the reply: %s\n",
+               strerror (errno));
+      ret = 32;
+      break;
+    }
+    len += (size_t) res;
+  }
+  close (s);
+  MHD_stop_daemon (d);
+  if (0 == ret)
+  {
+    body = NULL;
+    if (4 <= len)
+    {
+      size_t i;
+
+      for (i = 0; i <= len - 4; ++i)
+      {
+        if (0 == memcmp (buf + i, "\r\n\r\n", 4))
+        {
+          body = buf + i + 4;
+          break;
+        }
+      }
+    }
+    body_len = (NULL == body) ? 0 : (size_t) (buf + len - body);
+    if ( (0 == body_len) || (ZC_BODY_SIZE < body_len) )
+    {
+      fprintf (stderr, "Wrong reply, received %u bytes.\n",
+               (unsigned int) len);
+      ret = 64;
+    }
+    else if (0 != memcmp (expected, body, body_len))
+    {
+      fprintf (stderr, "The reply body has been damaged after the "
+               "connection timeout, %u bytes received.\n",
+               (unsigned int) body_len);
+      ret = 64;
+    }
+  }
+  free (buf);
+  free (expected);
+  if (0 != ret)
+    return ret;
+  if (1 != zc_freed)
+  {
+    fprintf (stderr,
+             "The response data freed %u times instead of 1.\n",
+             (unsigned int) zc_freed);
+    return 128;
+  }
+  return 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  unsigned int errorCount = 0;
+  (void) argc; (void) argv; /* Unused. Silence compiler warning. */
+
+  if (0 != curl_global_init (CURL_GLOBAL_WIN32))
+    return 2;
+  errorCount += testZeroCopyGet (0);
+  errorCount += testZeroCopyTimeout (0);
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_POLL))
+  {
+    errorCount += testZeroCopyGet (MHD_USE_POLL);
+    errorCount += testZeroCopyTimeout (MHD_USE_POLL);
+  }
+  if (MHD_YES == MHD_is_feature_supported (MHD_FEATURE_EPOLL))
+  {
+    errorCount += testZeroCopyGet (MHD_USE_EPOLL);
+    errorCount += testZeroCopyTimeout (MHD_USE_EPOLL);
+  }
+  if (0 != errorCount)
+    fprintf (stderr,
+             "Error (code: %u)\n",
+             errorCount);
+  curl_global_cleanup ();
+  return (0 == errorCount) ? 0 : 1;       /* 0 == pass */
+}
@@ -0,0 +1,398 @@
+/*
+    This file is part of GNU libmicrohttpd
+    Copyright (C) 2026 agent
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions
+    are met:
+    1. Redistributions of source code must retain the above copyright
+       notice unmodified, this list of conditions and the following
+       disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in
+       the documentation and/or other materials provided with the
+       distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+    IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+    OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+    THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file tools/perf_idle_conns.c
+ * @brief  Measure the cost of the MHD event loop pass with many idle
+ *         connections.
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "microhttpd.h"
+#include "mhd_tool_str_to_uint.h"
+
+#define PERF_IDLE_ERR_CODE_BAD_PARAM 65
+
+/**
+ * The number of the file descriptors reserved for the other needs
+ */
+#define PERF_IDLE_RESERVED_FDS 64
+
+/**
+ * The number of the connections opened before running the daemon
+ * to accept them
+ */
+#define PERF_IDLE_CONNECT_BATCH 64
+
+/**
+ * The maximum number of the connections with select(): every connection
+ * uses two FDs, all FDs must fit the FD sets
+ */
+#define PERF_IDLE_SELECT_MAX_CONNS \
+  ((FD_SETSIZE - PERF_IDLE_RESERVED_FDS) / 2)
+
+/* Parameters */
+static unsigned int param_conns = 100000;
+static unsigned int param_iterations = 1000;
+static int param_epoll = 0;
+
+/* The client sockets */
+static int *clients = NULL;
+static unsigned int num_clients = 0;
+
+
+static void
+print_help (const char *self_name)
+{
+  printf ("Usage: %s [OPTIONS]\n", self_name);
+  printf ("Measure the cost of the event loop pass with many idle "
+          "connections.\n\n");
+  printf ("  -c NUM, --connections=NUM  the number of the idle connections "
+          "(default: %u),\n"
+          "                             limited by the number of "
+          "the available FDs\n", param_conns);
+  printf ("  -i NUM, --iterations=NUM   the number of the measured event "
+          "loop passes\n"
+          "                             (default: %u)\n", param_iterations);
+  printf ("  -e, --epoll                use epoll instead of select()\n");
+  printf ("  -h, --help                 print this help\n");
+  printf ("\nWith select() the number of the connections is capped at %u\n"
+          "(FD_SETSIZE is %u), use --epoll for the larger numbers of "
+          "the connections.\n",
+          (unsigned int) PERF_IDLE_SELECT_MAX_CONNS,
+          (unsigned int) FD_SETSIZE);
+}
+
+
+static enum MHD_Result
+ahc_idle (void *cls,
+          struct MHD_Connection *connection,
+          const char *url,
+          const char *method,
+          const char *version,
+          const char *upload_data, size_t *upload_data_size,
+          void **req_cls)
+{
+  (void) cls; (void) connection; (void) url; (void) method;
+  (void) version; (void) upload_data; (void) upload_data_size;
+  (void) req_cls;
+  return MHD_NO; /* The connections are idle, no requests expected */
+}
+
+
+static int
+get_num_param (const char *name, const char *str, unsigned int *value)
+{
+  if ( (NULL == str) ||
+       (0 == mhd_tool_str_to_uint (str, value)) ||
+       (0 != str[mhd_tool_str_to_uint (str, value)]) ||
+       (0 == *value) )
+  {
+    fprintf (stderr, "Wrong value for parameter '%s'.\n", name);
+    return 0;
+  }
+  return ! 0;
+}
+
+
+static int
+process_params (int argc, char *const *argv)
+{
+  int i;
+  for (i = 1; i < argc; ++i)
+  {
+    const char *const p = argv[i];
+    if ((0 == strcmp (p, "-h")) || (0 == strcmp (p, "--help")))
+    {
+      print_help (argv[0]);
+      exit (0);
+    }
+    else if ((0 == strcmp (p, "-e")) || (0 == strcmp (p, "--epoll")))
+      param_epoll = ! 0;
+    else if (0 == strcmp (p, "-c"))
+    {
+      if (! get_num_param (p, argv[++i], &param_conns))
+        return 0;
+    }
+    else if (0 == strncmp (p, "--connections=", 14))
+    {
+      if (! get_num_param ("--connections", p + 14, &param_conns))
+        return 0;
+    }
+    else if (0 == strcmp (p, "-i"))
+    {
+      if (! get_num_param (p, argv[++i], &param_iterations))
+        return 0;
+    }
+    else if (0 == strncmp (p, "--iterations=", 13))
+    {
+      if (! get_num_param ("--iterations", p + 13, &param_iterations))
+        return 0;
+    }
+    else
+    {
+      fprintf (stderr, "Unrecognised parameter: '%s'.\n", p);
+      return 0;
+    }
+  }
+  return ! 0;
+}
+
+
+/**
+ * Raise the limit of the open files as much as allowed and reduce
+ * the number of the connections to fit the limit.
+ * Every connection uses two FDs: the client side and the server side.
+ */
+static void
+fit_conns_to_fd_limit (void)
+{
+  struct rlimit rl;
+  unsigned int max_conns;
+
+  if (0 != getrlimit (RLIMIT_NOFILE, &rl))
+    return;
+  if (rl.rlim_cur < rl.rlim_max)
+  {
+    rl.rlim_cur = rl.rlim_max;
+    if (0 != setrlimit (RLIMIT_NOFILE, &rl))
+      (void) getrlimit (RLIMIT_NOFILE, &rl);
+  }
+  if ((! param_epoll) && (PERF_IDLE_SELECT_MAX_CONNS < param_conns))
+  {
+    printf ("The number of connections is reduced from %u to %u to fit "
+            "select() FD sets (FD_SETSIZE is %u).\n", param_conns,
+            (unsigned int) PERF_IDLE_SELECT_MAX_CONNS,
+            (unsigned int) FD_SETSIZE);
+    param_conns = PERF_IDLE_SELECT_MAX_CONNS;
+  }
+  if ((RLIM_INFINITY == rl.rlim_cur) ||
+      (((rlim_t) param_conns) * 2 + PERF_IDLE_RESERVED_FDS <= rl.rlim_cur))
+    return;
+  if (PERF_IDLE_RESERVED_FDS + 2 > rl.rlim_cur)
+    max_conns = 1;
+  else
+    max_conns = (unsigned int) ((rl.rlim_cur - PERF_IDLE_RESERVED_FDS) / 2);
+  printf ("The number of connections is reduced from %u to %u to fit "
+          "the limit of the open files.\n", param_conns, max_conns);
+  param_conns = max_conns;
+}
+
+
+static uint64_t
+get_time_ns (void)
+{
+  struct timespec ts;
+  if (0 != clock_gettime (CLOCK_MONOTONIC, &ts))
+    return 0;
+  return ((uint64_t) ts.tv_sec) * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+static unsigned int
+get_num_conns (struct MHD_Daemon *d)
+{
+  const union MHD_DaemonInfo *dinfo;
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_CURRENT_CONNECTIONS);
+  if (NULL == dinfo)
+    return 0;
+  return dinfo->num_connections;
+}
+
+
+/**
+ * Open the idle client connections and let the daemon accept them.
+ * @return non-zero on success, zero on error
+ */
+static int
+open_clients (struct MHD_Daemon *d, uint16_t port)
+{
+  struct sockaddr_in sa;
+
+  memset (&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons (port);
+  sa.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+  clients = (int *) malloc (sizeof(int) * param_conns);
+  if (NULL == clients)
+  {
+    fprintf (stderr, "Out of memory.\n");
+    return 0;
+  }
+  while (num_clients < param_conns)
+  {
+    unsigned int batch_end = num_clients + PERF_IDLE_CONNECT_BATCH;
+    unsigned int spins;
+    if (batch_end > param_conns)
+      batch_end = param_conns;
+    for ( ; num_clients < batch_end; ++num_clients)
+    {
+      const int fd = socket (AF_INET, SOCK_STREAM, 0);
+      if (0 > fd)
+      {
+        fprintf (stderr, "Failed to create socket: %s\n", strerror (errno));
+        return 0;
+      }
+      clients[num_clients] = fd;
+      (void) fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+      if ((0 != connect (fd, (struct sockaddr *) &sa, sizeof(sa))) &&
+          (EINPROGRESS != errno))
+      {
+        fprintf (stderr, "Failed to connect: %s\n", strerror (errno));
+        close (fd);
+        return 0;
+      }
+    }
+    /* Let the daemon accept the connections */
+    for (spins = 0; get_num_conns (d) < num_clients; ++spins)
+    {
+      if (MHD_YES != MHD_run_wait (d, 10))
+      {
+        fprintf (stderr, "MHD_run_wait() failed.\n");
+        return 0;
+      }
+      if (1000 < spins)
+      {
+        fprintf (stderr, "The daemon has accepted only %u connections "
+                 "of %u.\n", get_num_conns (d), num_clients);
+        return 0;
+      }
+    }
+  }
+  return ! 0;
+}
+
+
+static void
+close_clients (void)
+{
+  unsigned int i;
+  for (i = 0; i < num_clients; ++i)
+    close (clients[i]);
+  free (clients);
+  clients = NULL;
+  num_clients = 0;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  struct MHD_Daemon *d;
+  const union MHD_DaemonInfo *dinfo;
+  unsigned int i;
+  uint64_t start;
+  uint64_t elapsed;
+  int ret;
+
+  if (! process_params (argc, argv))
+    return PERF_IDLE_ERR_CODE_BAD_PARAM;
+  if (param_epoll &&
+      (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_EPOLL)))
+  {
+    fprintf (stderr, "epoll is not supported by MHD on this platform.\n");
+    return PERF_IDLE_ERR_CODE_BAD_PARAM;
+  }
+  fit_conns_to_fd_limit ();
+
+  d = MHD_start_daemon ((param_epoll ? MHD_USE_EPOLL : MHD_NO_FLAG)
+                        | MHD_USE_ERROR_LOG,
+                        0, NULL, NULL,
+                        &ahc_idle, NULL,
+                        MHD_OPTION_CONNECTION_LIMIT,
+                        (unsigned int) (param_conns + 1),
+                        MHD_OPTION_CONNECTION_MEMORY_LIMIT, (size_t) 4096,
+                        MHD_OPTION_CONNECTION_TIMEOUT, (unsigned int) 0,
+                        MHD_OPTION_LISTEN_BACKLOG_SIZE,
+                        (unsigned int) PERF_IDLE_CONNECT_BATCH * 2,
+                        MHD_OPTION_END);
+  if (NULL == d)
+  {
+    fprintf (stderr, "Failed to start the daemon.\n");
+    return 99;
+  }
+  dinfo = MHD_get_daemon_info (d, MHD_DAEMON_INFO_BIND_PORT);
+  if ((NULL == dinfo) || (0 == dinfo->port))
+  {
+    fprintf (stderr, "Failed to get the daemon port.\n");
+    MHD_stop_daemon (d);
+    return 99;
+  }
+
+  ret = 0;
+  if (open_clients (d, dinfo->port))
+  {
+    /* Warm up */
+    for (i = 0; i < 10; ++i)
+      (void) MHD_run_wait (d, 0);
+    start = get_time_ns ();
+    for (i = 0; i < param_iterations; ++i)
+    {
+      if (MHD_YES != MHD_run_wait (d, 0))
+      {
+        fprintf (stderr, "MHD_run_wait() failed.\n");
+        ret = 99;
+        break;
+      }
+    }
+    elapsed = get_time_ns () - start;
+    if (0 == ret)
+    {
+      const double per_pass = ((double) elapsed) / param_iterations;
+      printf ("%s, %u idle connections, %u passes:\n",
+              param_epoll ? "epoll" : "select()", num_clients,
+              param_iterations);
+      printf ("  %.0f ns per event loop pass\n", per_pass);
+      printf ("  %.2f ns per connection per pass\n",
+              per_pass / num_clients);
+      printf ("  %.0f ns per pass per 100000 connections\n",
+              per_pass * 100000.0 / num_clients);
+    }
+  }
+  else
+    ret = 99;
+
+  close_clients ();
+  MHD_stop_daemon (d);
+  return ret;
+}
@@ -0,0 +1,264 @@
+/*
+    This file is part of GNU libmicrohttpd
+    Copyright (C) 2026 agent
+
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions
+    are met:
+    1. Redistributions of source code must retain the above copyright
+       notice unmodified, this list of conditions and the following
+       disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright
+       notice, this list of conditions and the following disclaimer in
+       the documentation and/or other materials provided with the
+       distribution.
+
+    THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+    IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+    OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+    IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+    INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+    (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+    LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+    ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+    (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+    THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/**
+ * @file tools/perf_startup.c
+ * @brief  Measure the time needed to start and to stop the MHD daemon.
+ * @author agent
+ */
+
+#include "mhd_options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "microhttpd.h"
+#include "mhd_tool_str_to_uint.h"
+
+#define PERF_START_ERR_CODE_BAD_PARAM 65
+
+/* Parameters */
+static unsigned int param_iterations = 1000;
+static unsigned int param_threads = 0;
+static unsigned int param_nonce_nc_size = 0;
+static int param_epoll = 0;
+static int param_external = 0;
+
+
+static void
+print_help (const char *self_name)
+{
+  printf ("Usage: %s [OPTIONS]\n", self_name);
+  printf ("Measure the time needed to start and to stop the daemon.\n\n");
+  printf ("  -i NUM, --iterations=NUM   the number of the daemons started "
+          "and stopped\n"
+          "                             (default: %u)\n", param_iterations);
+  printf ("  -t NUM, --threads=NUM      the size of the thread pool "
+          "(default: no pool)\n");
+  printf ("  -n NUM, --nonce-nc=NUM     the size of the nonce-nc map "
+          "(default: MHD default)\n");
+  printf ("  -e, --epoll                use epoll instead of select()\n");
+  printf ("  -x, --external             use the external polling instead "
+          "of the internal\n"
+          "                             thread\n");
+  printf ("  -h, --help                 print this help\n");
+}
+
+
+static enum MHD_Result
+ahc_empty (void *cls,
+           struct MHD_Connection *connection,
+           const char *url,
+           const char *method,
+           const char *version,
+           const char *upload_data, size_t *upload_data_size,
+           void **req_cls)
+{
+  (void) cls; (void) connection; (void) url; (void) method;
+  (void) version; (void) upload_data; (void) upload_data_size;
+  (void) req_cls;
+  return MHD_NO; /* No requests expected */
+}
+
+
+static int
+get_num_param (const char *name, const char *str, unsigned int *value)
+{
+  if ( (NULL == str) ||
+       (0 == mhd_tool_str_to_uint (str, value)) ||
+       (0 != str[mhd_tool_str_to_uint (str, value)]) )
+  {
+    fprintf (stderr, "Wrong value for parameter '%s'.\n", name);
+    return 0;
+  }
+  return ! 0;
+}
+
+
+static int
+process_params (int argc, char *const *argv)
+{
+  int i;
+  for (i = 1; i < argc; ++i)
+  {
+    const char *const p = argv[i];
+    if ((0 == strcmp (p, "-h")) || (0 == strcmp (p, "--help")))
+    {
+      print_help (argv[0]);
+      exit (0);
+    }
+    else if ((0 == strcmp (p, "-e")) || (0 == strcmp (p, "--epoll")))
+      param_epoll = ! 0;
+    else if ((0 == strcmp (p, "-x")) || (0 == strcmp (p, "--external")))
+      param_external = ! 0;
+    else if (0 == strcmp (p, "-i"))
+    {
+      if (! get_num_param (p, argv[++i], &param_iterations))
+        return 0;
+    }
+    else if (0 == strncmp (p, "--iterations=", 13))
+    {
+      if (! get_num_param ("--iterations", p + 13, &param_iterations))
+        return 0;
+    }
+    else if (0 == strcmp (p, "-t"))
+    {
+      if (! get_num_param (p, argv[++i], &param_threads))
+        return 0;
+    }
+    else if (0 == strncmp (p, "--threads=", 10))
+    {
+      if (! get_num_param ("--threads", p + 10, &param_threads))
+        return 0;
+    }
+    else if (0 == strcmp (p, "-n"))
+    {
+      if (! get_num_param (p, argv[++i], &param_nonce_nc_size))
+        return 0;
+    }
+    else if (0 == strncmp (p, "--nonce-nc=", 11))
+    {
+      if (! get_num_param ("--nonce-nc", p + 11, &param_nonce_nc_size))
+        return 0;
+    }
+    else
+    {
+      fprintf (stderr, "Unrecognised parameter: '%s'.\n", p);
+      return 0;
+    }
+  }
+  if (0 == param_iterations)
+  {
+    fprintf (stderr, "The number of iterations must not be zero.\n");
+    return 0;
+  }
+  if (param_external && (0 != param_threads))
+  {
+    fprintf (stderr, "The thread pool cannot be used with "
+             "the external polling.\n");
+    return 0;
+  }
+  return ! 0;
+}
+
+
+static uint64_t
+get_time_ns (void)
+{
+  struct timespec ts;
+  if (0 != clock_gettime (CLOCK_MONOTONIC, &ts))
+    return 0;
+  return ((uint64_t) ts.tv_sec) * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+int
+main (int argc, char *const *argv)
+{
+  struct MHD_OptionItem ops[3];
+  unsigned int num_ops;
+  unsigned int flags;
+  unsigned int i;
+  uint64_t start_total;
+  uint64_t stop_total;
+  uint64_t start_max;
+
+  if (! process_params (argc, argv))
+    return PERF_START_ERR_CODE_BAD_PARAM;
+  if (param_epoll &&
+      (MHD_NO == MHD_is_feature_supported (MHD_FEATURE_EPOLL)))
+  {
+    fprintf (stderr, "epoll is not supported by MHD on this platform.\n");
+    return PERF_START_ERR_CODE_BAD_PARAM;
+  }
+
+  flags = (param_epoll ? MHD_USE_EPOLL : MHD_NO_FLAG) | MHD_USE_ERROR_LOG;
+  if (! param_external)
+    flags |= MHD_USE_INTERNAL_POLLING_THREAD;
+  num_ops = 0;
+  if (0 != param_threads)
+  {
+    ops[num_ops].option = MHD_OPTION_THREAD_POOL_SIZE;
+    ops[num_ops].value = (intptr_t) param_threads;
+    ops[num_ops].ptr_value = NULL;
+    ++num_ops;
+  }
+  if (0 != param_nonce_nc_size)
+  {
+    ops[num_ops].option = MHD_OPTION_NONCE_NC_SIZE;
+    ops[num_ops].value = (intptr_t) param_nonce_nc_size;
+    ops[num_ops].ptr_value = NULL;
+    ++num_ops;
+  }
+  ops[num_ops].option = MHD_OPTION_END;
+  ops[num_ops].value = 0;
+  ops[num_ops].ptr_value = NULL;
+
+  start_total = 0;
+  stop_total = 0;
+  start_max = 0;
+  for (i = 0; i < param_iterations; ++i)
+  {
+    struct MHD_Daemon *d;
+    uint64_t t1;
+    uint64_t t2;
+    uint64_t t3;
+
+    t1 = get_time_ns ();
+    d = MHD_start_daemon (flags,
+                          0, NULL, NULL,
+                          &ahc_empty, NULL,
+                          MHD_OPTION_ARRAY, ops,
+                          MHD_OPTION_END);
+    t2 = get_time_ns ();
+    if (NULL == d)
+    {
+      fprintf (stderr, "Failed to start the daemon.\n");
+      return 99;
+    }
+    MHD_stop_daemon (d);
+    t3 = get_time_ns ();
+    start_total += t2 - t1;
+    stop_total += t3 - t2;
+    if (t2 - t1 > start_max)
+      start_max = t2 - t1;
+  }
+  printf ("%s, %s, %u daemons:\n",
+          param_epoll ? "epoll" : "select()",
+          param_external ? "external polling" :
+          ((0 != param_threads) ? "thread pool" : "internal thread"),
+          param_iterations);
+  if (0 != param_threads)
+    printf ("  %u worker threads\n", param_threads);
+  printf ("  %.1f us per daemon start (max %.1f us)\n",
+          ((double) start_total) / param_iterations / 1000.0,
+          ((double) start_max) / 1000.0);
+  printf ("  %.1f us per daemon stop\n",
+          ((double) stop_total) / param_iterations / 1000.0);
+  return 0;
+}